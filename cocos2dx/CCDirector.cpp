@@ -57,6 +57,7 @@ THE SOFTWARE.
 #include "sprite_nodes/CCAnimationCache.h"
 #include "touch_dispatcher/CCTouch.h"
 #include "support/user_default/CCUserDefault.h"
+#include "support/res/CCResourceLoader.h"
 #include "shaders/ccGLStateCache.h"
 #include "shaders/CCShaderCache.h"
 #include "kazmath/kazmath.h"
@@ -65,6 +66,7 @@ THE SOFTWARE.
 #include "platform/CCImage.h"
 #include "CCEGLView.h"
 #include "CCConfiguration.h"
+#include "CCRenderQueue.h"
 
 /**
  Position of the FPS
@@ -78,6 +80,7 @@ THE SOFTWARE.
 using namespace std;
 
 unsigned int g_uNumberOfDraws = 0;
+unsigned int g_uNumberOfUploadedBytes = 0;
 
 NS_CC_BEGIN
 // XXX it should be a Director ivar. Move it there once support for multiple directors is added
@@ -113,6 +116,9 @@ bool CCDirector::init(void)
 {
 	setDefaultValues();
 
+    // director is initialized in GL thread
+    CCSlabAllocator::setGLThread();
+
     // scenes
     m_pRunningScene = NULL;
     m_pNextScene = NULL;
@@ -124,6 +130,9 @@ bool CCDirector::init(void)
 
     // projection delegate if "Custom" projection is used
     m_pProjectionDelegate = NULL;
+    
+    // render queue is created when first frame is drawn with auto batching
+    m_pRenderQueue = NULL;
 
     // FPS
     m_fAccumDt = 0.0f;
@@ -132,6 +141,7 @@ bool CCDirector::init(void)
     m_pSPFLabel = NULL;
     m_pDrawsLabel = NULL;
     m_uTotalFrames = m_uFrames = 0;
+    m_uUploadedBytes = 0;
     m_pszFPS = new char[10];
     m_pLastUpdate = new struct cc_timeval();
     m_fSecondsPerFrame = 0.0f;
@@ -184,6 +194,7 @@ CCDirector::~CCDirector(void)
     CC_SAFE_RELEASE(m_pActionManager);
     CC_SAFE_RELEASE(m_pTouchDispatcher);
     CC_SAFE_RELEASE(m_pKeypadDispatcher);
+    CC_SAFE_RELEASE(m_pRenderQueue);
     CC_SAFE_DELETE(m_pAccelerometer);
 
     // pop the autorelease pool
@@ -221,6 +232,9 @@ void CCDirector::setDefaultValues(void)
 	// Display FPS
 	m_bDisplayStats = conf->getBool("cocos2d.x.display_fps", false);
 
+	// Automatic batching of sprites
+	m_bAutoBatchEnabled = conf->getBool("cocos2d.x.auto_batch", false);
+
 	// GL projection
 	const char *projection = conf->getCString("cocos2d.x.gl.projection", "3d");
 	if( strcmp(projection, "3d") == 0 )
@@ -259,13 +273,17 @@ void CCDirector::setGLDefaultValues(void)
 // Draw the Scene
 void CCDirector::drawScene(void)
 {
+    CC_PROFILER_BEGIN_FRAME();
+
     // calculate "global" dt
     calculateDeltaTime();
 
     //tick before glClear: issue #533
     if (! m_bPaused)
     {
+        CC_PROFILER_START("CCDirector - update");
         m_pScheduler->update(m_fDeltaTime);
+        CC_PROFILER_STOP("CCDirector - update");
     }
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -279,6 +297,21 @@ void CCDirector::drawScene(void)
 
     kmGLPushMatrix();
 
+    // collect sprite quads in render queue if auto batching is enabled
+    CCRenderQueue* pQueue = NULL;
+    if (m_bAutoBatchEnabled)
+    {
+        if (!m_pRenderQueue)
+        {
+            m_pRenderQueue = new CCRenderQueue();
+            m_pRenderQueue->init();
+        }
+        pQueue = m_pRenderQueue;
+        pQueue->begin();
+    }
+
+    CC_PROFILER_START("CCDirector - visit");
+
     // draw the scene
     if (m_pRunningScene)
     {
@@ -291,11 +324,23 @@ void CCDirector::drawScene(void)
         m_pNotificationNode->visit();
     }
     
+    // draw pending quads
+    if (pQueue)
+    {
+        pQueue->end();
+    }
+
+    CC_PROFILER_STOP("CCDirector - visit");
+    
     if (m_bDisplayStats)
     {
         showStats();
     }
     
+    // bytes are counted even if stats are not displayed
+    m_uUploadedBytes = g_uNumberOfUploadedBytes;
+    g_uNumberOfUploadedBytes = 0;
+    
     kmGLPopMatrix();
 
     m_uTotalFrames++;
@@ -740,6 +785,9 @@ void CCDirector::purgeDirector()
     // purge bitmap cache
     CCLabelBMFont::purgeCachedData();
 
+    // loading threads use caches and file utils
+    CCResourceLoader::stopLoadingThreads();
+    
     // purge all managed caches
     ccDrawFree();
     CCAnimationCache::purgeSharedAnimationCache();
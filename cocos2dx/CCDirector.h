@@ -78,6 +78,7 @@ class CCActionManager;
 class CCTouchDispatcher;
 class CCKeypadDispatcher;
 class CCAccelerometer;
+class CCRenderQueue;
 
 /**
 @brief Class that creates and handle the main Window and manages how
@@ -138,6 +139,23 @@ public:
     
     /** seconds per frame */
     inline float getSecondsPerFrame() { return m_fSecondsPerFrame; }
+    
+    /** Whether or not sprites are batched automatically when drawing scene */
+    inline bool isAutoBatchEnabled(void) { return m_bAutoBatchEnabled; }
+    /** Enable automatic batching, then consecutive sprites sharing same texture, shader and blend
+     function are drawn with one draw call even if they are not in a CCSpriteBatchNode.
+     Default is false, it can also be set by "cocos2d.x.auto_batch" in configuration
+     @since v2.2
+     */
+    inline void setAutoBatchEnabled(bool bEnabled) { m_bAutoBatchEnabled = bEnabled; }
+    
+    /** Render queue used by automatic batching, it is NULL until the first frame is drawn
+     with automatic batching enabled
+     @since v2.2
+     @js NA
+     @lua NA
+     */
+    inline CCRenderQueue* getRenderQueue(void) { return m_pRenderQueue; }
 
     /** Get the CCEGLView, where everything is rendered
      * @js NA
@@ -154,6 +172,11 @@ public:
     /** How many frames were called since the director started */
     inline unsigned int getTotalFrames(void) { return m_uTotalFrames; }
     
+    /** Bytes of vertex data uploaded to GL buffers in last frame
+     @since v2.2
+     */
+    inline unsigned int getUploadedBytes(void) { return m_uUploadedBytes; }
+    
     /** Sets an OpenGL projection
      @since v0.8.2
      @js NA
@@ -330,7 +353,8 @@ public:
     void setContentScaleFactor(float scaleFactor);
     float getContentScaleFactor(void);
     
-    // set global encrypt/decrypt functions
+    // set global encrypt/decrypt functions, resource decrypt function is also called in
+    // loading threads of CCResourceLoader so it must be thread safe
     void setResDecrypt(CC_DECRYPT_FUNC dec);
     void setUserDefaultDecrypt(CC_DECRYPT_FUNC dec);
     void setUserDefaultEncrypt(CC_ENCRYPT_FUNC enc);
@@ -409,6 +433,7 @@ protected:
 
     /* How many frames were called since the director started */
     unsigned int m_uTotalFrames;
+    unsigned int m_uUploadedBytes;
     unsigned int m_uFrames;
     float m_fSecondsPerFrame;
      
@@ -449,6 +474,12 @@ protected:
     /* Projection protocol delegate */
     CCDirectorDelegate *m_pProjectionDelegate;
     
+    /* whether or not sprites are batched automatically */
+    bool m_bAutoBatchEnabled;
+    
+    /* render queue for automatic batching, created lazily */
+    CCRenderQueue *m_pRenderQueue;
+    
     // CCEGLViewProtocol will recreate stats labels to fit visible rect
     friend class CCEGLViewProtocol;
 };
@@ -0,0 +1,190 @@
+/****************************************************************************
+Copyright (c) 2010-2012 cocos2d-x.org
+
+http://www.cocos2d-x.org
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+#include "CCRenderQueue.h"
+#include "ccMacros.h"
+#include "textures/CCTexture2D.h"
+#include "textures/CCTextureAtlas.h"
+#include "shaders/CCGLProgram.h"
+#include "shaders/CCShaderCache.h"
+#include "shaders/ccGLStateCache.h"
+#include "kazmath/GL/matrix.h"
+
+NS_CC_BEGIN
+
+// initial capacity of quads, it grows when needed
+#define kCCRenderQueueDefaultCapacity 128
+
+// indices are GLushort so one draw can't have more quads
+#define kCCRenderQueueMaxCapacity (65536 / 4)
+
+static CCRenderQueue* s_pCurrentQueue = NULL;
+
+CCRenderQueue::CCRenderQueue()
+: m_pAtlas(NULL)
+, m_pTexture(NULL)
+, m_pProgram(NULL)
+, m_bFlushing(false)
+, m_uQuads(0)
+, m_uDraws(0)
+, m_uLastQuads(0)
+, m_uLastDraws(0)
+{
+    m_tBlendFunc.src = CC_BLEND_SRC;
+    m_tBlendFunc.dst = CC_BLEND_DST;
+}
+
+CCRenderQueue::~CCRenderQueue()
+{
+    if(s_pCurrentQueue == this)
+    {
+        s_pCurrentQueue = NULL;
+    }
+    CC_SAFE_RELEASE(m_pAtlas);
+}
+
+CCRenderQueue* CCRenderQueue::create()
+{
+    CCRenderQueue* pRet = new CCRenderQueue();
+    if(pRet && pRet->init())
+    {
+        CC_SAFE_AUTORELEASE(pRet);
+        return pRet;
+    }
+    CC_SAFE_DELETE(pRet);
+    return NULL;
+}
+
+bool CCRenderQueue::init()
+{
+    m_pAtlas = new CCTextureAtlas();
+    return m_pAtlas->initWithTexture(NULL, kCCRenderQueueDefaultCapacity);
+}
+
+CCRenderQueue* CCRenderQueue::currentQueue()
+{
+    return s_pCurrentQueue;
+}
+
+void CCRenderQueue::begin()
+{
+    m_uQuads = 0;
+    m_uDraws = 0;
+    m_pAtlas->removeAllQuads();
+    s_pCurrentQueue = this;
+}
+
+void CCRenderQueue::end()
+{
+    flush();
+    s_pCurrentQueue = NULL;
+
+    m_uLastQuads = m_uQuads;
+    m_uLastDraws = m_uDraws;
+}
+
+bool CCRenderQueue::appendQuad(const ccV3F_C4B_T2F_Quad& quad, CCTexture2D* texture, CCGLProgram* program, const ccBlendFunc& blendFunc)
+{
+    // only builtin shader without custom uniforms can be merged
+    if(!texture || program != CCShaderCache::sharedShaderCache()->programForKey(kCCShader_PositionTextureColor))
+    {
+        flush();
+        return false;
+    }
+
+    unsigned int total = m_pAtlas->getTotalQuads();
+    if(total > 0 &&
+       (texture != m_pTexture ||
+        program != m_pProgram ||
+        blendFunc.src != m_tBlendFunc.src ||
+        blendFunc.dst != m_tBlendFunc.dst))
+    {
+        flush();
+        total = 0;
+    }
+    else if(total == kCCRenderQueueMaxCapacity)
+    {
+        flush();
+        total = 0;
+    }
+
+    // grow capacity
+    if(total == m_pAtlas->getCapacity())
+    {
+        if(!m_pAtlas->resizeCapacity(MIN(total * 2, kCCRenderQueueMaxCapacity)))
+        {
+            return false;
+        }
+    }
+
+    m_pTexture = texture;
+    m_pProgram = program;
+    m_tBlendFunc = blendFunc;
+
+    // transform vertices to world space, so model view matrix can be identity when flushing
+    kmMat4 mv;
+    kmGLGetMatrix(KM_GL_MODELVIEW, &mv);
+    const float* m = mv.mat;
+    ccV3F_C4B_T2F_Quad q = quad;
+    ccV3F_C4B_T2F* src = (ccV3F_C4B_T2F*)&quad;
+    ccV3F_C4B_T2F* dst = (ccV3F_C4B_T2F*)&q;
+    for(int i = 0; i < 4; i++)
+    {
+        const ccVertex3F& v = src[i].vertices;
+        dst[i].vertices.x = m[0] * v.x + m[4] * v.y + m[8] * v.z + m[12];
+        dst[i].vertices.y = m[1] * v.x + m[5] * v.y + m[9] * v.z + m[13];
+        dst[i].vertices.z = m[2] * v.x + m[6] * v.y + m[10] * v.z + m[14];
+    }
+    m_pAtlas->updateQuad(&q, total);
+
+    m_uQuads++;
+    return true;
+}
+
+void CCRenderQueue::flush()
+{
+    if(m_bFlushing || m_pAtlas->getTotalQuads() == 0)
+        return;
+
+    m_bFlushing = true;
+
+    kmGLPushMatrix();
+    kmGLLoadIdentity();
+
+    m_pProgram->use();
+    m_pProgram->setUniformsForBuiltins();
+    ccGLBlendFunc(m_tBlendFunc.src, m_tBlendFunc.dst);
+
+    m_pAtlas->setTexture(m_pTexture);
+    m_pAtlas->drawQuads();
+    m_pAtlas->removeAllQuads();
+    m_pAtlas->setTexture(NULL);
+
+    kmGLPopMatrix();
+
+    m_uDraws++;
+    m_bFlushing = false;
+}
+
+NS_CC_END
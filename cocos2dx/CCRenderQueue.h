@@ -0,0 +1,130 @@
+/****************************************************************************
+Copyright (c) 2010-2012 cocos2d-x.org
+
+http://www.cocos2d-x.org
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+#ifndef __CCRENDERQUEUE_H__
+#define __CCRENDERQUEUE_H__
+
+#include "cocoa/CCObject.h"
+#include "ccTypes.h"
+
+NS_CC_BEGIN
+
+class CCTexture2D;
+class CCGLProgram;
+class CCTextureAtlas;
+
+/**
+ * @addtogroup global
+ * @{
+ */
+
+/**
+ * @brief Queue of sprite quads collected during CCNode::visit
+ *
+ * When the director enables auto batching, CCSprite::draw doesn't draw by itself, it
+ * transforms its quad to world space and appends it to the queue. Consecutive quads
+ * sharing texture, shader program and blend function are merged and drawn with one
+ * draw call. Anything else which touches GL state (a shader program is used, a render
+ * target, stencil or scissor is changed) flushes the queue first so the drawing order
+ * is same as before.
+ *
+ * Only sprites using the builtin position-texture-color shaders are batched, sprites
+ * with other shaders are drawn as usual.
+ *
+ * @since v2.2
+ * @js NA
+ * @lua NA
+ */
+class CC_DLL CCRenderQueue : public CCObject
+{
+public:
+    CCRenderQueue();
+    virtual ~CCRenderQueue();
+
+    static CCRenderQueue* create();
+    bool init();
+
+    /// the queue which is collecting quads now, or NULL if no frame is in progress
+    static CCRenderQueue* currentQueue();
+
+    /// start to collect quads, called by director before visiting the scene
+    void begin();
+
+    /// flush remaining quads and stop collecting, called by director after visiting the scene
+    void end();
+
+    /**
+     * Append a quad which will be transformed by current model view matrix. If the quad
+     * can't be batched the queue is flushed and false is returned, so caller should
+     * draw it as usual
+     */
+    bool appendQuad(const ccV3F_C4B_T2F_Quad& quad, CCTexture2D* texture, CCGLProgram* program, const ccBlendFunc& blendFunc);
+
+    /// draw all pending quads with one draw call
+    void flush();
+
+    /// quads appended in last frame
+    unsigned int getQuadCount() { return m_uLastQuads; }
+
+    /// draw calls issued for appended quads in last frame
+    unsigned int getDrawCount() { return m_uLastDraws; }
+
+    /// draw calls saved by merging in last frame
+    unsigned int getMergedDrawCount() { return m_uLastQuads - m_uLastDraws; }
+
+private:
+    CCTextureAtlas* m_pAtlas;
+
+    // state of pending quads, weak reference
+    CCTexture2D* m_pTexture;
+    CCGLProgram* m_pProgram;
+    ccBlendFunc m_tBlendFunc;
+
+    // true when flushing, to avoid reentrance from CCGLProgram::use
+    bool m_bFlushing;
+
+    // counters of current and last frame
+    unsigned int m_uQuads;
+    unsigned int m_uDraws;
+    unsigned int m_uLastQuads;
+    unsigned int m_uLastDraws;
+};
+
+/** @def CC_RENDER_QUEUE_FLUSH
+ Flush pending quads of render queue, call it before changing GL state which is not
+ tracked by the queue, such as frame buffer, scissor and stencil
+ */
+#define CC_RENDER_QUEUE_FLUSH() \
+    do { \
+        CCRenderQueue* __queue__ = CCRenderQueue::currentQueue(); \
+        if(__queue__) \
+            __queue__->flush(); \
+    } while(0)
+
+// end of global group
+/// @}
+
+NS_CC_END
+
+#endif // __CCRENDERQUEUE_H__
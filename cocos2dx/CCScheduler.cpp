@@ -30,6 +30,7 @@ THE SOFTWARE.
 #include "cocoa/utlist.h"
 #include "cocoa/ccCArray.h"
 #include "cocoa/CCArray.h"
+#include <algorithm>
 
 using namespace std;
 
@@ -60,13 +61,38 @@ typedef struct _hashSelectorEntry
 {
     ccArray             *timers;
     CCObject            *target;    // hash key (retained)
-    unsigned int        timerIndex;
     CCTimer             *currentTimer;
     bool                currentTimerSalvaged;
     bool                paused;
     UT_hash_handle      hh;
 } tHashTimerEntry;
 
+// Node of timer queue, a timer is only updated when its deadline is reached
+typedef struct _timerQueueNode
+{
+    double                          deadline;
+    unsigned int                    seq;            // keeps scheduling order of timers with same deadline
+    CCTimer                         *timer;         // not retained (retained by hashSelectorEntry or script entry)
+    tHashTimerEntry                 *element;       // owner of a custom selector timer
+    CCSchedulerScriptHandlerEntry   *scriptEntry;   // owner of a script timer
+} tTimerQueueNode;
+
+// timer is not in queue
+#define kCCTimerNotQueued -1
+
+// queue index <= this value means timer is popped and waits in due list at (kCCTimerDueBase - index)
+#define kCCTimerDueBase -2
+
+static inline bool timerNodeLess(const tTimerQueueNode& a, const tTimerQueueNode& b)
+{
+    return a.deadline < b.deadline || (a.deadline == b.deadline && a.seq < b.seq);
+}
+
+static inline bool isCustomTimerNode(const tTimerQueueNode& node)
+{
+    return node.scriptEntry == NULL;
+}
+
 // implementation CCTimer
 
 CCTimer::CCTimer()
@@ -79,6 +105,11 @@ CCTimer::CCTimer()
 , m_fDelay(0.0f)
 , m_fInterval(0.0f)
 , m_pfnSelector(NULL)
+, m_dLastUpdate(0)
+, m_nQueueIndex(kCCTimerNotQueued)
+, m_bQueuePaused(false)
+, m_dPausedDeadline(0)
+, m_dPausedTime(0)
 {
     memset(&m_nScriptHandler, 0, sizeof(ccScriptFunction));
 }
@@ -226,6 +257,18 @@ void CCTimer::update(float dt)
     }
 }
 
+float CCTimer::getTimeToTrigger() const
+{
+    // first update only initializes timer
+    if (m_fElapsed == -1)
+    {
+        return 0;
+    }
+
+    float fThreshold = m_bUseDelay ? m_fDelay : m_fInterval;
+    return MAX(0, fThreshold - m_fElapsed);
+}
+
 float CCTimer::getInterval() const
 {
     return m_fInterval;
@@ -254,6 +297,14 @@ CCScheduler::CCScheduler(void)
 , m_bCurrentTargetSalvaged(false)
 , m_bUpdateHashLocked(false)
 , m_pScriptHandlerEntries(NULL)
+, m_dTime(0)
+, m_uTimerSeq(0)
+, m_pTimerQueue(NULL)
+, m_uTimerQueueCount(0)
+, m_uTimerQueueCapacity(0)
+, m_pDueTimers(NULL)
+, m_uDueTimersCount(0)
+, m_uDueTimersCapacity(0)
 {
 
 }
@@ -262,6 +313,186 @@ CCScheduler::~CCScheduler(void)
 {
     unscheduleAll();
     CC_SAFE_RELEASE(m_pScriptHandlerEntries);
+    CC_SAFE_FREE(m_pTimerQueue);
+    CC_SAFE_FREE(m_pDueTimers);
+}
+
+void CCScheduler::setQueueNode(unsigned int index, const tTimerQueueNode& node)
+{
+    m_pTimerQueue[index] = node;
+    node.timer->m_nQueueIndex = (int)index;
+}
+
+void CCScheduler::siftUp(unsigned int index)
+{
+    tTimerQueueNode node = m_pTimerQueue[index];
+    while (index > 0)
+    {
+        unsigned int parent = (index - 1) / 2;
+        if (! timerNodeLess(node, m_pTimerQueue[parent]))
+        {
+            break;
+        }
+        setQueueNode(index, m_pTimerQueue[parent]);
+        index = parent;
+    }
+    setQueueNode(index, node);
+}
+
+void CCScheduler::siftDown(unsigned int index)
+{
+    tTimerQueueNode node = m_pTimerQueue[index];
+    for (;;)
+    {
+        unsigned int child = index * 2 + 1;
+        if (child >= m_uTimerQueueCount)
+        {
+            break;
+        }
+        if (child + 1 < m_uTimerQueueCount && timerNodeLess(m_pTimerQueue[child + 1], m_pTimerQueue[child]))
+        {
+            child++;
+        }
+        if (! timerNodeLess(m_pTimerQueue[child], node))
+        {
+            break;
+        }
+        setQueueNode(index, m_pTimerQueue[child]);
+        index = child;
+    }
+    setQueueNode(index, node);
+}
+
+void CCScheduler::queueTimer(CCTimer *pTimer, double deadline, tHashTimerEntry *pElement, CCSchedulerScriptHandlerEntry *pScriptEntry)
+{
+    CCAssert(pTimer->m_nQueueIndex == kCCTimerNotQueued, "timer is already queued");
+
+    if (m_uTimerQueueCount == m_uTimerQueueCapacity)
+    {
+        m_uTimerQueueCapacity = MAX(64, m_uTimerQueueCapacity * 2);
+        m_pTimerQueue = (tTimerQueueNode*)realloc(m_pTimerQueue, m_uTimerQueueCapacity * sizeof(tTimerQueueNode));
+    }
+
+    tTimerQueueNode node;
+    node.deadline = deadline;
+    node.seq = m_uTimerSeq++;
+    node.timer = pTimer;
+    node.element = pElement;
+    node.scriptEntry = pScriptEntry;
+    setQueueNode(m_uTimerQueueCount++, node);
+    siftUp(m_uTimerQueueCount - 1);
+}
+
+void CCScheduler::dequeueTimer(CCTimer *pTimer)
+{
+    int index = pTimer->m_nQueueIndex;
+    if (index >= 0)
+    {
+        m_uTimerQueueCount--;
+        if ((unsigned int)index < m_uTimerQueueCount)
+        {
+            // move last node to the hole and restore heap order
+            setQueueNode(index, m_pTimerQueue[m_uTimerQueueCount]);
+            if (index > 0 && timerNodeLess(m_pTimerQueue[index], m_pTimerQueue[(index - 1) / 2]))
+            {
+                siftUp(index);
+            }
+            else
+            {
+                siftDown(index);
+            }
+        }
+    }
+    else if (index <= kCCTimerDueBase)
+    {
+        // popped in this frame but not updated yet, just skip it
+        m_pDueTimers[kCCTimerDueBase - index].timer = NULL;
+    }
+    pTimer->m_nQueueIndex = kCCTimerNotQueued;
+    pTimer->m_bQueuePaused = false;
+}
+
+void CCScheduler::popDueTimers()
+{
+    m_uDueTimersCount = 0;
+    while (m_uTimerQueueCount > 0 && m_pTimerQueue[0].deadline <= m_dTime)
+    {
+        if (m_uDueTimersCount == m_uDueTimersCapacity)
+        {
+            m_uDueTimersCapacity = MAX(64, m_uDueTimersCapacity * 2);
+            m_pDueTimers = (tTimerQueueNode*)realloc(m_pDueTimers, m_uDueTimersCapacity * sizeof(tTimerQueueNode));
+        }
+
+        tTimerQueueNode node = m_pTimerQueue[0];
+        m_uTimerQueueCount--;
+        if (m_uTimerQueueCount > 0)
+        {
+            setQueueNode(0, m_pTimerQueue[m_uTimerQueueCount]);
+            siftDown(0);
+        }
+
+        m_pDueTimers[m_uDueTimersCount++] = node;
+    }
+
+    // a frame triggers the custom selectors before the script callbacks,
+    // timers of each kind are still triggered in deadline order
+    std::stable_partition(m_pDueTimers, m_pDueTimers + m_uDueTimersCount, isCustomTimerNode);
+    for (unsigned int i = 0; i < m_uDueTimersCount; i++)
+    {
+        m_pDueTimers[i].timer->m_nQueueIndex = kCCTimerDueBase - (int)i;
+    }
+}
+
+double CCScheduler::getTimerDeadline(CCTimer *pTimer)
+{
+    int index = pTimer->m_nQueueIndex;
+    if (index >= 0)
+    {
+        return m_pTimerQueue[index].deadline;
+    }
+    else if (index <= kCCTimerDueBase)
+    {
+        return m_pDueTimers[kCCTimerDueBase - index].deadline;
+    }
+    return m_dTime;
+}
+
+void CCScheduler::pauseTimer(CCTimer *pTimer, double deadline)
+{
+    if (pTimer->m_bQueuePaused)
+    {
+        return;
+    }
+
+    // paused timer is not polled, it is queued again when resumed
+    dequeueTimer(pTimer);
+    pTimer->m_bQueuePaused = true;
+    pTimer->m_dPausedDeadline = deadline;
+    pTimer->m_dPausedTime = m_dTime;
+}
+
+void CCScheduler::resumeTimer(CCTimer *pTimer, tHashTimerEntry *pElement, CCSchedulerScriptHandlerEntry *pScriptEntry)
+{
+    if (! pTimer->m_bQueuePaused)
+    {
+        return;
+    }
+
+    // time passed in pause doesn't count, shift deadline and last update by it
+    double shift = m_dTime - pTimer->m_dPausedTime;
+    pTimer->m_bQueuePaused = false;
+    pTimer->m_dLastUpdate += shift;
+    queueTimer(pTimer, pTimer->m_dPausedDeadline + shift, pElement, pScriptEntry);
+}
+
+void CCScheduler::markScriptEntryForDeletion(CCSchedulerScriptHandlerEntry *pEntry)
+{
+    pEntry->markedForDeletion();
+
+    // let it be removed in next tick
+    CCTimer* pTimer = pEntry->getTimer();
+    dequeueTimer(pTimer);
+    queueTimer(pTimer, m_dTime, NULL, pEntry);
 }
 
 void CCScheduler::removeHashElement(_hashSelectorEntry *pElement)
@@ -269,6 +500,10 @@ void CCScheduler::removeHashElement(_hashSelectorEntry *pElement)
 
 	cocos2d::CCObject *target = pElement->target;
 
+    for (unsigned int i = 0; i < pElement->timers->num; ++i)
+    {
+        dequeueTimer((CCTimer*)pElement->timers->arr[i]);
+    }
     ccArrayFree(pElement->timers);
     HASH_DEL(m_pHashForTimers, pElement);
     free(pElement);
@@ -325,6 +560,17 @@ void CCScheduler::scheduleSelector(SEL_SCHEDULE pfnSelector, CCObject *pTarget,
             {
                 CCLOG("CCScheduler#scheduleSelector. Selector already scheduled. Updating interval from: %.4f to %.4f", timer->getInterval(), fInterval);
                 timer->setInterval(fInterval);
+
+                // deadline depends on interval, queue it again
+                if (timer->m_bQueuePaused)
+                {
+                    timer->m_dPausedDeadline = timer->m_dLastUpdate + timer->getTimeToTrigger();
+                }
+                else
+                {
+                    dequeueTimer(timer);
+                    queueTimer(timer, timer->m_dLastUpdate + timer->getTimeToTrigger(), pElement, NULL);
+                }
                 return;
             }        
         }
@@ -334,7 +580,18 @@ void CCScheduler::scheduleSelector(SEL_SCHEDULE pfnSelector, CCObject *pTarget,
     CCTimer *pTimer = new CCTimer();
     pTimer->initWithTarget(pTarget, pfnSelector, fInterval, repeat, delay);
     ccArrayAppendObject(pElement->timers, pTimer);
-    CC_SAFE_RELEASE(pTimer);    
+    CC_SAFE_RELEASE(pTimer);
+
+    // it will be initialized in next tick
+    pTimer->m_dLastUpdate = m_dTime;
+    if (pElement->paused)
+    {
+        pauseTimer(pTimer, m_dTime);
+    }
+    else
+    {
+        queueTimer(pTimer, m_dTime, pElement, NULL);
+    }
 }
 
 void CCScheduler::unscheduleSelector(SEL_SCHEDULE pfnSelector, CCObject *pTarget)
@@ -365,14 +622,9 @@ void CCScheduler::unscheduleSelector(SEL_SCHEDULE pfnSelector, CCObject *pTarget
                     pElement->currentTimerSalvaged = true;
                 }
 
+                dequeueTimer(pTimer);
                 ccArrayRemoveObjectAtIndex(pElement->timers, i, true);
 
-                // update timerIndex in case we are in tick:, looping over the actions
-                if (pElement->timerIndex >= i)
-                {
-                    pElement->timerIndex--;
-                }
-
                 if (pElement->timers->num == 0)
                 {
                     if (m_pCurrentTarget == pElement)
@@ -594,6 +846,14 @@ void CCScheduler::unscheduleAllWithMinPriority(int nMinPriority)
 
     if (m_pScriptHandlerEntries)
     {
+        CCObject* pObj = NULL;
+        CCARRAY_FOREACH(m_pScriptHandlerEntries, pObj)
+        {
+            // mark it in case it is being updated now
+            CCSchedulerScriptHandlerEntry* pEntry = static_cast<CCSchedulerScriptHandlerEntry*>(pObj);
+            pEntry->markedForDeletion();
+            dequeueTimer(pEntry->getTimer());
+        }
         m_pScriptHandlerEntries->removeAllObjects();
     }
 }
@@ -618,6 +878,10 @@ void CCScheduler::unscheduleAllForTarget(CCObject *pTarget)
             CC_SAFE_RETAIN(pElement->currentTimer);
             pElement->currentTimerSalvaged = true;
         }
+        for (unsigned int i = 0; i < pElement->timers->num; ++i)
+        {
+            dequeueTimer((CCTimer*)pElement->timers->arr[i]);
+        }
         ccArrayRemoveAllObjects(pElement->timers);
 
         if (m_pCurrentTarget == pElement)
@@ -643,6 +907,18 @@ unsigned int CCScheduler::scheduleScriptFunc(ccScriptFunction func, float fInter
         CC_SAFE_RETAIN(m_pScriptHandlerEntries);
     }
     m_pScriptHandlerEntries->addObject(pEntry);
+
+    // it will be initialized in next tick
+    CCTimer* pTimer = pEntry->getTimer();
+    pTimer->m_dLastUpdate = m_dTime;
+    if (bPaused)
+    {
+        pauseTimer(pTimer, m_dTime);
+    }
+    else
+    {
+        queueTimer(pTimer, m_dTime, NULL, pEntry);
+    }
     return pEntry->getEntryId();
 }
 
@@ -652,7 +928,7 @@ void CCScheduler::unscheduleAllScriptEntryForTarget(CCObject* target) {
             CCSchedulerScriptHandlerEntry* pEntry = static_cast<CCSchedulerScriptHandlerEntry*>(m_pScriptHandlerEntries->objectAtIndex(i));
             ccScriptFunction& func = pEntry->getHandler();
             if(func.target == target || target->getID() == pEntry->getObjId()) {
-                pEntry->markedForDeletion();
+                markScriptEntryForDeletion(pEntry);
             }
         }
     }
@@ -672,7 +948,7 @@ void CCScheduler::unscheduleScriptFuncByObjId(const int objId) {
     for (int i = m_pScriptHandlerEntries->count() - 1; i >= 0; i--) {
         CCSchedulerScriptHandlerEntry* pEntry = static_cast<CCSchedulerScriptHandlerEntry*>(m_pScriptHandlerEntries->objectAtIndex(i));
         if(pEntry->getObjId() == objId) {
-            pEntry->markedForDeletion();
+            markScriptEntryForDeletion(pEntry);
         }
     }
 }
@@ -681,7 +957,7 @@ void CCScheduler::unscheduleScriptFuncByEntryId(const int entryId) {
     for (int i = m_pScriptHandlerEntries->count() - 1; i >= 0; i--) {
         CCSchedulerScriptHandlerEntry* pEntry = static_cast<CCSchedulerScriptHandlerEntry*>(m_pScriptHandlerEntries->objectAtIndex(i));
         if(pEntry->getEntryId() == entryId) {
-            pEntry->markedForDeletion();
+            markScriptEntryForDeletion(pEntry);
             break;
         }
     }
@@ -696,7 +972,7 @@ void CCScheduler::unscheduleScriptFunc(const ccScriptFunction& scriptFunc)
         ccScriptFunction& func = pEntry->getHandler();
         if (func.target == scriptFunc.target && engine->isScriptFunctionSame(func.handler, scriptFunc.handler))
         {
-            pEntry->markedForDeletion();
+            markScriptEntryForDeletion(pEntry);
             break;
         }
     }
@@ -712,6 +988,11 @@ void CCScheduler::resumeTarget(CCObject *pTarget)
     if (pElement)
     {
         pElement->paused = false;
+        for (unsigned int i = 0; i < pElement->timers->num; ++i)
+        {
+            CCTimer *pTimer = (CCTimer*)pElement->timers->arr[i];
+            resumeTimer(pTimer, pElement, NULL);
+        }
     }
 
     // update selector
@@ -729,6 +1010,7 @@ void CCScheduler::resumeTarget(CCObject *pTarget)
             CCSchedulerScriptHandlerEntry* pEntry = static_cast<CCSchedulerScriptHandlerEntry*>(m_pScriptHandlerEntries->objectAtIndex(i));
             if(pEntry->getHandler().target == pTarget || pEntry->getObjId() == pTarget->getID()) {
                 pEntry->setPaused(false);
+                resumeTimer(pEntry->getTimer(), NULL, pEntry);
             }
         }
     }
@@ -744,6 +1026,11 @@ void CCScheduler::pauseTarget(CCObject *pTarget)
     if (pElement)
     {
         pElement->paused = true;
+        for (unsigned int i = 0; i < pElement->timers->num; ++i)
+        {
+            CCTimer *pTimer = (CCTimer*)pElement->timers->arr[i];
+            pauseTimer(pTimer, getTimerDeadline(pTimer));
+        }
     }
 
     // update selector
@@ -761,6 +1048,12 @@ void CCScheduler::pauseTarget(CCObject *pTarget)
             CCSchedulerScriptHandlerEntry* pEntry = static_cast<CCSchedulerScriptHandlerEntry*>(m_pScriptHandlerEntries->objectAtIndex(i));
             if(pEntry->getHandler().target == pTarget || pEntry->getObjId() == pTarget->getID()) {
                 pEntry->setPaused(true);
+
+                // entry marked for deletion stays in queue to be removed
+                if (! pEntry->isMarkedForDeletion())
+                {
+                    pauseTimer(pEntry->getTimer(), getTimerDeadline(pEntry->getTimer()));
+                }
             }
         }
     }
@@ -804,6 +1097,11 @@ CCSet* CCScheduler::pauseAllTargetsWithMinPriority(int nMinPriority)
         element = (tHashTimerEntry*)element->hh.next)
     {
         element->paused = true;
+        for (unsigned int i = 0; i < element->timers->num; ++i)
+        {
+            CCTimer *pTimer = (CCTimer*)element->timers->arr[i];
+            pauseTimer(pTimer, getTimerDeadline(pTimer));
+        }
         idsWithSelectors->addObject(element->target);
     }
 
@@ -891,61 +1189,107 @@ void CCScheduler::update(float dt)
         }
     }
 
-    // Iterate over all the custom selectors
-    for (tHashTimerEntry *elt = m_pHashForTimers; elt != NULL; )
+    // Iterate over the custom selectors and script callbacks which are due
+    m_dTime += dt;
+    popDueTimers();
+    for (unsigned int i = 0; i < m_uDueTimersCount; i++)
     {
-        m_pCurrentTarget = elt;
-        m_bCurrentTargetSalvaged = false;
+        // the timer may be unscheduled by a previous callback of this frame
+        tTimerQueueNode node = m_pDueTimers[i];
+        CCTimer* pTimer = node.timer;
+        if (! pTimer)
+        {
+            continue;
+        }
+        pTimer->m_nQueueIndex = kCCTimerNotQueued;
 
-        if (! m_pCurrentTarget->paused)
+        if (node.scriptEntry)
         {
-            // The 'timers' array may change while inside this loop
-            for (elt->timerIndex = 0; elt->timerIndex < elt->timers->num; ++(elt->timerIndex))
+            CCSchedulerScriptHandlerEntry* pEntry = node.scriptEntry;
+            if (pEntry->isMarkedForDeletion())
             {
-                elt->currentTimer = (CCTimer*)(elt->timers->arr[elt->timerIndex]);
-                elt->currentTimerSalvaged = false;
+                m_pScriptHandlerEntries->removeObject(pEntry);
+                continue;
+            }
 
-                elt->currentTimer->update(dt);
+            // entry paused without scheduler, take it out of queue until target is resumed
+            if (pEntry->isPaused())
+            {
+                pauseTimer(pTimer, node.deadline);
+                continue;
+            }
 
-                if (elt->currentTimerSalvaged)
-                {
-                    // The currentTimer told the remove itself. To prevent the timer from
-                    // accidentally deallocating itself before finishing its step, we retained
-                    // it. Now that step is done, it's safe to release it.
-                    CC_SAFE_RELEASE(elt->currentTimer);
-                }
+            float fTimerDelta = (float)(m_dTime - pTimer->m_dLastUpdate);
+            pTimer->m_dLastUpdate = m_dTime;
 
-                elt->currentTimer = NULL;
+            pEntry->retain();
+            pTimer->update(fTimerDelta);
+            if (pEntry->isMarkedForDeletion())
+            {
+                dequeueTimer(pTimer);
+                m_pScriptHandlerEntries->removeObject(pEntry);
+            }
+            else if (pTimer->m_bQueuePaused)
+            {
+                // paused by its own callback
+                pTimer->m_dPausedDeadline = m_dTime + pTimer->getTimeToTrigger();
+            }
+            else if (pTimer->m_nQueueIndex == kCCTimerNotQueued)
+            {
+                queueTimer(pTimer, m_dTime + pTimer->getTimeToTrigger(), NULL, pEntry);
             }
+            pEntry->release();
         }
+        else
+        {
+            tHashTimerEntry* elt = node.element;
 
-        // elt, at this moment, is still valid
-        // so it is safe to ask this here (issue #490)
-        elt = (tHashTimerEntry *)elt->hh.next;
+            // paused timers are out of queue, this is only a guard
+            if (elt->paused)
+            {
+                pauseTimer(pTimer, node.deadline);
+                continue;
+            }
 
-        // only delete currentTarget if no actions were scheduled during the cycle (issue #481)
-        if (m_bCurrentTargetSalvaged && m_pCurrentTarget->timers->num == 0)
-        {
-            removeHashElement(m_pCurrentTarget);
-        }
-    }
+            float fTimerDelta = (float)(m_dTime - pTimer->m_dLastUpdate);
+            pTimer->m_dLastUpdate = m_dTime;
 
-    // Iterate over all the script callbacks
-    if (m_pScriptHandlerEntries)
-    {
-        for (int i = m_pScriptHandlerEntries->count() - 1; i >= 0; i--)
-        {
-            CCSchedulerScriptHandlerEntry* pEntry = static_cast<CCSchedulerScriptHandlerEntry*>(m_pScriptHandlerEntries->objectAtIndex(i));
-            if (pEntry->isMarkedForDeletion())
+            m_pCurrentTarget = elt;
+            m_bCurrentTargetSalvaged = false;
+
+            elt->currentTimer = pTimer;
+            elt->currentTimerSalvaged = false;
+
+            pTimer->update(fTimerDelta);
+
+            if (elt->currentTimerSalvaged)
             {
-                m_pScriptHandlerEntries->removeObjectAtIndex(i);
+                // The currentTimer told the remove itself. To prevent the timer from
+                // accidentally deallocating itself before finishing its step, we retained
+                // it. Now that step is done, it's safe to release it.
+                CC_SAFE_RELEASE(pTimer);
             }
-            else if (!pEntry->isPaused())
+            else if (pTimer->m_bQueuePaused)
+            {
+                // paused by its own callback
+                pTimer->m_dPausedDeadline = m_dTime + pTimer->getTimeToTrigger();
+            }
+            else if (pTimer->m_nQueueIndex == kCCTimerNotQueued)
+            {
+                queueTimer(pTimer, m_dTime + pTimer->getTimeToTrigger(), elt, NULL);
+            }
+
+            elt->currentTimer = NULL;
+            m_pCurrentTarget = NULL;
+
+            // only delete currentTarget if no actions were scheduled during the cycle (issue #481)
+            if (m_bCurrentTargetSalvaged && elt->timers->num == 0)
             {
-                pEntry->getTimer()->update(dt);
+                removeHashElement(elt);
             }
         }
     }
+    m_uDueTimersCount = 0;
 
     // delete all updates that are marked for deletion
     // updates with priority < 0
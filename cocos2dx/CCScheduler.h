@@ -84,6 +84,9 @@ public:
     /** triggers the timer */
     void update(float dt);
     
+    /** seconds left before the timer is triggered, 0 means it should be updated in next frame */
+    float getTimeToTrigger(void) const;
+    
 public:
     /** Allocates a timer with a target and a selector. 
      *  @lua NA
@@ -114,6 +117,17 @@ protected:
     SEL_SCHEDULE m_pfnSelector;
     
     ccScriptFunction m_nScriptHandler;
+    
+    // scheduler time of last update, and position in scheduler timer queue
+    double m_dLastUpdate;
+    int m_nQueueIndex;
+
+    // timer of paused target is out of queue, it keeps its deadline and the time it is paused
+    bool m_bQueuePaused;
+    double m_dPausedDeadline;
+    double m_dPausedTime;
+    
+    friend class CCScheduler;
 };
 
 //
@@ -122,6 +136,7 @@ protected:
 struct _listEntry;
 struct _hashSelectorEntry;
 struct _hashUpdateEntry;
+struct _timerQueueNode;
 
 class CCArray;
 
@@ -135,6 +150,11 @@ There are 2 different types of callbacks (selectors):
 
 The 'custom selectors' should be avoided when possible. It is faster, and consumes less memory to use the 'update selector'.
 
+Custom selectors and script callbacks are kept in a queue ordered by deadline, so a frame only
+updates the timers which are due, a timer with a long interval costs nothing until it is triggered.
+Within a frame the due custom selectors are triggered first and then the due script callbacks,
+each in deadline order.
+
 */
 class CC_DLL CCScheduler : public CCObject
 {
@@ -310,6 +330,19 @@ private:
     void priorityIn(struct _listEntry **ppList, CCObject *pTarget, int nPriority, bool bPaused);
     void appendIn(struct _listEntry **ppList, CCObject *pTarget, bool bPaused);
 
+    // timer queue specific
+
+    void queueTimer(CCTimer *pTimer, double deadline, struct _hashSelectorEntry *pElement, CCSchedulerScriptHandlerEntry *pScriptEntry);
+    void dequeueTimer(CCTimer *pTimer);
+    void setQueueNode(unsigned int index, const struct _timerQueueNode& node);
+    void siftUp(unsigned int index);
+    void siftDown(unsigned int index);
+    void popDueTimers();
+    double getTimerDeadline(CCTimer *pTimer);
+    void pauseTimer(CCTimer *pTimer, double deadline);
+    void resumeTimer(CCTimer *pTimer, struct _hashSelectorEntry *pElement, CCSchedulerScriptHandlerEntry *pScriptEntry);
+    void markScriptEntryForDeletion(CCSchedulerScriptHandlerEntry *pEntry);
+
 protected:
     float m_fTimeScale;
 
@@ -328,6 +361,17 @@ protected:
     // If true unschedule will not remove anything from a hash. Elements will only be marked for deletion.
     bool m_bUpdateHashLocked;
     CCArray* m_pScriptHandlerEntries;
+
+    // Used for timer queue, a binary min heap ordered by deadline
+    double m_dTime;
+    unsigned int m_uTimerSeq;
+    struct _timerQueueNode *m_pTimerQueue;
+    unsigned int m_uTimerQueueCount;
+    unsigned int m_uTimerQueueCapacity;
+    // timers popped from queue in current frame
+    struct _timerQueueNode *m_pDueTimers;
+    unsigned int m_uDueTimersCount;
+    unsigned int m_uDueTimersCapacity;
 };
 
 // end of global group
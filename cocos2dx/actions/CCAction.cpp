@@ -32,6 +32,8 @@ THE SOFTWARE.
 #include "cocoa/CCZone.h"
 
 NS_CC_BEGIN
+
+CC_SLAB_ALLOCATED_IMPL(CCAction)
 //
 // Action Base Class
 //
@@ -40,6 +42,7 @@ CCAction::CCAction()
 :m_pOriginalTarget(NULL)
 ,m_pTarget(NULL)
 ,m_nTag(kCCActionTagInvalid)
+,m_nTweenSlot(-1)
 {
 }
 
@@ -48,6 +48,8 @@ enum {
  */
 class CC_DLL CCAction : public CCObject 
 {
+    CC_SLAB_ALLOCATED(CCAction)
+
 public:
     /**
      * @js ctor
@@ -122,6 +124,11 @@ protected:
     CCNode    *m_pTarget;
     /** The action tag. An identifier of the action */
     int     m_nTag;
+
+    /** Slot in tween list of CCActionManager, -1 if action is stepped by itself */
+    int     m_nTweenSlot;
+
+    friend class CCActionManager;
 };
 
 /** 
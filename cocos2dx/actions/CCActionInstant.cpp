@@ -34,6 +34,8 @@
 #include "cocoa/CCDouble.h"
 
 NS_CC_BEGIN
+
+CC_SLAB_ALLOCATED_IMPL(CCCallFunc)
 //
 // InstantAction
 //
@@ -291,6 +291,8 @@ protected:
 */
 class CC_DLL CCCallFunc : public CCActionInstant //<NSCopying>
 {
+    CC_SLAB_ALLOCATED(CCCallFunc)
+
 public:
     /**
      *  @js ctor
@@ -36,6 +36,8 @@ THE SOFTWARE.
 
 NS_CC_BEGIN
 
+CC_SLAB_ALLOCATED_IMPL(CCSequence)
+
 // Extra action for making a CCSequence or CCSpawn when only adding one action to it.
 class ExtraAction : public CCFiniteTimeAction
 {
@@ -92,12 +92,16 @@ public:
 protected:
     float m_elapsed;
     bool   m_bFirstTick;
+
+    friend class CCActionManager;
 };
 
 /** @brief Runs actions sequentially, one after another
  */
 class CC_DLL CCSequence : public CCActionInterval
 {
+    CC_SLAB_ALLOCATED(CCSequence)
+
 public:
     /**
      * @js NA
@@ -357,6 +361,8 @@ protected:
     float m_fDstAngleY;
     float m_fStartAngleY;
     float m_fDiffAngleY;
+
+    friend class CCActionManager;
 };
 
 /** @brief Rotates a CCNode object clockwise a number of degrees by modifying it's rotation attribute.
@@ -416,6 +422,8 @@ protected:
     CCPoint m_previousPosition;
     bool m_autoHeadOn;
     float m_initAngle;
+
+    friend class CCActionManager;
 };
 
 /** Moves a CCNode object to the position x,y. x and y are absolute coordinates by modifying it's position attribute.
@@ -656,6 +664,8 @@ protected:
     float m_fEndScaleY;
     float m_fDeltaX;
     float m_fDeltaY;
+
+    friend class CCActionManager;
 };
 
 /** @brief Scales a CCNode object a zoom factor by modifying it's scale attribute.
@@ -769,6 +779,8 @@ public:
 protected:
     GLubyte m_toOpacity;
     GLubyte m_fromOpacity;
+
+    friend class CCActionManager;
 };
 
 /** @brief Tints a CCNode that implements the CCNodeRGB protocol from current tint to a custom one.
@@ -33,6 +33,12 @@ THE SOFTWARE.
 #include "cocoa/uthash.h"
 #include "cocoa/CCSet.h"
 #include "actions/CCActionWatcher.h"
+#include "actions/CCActionInterval.h"
+#include "actions/CCActionEase.h"
+#include "CCProtocols.h"
+#include <float.h>
+#include <typeinfo>
+#include <vector>
 
 NS_CC_BEGIN
 //
@@ -49,12 +55,74 @@ typedef struct _hashElement
     UT_hash_handle                hh;
 } tHashElement;
 
+// value changed by a tween
+enum {
+    kCCTweenMove,
+    kCCTweenScale,
+    kCCTweenFade,
+    kCCTweenRotate
+};
+
+// easing of tween time, same as CCEase actions
+enum {
+    kCCTweenEaseNone,
+    kCCTweenEaseIn,
+    kCCTweenEaseOut,
+    kCCTweenEaseInOut,
+    kCCTweenEaseExponentialIn,
+    kCCTweenEaseExponentialOut,
+    kCCTweenEaseExponentialInOut,
+    kCCTweenEaseSineIn,
+    kCCTweenEaseSineOut,
+    kCCTweenEaseSineInOut
+};
+
+/*
+ * Common interval actions, in flat arrays indexed by slot. Times and values of all of them are
+ * computed in tight loops before targets are walked, and walk applies value of a tween when it
+ * meets the action, so setters, stop and removal happen in same order as stepped actions.
+ * Action object stays in action list of target, its elapsed time is written back when it is
+ * applied.
+ */
+typedef struct _tweenList
+{
+    // action in action list of target, NULL if slot is free
+    std::vector<CCActionInterval*>  actions;
+    // tween action, it is inner action if action is an ease
+    std::vector<CCActionInterval*>  tweens;
+    std::vector<CCNode*>            targets;
+    std::vector<CCRGBAProtocol*>    rgbas;
+    std::vector<unsigned char>      kinds;
+    std::vector<unsigned char>      eases;
+    std::vector<float>              rates;
+
+    // state, same as m_elapsed and m_bFirstTick of action
+    std::vector<float>              elapsed;
+    std::vector<unsigned char>      firstTicks;
+    std::vector<float>              durations;
+
+    // value is from + delta * time, 0 is x of position or scale, opacity or x of rotation
+    std::vector<float>              from0;
+    std::vector<float>              from1;
+    std::vector<float>              delta0;
+    std::vector<float>              delta1;
+
+    // computed in this frame, ready is cleared when it is applied
+    std::vector<float>              nextElapsed;
+    std::vector<float>              times;
+    std::vector<float>              values0;
+    std::vector<float>              values1;
+    std::vector<unsigned char>      ready;
+
+    std::vector<int>                freeSlots;
+} tTweenList;
+
 CCActionManager::CCActionManager(void)
 : m_pTargets(NULL), 
   m_pCurrentTarget(NULL),
   m_bCurrentTargetSalvaged(false)
 {
-
+    m_pTweens = new tTweenList();
 }
 
 CCActionManager::~CCActionManager(void)
@@ -62,12 +130,16 @@ CCActionManager::~CCActionManager(void)
     CCLOGINFO("cocos2d: deallocing %p", this);
 
     removeAllActions();
+    delete m_pTweens;
 }
 
 // private
 
 void CCActionManager::deleteHashElement(tHashElement *pElement)
 {
+    for(unsigned int i = 0; i < pElement->actions->num; i++) {
+        removeTween((CCAction*)pElement->actions->arr[i]);
+    }
     ccArrayFree(pElement->actions);
     HASH_DEL(m_pTargets, pElement);
     CC_SAFE_RELEASE(pElement->target);
@@ -110,6 +182,7 @@ void CCActionManager::removeActionAtIndex(unsigned int uIndex, tHashElement *pEl
     }
 
     notifyWatcher(pAction);
+    removeTween(pAction);
     ccArrayRemoveObjectAtIndex(pElement->actions, uIndex, true);
 
     // update actionIndex in case we are in tick. looping over the actions
@@ -205,6 +278,7 @@ void CCActionManager::addAction(CCAction *pAction, CCNode *pTarget, bool paused)
      ccArrayAppendObject(pElement->actions, pAction);
  
      pAction->startWithTarget(pTarget);
+     addTween(pAction);
 }
 
 // remove
@@ -239,6 +313,7 @@ void CCActionManager::removeAllActionsFromTarget(CCObject *pTarget)
         
         for(unsigned int i = 0; i < pElement->actions->num; i++) {
             notifyWatcher((CCAction*)pElement->actions->arr[i]);
+            removeTween((CCAction*)pElement->actions->arr[i]);
         }
         
         ccArrayRemoveAllObjects(pElement->actions);
@@ -355,6 +430,8 @@ unsigned int CCActionManager::numberOfRunningActionsInTarget(CCObject *pTarget)
 // main loop
 void CCActionManager::update(float dt)
 {
+    updateTweens(dt);
+
     for (tHashElement *elt = m_pTargets; elt != NULL; )
     {
         m_pCurrentTarget = elt;
@@ -374,7 +451,14 @@ void CCActionManager::update(float dt)
 
                 m_pCurrentTarget->currentActionSalvaged = false;
 
-                m_pCurrentTarget->currentAction->step(dt);
+                if (m_pCurrentTarget->currentAction->m_nTweenSlot >= 0)
+                {
+                    stepTween(m_pCurrentTarget->currentAction, dt);
+                }
+                else
+                {
+                    m_pCurrentTarget->currentAction->step(dt);
+                }
 
                 if (m_pCurrentTarget->currentActionSalvaged)
                 {
@@ -416,4 +500,328 @@ void CCActionManager::registerWatcher(CCActionWatcher* w) {
     m_actionWatchers.addObject(w);
 }
 
+// tween list
+
+unsigned int CCActionManager::getTweenCount(void)
+{
+    return m_pTweens->actions.size() - m_pTweens->freeSlots.size();
+}
+
+void CCActionManager::addTween(CCAction *pAction)
+{
+#if CC_ACTION_MANAGER_USE_TWEEN_LIST
+    // exact classes only, a subclass may override update
+    CCActionInterval *pTween = NULL;
+    int ease = kCCTweenEaseNone;
+    float rate = 1;
+    const std::type_info& type = typeid(*pAction);
+    if (type == typeid(CCActionEase))
+    {
+        ease = kCCTweenEaseNone;
+    }
+    else if (type == typeid(CCEaseIn) || type == typeid(CCEaseOut) || type == typeid(CCEaseInOut))
+    {
+        ease = type == typeid(CCEaseIn) ? kCCTweenEaseIn : (type == typeid(CCEaseOut) ? kCCTweenEaseOut : kCCTweenEaseInOut);
+        rate = ((CCEaseRateAction*)pAction)->getRate();
+    }
+    else if (type == typeid(CCEaseExponentialIn))
+    {
+        ease = kCCTweenEaseExponentialIn;
+    }
+    else if (type == typeid(CCEaseExponentialOut))
+    {
+        ease = kCCTweenEaseExponentialOut;
+    }
+    else if (type == typeid(CCEaseExponentialInOut))
+    {
+        ease = kCCTweenEaseExponentialInOut;
+    }
+    else if (type == typeid(CCEaseSineIn))
+    {
+        ease = kCCTweenEaseSineIn;
+    }
+    else if (type == typeid(CCEaseSineOut))
+    {
+        ease = kCCTweenEaseSineOut;
+    }
+    else if (type == typeid(CCEaseSineInOut))
+    {
+        ease = kCCTweenEaseSineInOut;
+    }
+    else
+    {
+        pTween = (CCActionInterval*)pAction;
+    }
+    if (pTween == NULL)
+    {
+        pTween = ((CCActionEase*)pAction)->getInnerAction();
+        if (pTween == NULL)
+        {
+            return;
+        }
+    }
+
+    int kind;
+    float from0, from1, delta0, delta1;
+    CCRGBAProtocol *pRGBA = NULL;
+    const std::type_info& tweenType = typeid(*pTween);
+    if (tweenType == typeid(CCMoveTo) || tweenType == typeid(CCMoveBy))
+    {
+        CCMoveBy *pMove = (CCMoveBy*)pTween;
+        if (pMove->m_autoHeadOn)
+        {
+            return;
+        }
+        kind = kCCTweenMove;
+        from0 = pMove->m_startPosition.x;
+        from1 = pMove->m_startPosition.y;
+        delta0 = pMove->m_positionDelta.x;
+        delta1 = pMove->m_positionDelta.y;
+    }
+    else if (tweenType == typeid(CCScaleTo) || tweenType == typeid(CCScaleBy))
+    {
+        CCScaleTo *pScale = (CCScaleTo*)pTween;
+        kind = kCCTweenScale;
+        from0 = pScale->m_fStartScaleX;
+        from1 = pScale->m_fStartScaleY;
+        delta0 = pScale->m_fDeltaX;
+        delta1 = pScale->m_fDeltaY;
+    }
+    else if (tweenType == typeid(CCFadeTo))
+    {
+        CCFadeTo *pFade = (CCFadeTo*)pTween;
+        kind = kCCTweenFade;
+        from0 = pFade->m_fromOpacity;
+        from1 = 0;
+        delta0 = pFade->m_toOpacity - pFade->m_fromOpacity;
+        delta1 = 0;
+        pRGBA = dynamic_cast<CCRGBAProtocol*>(pTween->getTarget());
+    }
+    else if (tweenType == typeid(CCRotateTo))
+    {
+        CCRotateTo *pRotate = (CCRotateTo*)pTween;
+        kind = kCCTweenRotate;
+        from0 = pRotate->m_fStartAngleX;
+        from1 = pRotate->m_fStartAngleY;
+        delta0 = pRotate->m_fDiffAngleX;
+        delta1 = pRotate->m_fDiffAngleY;
+    }
+    else
+    {
+        return;
+    }
+
+    // take a free slot or append one
+    tTweenList *pList = m_pTweens;
+    int slot;
+    if (!pList->freeSlots.empty())
+    {
+        slot = pList->freeSlots.back();
+        pList->freeSlots.pop_back();
+    }
+    else
+    {
+        slot = pList->actions.size();
+        pList->actions.push_back(NULL);
+        pList->tweens.push_back(NULL);
+        pList->targets.push_back(NULL);
+        pList->rgbas.push_back(NULL);
+        pList->kinds.push_back(0);
+        pList->eases.push_back(0);
+        pList->rates.push_back(0);
+        pList->elapsed.push_back(0);
+        pList->firstTicks.push_back(0);
+        pList->durations.push_back(0);
+        pList->from0.push_back(0);
+        pList->from1.push_back(0);
+        pList->delta0.push_back(0);
+        pList->delta1.push_back(0);
+        pList->nextElapsed.push_back(0);
+        pList->times.push_back(0);
+        pList->values0.push_back(0);
+        pList->values1.push_back(0);
+        pList->ready.push_back(0);
+    }
+
+    CCActionInterval *pInterval = (CCActionInterval*)pAction;
+    pList->actions[slot] = pInterval;
+    pList->tweens[slot] = pTween;
+    pList->targets[slot] = pTween->getTarget();
+    pList->rgbas[slot] = pRGBA;
+    pList->kinds[slot] = kind;
+    pList->eases[slot] = ease;
+    pList->rates[slot] = rate;
+    pList->elapsed[slot] = pInterval->m_elapsed;
+    pList->firstTicks[slot] = pInterval->m_bFirstTick;
+    pList->durations[slot] = pInterval->getDuration();
+    pList->from0[slot] = from0;
+    pList->from1[slot] = from1;
+    pList->delta0[slot] = delta0;
+    pList->delta1[slot] = delta1;
+
+    // added after tweens are computed, it is stepped by itself in this frame
+    pList->ready[slot] = 0;
+    pAction->m_nTweenSlot = slot;
+#endif
+}
+
+void CCActionManager::removeTween(CCAction *pAction)
+{
+    int slot = pAction->m_nTweenSlot;
+    if (slot < 0)
+    {
+        return;
+    }
+
+    tTweenList *pList = m_pTweens;
+    pList->actions[slot] = NULL;
+    pList->tweens[slot] = NULL;
+    pList->targets[slot] = NULL;
+    pList->rgbas[slot] = NULL;
+    pList->ready[slot] = 0;
+    pList->freeSlots.push_back(slot);
+    pAction->m_nTweenSlot = -1;
+}
+
+void CCActionManager::updateTweens(float dt)
+{
+    tTweenList *pList = m_pTweens;
+    unsigned int count = pList->actions.size();
+    if (count == pList->freeSlots.size())
+    {
+        return;
+    }
+
+    // free slots are computed too, it costs less than skipping them
+    const float *elapsed = &pList->elapsed[0];
+    const unsigned char *firstTicks = &pList->firstTicks[0];
+    const float *durations = &pList->durations[0];
+    float *nextElapsed = &pList->nextElapsed[0];
+    float *times = &pList->times[0];
+
+    // same as CCActionInterval::step
+    for (unsigned int i = 0; i < count; i++)
+    {
+        float e = firstTicks[i] ? 0 : elapsed[i] + dt;
+        nextElapsed[i] = e;
+        times[i] = MAX(0, MIN(1, e / MAX(durations[i], FLT_EPSILON)));
+    }
+
+    // same as update of CCEase actions
+    const unsigned char *eases = &pList->eases[0];
+    const float *rates = &pList->rates[0];
+    for (unsigned int i = 0; i < count; i++)
+    {
+        float time = times[i];
+        switch (eases[i])
+        {
+            case kCCTweenEaseIn:
+                time = powf(time, rates[i]);
+                break;
+            case kCCTweenEaseOut:
+                time = powf(time, 1 / rates[i]);
+                break;
+            case kCCTweenEaseInOut:
+                time *= 2;
+                time = time < 1 ? 0.5f * powf(time, rates[i]) : 1.0f - 0.5f * powf(2 - time, rates[i]);
+                break;
+            case kCCTweenEaseExponentialIn:
+                time = time == 0 ? 0 : powf(2, 10 * (time/1 - 1)) - 1 * 0.001f;
+                break;
+            case kCCTweenEaseExponentialOut:
+                time = time == 1 ? 1 : (-powf(2, -10 * time / 1) + 1);
+                break;
+            case kCCTweenEaseExponentialInOut:
+                time /= 0.5f;
+                time = time < 1 ? 0.5f * powf(2, 10 * (time - 1)) : 0.5f * (-powf(2, -10 * (time - 1)) + 2);
+                break;
+            case kCCTweenEaseSineIn:
+                time = -1 * cosf(time * (float)M_PI_2) + 1;
+                break;
+            case kCCTweenEaseSineOut:
+                time = sinf(time * (float)M_PI_2);
+                break;
+            case kCCTweenEaseSineInOut:
+                time = -0.5f * (cosf((float)M_PI * time) - 1);
+                break;
+            default:
+                break;
+        }
+        times[i] = time;
+    }
+
+    // same as update of tween actions
+    const float *from0 = &pList->from0[0];
+    const float *from1 = &pList->from1[0];
+    const float *delta0 = &pList->delta0[0];
+    const float *delta1 = &pList->delta1[0];
+    float *values0 = &pList->values0[0];
+    float *values1 = &pList->values1[0];
+    for (unsigned int i = 0; i < count; i++)
+    {
+        values0[i] = from0[i] + delta0[i] * times[i];
+        values1[i] = from1[i] + delta1[i] * times[i];
+    }
+
+    memset(&pList->ready[0], 1, count);
+}
+
+void CCActionManager::stepTween(CCAction *pAction, float dt)
+{
+    tTweenList *pList = m_pTweens;
+    int slot = pAction->m_nTweenSlot;
+
+    // not computed in this frame, step it and keep its state
+    if (!pList->ready[slot])
+    {
+        CCActionInterval *pInterval = pList->actions[slot];
+        pAction->step(dt);
+        if (pAction->m_nTweenSlot == slot)
+        {
+            pList->elapsed[slot] = pInterval->m_elapsed;
+            pList->firstTicks[slot] = pInterval->m_bFirstTick;
+        }
+        return;
+    }
+    pList->ready[slot] = 0;
+
+    float elapsed = pList->nextElapsed[slot];
+    pList->elapsed[slot] = elapsed;
+    pList->firstTicks[slot] = 0;
+    pList->actions[slot]->m_elapsed = elapsed;
+    pList->actions[slot]->m_bFirstTick = false;
+
+    // setter may remove actions and free this slot, so read all before calling them
+    CCNode *pTarget = pList->targets[slot];
+    float value0 = pList->values0[slot];
+    float value1 = pList->values1[slot];
+    switch (pList->kinds[slot])
+    {
+        case kCCTweenMove:
+#if CC_ENABLE_STACKABLE_ACTIONS
+            // stacked position depends on current position of target
+            pList->tweens[slot]->update(pList->times[slot]);
+#else
+            pTarget->setPosition(CCPointMake(value0, value1));
+#endif
+            break;
+        case kCCTweenScale:
+            pTarget->setScaleX(value0);
+            pTarget->setScaleY(value1);
+            break;
+        case kCCTweenFade:
+            if (CCRGBAProtocol *pRGBA = pList->rgbas[slot])
+            {
+                pRGBA->setOpacity((GLubyte)value0);
+            }
+            break;
+        case kCCTweenRotate:
+            pTarget->setRotationX(value0);
+            pTarget->setRotationY(value1);
+            break;
+        default:
+            break;
+    }
+}
+
 NS_CC_END
@@ -38,6 +38,7 @@ class CCSet;
 class CCActionWatcher;
 
 struct _hashElement;
+struct _tweenList;
 
 /**
  * @addtogroup actions
@@ -124,6 +125,11 @@ public:
     /// register an action watcher
     void registerWatcher(CCActionWatcher* w);
 
+    /** Returns count of running actions which are updated by tween list, see CC_ACTION_MANAGER_USE_TWEEN_LIST
+     @since v2.2
+     */
+    unsigned int getTweenCount(void);
+
 protected:
     // declared in CCActionManager.m
 
@@ -133,10 +139,17 @@ protected:
     void update(float dt);
     void notifyWatcher(CCAction* a);
 
+    // tween list
+    void addTween(CCAction *pAction);
+    void removeTween(CCAction *pAction);
+    void updateTweens(float dt);
+    void stepTween(CCAction *pAction, float dt);
+
 protected:
     struct _hashElement    *m_pTargets;
     struct _hashElement    *m_pCurrentTarget;
     bool            m_bCurrentTargetSalvaged;
+    struct _tweenList      *m_pTweens;
     CCArray m_actionWatchers;
 };
 
@@ -40,6 +40,8 @@ THE SOFTWARE.
 #include "kazmath/GL/matrix.h"
 #include "support/component/CCComponent.h"
 #include "support/component/CCComponentContainer.h"
+#include <algorithm>
+#include <vector>
 
 #if CC_NODE_RENDER_SUBPIXEL
 #define RENDER_IN_SUBPIXEL
@@ -88,6 +90,7 @@ CCNode::CCNode(void)
 , m_bVisible(true)
 , m_bIgnoreAnchorPointForPosition(false)
 , m_bReorderChildDirty(false)
+, m_bReorderDirty(false)
 , m_pComponentContainer(NULL)
 , m_bInformDetach(false)
 {
@@ -808,6 +811,7 @@ void CCNode::detachChild(CCNode *child, bool doCleanup)
 void CCNode::insertChild(CCNode* child, int z)
 {
     m_bReorderChildDirty = true;
+    child->m_bReorderDirty = true;
     ccArrayAppendObjectWithResize(m_pChildren->data, child);
     child->_setZOrder(z);
 }
@@ -816,32 +820,88 @@ void CCNode::reorderChild(CCNode *child, int zOrder)
 {
     CCAssert( child != NULL, "Child must be non-nil");
     m_bReorderChildDirty = true;
+    child->m_bReorderDirty = true;
     child->setOrderOfArrival(s_globalOrderOfArrival++);
     child->_setZOrder(zOrder);
 }
 
-void CCNode::sortAllChildren()
+// sort key of a child, index is its position before sorting so the order is total and the sort is stable
+typedef struct _zOrderSortItem
 {
-    if (m_bReorderChildDirty)
+    CCNode* node;
+    int zOrder;
+    unsigned int orderOfArrival;
+    unsigned int index;
+} tZOrderSortItem;
+
+static inline bool zOrderSortItemLess(const tZOrderSortItem& a, const tZOrderSortItem& b)
+{
+    if(a.zOrder != b.zOrder)
+        return a.zOrder < b.zOrder;
+    if(a.orderOfArrival != b.orderOfArrival)
+        return a.orderOfArrival < b.orderOfArrival;
+    return a.index < b.index;
+}
+
+void CCNode::sortNodesByZOrder(ccArray* nodes)
+{
+    // scratch buffers, sorting only happens in gl thread
+    static std::vector<tZOrderSortItem> s_kept;
+    static std::vector<tZOrderSortItem> s_moved;
+
+    unsigned int length = nodes->num;
+    if(length < 2)
     {
-        int i,j,length = m_pChildren->data->num;
-        CCNode ** x = (CCNode**)m_pChildren->data->arr;
-        CCNode *tempItem;
+        if(length == 1)
+            ((CCNode*)nodes->arr[0])->m_bReorderDirty = false;
+        return;
+    }
 
-        // insertion sort
-        for(i=1; i<length; i++)
+    // split nodes into a sorted subsequence which stays in place and the nodes must be moved
+    s_kept.clear();
+    s_moved.clear();
+    for(unsigned int i = 0; i < length; i++)
+    {
+        CCNode* node = (CCNode*)nodes->arr[i];
+        tZOrderSortItem item = { node, node->m_nZOrder, node->m_uOrderOfArrival, i };
+        if(node->m_bReorderDirty || (!s_kept.empty() && zOrderSortItemLess(item, s_kept.back())))
         {
-            tempItem = x[i];
-            j = i-1;
-
-            //continue moving element downwards while zOrder is smaller or when zOrder is the same but mutatedIndex is smaller
-            while(j>=0 && ( tempItem->m_nZOrder < x[j]->m_nZOrder || ( tempItem->m_nZOrder== x[j]->m_nZOrder && tempItem->m_uOrderOfArrival < x[j]->m_uOrderOfArrival ) ) )
-            {
-                x[j+1] = x[j];
-                j = j-1;
-            }
-            x[j+1] = tempItem;
+            s_moved.push_back(item);
+        }
+        else
+        {
+            s_kept.push_back(item);
         }
+        node->m_bReorderDirty = false;
+    }
+
+    if(s_moved.empty())
+        return;
+
+    std::sort(s_moved.begin(), s_moved.end(), zOrderSortItemLess);
+
+    // merge back
+    std::vector<tZOrderSortItem>::const_iterator k = s_kept.begin();
+    std::vector<tZOrderSortItem>::const_iterator m = s_moved.begin();
+    CCObject** x = nodes->arr;
+    while(k != s_kept.end() && m != s_moved.end())
+    {
+        if(zOrderSortItemLess(*m, *k))
+            *x++ = (m++)->node;
+        else
+            *x++ = (k++)->node;
+    }
+    for(; k != s_kept.end(); ++k)
+        *x++ = k->node;
+    for(; m != s_moved.end(); ++m)
+        *x++ = m->node;
+}
+
+void CCNode::sortAllChildren()
+{
+    if (m_bReorderChildDirty)
+    {
+        sortNodesByZOrder(m_pChildren->data);
 
         //don't need to check children recursively, that's done in visit of each child
 
@@ -849,7 +909,6 @@ void CCNode::sortAllChildren()
     }
 }
 
-
  void CCNode::draw()
  {
      //CCAssert(0);
@@ -1514,6 +1514,14 @@ private:
     CCPoint convertToWindowSpace(const CCPoint& nodePoint);
 
 protected:
+    /**
+     * Sorts nodes by zOrder then orderOfArrival, keeping the current order of equal nodes.
+     * Nodes which were not reordered since last sort are assumed to be in place already, so
+     * only the moved ones are sorted and merged back. It costs O(n + k log k) for k moved
+     * nodes, O(n log n) at worst.
+     */
+    static void sortNodesByZOrder(ccArray* nodes);
+
     float m_fRotationX;                 ///< rotation angle on x-axis
     float m_fRotationY;                 ///< rotation angle on y-axis
     
@@ -1573,6 +1581,7 @@ protected:
                                           ///< Used by CCLayer and CCScene.
     
     bool m_bReorderChildDirty;          ///< children order dirty flag
+    bool m_bReorderDirty;               ///< zOrder or orderOfArrival changed since parent sorted its children
     
     /// when it is true, child will trigger a event to parent when it about to remove self from parent
     /// it is only triggered by removeFromParent(), directly calling removeChild won't do anything
@@ -28,6 +28,8 @@ THE SOFTWARE.
 
 NS_CC_BEGIN
 
+CC_SLAB_ALLOCATED_IMPL(CCArray)
+
 
 CCArray::CCArray()
 : data(NULL)
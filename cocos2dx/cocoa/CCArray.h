@@ -113,6 +113,8 @@ NS_CC_BEGIN
  */
 class CC_DLL CCArray : public CCObject
 {
+    CC_SLAB_ALLOCATED(CCArray)
+
 public:
     /**
      * @lua NA
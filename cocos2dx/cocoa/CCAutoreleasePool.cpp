@@ -28,58 +28,76 @@ NS_CC_BEGIN
 
 static CCPoolManager* s_pPoolManager = NULL;
 
+// entries of a chunk, power of two so index is split by shift and mask
+#define kCCAutoreleaseChunkShift 10
+#define kCCAutoreleaseChunkSize (1 << kCCAutoreleaseChunkShift)
+#define kCCAutoreleaseChunkMask (kCCAutoreleaseChunkSize - 1)
+
+#define CC_AUTORELEASE_ENTRY(__index__) m_vChunks[(__index__) >> kCCAutoreleaseChunkShift][(__index__) & kCCAutoreleaseChunkMask]
+
 CCAutoreleasePool::CCAutoreleasePool(void)
+: m_uCount(0)
 {
-    m_pManagedObjectArray = new CCArray();
-    m_pManagedObjectArray->init();
 }
 
 CCAutoreleasePool::~CCAutoreleasePool(void)
 {
-    CC_SAFE_DELETE(m_pManagedObjectArray);
+    clear();
+
+    for (std::vector<CCObject**>::iterator it = m_vChunks.begin(); it != m_vChunks.end(); ++it)
+    {
+        free(*it);
+    }
 }
 
 void CCAutoreleasePool::addObject(CCObject* pObject)
 {
-    m_pManagedObjectArray->addObject(pObject);
+    if ((m_uCount >> kCCAutoreleaseChunkShift) == m_vChunks.size())
+    {
+        m_vChunks.push_back((CCObject**)malloc(sizeof(CCObject*) * kCCAutoreleaseChunkSize));
+    }
+    CC_AUTORELEASE_ENTRY(m_uCount) = pObject;
+    ++m_uCount;
 
-    CCAssert(pObject->m_uReference > 1, "reference count should be greater than 1");
+    // the pool takes over the reference of caller
+    CCAssert(pObject->m_uReference > 0, "reference count should be greater than 0");
     ++(pObject->m_uAutoReleaseCount);
-    pObject->release(); // no ref count, in this case autorelease pool added.
 }
 
 void CCAutoreleasePool::removeObject(CCObject* pObject)
 {
-    for (unsigned int i = 0; i < pObject->m_uAutoReleaseCount; ++i)
+    // entries are cleared instead of removed, so other entries don't move
+    unsigned int uRemaining = pObject->m_uAutoReleaseCount;
+    for (unsigned int i = m_uCount; i > 0 && uRemaining > 0; --i)
+    {
+        CCObject*& pEntry = CC_AUTORELEASE_ENTRY(i - 1);
+        if (pEntry == pObject)
+        {
+            pEntry = NULL;
+            --uRemaining;
+        }
+    }
+
+    // drop cleared entries at the end
+    while (m_uCount > 0 && CC_AUTORELEASE_ENTRY(m_uCount - 1) == NULL)
     {
-        m_pManagedObjectArray->removeObject(pObject, false);
+        --m_uCount;
     }
 }
 
 void CCAutoreleasePool::clear()
 {
-    if(m_pManagedObjectArray->count() > 0)
+    // count is decreased before releasing, objects autoreleased by a destructor are
+    // added at the end and released in this loop too
+    while (m_uCount > 0)
     {
-        //CCAutoreleasePool* pReleasePool;
-#ifdef _DEBUG
-        int nIndex = m_pManagedObjectArray->count() - 1;
-#endif
-
-        CCObject* pObj = NULL;
-        CCARRAY_FOREACH_REVERSE(m_pManagedObjectArray, pObj)
+        --m_uCount;
+        CCObject* pObj = CC_AUTORELEASE_ENTRY(m_uCount);
+        if (pObj)
         {
-            if(!pObj)
-                break;
-
             --(pObj->m_uAutoReleaseCount);
-            //CC_SAFE_RELEASE((*it));
-            //delete (*it);
-#ifdef _DEBUG
-            nIndex--;
-#endif
+            pObj->release();
         }
-
-        m_pManagedObjectArray->removeAllObjects();
     }
 }
 
@@ -105,6 +123,9 @@ void CCPoolManager::purgePoolManager()
 }
 
 CCPoolManager::CCPoolManager()
+: m_uFrameObjects(0)
+, m_uLastFrameObjects(0)
+, m_uPeakPoolSize(0)
 {
     m_pReleasePoolStack = new CCArray();    
     m_pReleasePoolStack->init();
@@ -159,6 +180,13 @@ void CCPoolManager::pop()
      int nCount = m_pReleasePoolStack->count();
 
     m_pCurReleasePool->clear();
+
+    // bottom pool is drained once a frame
+    if (nCount == 1)
+    {
+        m_uLastFrameObjects = m_uFrameObjects;
+        m_uFrameObjects = 0;
+    }
  
       if(nCount > 1)
       {
@@ -184,7 +212,11 @@ void CCPoolManager::removeObject(CCObject* pObject)
 
 void CCPoolManager::addObject(CCObject* pObject)
 {
-    getCurReleasePool()->addObject(pObject);
+    CCAutoreleasePool* pPool = getCurReleasePool();
+    pPool->addObject(pObject);
+
+    ++m_uFrameObjects;
+    m_uPeakPoolSize = MAX(m_uPeakPoolSize, pPool->getObjectCount());
 }
 
 
@@ -26,6 +26,7 @@ THE SOFTWARE.
 
 #include "CCObject.h"
 #include "CCArray.h"
+#include <vector>
 
 NS_CC_BEGIN
 
@@ -38,15 +39,25 @@ NS_CC_BEGIN
 
 class CC_DLL CCAutoreleasePool : public CCObject
 {
-    CCArray*    m_pManagedObjectArray;    
+    // objects are kept in chunks of fixed size, adding an object never moves others
+    std::vector<CCObject**> m_vChunks;
+    unsigned int            m_uCount;
 public:
     CCAutoreleasePool(void);
     ~CCAutoreleasePool(void);
 
     void addObject(CCObject *pObject);
+    /** Removes entries of an object which is being deleted. Search starts from the newest
+     entry, since objects are usually deleted soon after they are autoreleased */
     void removeObject(CCObject *pObject);
 
+    /** releases objects in reverse order of adding */
     void clear();
+
+    /** number of entries, an object autoreleased twice has two
+     @since v2.2
+     */
+    unsigned int getObjectCount() { return m_uCount; }
 };
 
 /**
@@ -58,6 +69,11 @@ class CC_DLL CCPoolManager
     CCArray*    m_pReleasePoolStack;    
     CCAutoreleasePool*                    m_pCurReleasePool;
 
+    // counters
+    unsigned int m_uFrameObjects;
+    unsigned int m_uLastFrameObjects;
+    unsigned int m_uPeakPoolSize;
+
     CCAutoreleasePool* getCurReleasePool();
 public:
     CCPoolManager();
@@ -69,6 +85,18 @@ public:
     void removeObject(CCObject* pObject);
     void addObject(CCObject* pObject);
 
+    /** objects autoreleased between last two drains of the bottom pool, which is drained
+     by director once a frame
+     @since v2.2
+     */
+    unsigned int getLastFrameObjectCount() { return m_uLastFrameObjects; }
+
+    /** max entries a pool has held
+     @since v2.2
+     */
+    unsigned int getPeakPoolSize() { return m_uPeakPoolSize; }
+    void resetPeakPoolSize() { m_uPeakPoolSize = 0; }
+
     static CCPoolManager* sharedPoolManager();
     static void purgePoolManager();
 
@@ -38,6 +38,8 @@ NS_CC_BEGIN
 
 class CC_DLL CCBool : public CCObject
 {
+    CC_SLAB_ALLOCATED(CCBool)
+
 public:
     CCBool(bool v)
         : m_bValue(v) {}
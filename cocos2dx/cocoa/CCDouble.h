@@ -38,6 +38,8 @@ NS_CC_BEGIN
 
 class CC_DLL CCDouble : public CCObject
 {
+    CC_SLAB_ALLOCATED(CCDouble)
+
 public:
     CCDouble(double v)
         : m_dValue(v) {}
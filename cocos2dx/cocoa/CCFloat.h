@@ -38,6 +38,8 @@ NS_CC_BEGIN
 
 class CC_DLL CCFloat : public CCObject
 {
+    CC_SLAB_ALLOCATED(CCFloat)
+
 public:
     CCFloat(float v)
         : m_fValue(v) {}
@@ -13,6 +13,8 @@ NS_CC_BEGIN
 
 class CC_DLL CCInteger : public CCObject
 {
+    CC_SLAB_ALLOCATED(CCInteger)
+
 public:
     CCInteger(int v)
         : m_nValue(v) {}
@@ -50,6 +50,11 @@ CCObject::CCObject(void)
     static unsigned int uObjectCount = 0;
 
     m_uID = ++uObjectCount;
+
+    // for memory debugging
+#ifdef CC_CFLAG_MEMORY_TRACKING
+    CCMemory::trackCCObject(this);
+#endif
 }
 
 CCObject* CCObject::create() {
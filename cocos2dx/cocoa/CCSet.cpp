@@ -28,6 +28,8 @@ using namespace std;
 
 NS_CC_BEGIN
 
+CC_SLAB_ALLOCATED_IMPL(CCSet)
+
 CCSet::CCSet(void)
 {
     m_pSet = new set<CCObject *>;
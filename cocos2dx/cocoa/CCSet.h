@@ -39,6 +39,8 @@ typedef std::set<CCObject *>::iterator CCSetIterator;
 
 class CC_DLL CCSet : public CCObject
 {
+    CC_SLAB_ALLOCATED(CCSet)
+
 public:
     /**
      * @js  ctor
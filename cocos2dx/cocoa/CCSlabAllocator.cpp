@@ -0,0 +1,244 @@
+/****************************************************************************
+ Author: Luma (stubma@gmail.com)
+
+ https://github.com/stubma/cocos2dx-classical
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#include "CCSlabAllocator.h"
+#include "CCFloat.h"
+#include "CCInteger.h"
+#include "CCDouble.h"
+#include "CCBool.h"
+#include "ccMacros.h"
+#include <stdlib.h>
+
+#if CC_SLAB_ALLOCATOR_ENABLED
+#include <pthread.h>
+#endif
+
+// size step of size classes
+#define kCCSlabSizeStep 16
+
+// max size allocated from slab, bigger size uses malloc
+#define kCCSlabMaxSize 256
+
+// count of size classes
+#define kCCSlabClassCount (kCCSlabMaxSize / kCCSlabSizeStep)
+
+// size of chunk carved into blocks
+#define kCCSlabChunkSize (16 * 1024)
+
+NS_CC_BEGIN
+
+// CCFloat, CCInteger, CCDouble and CCBool are header only, their stats live here
+CC_SLAB_ALLOCATED_IMPL(CCFloat)
+CC_SLAB_ALLOCATED_IMPL(CCInteger)
+CC_SLAB_ALLOCATED_IMPL(CCDouble)
+CC_SLAB_ALLOCATED_IMPL(CCBool)
+
+// registered stats, it is zero initialized before any stats constructor runs
+static CCSlabClassStats* s_firstStats = NULL;
+
+// total bytes of chunks
+static size_t s_chunkBytes = 0;
+
+CCSlabClassStats::CCSlabClassStats(const char* name) :
+name(name),
+glLive(0),
+otherLive(0),
+peak(0),
+total(0) {
+    // stats are static members, constructed before main, no lock needed
+    next = s_firstStats;
+    s_firstStats = this;
+}
+
+#if CC_SLAB_ALLOCATOR_ENABLED
+
+// a free block, link is stored in block itself
+struct _slabBlock {
+    _slabBlock* next;
+};
+
+// free lists owned by GL thread, no lock
+static _slabBlock* s_glFree[kCCSlabClassCount] = { NULL };
+
+// free lists shared by other threads, guarded by s_mutex
+static _slabBlock* s_sharedFree[kCCSlabClassCount] = { NULL };
+
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t s_glThread;
+static bool s_glThreadSet = false;
+
+// carve a new chunk into blocks of a size class, must be called with s_mutex locked
+static _slabBlock* carveChunk(int sizeClass) {
+    size_t blockSize = (sizeClass + 1) * kCCSlabSizeStep;
+    char* chunk = (char*)malloc(kCCSlabChunkSize);
+    if(!chunk)
+        return NULL;
+    s_chunkBytes += kCCSlabChunkSize;
+
+    // link blocks in address order
+    int count = kCCSlabChunkSize / blockSize;
+    for(int i = 0; i < count - 1; i++) {
+        ((_slabBlock*)(chunk + i * blockSize))->next = (_slabBlock*)(chunk + (i + 1) * blockSize);
+    }
+    ((_slabBlock*)(chunk + (count - 1) * blockSize))->next = NULL;
+    return (_slabBlock*)chunk;
+}
+
+static inline void countAlloc(CCSlabClassStats* stats, bool glThread) {
+    if(!stats)
+        return;
+    if(glThread)
+        stats->glLive++;
+    else
+        stats->otherLive++;
+    stats->total++;
+    int live = stats->getLiveCount();
+    if(live > stats->peak)
+        stats->peak = live;
+}
+
+static inline void countFree(CCSlabClassStats* stats, bool glThread) {
+    if(!stats)
+        return;
+    if(glThread)
+        stats->glLive--;
+    else
+        stats->otherLive--;
+}
+
+void CCSlabAllocator::setGLThread() {
+    s_glThread = pthread_self();
+    s_glThreadSet = true;
+}
+
+bool CCSlabAllocator::isGLThread() {
+    return s_glThreadSet && pthread_equal(pthread_self(), s_glThread);
+}
+
+void* CCSlabAllocator::allocate(size_t size, CCSlabClassStats* stats) {
+    bool glThread = isGLThread();
+
+    // big object
+    if(size > kCCSlabMaxSize || size == 0) {
+        void* p = malloc(size);
+        if(p) {
+            if(!glThread)
+                pthread_mutex_lock(&s_mutex);
+            countAlloc(stats, glThread);
+            if(!glThread)
+                pthread_mutex_unlock(&s_mutex);
+        }
+        return p;
+    }
+
+    int sizeClass = (int)((size - 1) / kCCSlabSizeStep);
+    _slabBlock* block;
+    if(glThread) {
+        // fast path, refill from shared list or a new chunk when empty
+        block = s_glFree[sizeClass];
+        if(!block) {
+            pthread_mutex_lock(&s_mutex);
+            block = s_sharedFree[sizeClass];
+            s_sharedFree[sizeClass] = NULL;
+            if(!block)
+                block = carveChunk(sizeClass);
+            pthread_mutex_unlock(&s_mutex);
+            if(!block)
+                return NULL;
+        }
+        s_glFree[sizeClass] = block->next;
+        countAlloc(stats, true);
+    } else {
+        pthread_mutex_lock(&s_mutex);
+        block = s_sharedFree[sizeClass];
+        if(!block)
+            block = carveChunk(sizeClass);
+        if(block) {
+            s_sharedFree[sizeClass] = block->next;
+            countAlloc(stats, false);
+        }
+        pthread_mutex_unlock(&s_mutex);
+    }
+    return block;
+}
+
+void CCSlabAllocator::deallocate(void* p, size_t size, CCSlabClassStats* stats) {
+    if(!p)
+        return;
+
+    bool glThread = isGLThread();
+    if(!glThread)
+        pthread_mutex_lock(&s_mutex);
+    countFree(stats, glThread);
+    if(size > kCCSlabMaxSize || size == 0) {
+        free(p);
+    } else {
+        int sizeClass = (int)((size - 1) / kCCSlabSizeStep);
+        _slabBlock* block = (_slabBlock*)p;
+        _slabBlock** list = glThread ? s_glFree : s_sharedFree;
+        block->next = list[sizeClass];
+        list[sizeClass] = block;
+    }
+    if(!glThread)
+        pthread_mutex_unlock(&s_mutex);
+}
+
+#else
+
+void CCSlabAllocator::setGLThread() {
+}
+
+bool CCSlabAllocator::isGLThread() {
+    return false;
+}
+
+void* CCSlabAllocator::allocate(size_t size, CCSlabClassStats* stats) {
+    return malloc(size);
+}
+
+void CCSlabAllocator::deallocate(void* p, size_t size, CCSlabClassStats* stats) {
+    free(p);
+}
+
+#endif // #if CC_SLAB_ALLOCATOR_ENABLED
+
+CCSlabClassStats* CCSlabAllocator::firstClassStats() {
+    return s_firstStats;
+}
+
+size_t CCSlabAllocator::getChunkBytes() {
+    return s_chunkBytes;
+}
+
+void CCSlabAllocator::dumpStats() {
+#if CC_SLAB_ALLOCATOR_ENABLED
+    CCLOG("CCSlabAllocator: %u bytes in chunks", (unsigned int)s_chunkBytes);
+    for(CCSlabClassStats* stats = s_firstStats; stats; stats = stats->next) {
+        CCLOG("CCSlabAllocator: %s live %d, peak %d, total %u", stats->name, stats->getLiveCount(), stats->peak, stats->total);
+    }
+#else
+    CCLOG("CCSlabAllocator: disabled, set CC_USE_SLAB_ALLOCATOR to 1 to enable");
+#endif
+}
+
+NS_CC_END
@@ -0,0 +1,154 @@
+/****************************************************************************
+ Author: Luma (stubma@gmail.com)
+
+ https://github.com/stubma/cocos2dx-classical
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#ifndef __CCSlabAllocator_h__
+#define __CCSlabAllocator_h__
+
+#include "ccConfig.h"
+#include "platform/CCPlatformMacros.h"
+#include <stddef.h>
+
+/// is slab allocator really used, it is off when memory tracking replaces global new
+#if CC_USE_SLAB_ALLOCATOR && !defined(CC_CFLAG_MEMORY_TRACKING) && (CC_TARGET_PLATFORM != CC_PLATFORM_WINRT) && (CC_TARGET_PLATFORM != CC_PLATFORM_WP8)
+    #define CC_SLAB_ALLOCATOR_ENABLED 1
+#else
+    #define CC_SLAB_ALLOCATOR_ENABLED 0
+#endif
+
+NS_CC_BEGIN
+
+/**
+ * Allocation counts of a class allocated by CCSlabAllocator. Every class using CC_SLAB_ALLOCATED
+ * has one, and it is registered in a list which can be walked by CCSlabAllocator::firstClassStats.
+ * Subclass which doesn't use CC_SLAB_ALLOCATED is counted in its nearest parent.
+ *
+ * Counts are updated without lock in GL thread, so live count read from other thread and peak
+ * count are approximate.
+ *
+ * @since v2.2
+ */
+struct CC_DLL CCSlabClassStats {
+    CCSlabClassStats(const char* name);
+
+    /// live object count
+    int getLiveCount() const { return glLive + otherLive; }
+
+    /// class name
+    const char* name;
+
+    /// live count changed in GL thread, it can be negative if objects allocated by other threads are freed in GL thread
+    int glLive;
+
+    /// live count changed in other threads, guarded by allocator lock
+    int otherLive;
+
+    /// max live count ever reached
+    int peak;
+
+    /// total allocation count
+    unsigned int total;
+
+    /// next registered stats
+    CCSlabClassStats* next;
+};
+
+/**
+ * Size-class allocator for small objects which are created and released many times in a frame.
+ * Size is rounded up to a multiple of 16 bytes, up to 256 bytes, every size class has its own
+ * free list and blocks are carved from 16KB chunks. Bigger size falls back to malloc.
+ *
+ * GL thread, set by setGLThread, has its own free lists and never takes a lock, unless its list
+ * is empty and it needs to take blocks freed by other threads or carve a new chunk. Other threads
+ * share locked free lists. A block can be freed in any thread.
+ *
+ * Chunks are never returned to system, a free block is always reused by same size class.
+ *
+ * A class opts in by CC_SLAB_ALLOCATED in its declaration and CC_SLAB_ALLOCATED_IMPL in its
+ * source, both are empty unless CC_USE_SLAB_ALLOCATOR is enabled.
+ *
+ * @since v2.2
+ */
+class CC_DLL CCSlabAllocator {
+public:
+    /// set calling thread as GL thread, CCDirector calls it when initialized
+    static void setGLThread();
+
+    /// is calling thread the GL thread
+    static bool isGLThread();
+
+    /**
+     * Allocate a block
+     *
+     * @param size block size
+     * @param stats stats of allocated class, can be NULL
+     * @return block, or NULL if out of memory
+     */
+    static void* allocate(size_t size, CCSlabClassStats* stats);
+
+    /**
+     * Free a block returned by allocate
+     *
+     * @param p block, can be NULL
+     * @param size same size passed to allocate
+     * @param stats same stats passed to allocate
+     */
+    static void deallocate(void* p, size_t size, CCSlabClassStats* stats);
+
+    /// first registered class stats, walk by CCSlabClassStats::next
+    static CCSlabClassStats* firstClassStats();
+
+    /// total bytes of chunks allocated from system
+    static size_t getChunkBytes();
+
+    /// log live, peak and total count of every class
+    static void dumpStats();
+};
+
+NS_CC_END
+
+#if CC_SLAB_ALLOCATOR_ENABLED
+
+/**
+ * Put at the beginning of class body to allocate the class and its subclasses by CCSlabAllocator,
+ * it leaves access as private. Operator new is non-throwing so a failed new returns NULL as
+ * creators expect.
+ */
+#define CC_SLAB_ALLOCATED(className) \
+    public: \
+        static void* operator new(size_t size) throw() { return cocos2d::CCSlabAllocator::allocate(size, &s_slabStats); } \
+        static void operator delete(void* p, size_t size) { cocos2d::CCSlabAllocator::deallocate(p, size, &s_slabStats); } \
+        static cocos2d::CCSlabClassStats s_slabStats; \
+    private:
+
+/// put in source of a class which uses CC_SLAB_ALLOCATED
+#define CC_SLAB_ALLOCATED_IMPL(className) \
+    cocos2d::CCSlabClassStats className::s_slabStats(#className);
+
+#else
+
+#define CC_SLAB_ALLOCATED(className)
+#define CC_SLAB_ALLOCATED_IMPL(className)
+
+#endif // #if CC_SLAB_ALLOCATOR_ENABLED
+
+#endif // __CCSlabAllocator_h__
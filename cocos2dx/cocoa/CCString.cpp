@@ -6,6 +6,8 @@
 
 NS_CC_BEGIN
 
+CC_SLAB_ALLOCATED_IMPL(CCString)
+
 #define kMaxStringLen (1024*100)
 
 CCString::CCString()
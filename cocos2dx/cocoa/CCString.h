@@ -43,6 +43,8 @@ NS_CC_BEGIN
 
 class CC_DLL CCString : public CCObject
 {
+    CC_SLAB_ALLOCATED(CCString)
+
 public:
     /**
      * @lua NA
@@ -24,6 +24,7 @@ THE SOFTWARE.
 ****************************************************************************/
 #include "CCGrabber.h"
 #include "ccMacros.h"
+#include "CCRenderQueue.h"
 #include "textures/CCTexture2D.h"
 #include "platform/platform.h"
 
@@ -62,6 +63,7 @@ void CCGrabber::grab(CCTexture2D *pTexture)
 void CCGrabber::beforeRender(CCTexture2D *pTexture)
 {
     CC_UNUSED_PARAM(pTexture);
+    CC_RENDER_QUEUE_FLUSH();
 
     glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_oldFBO);
     glBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
@@ -84,6 +86,7 @@ void CCGrabber::beforeRender(CCTexture2D *pTexture)
 void CCGrabber::afterRender(cocos2d::CCTexture2D *pTexture)
 {
     CC_UNUSED_PARAM(pTexture);
+    CC_RENDER_QUEUE_FLUSH();
 
     glBindFramebuffer(GL_FRAMEBUFFER, m_oldFBO);
 //  glColorMask(true, true, true, true);    // #631
@@ -25,6 +25,7 @@ THE SOFTWARE.
 #include "ccMacros.h"
 #include "effects/CCGrid.h"
 #include "CCDirector.h"
+#include "CCRenderQueue.h"
 #include "effects/CCGrabber.h"
 #include "support/utils/CCUtils.h"
 #include "shaders/CCGLProgram.h"
@@ -199,6 +200,8 @@ void CCGridBase::set2DProjection()
 
 void CCGridBase::beforeDraw(void)
 {
+    CC_RENDER_QUEUE_FLUSH();
+
     // save projection
     CCDirector *director = CCDirector::sharedDirector();
     m_directorProjection = director->getProjection();
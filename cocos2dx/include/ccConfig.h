@@ -204,6 +204,80 @@ Only valid for cocos2d-mac. Not supported on cocos2d-ios.
 #define CC_USE_LA88_LABELS 1
 #endif
 
+/** @def CC_PARTICLE_USE_SIMD
+ If enabled, particle systems are updated 4 particles at once with SSE2 on x86 and NEON on ARM.
+ Platforms without them always use the scalar code. Results of both differ only by float rounding.
+
+ To disable set it to 0. Enabled by default.
+
+ @since v2.2
+ */
+#ifndef CC_PARTICLE_USE_SIMD
+#define CC_PARTICLE_USE_SIMD 1
+#endif
+
+/** @def CC_FILE_VIEW_MMAP_THRESHOLD
+ Files at least this large are memory mapped by CCFileUtils::openFileView, smaller files are read
+ into memory because mapping a few pages costs more than copying them.
+
+ Set it to 0 to map all files. Default is 16KB.
+
+ @since v2.2
+ */
+#ifndef CC_FILE_VIEW_MMAP_THRESHOLD
+#define CC_FILE_VIEW_MMAP_THRESHOLD (16 * 1024)
+#endif
+
+/** @def CC_MAX_CACHED_ZIPS
+ Max number of zip files kept open by CCFileUtils::getFileDataFromZip. Least recently used zip
+ file is closed when another one is opened.
+
+ Default is 4.
+
+ @since v2.2
+ */
+#ifndef CC_MAX_CACHED_ZIPS
+#define CC_MAX_CACHED_ZIPS 4
+#endif
+
+/** @def CC_BMFONT_FLAT_GLYPH_RANGE
+ Glyphs of CCLabelBMFont whose code is below this value are found by a direct indexed table, others,
+ such as CJK, are found by binary search. The table costs 2 bytes per code for every loaded font.
+
+ Default is 0x800, which covers Latin, Greek, Cyrillic, Hebrew and Arabic.
+
+ @since v2.2
+ */
+#ifndef CC_BMFONT_FLAT_GLYPH_RANGE
+#define CC_BMFONT_FLAT_GLYPH_RANGE 0x800
+#endif
+
+/** @def CC_ACTION_MANAGER_USE_TWEEN_LIST
+ If enabled, CCActionManager keeps CCMoveTo, CCMoveBy, CCScaleTo, CCScaleBy, CCFadeTo and CCRotateTo,
+ bare or wrapped by a rate, exponential or sine CCEase action, in flat arrays and computes their
+ times and values for all targets in tight loops, instead of stepping them one by one.
+
+ To disable set it to 0. Enabled by default.
+
+ @since v2.2
+ */
+#ifndef CC_ACTION_MANAGER_USE_TWEEN_LIST
+#define CC_ACTION_MANAGER_USE_TWEEN_LIST 1
+#endif
+
+/** @def CC_USE_SLAB_ALLOCATOR
+ If enabled, short-lived CCObject subclasses such as CCString, CCFloat, CCInteger, CCArray, CCSet and
+ actions are allocated from size-class free lists of CCSlabAllocator instead of malloc one by one.
+ Allocation in GL thread doesn't take any lock. It is ignored when CC_CFLAG_MEMORY_TRACKING is defined.
+
+ To enable set it to 1. Disabled by default.
+
+ @since v2.2
+ */
+#ifndef CC_USE_SLAB_ALLOCATOR
+#define CC_USE_SLAB_ALLOCATOR 0
+#endif
+
 /** @def CC_SPRITE_DEBUG_DRAW
  If enabled, all subclasses of CCSprite will draw a bounding box
  Useful for debugging purposes only. It is recommended to leave it disabled.
@@ -239,18 +239,29 @@ It should work same as apples CFSwapInt32LittleToHost(..)
 #define CC_PROFILER_DISPLAY_TIMERS() CCProfiler::sharedProfiler()->displayTimers()
 #define CC_PROFILER_PURGE_ALL() CCProfiler::sharedProfiler()->releaseAllTimers()
 
-#define CC_PROFILER_START(__name__) CCProfilingBeginTimingBlock(__name__)
-#define CC_PROFILER_STOP(__name__) CCProfilingEndTimingBlock(__name__)
+// zone names are looked up once per call site, so they must be constant
+#define CC_PROFILER_START(__name__) do{ static const unsigned int __zone__ = CCProfiler::zoneForName(__name__); CCProfilingBeginZone(__zone__); } while(0)
+#define CC_PROFILER_STOP(__name__) do{ static const unsigned int __zone__ = CCProfiler::zoneForName(__name__); CCProfilingEndZone(__zone__); } while(0)
 #define CC_PROFILER_RESET(__name__) CCProfilingResetTimingBlock(__name__)
 
-#define CC_PROFILER_START_CATEGORY(__cat__, __name__) do{ if(__cat__) CCProfilingBeginTimingBlock(__name__); } while(0)
-#define CC_PROFILER_STOP_CATEGORY(__cat__, __name__) do{ if(__cat__) CCProfilingEndTimingBlock(__name__); } while(0)
+#define CC_PROFILER_START_CATEGORY(__cat__, __name__) do{ if(__cat__) CC_PROFILER_START(__name__); } while(0)
+#define CC_PROFILER_STOP_CATEGORY(__cat__, __name__) do{ if(__cat__) CC_PROFILER_STOP(__name__); } while(0)
 #define CC_PROFILER_RESET_CATEGORY(__cat__, __name__) do{ if(__cat__) CCProfilingResetTimingBlock(__name__); } while(0)
 
 #define CC_PROFILER_START_INSTANCE(__id__, __name__) do{ CCProfilingBeginTimingBlock( CCString::createWithFormat("%08X - %s", __id__, __name__)->getCString() ); } while(0)
 #define CC_PROFILER_STOP_INSTANCE(__id__, __name__) do{ CCProfilingEndTimingBlock(    CCString::createWithFormat("%08X - %s", __id__, __name__)->getCString() ); } while(0)
 #define CC_PROFILER_RESET_INSTANCE(__id__, __name__) do{ CCProfilingResetTimingBlock( CCString::createWithFormat("%08X - %s", __id__, __name__)->getCString() ); } while(0)
 
+// zone lasting until end of current scope
+#define CC_PROFILER_JOIN_(__a__, __b__) __a__##__b__
+#define CC_PROFILER_JOIN(__a__, __b__) CC_PROFILER_JOIN_(__a__, __b__)
+#define CC_PROFILER_ZONE(__name__) \
+    static const unsigned int CC_PROFILER_JOIN(__zone, __LINE__) = CCProfiler::zoneForName(__name__); \
+    CCProfilingScope CC_PROFILER_JOIN(__scope, __LINE__)(CC_PROFILER_JOIN(__zone, __LINE__))
+
+#define CC_PROFILER_THREAD_NAME(__name__) CCProfiler::setThreadName(__name__)
+#define CC_PROFILER_BEGIN_FRAME() CCProfiler::sharedProfiler()->beginFrame()
+#define CC_PROFILER_CAPTURE_FRAMES(__frames__, __path__) CCProfiler::sharedProfiler()->captureFrames(__frames__, __path__)
 
 #else
 
@@ -269,6 +280,12 @@ It should work same as apples CFSwapInt32LittleToHost(..)
 #define CC_PROFILER_STOP_INSTANCE(__id__, __name__) do {} while(0)
 #define CC_PROFILER_RESET_INSTANCE(__id__, __name__) do {} while(0)
 
+#define CC_PROFILER_ZONE(__name__) do {} while(0)
+
+#define CC_PROFILER_THREAD_NAME(__name__) do {} while(0)
+#define CC_PROFILER_BEGIN_FRAME() do {} while(0)
+#define CC_PROFILER_CAPTURE_FRAMES(__frames__, __path__) do {} while(0)
+
 #endif
 
 #if !defined(COCOS2D_DEBUG) || COCOS2D_DEBUG == 0
@@ -290,6 +307,13 @@ It should work same as apples CFSwapInt32LittleToHost(..)
 extern unsigned int CC_DLL g_uNumberOfDraws;
 #define CC_INCREMENT_GL_DRAWS(__n__) g_uNumberOfDraws += __n__
 
+/** @def CC_INCREMENT_GL_UPLOADED_BYTES
+ Increments the count of vertex bytes uploaded to GL buffers in current frame.
+ The count of last frame can be read by CCDirector::getUploadedBytes
+ */
+extern unsigned int CC_DLL g_uNumberOfUploadedBytes;
+#define CC_INCREMENT_GL_UPLOADED_BYTES(__n__) g_uNumberOfUploadedBytes += __n__
+
 /*******************/
 /** Notifications **/
 /*******************/
@@ -75,6 +75,7 @@ THE SOFTWARE.
 #include "cocoa/CCAffineTransform.h"
 #include "cocoa/CCDictionary.h"
 #include "cocoa/CCObject.h"
+#include "cocoa/CCSlabAllocator.h"
 #include "cocoa/CCArray.h"
 #include "cocoa/CCGeometry.h"
 #include "cocoa/CCSet.h"
@@ -295,6 +296,7 @@ THE SOFTWARE.
 #include "CCConfiguration.h"
 #include "CCDirector.h"
 #include "CCScheduler.h"
+#include "CCRenderQueue.h"
 
 // component
 #include "support/component/CCComponent.h"
@@ -42,21 +42,33 @@ http://www.angelcode.com/products/bmfont/ (Free, Windows only)
 #include "CCDirector.h"
 #include "textures/CCTextureCache.h"
 #include "support/codec/ccUTF8.h"
+#include "platform/CCFileView.h"
+#include <algorithm>
 
 using namespace std;
 
 NS_CC_BEGIN
 
-// The return value needs to be deleted by CC_SAFE_DELETE_ARRAY.
-static unsigned short* copyUTF16StringN(unsigned short* str)
+// Copies str to buffer, buffer is reallocated only if it is too small. It needs to be deleted by CC_SAFE_DELETE_ARRAY.
+static void assignUTF16String(unsigned short*& buffer, unsigned int& capacity, const unsigned short* str)
 {
-    int length = str ? cc_wcslen(str) : 0;
-    unsigned short* ret = new unsigned short[length+1];
-    for (int i = 0; i < length; ++i) {
-        ret[i] = str[i];
+    unsigned int length = str ? cc_wcslen(str) : 0;
+    if (!buffer || capacity < length + 1)
+    {
+        unsigned short* tmp = buffer;
+        capacity = length + 1;
+        buffer = new unsigned short[capacity];
+        if (length > 0)
+        {
+            memcpy(buffer, str, length * sizeof(unsigned short));
+        }
+        CC_SAFE_DELETE_ARRAY(tmp);
     }
-    ret[length] = 0;
-    return ret;
+    else if (length > 0)
+    {
+        memmove(buffer, str, length * sizeof(unsigned short));
+    }
+    buffer[length] = 0;
 }
 
 //
@@ -113,28 +125,35 @@ CCBMFontConfiguration * CCBMFontConfiguration::create(const char *FNTfile)
 
 bool CCBMFontConfiguration::initWithFNTfile(const char *FNTfile)
 {
-    m_pKerningDictionary = NULL;
-    m_pFontDefDictionary = NULL;
+    m_fontDefs.clear();
+    m_kernings.clear();
     
-    m_pCharacterSet = this->parseConfigFile(FNTfile);
-    
-    if (! m_pCharacterSet)
+    if (! this->parseConfigFile(FNTfile))
     {
         return false;
     }
-
+    
+    this->buildLookupTables();
     return true;
 }
 
-std::set<unsigned int>* CCBMFontConfiguration::getCharacterSet() const
+std::set<unsigned int>* CCBMFontConfiguration::getCharacterSet()
 {
+    if (! m_pCharacterSet)
+    {
+        m_pCharacterSet = new set<unsigned int>();
+        for (vector<ccBMFontDef>::const_iterator iter = m_fontDefs.begin(); iter != m_fontDefs.end(); ++iter)
+        {
+            m_pCharacterSet->insert(m_pCharacterSet->end(), iter->charID);
+        }
+    }
     return m_pCharacterSet;
 }
 
 CCBMFontConfiguration::CCBMFontConfiguration()
-: m_pFontDefDictionary(NULL)
+: m_pFlatFontDefIndex(NULL)
+, m_nFirstSparseFontDef(0)
 , m_nCommonHeight(0)
-, m_pKerningDictionary(NULL)
 , m_pCharacterSet(NULL)
 {
 
@@ -143,8 +162,7 @@ CCBMFontConfiguration::CCBMFontConfiguration()
 CCBMFontConfiguration::~CCBMFontConfiguration()
 {
     CCLOGINFO( "cocos2d: deallocing CCBMFontConfiguration" );
-    this->purgeFontDefDictionary();
-    this->purgeKerningDictionary();
+    CC_SAFE_DELETE_ARRAY(m_pFlatFontDefIndex);
     m_sAtlasName.clear();
     CC_SAFE_DELETE(m_pCharacterSet);
 }
@@ -154,69 +172,134 @@ const char* CCBMFontConfiguration::description(void)
     return CCString::createWithFormat(
         "<CCBMFontConfiguration = " CC_FORMAT_PRINTF_SIZE_T " | Glphys:%d Kernings:%d | Image = %s>",
         (size_t)this,
-        HASH_COUNT(m_pFontDefDictionary),
-        HASH_COUNT(m_pKerningDictionary),
+        (int)m_fontDefs.size(),
+        (int)m_kernings.size(),
         m_sAtlasName.c_str()
     )->getCString();
 }
 
-void CCBMFontConfiguration::purgeKerningDictionary()
+static bool compareFontDef(const ccBMFontDef& a, const ccBMFontDef& b)
 {
-    tCCKerningHashElement *current;
-    while(m_pKerningDictionary) 
+    return a.charID < b.charID;
+}
+
+static bool isSameFontDef(const ccBMFontDef& a, const ccBMFontDef& b)
+{
+    return a.charID == b.charID;
+}
+
+static bool compareKerning(const ccBMFontKerning& a, const ccBMFontKerning& b)
+{
+    return a.key < b.key;
+}
+
+static bool isSameKerning(const ccBMFontKerning& a, const ccBMFontKerning& b)
+{
+    return a.key == b.key;
+}
+
+void CCBMFontConfiguration::buildLookupTables()
+{
+    // last definition of a char wins, same as hash lookup did
+    std::reverse(m_fontDefs.begin(), m_fontDefs.end());
+    std::stable_sort(m_fontDefs.begin(), m_fontDefs.end(), compareFontDef);
+    m_fontDefs.erase(std::unique(m_fontDefs.begin(), m_fontDefs.end(), isSameFontDef), m_fontDefs.end());
+    std::reverse(m_kernings.begin(), m_kernings.end());
+    std::stable_sort(m_kernings.begin(), m_kernings.end(), compareKerning);
+    m_kernings.erase(std::unique(m_kernings.begin(), m_kernings.end(), isSameKerning), m_kernings.end());
+    
+    // chars in flat range are at the beginning
+    CC_SAFE_DELETE_ARRAY(m_pFlatFontDefIndex);
+    m_pFlatFontDefIndex = new unsigned short[CC_BMFONT_FLAT_GLYPH_RANGE];
+    memset(m_pFlatFontDefIndex, 0xff, sizeof(unsigned short) * CC_BMFONT_FLAT_GLYPH_RANGE);
+    unsigned int count = m_fontDefs.size();
+    unsigned int i = 0;
+    for (; i < count && m_fontDefs[i].charID < CC_BMFONT_FLAT_GLYPH_RANGE; i++)
     {
-        current = m_pKerningDictionary; 
-        HASH_DEL(m_pKerningDictionary,current);
-        free(current);
+        m_pFlatFontDefIndex[m_fontDefs[i].charID] = (unsigned short)i;
     }
+    m_nFirstSparseFontDef = i;
+    
+    // character set is rebuilt when it is queried
+    CC_SAFE_DELETE(m_pCharacterSet);
 }
 
-void CCBMFontConfiguration::purgeFontDefDictionary()
-{    
-    tCCFontDefHashElement *current, *tmp;
+const ccBMFontDef* CCBMFontConfiguration::findSparseFontDef(unsigned int charID) const
+{
+    ccBMFontDef key;
+    key.charID = charID;
+    vector<ccBMFontDef>::const_iterator iter = std::lower_bound(m_fontDefs.begin() + m_nFirstSparseFontDef, m_fontDefs.end(), key, compareFontDef);
+    if (iter != m_fontDefs.end() && iter->charID == charID)
+    {
+        return &(*iter);
+    }
+    return NULL;
+}
 
-    HASH_ITER(hh, m_pFontDefDictionary, current, tmp) {
-        HASH_DEL(m_pFontDefDictionary, current);
-        free(current);
+int CCBMFontConfiguration::getKerningAmount(unsigned short first, unsigned short second) const
+{
+    if (m_kernings.empty())
+    {
+        return 0;
     }
+    ccBMFontKerning key;
+    key.key = (first<<16) | (second & 0xffff);
+    vector<ccBMFontKerning>::const_iterator iter = std::lower_bound(m_kernings.begin(), m_kernings.end(), key, compareKerning);
+    if (iter != m_kernings.end() && iter->key == key.key)
+    {
+        return iter->amount;
+    }
+    return 0;
+}
+
+static inline bool lineStartsWith(const std::string& line, const char* prefix)
+{
+    return line.compare(0, strlen(prefix), prefix) == 0;
 }
 
-std::set<unsigned int>* CCBMFontConfiguration::parseConfigFile(const char *controlFile)
+bool CCBMFontConfiguration::parseConfigFile(const char *controlFile)
 {    
     std::string fullpath = CCFileUtils::sharedFileUtils()->fullPathForFilename(controlFile);
-    CCString *contents = CCString::createWithContentsOfFile(fullpath.c_str());
+    CCFileView* pView = CCFileUtils::sharedFileUtils()->openFileView(fullpath.c_str());
 
-    CCAssert(contents, "CCBMFontConfiguration::parseConfigFile | Open file error.");
+    CCAssert(pView, "CCBMFontConfiguration::parseConfigFile | Open file error.");
     
-    set<unsigned int> *validCharsString = new set<unsigned int>();
-
-    if (!contents)
+    if (!pView)
     {
         CCLOG("cocos2d: Error parsing FNTfile %s", controlFile);
-        return NULL;
+        return false;
+    }
+    
+    // binary format starts with "BMF" and version
+    const unsigned char* pData = pView->getBytes();
+    size_t nSize = pView->getSize();
+    if (nSize >= 4 && memcmp(pData, "BMF", 3) == 0)
+    {
+        bool bRet = this->parseBinaryConfigFile(pData, nSize, controlFile);
+        pView->release();
+        if (!bRet)
+        {
+            CCLOG("cocos2d: Error parsing FNTfile %s", controlFile);
+        }
+        return bRet;
     }
 
     // parse spacing / padding
     std::string line;
-    std::string strLeft = contents->getCString();
-    while (strLeft.length() > 0)
+    const char* p = (const char*)pData;
+    const char* end = p + nSize;
+    while (p < end)
     {
-        int pos = strLeft.find('\n');
-
-        if (pos != (int)std::string::npos)
-        {
-            // the data is more than a line.get one line
-            line = strLeft.substr(0, pos);
-            strLeft = strLeft.substr(pos + 1);
-        }
-        else
+        // get one line, rest of data is not copied
+        const char* eol = (const char*)memchr(p, '\n', end - p);
+        if (!eol)
         {
-            // get the left data
-            line = strLeft;
-            strLeft.erase();
+            eol = end;
         }
+        line.assign(p, eol - p);
+        p = eol + 1;
 
-        if(line.substr(0,strlen("info face")) == "info face") 
+        if(lineStartsWith(line, "info face")) 
         {
             // XXX: info parsing is incomplete
             // Not needed for the Hiero editors, but needed for the AngelCode editor
@@ -224,43 +307,156 @@ std::set<unsigned int>* CCBMFontConfiguration::parseConfigFile(const char *contr
             this->parseInfoArguments(line);
         }
         // Check to see if the start of the line is something we are interested in
-        else if(line.substr(0,strlen("common lineHeight")) == "common lineHeight")
+        else if(lineStartsWith(line, "common lineHeight"))
         {
             this->parseCommonArguments(line);
         }
-        else if(line.substr(0,strlen("page id")) == "page id")
+        else if(lineStartsWith(line, "page id"))
         {
             this->parseImageFileName(line, controlFile);
         }
-        else if(line.substr(0,strlen("chars c")) == "chars c")
+        else if(lineStartsWith(line, "chars c"))
         {
             // Ignore this line
         }
-        else if(line.substr(0,strlen("char")) == "char")
+        else if(lineStartsWith(line, "char"))
         {
             // Parse the current line and create a new CharDef
-            tCCFontDefHashElement* element = (tCCFontDefHashElement*)malloc( sizeof(*element) );
-            this->parseCharacterDefinition(line, &element->fontDef);
-
-            element->key = element->fontDef.charID;
-            HASH_ADD_INT(m_pFontDefDictionary, key, element);
-            
-            validCharsString->insert(element->fontDef.charID);
+            ccBMFontDef fontDef;
+            this->parseCharacterDefinition(line, &fontDef);
+            m_fontDefs.push_back(fontDef);
         }
 //        else if(line.substr(0,strlen("kernings count")) == "kernings count")
 //        {
 //            this->parseKerningCapacity(line);
 //        }
-        else if(line.substr(0,strlen("kerning first")) == "kerning first")
+        else if(lineStartsWith(line, "kerning first"))
         {
             this->parseKerningEntry(line);
         }
     }
     
-    return validCharsString;
+    pView->release();
+    return true;
+}
+
+static inline unsigned short readBMFontU16(const unsigned char* p)
+{
+    return (unsigned short)(p[0] | (p[1] << 8));
+}
+
+static inline unsigned int readBMFontU32(const unsigned char* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+bool CCBMFontConfiguration::parseBinaryConfigFile(const unsigned char* pData, size_t nSize, const char *controlFile)
+{
+    //////////////////////////////////////////////////////////////////////////
+    // binary format version 3, all values are little endian:
+    // "BMF", version, then blocks of type(1 byte), size(4 bytes) and content
+    // http://www.angelcode.com/products/bmfont/doc/file_format.html
+    //////////////////////////////////////////////////////////////////////////
+    
+    if (pData[3] != 3)
+    {
+        CCLOG("cocos2d: FNTfile %s has unsupported binary version %d", controlFile, pData[3]);
+        return false;
+    }
+    
+    size_t offset = 4;
+    while (offset + 5 <= nSize)
+    {
+        unsigned char blockType = pData[offset];
+        size_t blockSize = readBMFontU32(pData + offset + 1);
+        offset += 5;
+        if (blockSize > nSize - offset)
+        {
+            return false;
+        }
+        const unsigned char* block = pData + offset;
+        
+        switch (blockType)
+        {
+            case 1:
+            {
+                // info: fontSize(2) bitField(1) charSet(1) stretchH(2) aa(1) paddingUp, paddingRight, paddingDown, paddingLeft(1 each) ...
+                if (blockSize >= 11)
+                {
+                    m_tPadding.top = block[7];
+                    m_tPadding.right = block[8];
+                    m_tPadding.bottom = block[9];
+                    m_tPadding.left = block[10];
+                }
+                break;
+            }
+            case 2:
+            {
+                // common: lineHeight(2) base(2) scaleW(2) scaleH(2) pages(2) ...
+                if (blockSize >= 10)
+                {
+                    m_nCommonHeight = readBMFontU16(block);
+                    CCAssert(readBMFontU16(block + 4) <= CCConfiguration::sharedConfiguration()->getMaxTextureSize(), "CCLabelBMFont: page can't be larger than supported");
+                    CCAssert(readBMFontU16(block + 6) <= CCConfiguration::sharedConfiguration()->getMaxTextureSize(), "CCLabelBMFont: page can't be larger than supported");
+                    CCAssert(readBMFontU16(block + 8) == 1, "CCBitfontAtlas: only supports 1 page");
+                }
+                break;
+            }
+            case 3:
+            {
+                // pages: NUL terminated names, only first page is used
+                const unsigned char* nameEnd = (const unsigned char*)memchr(block, 0, blockSize);
+                if (nameEnd)
+                {
+                    std::string name((const char*)block, nameEnd - block);
+                    m_sAtlasName = CCFileUtils::sharedFileUtils()->fullPathFromRelativeFile(name.c_str(), controlFile);
+                }
+                break;
+            }
+            case 4:
+            {
+                // chars: id(4) x(2) y(2) width(2) height(2) xoffset(2) yoffset(2) xadvance(2) page(1) chnl(1)
+                size_t count = blockSize / 20;
+                m_fontDefs.reserve(m_fontDefs.size() + count);
+                for (size_t i = 0; i < count; i++)
+                {
+                    const unsigned char* c = block + i * 20;
+                    ccBMFontDef fontDef;
+                    fontDef.charID = readBMFontU32(c);
+                    fontDef.rect = CCRectMake(readBMFontU16(c + 4), readBMFontU16(c + 6), readBMFontU16(c + 8), readBMFontU16(c + 10));
+                    fontDef.xOffset = (short)readBMFontU16(c + 12);
+                    fontDef.yOffset = (short)readBMFontU16(c + 14);
+                    fontDef.xAdvance = (short)readBMFontU16(c + 16);
+                    m_fontDefs.push_back(fontDef);
+                }
+                break;
+            }
+            case 5:
+            {
+                // kerning pairs: first(4) second(4) amount(2)
+                size_t count = blockSize / 10;
+                m_kernings.reserve(m_kernings.size() + count);
+                for (size_t i = 0; i < count; i++)
+                {
+                    const unsigned char* k = block + i * 10;
+                    ccBMFontKerning kerning;
+                    kerning.key = (readBMFontU32(k) << 16) | (readBMFontU32(k + 4) & 0xffff);
+                    kerning.amount = (short)readBMFontU16(k + 8);
+                    m_kernings.push_back(kerning);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+        
+        offset += blockSize;
+    }
+    
+    return true;
 }
 
-void CCBMFontConfiguration::parseImageFileName(std::string line, const char *fntFile)
+void CCBMFontConfiguration::parseImageFileName(const std::string& line, const char *fntFile)
 {
     //////////////////////////////////////////////////////////////////////////
     // line to parse:
@@ -280,7 +476,7 @@ void CCBMFontConfiguration::parseImageFileName(std::string line, const char *fnt
     m_sAtlasName = CCFileUtils::sharedFileUtils()->fullPathFromRelativeFile(value.c_str(), fntFile);
 }
 
-void CCBMFontConfiguration::parseInfoArguments(std::string line)
+void CCBMFontConfiguration::parseInfoArguments(const std::string& line)
 {
     //////////////////////////////////////////////////////////////////////////
     // possible lines to parse:
@@ -295,7 +491,7 @@ void CCBMFontConfiguration::parseInfoArguments(std::string line)
     sscanf(value.c_str(), "padding=%d,%d,%d,%d", &m_tPadding.top, &m_tPadding.right, &m_tPadding.bottom, &m_tPadding.left);
 }
 
-void CCBMFontConfiguration::parseCommonArguments(std::string line)
+void CCBMFontConfiguration::parseCommonArguments(const std::string& line)
 {
     //////////////////////////////////////////////////////////////////////////
     // line to parse:
@@ -326,7 +522,7 @@ void CCBMFontConfiguration::parseCommonArguments(std::string line)
     // packed (ignore) What does this mean ??
 }
 
-void CCBMFontConfiguration::parseCharacterDefinition(std::string line, ccBMFontDef *characterDefinition)
+void CCBMFontConfiguration::parseCharacterDefinition(const std::string& line, ccBMFontDef *characterDefinition)
 {    
     //////////////////////////////////////////////////////////////////////////
     // line to parse:
@@ -376,7 +572,7 @@ void CCBMFontConfiguration::parseCharacterDefinition(std::string line, ccBMFontD
     sscanf(value.c_str(), "xadvance=%hd", &characterDefinition->xAdvance);
 }
 
-void CCBMFontConfiguration::parseKerningEntry(std::string line)
+void CCBMFontConfiguration::parseKerningEntry(const std::string& line)
 {        
     //////////////////////////////////////////////////////////////////////////
     // line to parse:
@@ -404,10 +600,10 @@ void CCBMFontConfiguration::parseKerningEntry(std::string line)
     value = line.substr(index, index2-index);
     sscanf(value.c_str(), "amount=%d", &amount);
 
-    tCCKerningHashElement *element = (tCCKerningHashElement *)calloc( sizeof( *element ), 1 );
-    element->amount = amount;
-    element->key = (first<<16) | (second&0xffff);
-    HASH_ADD_INT(m_pKerningDictionary,key, element);
+    ccBMFontKerning kerning;
+    kerning.amount = amount;
+    kerning.key = (first<<16) | (second&0xffff);
+    m_kernings.push_back(kerning);
 }
 //
 //CCLabelBMFont
@@ -530,8 +726,10 @@ bool CCLabelBMFont::initWithString(const char *theString, const char *fntFile, f
 
 CCLabelBMFont::CCLabelBMFont()
 : m_sString(NULL)
+, m_uStringCapacity(0)
 , m_sInitialString(NULL)
-, m_pAlignment(kCCTextAlignmentCenter)
+, m_uInitialStringCapacity(0)
+, m_pAlignment(kCCTextAlignmentLeft)
 , m_fWidth(-1.0f)
 , m_pConfiguration(NULL)
 , m_bLineBreakWithoutSpaces(false)
@@ -545,6 +743,9 @@ CCLabelBMFont::CCLabelBMFont()
 , m_bCascadeOpacityEnabled(true)
 , m_bIsOpacityModifyRGB(false)
 , m_lineKerning(0)
+, m_bQuadMode(false)
+, m_bQuadsDirty(false)
+, m_uLetterCount(0)
 {
 
 }
@@ -560,16 +761,7 @@ CCLabelBMFont::~CCLabelBMFont()
 // LabelBMFont - Atlas generation
 int CCLabelBMFont::kerningAmountForFirst(unsigned short first, unsigned short second)
 {
-    int ret = 0;
-    unsigned int key = (first<<16) | (second & 0xffff);
-
-    if( m_pConfiguration->m_pKerningDictionary ) {
-        tCCKerningHashElement *element = NULL;
-        HASH_FIND_INT(m_pConfiguration->m_pKerningDictionary, &key, element);        
-        if(element)
-            ret = element->amount;
-    }
-    return ret;
+    return m_pConfiguration->getKerningAmount(first, second);
 }
 
 void CCLabelBMFont::createFontChars()
@@ -586,14 +778,22 @@ void CCLabelBMFont::createFontChars()
 
     unsigned int quantityOfLines = 1;
     unsigned int stringLen = m_sString ? cc_wcslen(m_sString) : 0;
+    
+    // letters are laid out again, capacity of m_letters is kept
+    if (m_bQuadMode)
+    {
+        ccBMFontLetter empty = { false, CCRectZero, CCPointZero };
+        m_letters.assign(stringLen, empty);
+        m_uLetterCount = 0;
+        m_bQuadsDirty = true;
+    }
+    
     if (stringLen == 0)
     {
         this->setContentSize(CC_SIZE_PIXELS_TO_POINTS(tmpSize));
         return;
     }
 
-    set<unsigned int> *charSet = m_pConfiguration->getCharacterSet();
-
     for (unsigned int i = 0; i < stringLen - 1; ++i)
     {
         unsigned short c = m_sString[i];
@@ -621,26 +821,16 @@ void CCLabelBMFont::createFontChars()
             continue;
         }
         
-        if (charSet->find(c) == charSet->end())
+        const ccBMFontDef* pFontDef = m_pConfiguration->getFontDef(c);
+        if (! pFontDef)
         {
             CCLOGWARN("cocos2d::CCLabelBMFont: Attempted to use character not defined in this bitmap: %d", c);
             continue;      
         }
 
         kerningAmount = this->kerningAmountForFirst(prev, c);
-        
-        tCCFontDefHashElement *element = NULL;
-
-        // unichar is a short, and an int is needed on HASH_FIND_INT
-        unsigned int key = c;
-        HASH_FIND_INT(m_pConfiguration->m_pFontDefDictionary, &key, element);
-        if (! element)
-        {
-            CCLOGWARN("cocos2d::CCLabelBMFont: characer not found %d", c);
-            continue;
-        }
 
-        fontDef = element->fontDef;
+        fontDef = *pFontDef;
 
         rect = fontDef.rect;
         rect = CC_RECT_PIXELS_TO_POINTS(rect);
@@ -648,6 +838,31 @@ void CCLabelBMFont::createFontChars()
         rect.origin.x += m_tImageOffset.x;
         rect.origin.y += m_tImageOffset.y;
 
+        // See issue 1343. cast( signed short + unsigned integer ) == unsigned integer (sign is lost!)
+        int yOffset = m_pConfiguration->m_nCommonHeight - fontDef.yOffset;
+        CCPoint fontPos = ccp( (float)nextFontPositionX + fontDef.xOffset + fontDef.rect.size.width*0.5f + kerningAmount,
+            (float)nextFontPositionY + yOffset - rect.size.height*0.5f * CC_CONTENT_SCALE_FACTOR() );
+
+        // update kerning
+        nextFontPositionX += fontDef.xAdvance + kerningAmount;
+        prev = c;
+
+        if (longestLine < nextFontPositionX)
+        {
+            longestLine = nextFontPositionX;
+        }
+        
+        // quad mode only records layout, quads are written before drawing
+        if (m_bQuadMode)
+        {
+            ccBMFontLetter& letter = m_letters[i];
+            letter.valid = true;
+            letter.rect = rect;
+            letter.position = CC_POINT_PIXELS_TO_POINTS(fontPos);
+            m_uLetterCount++;
+            continue;
+        }
+
         CCSprite *fontChar;
 
         bool hasSprite = true;
@@ -688,21 +903,7 @@ void CCLabelBMFont::createFontChars()
 
         // updating previous sprite
         fontChar->setTextureRect(rect, false, rect.size);
-
-        // See issue 1343. cast( signed short + unsigned integer ) == unsigned integer (sign is lost!)
-        int yOffset = m_pConfiguration->m_nCommonHeight - fontDef.yOffset;
-        CCPoint fontPos = ccp( (float)nextFontPositionX + fontDef.xOffset + fontDef.rect.size.width*0.5f + kerningAmount,
-            (float)nextFontPositionY + yOffset - rect.size.height*0.5f * CC_CONTENT_SCALE_FACTOR() );
         fontChar->setPosition(CC_POINT_PIXELS_TO_POINTS(fontPos));
-
-        // update kerning
-        nextFontPositionX += fontDef.xAdvance + kerningAmount;
-        prev = c;
-
-        if (longestLine < nextFontPositionX)
-        {
-            longestLine = nextFontPositionX;
-        }
         
         if (! hasSprite)
         {
@@ -745,24 +946,26 @@ void CCLabelBMFont::setString(const char *newString, bool needUpdateLabel)
     if (needUpdateLabel) {
         m_sInitialStringUTF8 = newString;
     }
-    unsigned short* utf16String = cc_utf8_to_utf16(newString);
-    setString(utf16String, needUpdateLabel);
-    CC_SAFE_DELETE_ARRAY(utf16String);
+    cc_utf8_to_utf16_buffer(newString, m_utf16Buffer);
+    setString(&m_utf16Buffer[0], needUpdateLabel);
  }
 
 void CCLabelBMFont::setString(unsigned short *newString, bool needUpdateLabel)
 {
     if (!needUpdateLabel)
     {
-        unsigned short* tmp = m_sString;
-        m_sString = copyUTF16StringN(newString);
-        CC_SAFE_DELETE_ARRAY(tmp);
+        assignUTF16String(m_sString, m_uStringCapacity, newString);
     }
     else
     {
-        unsigned short* tmp = m_sInitialString;
-        m_sInitialString = copyUTF16StringN(newString);
-        CC_SAFE_DELETE_ARRAY(tmp);
+        assignUTF16String(m_sInitialString, m_uInitialStringCapacity, newString);
+        
+        // updateLabel lays out letters again
+        if (m_bQuadMode)
+        {
+            updateLabel();
+            return;
+        }
     }
     
     if (m_pChildren && m_pChildren->count() != 0)
@@ -849,6 +1052,7 @@ void CCLabelBMFont::setOpacity(GLubyte opacity)
 void CCLabelBMFont::setOpacityModifyRGB(bool var)
 {
     m_bIsOpacityModifyRGB = var;
+    m_bQuadsDirty = true;
     if (m_pChildren && m_pChildren->count() != 0)
     {
         CCObject* child;
@@ -874,6 +1078,7 @@ bool CCLabelBMFont::isOpacityModifyRGB()
 void CCLabelBMFont::updateDisplayedOpacity(GLubyte parentOpacity)
 {
 	m_cDisplayedOpacity = m_cRealOpacity * parentOpacity/255.0;
+    m_bQuadsDirty = true;
     
 	CCObject* pObj;
 	CCARRAY_FOREACH(m_pChildren, pObj)
@@ -888,6 +1093,7 @@ void CCLabelBMFont::updateDisplayedColor(const ccColor3B& parentColor)
 	m_tDisplayedColor.r = m_tRealColor.r * parentColor.r/255.0;
 	m_tDisplayedColor.g = m_tRealColor.g * parentColor.g/255.0;
 	m_tDisplayedColor.b = m_tRealColor.b * parentColor.b/255.0;
+    m_bQuadsDirty = true;
     
     CCObject* pObj;
 	CCARRAY_FOREACH(m_pChildren, pObj)
@@ -935,11 +1141,14 @@ void CCLabelBMFont::updateLabel()
     if (m_fWidth > 0)
     {
         // Step 1: Make multiline
-        vector<unsigned short> str_whole = cc_utf16_vec_from_utf16_str(m_sString);
-        unsigned int stringLength = str_whole.size();
-        vector<unsigned short> multiline_string;
-        multiline_string.reserve( stringLength );
-        vector<unsigned short> last_word;
+        // m_sString is not changed until the end, buffers are reused between updates
+        const unsigned short* str_whole = m_sString;
+        unsigned int stringLength = cc_wcslen(m_sString);
+        vector<unsigned short>& multiline_string = m_wrapBuffer;
+        multiline_string.clear();
+        multiline_string.reserve( stringLength + 1 );
+        vector<unsigned short>& last_word = m_wordBuffer;
+        last_word.clear();
         last_word.reserve( stringLength );
 
         unsigned int line = 1, i = 0;
@@ -947,20 +1156,20 @@ void CCLabelBMFont::updateLabel()
         float startOfLine = -1, startOfWord = -1;
         int skip = 0;
 
-        CCArray* children = getChildren();
-        for (unsigned int j = 0; j < children->count(); j++)
+        unsigned int letterCount = m_bQuadMode ? m_uLetterCount : getChildren()->count();
+        for (unsigned int j = 0; j < letterCount; j++)
         {
-            CCSprite* characterSprite;
             unsigned int justSkipped = 0;
             
-            while (!(characterSprite = (CCSprite*)this->getChildByTag(j + skip + justSkipped)))
+            while (!this->hasLetter(j + skip + justSkipped))
             {
                 justSkipped++;
             }
             
             skip += justSkipped;
+            int letterTag = j + skip;
             
-            if (!characterSprite->isVisible())
+            if (!this->isLetterVisible(letterTag))
                 continue;
 
             if (i >= stringLength)
@@ -970,7 +1179,7 @@ void CCLabelBMFont::updateLabel()
 
             if (!start_word)
             {
-                startOfWord = getLetterPosXLeft( characterSprite );
+                startOfWord = getLetterPosXLeft( letterTag );
                 start_word = true;
             }
             if (!start_line)
@@ -1001,7 +1210,7 @@ void CCLabelBMFont::updateLabel()
 
                 if (!startOfWord)
                 {
-                    startOfWord = getLetterPosXLeft( characterSprite );
+                    startOfWord = getLetterPosXLeft( letterTag );
                     start_word = true;
                 }
                 if (!startOfLine)
@@ -1024,7 +1233,7 @@ void CCLabelBMFont::updateLabel()
             }
 
             // Out of bounds.
-            if ( getLetterPosXRight( characterSprite ) - startOfLine > m_fWidth )
+            if ( getLetterPosXRight( letterTag ) - startOfLine > m_fWidth )
             {
                 if (!m_bLineBreakWithoutSpaces)
                 {
@@ -1062,7 +1271,7 @@ void CCLabelBMFont::updateLabel()
 
                     if (!startOfWord)
                     {
-                        startOfWord = getLetterPosXLeft( characterSprite );
+                        startOfWord = getLetterPosXLeft( letterTag );
                         start_word = true;
                     }
                     if (!startOfLine)
@@ -1086,20 +1295,9 @@ void CCLabelBMFont::updateLabel()
         }
 
         multiline_string.insert(multiline_string.end(), last_word.begin(), last_word.end());
+        multiline_string.push_back(0);
 
-        int size = multiline_string.size();
-        unsigned short* str_new = new unsigned short[size + 1];
-
-        for (int i = 0; i < size; ++i)
-        {
-            str_new[i] = multiline_string[i];
-        }
-
-        str_new[size] = '\0';
-
-        this->setString(str_new, false);
-        
-        CC_SAFE_DELETE_ARRAY(str_new);
+        this->setString(&multiline_string[0], false);
     }
 
     // Step 2: Make alignment
@@ -1109,13 +1307,12 @@ void CCLabelBMFont::updateLabel()
 
         int lineNumber = 0;
         int str_len = cc_wcslen(m_sString);
-        vector<unsigned short> last_line;
+        unsigned int line_length = 0;
         for (int ctr = 0; ctr <= str_len; ++ctr)
         {
             if (m_sString[ctr] == '\n' || m_sString[ctr] == 0)
             {
                 float lineWidth = 0.0f;
-                unsigned int line_length = last_line.size();
 				// if last line is empty we must just increase lineNumber and work with next line
                 if (line_length == 0)
                 {
@@ -1125,11 +1322,10 @@ void CCLabelBMFont::updateLabel()
                 int index = i + line_length - 1 + lineNumber;
                 if (index < 0) continue;
 
-                CCSprite* lastChar = (CCSprite*)getChildByTag(index);
-                if ( lastChar == NULL )
+                if (!hasLetter(index))
                     continue;
 
-                lineWidth = lastChar->getPosition().x + lastChar->getContentSize().width/2.0f;
+                lineWidth = getLetterPosition(index).x + getLetterWidth(index)/2.0f;
 
                 float shift = 0;
                 switch (m_pAlignment)
@@ -1151,22 +1347,18 @@ void CCLabelBMFont::updateLabel()
                         index = i + j + lineNumber;
                         if (index < 0) continue;
 
-                        CCSprite* characterSprite = (CCSprite*)getChildByTag(index);
-                        if (characterSprite)
-                        {
-                            characterSprite->setPosition(ccpAdd(characterSprite->getPosition(), ccp(shift, 0.0f)));
-                        }
+                        moveLetter(index, shift);
                     }
                 }
 
                 i += line_length;
                 lineNumber++;
 
-                last_line.clear();
+                line_length = 0;
                 continue;
             }
 
-            last_line.push_back(m_sString[ctr]);
+            line_length++;
         }
     }
 }
@@ -1208,14 +1400,177 @@ void CCLabelBMFont::setScaleY(float scaleY)
     updateLabel();
 }
 
-float CCLabelBMFont::getLetterPosXLeft( CCSprite* sp )
+bool CCLabelBMFont::hasLetter(int tag)
+{
+    if (m_bQuadMode)
+    {
+        return tag >= 0 && tag < (int)m_letters.size() && m_letters[tag].valid;
+    }
+    return CCSpriteBatchNode::getChildByTag(tag) != NULL;
+}
+
+bool CCLabelBMFont::isLetterVisible(int tag)
 {
-    return sp->getPosition().x * m_fScaleX - (sp->getContentSize().width * m_fScaleX * sp->getAnchorPoint().x);
+    if (m_bQuadMode)
+    {
+        return true;
+    }
+    return CCSpriteBatchNode::getChildByTag(tag)->isVisible();
 }
 
-float CCLabelBMFont::getLetterPosXRight( CCSprite* sp )
+CCPoint CCLabelBMFont::getLetterPosition(int tag)
 {
-    return sp->getPosition().x * m_fScaleX + (sp->getContentSize().width * m_fScaleX * sp->getAnchorPoint().x);
+    if (m_bQuadMode)
+    {
+        return m_letters[tag].position;
+    }
+    return CCSpriteBatchNode::getChildByTag(tag)->getPosition();
+}
+
+float CCLabelBMFont::getLetterWidth(int tag)
+{
+    if (m_bQuadMode)
+    {
+        return m_letters[tag].rect.size.width;
+    }
+    return CCSpriteBatchNode::getChildByTag(tag)->getContentSize().width;
+}
+
+void CCLabelBMFont::moveLetter(int tag, float dx)
+{
+    if (m_bQuadMode)
+    {
+        if (hasLetter(tag))
+        {
+            m_letters[tag].position.x += dx;
+            m_bQuadsDirty = true;
+        }
+        return;
+    }
+
+    CCNode* characterSprite = CCSpriteBatchNode::getChildByTag(tag);
+    if (characterSprite)
+    {
+        characterSprite->setPosition(ccpAdd(characterSprite->getPosition(), ccp(dx, 0.0f)));
+    }
+}
+
+float CCLabelBMFont::getLetterPosXLeft( int tag )
+{
+    // letters of quad mode are anchored at center, same as sprites
+    float anchorX = m_bQuadMode ? 0.5f : CCSpriteBatchNode::getChildByTag(tag)->getAnchorPoint().x;
+    return getLetterPosition(tag).x * m_fScaleX - (getLetterWidth(tag) * m_fScaleX * anchorX);
+}
+
+float CCLabelBMFont::getLetterPosXRight( int tag )
+{
+    float anchorX = m_bQuadMode ? 0.5f : CCSpriteBatchNode::getChildByTag(tag)->getAnchorPoint().x;
+    return getLetterPosition(tag).x * m_fScaleX + (getLetterWidth(tag) * m_fScaleX * anchorX);
+}
+
+// LabelBMFont - Quad mode
+void CCLabelBMFont::setQuadMode(bool quadMode)
+{
+    if (m_bQuadMode == quadMode)
+    {
+        return;
+    }
+
+    // sprites or quads of old mode are dropped, new mode lays out letters again
+    if (quadMode)
+    {
+        removeAllChildrenWithCleanup(true);
+    }
+    else
+    {
+        m_pobTextureAtlas->removeAllQuads();
+        m_letters.clear();
+        m_uLetterCount = 0;
+    }
+    m_bQuadMode = quadMode;
+    updateLabel();
+}
+
+CCNode* CCLabelBMFont::getChildByTag(int tag)
+{
+    // letter is asked for, so it has to be a sprite
+    if (m_bQuadMode)
+    {
+        setQuadMode(false);
+    }
+    return CCSpriteBatchNode::getChildByTag(tag);
+}
+
+void CCLabelBMFont::updateQuads()
+{
+    m_bQuadsDirty = false;
+    m_pobTextureAtlas->removeAllQuads();
+    if (m_uLetterCount == 0)
+    {
+        return;
+    }
+    if (m_pobTextureAtlas->getCapacity() < m_uLetterCount)
+    {
+        m_pobTextureAtlas->resizeCapacity(m_uLetterCount);
+    }
+
+    // same color as CCSprite::updateColor
+    ccColor4B color4 = { m_tDisplayedColor.r, m_tDisplayedColor.g, m_tDisplayedColor.b, m_cDisplayedOpacity };
+    if (m_bIsOpacityModifyRGB)
+    {
+        color4.r *= m_cDisplayedOpacity/255.0f;
+        color4.g *= m_cDisplayedOpacity/255.0f;
+        color4.b *= m_cDisplayedOpacity/255.0f;
+    }
+
+    CCTexture2D* tex = m_pobTextureAtlas->getTexture();
+    float atlasWidth = (float)tex->getPixelsWide();
+    float atlasHeight = (float)tex->getPixelsHigh();
+
+    ccV3F_C4B_T2F_Quad quad;
+    quad.bl.colors = quad.br.colors = quad.tl.colors = quad.tr.colors = color4;
+    unsigned int quadIndex = 0;
+    for (std::vector<ccBMFontLetter>::const_iterator iter = m_letters.begin(); iter != m_letters.end(); ++iter)
+    {
+        if (!iter->valid)
+        {
+            continue;
+        }
+
+        // same texture coordinates as CCSprite::setTextureCoords, without rotation and flip
+        CCRect rect = CC_RECT_POINTS_TO_PIXELS(iter->rect);
+#if CC_FIX_ARTIFACTS_BY_STRECHING_TEXEL
+        float left = (2*rect.origin.x+1)/(2*atlasWidth);
+        float right = left + (rect.size.width*2-2)/(2*atlasWidth);
+        float top = (2*rect.origin.y+1)/(2*atlasHeight);
+        float bottom = top + (rect.size.height*2-2)/(2*atlasHeight);
+#else
+        float left = rect.origin.x/atlasWidth;
+        float right = (rect.origin.x + rect.size.width) / atlasWidth;
+        float top = rect.origin.y/atlasHeight;
+        float bottom = (rect.origin.y + rect.size.height) / atlasHeight;
+#endif // ! CC_FIX_ARTIFACTS_BY_STRECHING_TEXEL
+        quad.bl.texCoords.u = left;
+        quad.bl.texCoords.v = bottom;
+        quad.br.texCoords.u = right;
+        quad.br.texCoords.v = bottom;
+        quad.tl.texCoords.u = left;
+        quad.tl.texCoords.v = top;
+        quad.tr.texCoords.u = right;
+        quad.tr.texCoords.v = top;
+
+        // vertices in label space
+        float x1 = iter->position.x - iter->rect.size.width * 0.5f;
+        float y1 = iter->position.y - iter->rect.size.height * 0.5f;
+        float x2 = x1 + iter->rect.size.width;
+        float y2 = y1 + iter->rect.size.height;
+        quad.bl.vertices = vertex3(x1, y1, 0);
+        quad.br.vertices = vertex3(x2, y1, 0);
+        quad.tl.vertices = vertex3(x1, y2, 0);
+        quad.tr.vertices = vertex3(x2, y2, 0);
+
+        m_pobTextureAtlas->updateQuad(&quad, quadIndex++);
+    }
 }
 
 // LabelBMFont - FntFile
@@ -1248,19 +1603,24 @@ CCBMFontConfiguration* CCLabelBMFont::getConfiguration() const
 	return m_pConfiguration;
 }
 
-//LabelBMFont - Debug draw
-#if CC_LABELBMFONT_DEBUG_DRAW
+//LabelBMFont - Draw
 void CCLabelBMFont::draw()
 {
+    if (m_bQuadMode && m_bQuadsDirty)
+    {
+        updateQuads();
+    }
+    
     CCSpriteBatchNode::draw();
+    
+#if CC_LABELBMFONT_DEBUG_DRAW
     const CCSize& s = this->getContentSize();
     CCPoint vertices[4]={
         ccp(0,0),ccp(s.width,0),
         ccp(s.width,s.height),ccp(0,s.height),
     };
     ccDrawPoly(vertices, 4, true);
-}
-
 #endif // CC_LABELBMFONT_DEBUG_DRAW
+}
 
 NS_CC_END
@@ -53,8 +53,6 @@ enum {
     kCCLabelAutomaticWidth = -1,
 };
 
-struct _FontDefHashElement;
-
 /**
 @struct ccBMFontDef
 BMFont definition
@@ -87,20 +85,29 @@ typedef struct _BMFontPadding {
     int bottom;
 } ccBMFontPadding;
 
-typedef struct _FontDefHashElement
-{
-	unsigned int	key;		// key. Font Unicode value
-	ccBMFontDef		fontDef;	// font definition
-	UT_hash_handle	hh;
-} tCCFontDefHashElement;
+/** @struct ccBMFontLetter
+Layout of a letter when CCLabelBMFont is in quad mode
+@since v2.2
+*/
+typedef struct _BMFontLetter {
+    /// false if there is no glyph at this index, such as a line break
+    bool valid;
+    /// texture rect (in points)
+    CCRect rect;
+    /// center of letter (in points)
+    CCPoint position;
+} ccBMFontLetter;
 
-// Equal function for targetSet.
-typedef struct _KerningHashElement
-{
-	int				key;		// key for the hash. 16-bit for 1st element, 16-bit for 2nd element
-	int				amount;
-	UT_hash_handle	hh;
-} tCCKerningHashElement;
+/** @struct ccBMFontKerning
+BMFont kerning pair
+@since v2.2
+*/
+typedef struct _BMFontKerning {
+    /// first char in high 16 bits, second char in low 16 bits
+    unsigned int key;
+    /// amount to adjust x position of second char (in pixels)
+    int amount;
+} ccBMFontKerning;
 
 /** @brief CCBMFontConfiguration has parsed configuration of the the .fnt file
 @since v0.8
@@ -111,8 +118,14 @@ class CC_DLL CCBMFontConfiguration : public CCObject
 {
     // XXX: Creating a public interface so that the bitmapFontArray[] is accessible
 public://@public
-    // BMFont definitions
-    tCCFontDefHashElement *m_pFontDefDictionary;
+    // BMFont definitions, sorted by char id
+    std::vector<ccBMFontDef> m_fontDefs;
+    
+    // index of definition in m_fontDefs for char id below CC_BMFONT_FLAT_GLYPH_RANGE, 0xffff if not exist
+    unsigned short* m_pFlatFontDefIndex;
+    
+    // index of first definition whose char id is not in flat table
+    unsigned int m_nFirstSparseFontDef;
 
     //! FNTConfig: Common Height Should be signed (issue #1343)
     int m_nCommonHeight;
@@ -120,10 +133,10 @@ public://@public
     ccBMFontPadding    m_tPadding;
     //! atlas name
     std::string m_sAtlasName;
-    //! values for kerning
-    tCCKerningHashElement *m_pKerningDictionary;
+    //! values for kerning, sorted by key
+    std::vector<ccBMFontKerning> m_kernings;
     
-    // Character Set defines the letters that actually exist in the font
+    // Character Set defines the letters that actually exist in the font, created when it is queried
     std::set<unsigned int> *m_pCharacterSet;
     
 public:
@@ -142,23 +155,40 @@ public:
     /** allocates a CCBMFontConfiguration with a FNT file */
     static CCBMFontConfiguration * create(const char *FNTfile);
 
-    /** initializes a BitmapFontConfiguration with a FNT file */
+    /** initializes a BitmapFontConfiguration with a FNT file, in text or binary (version 3) format */
     bool initWithFNTfile(const char *FNTfile);
     
+    /** finds definition of a char, NULL if font doesn't have it
+     * @since v2.2
+     */
+    const ccBMFontDef* getFontDef(unsigned int charID) const {
+        if(charID < CC_BMFONT_FLAT_GLYPH_RANGE) {
+            unsigned short index = m_pFlatFontDefIndex ? m_pFlatFontDefIndex[charID] : 0xffff;
+            return index == 0xffff ? NULL : &m_fontDefs[index];
+        }
+        return findSparseFontDef(charID);
+    }
+    
+    /** kerning amount between two chars, in pixels
+     * @since v2.2
+     */
+    int getKerningAmount(unsigned short first, unsigned short second) const;
+    
     inline const char* getAtlasName(){ return m_sAtlasName.c_str(); }
     inline void setAtlasName(const char* atlasName) { m_sAtlasName = atlasName; }
     
-    std::set<unsigned int>* getCharacterSet() const;
+    std::set<unsigned int>* getCharacterSet();
     
 private:
-    std::set<unsigned int>* parseConfigFile(const char *controlFile);
-    void parseCharacterDefinition(std::string line, ccBMFontDef *characterDefinition);
-    void parseInfoArguments(std::string line);
-    void parseCommonArguments(std::string line);
-    void parseImageFileName(std::string line, const char *fntFile);
-    void parseKerningEntry(std::string line);
-    void purgeKerningDictionary();
-    void purgeFontDefDictionary();
+    bool parseConfigFile(const char *controlFile);
+    bool parseBinaryConfigFile(const unsigned char* pData, size_t nSize, const char *controlFile);
+    void parseCharacterDefinition(const std::string& line, ccBMFontDef *characterDefinition);
+    void parseInfoArguments(const std::string& line);
+    void parseCommonArguments(const std::string& line);
+    void parseImageFileName(const std::string& line, const char *fntFile);
+    void parseKerningEntry(const std::string& line);
+    void buildLookupTables();
+    const ccBMFontDef* findSparseFontDef(unsigned int charID) const;
 };
 
 /** @brief CCLabelBMFont is a subclass of CCSpriteBatchNode.
@@ -174,6 +204,13 @@ Features:
 - anchorPoint can be used to align the "label"
 - Supports AngelCode text format
 
+Quad mode:
+For labels which are changed very often, such as scores, timers and damage numbers, call
+setQuadMode(true). The label then writes glyph quads directly into its texture atlas and
+creates no CCSprite for letters, so setString doesn't create or move any node. A letter
+is only needed when game asks for it by getChildByTag, and the label goes back to sprite
+mode at that time.
+
 Limitations:
 - All inner characters are using an anchorPoint of (0.5f, 0.5f) and it is not recommend to change it
 because it might affect the rendering
@@ -258,23 +295,43 @@ public:
     virtual bool isCascadeColorEnabled();
     virtual void setCascadeColorEnabled(bool cascadeColorEnabled);
 
+    /** Enables or disables quad mode, disabled by default. In quad mode the label
+     has no children, and setString doesn't allocate memory once buffers are large
+     enough, line wrapping and alignment reuse buffers of the label too.
+     @since v2.2
+     */
+    void setQuadMode(bool quadMode);
+    bool isQuadMode() const { return m_bQuadMode; }
+    
+    /** Returns letter sprite of given index. In quad mode, it turns quad mode off first
+     and letters are sprites from then on.
+     */
+    virtual CCNode* getChildByTag(int tag);
+    
     void setLineKerning(float k);
     void setFntFile(const char* fntFile);
     const char* getFntFile();
 	CCBMFontConfiguration* getConfiguration() const;
-#if CC_LABELBMFONT_DEBUG_DRAW
     virtual void draw();
-#endif // CC_LABELBMFONT_DEBUG_DRAW
 private:
     char * atlasNameFromFntFile(const char *fntFile);
     int kerningAmountForFirst(unsigned short first, unsigned short second);
-    float getLetterPosXLeft( CCSprite* characterSprite );
-    float getLetterPosXRight( CCSprite* characterSprite );
+    
+    // letters are sprites with tag of string index, or m_letters in quad mode
+    bool hasLetter(int tag);
+    bool isLetterVisible(int tag);
+    CCPoint getLetterPosition(int tag);
+    float getLetterWidth(int tag);
+    void moveLetter(int tag, float dx);
+    float getLetterPosXLeft(int tag);
+    float getLetterPosXRight(int tag);
+    void updateQuads();
     
 protected:
     virtual void setString(unsigned short *newString, bool needUpdateLabel);
     // string to render
     unsigned short* m_sString;
+    unsigned int m_uStringCapacity;
     
     // vertical line kerning
     float m_lineKerning;
@@ -284,6 +341,7 @@ protected:
     
     // initial string without line breaks
     unsigned short* m_sInitialString;
+    unsigned int m_uInitialStringCapacity;
     std::string m_sInitialStringUTF8;
     
     // alignment of all lines
@@ -309,6 +367,20 @@ protected:
     bool m_bCascadeOpacityEnabled;
     /** conforms to CCRGBAProtocol protocol */
     bool        m_bIsOpacityModifyRGB;
+    
+    // quad mode, see setQuadMode
+    bool m_bQuadMode;
+    // quads need to be written before drawing
+    bool m_bQuadsDirty;
+    // letter layout in quad mode, index is same as string index
+    std::vector<ccBMFontLetter> m_letters;
+    // count of valid letters in quad mode
+    unsigned int m_uLetterCount;
+    // reused buffer for utf8 conversion
+    std::vector<unsigned short> m_utf16Buffer;
+    // reused buffers for line wrapping in updateLabel
+    std::vector<unsigned short> m_wrapBuffer;
+    std::vector<unsigned short> m_wordBuffer;
 
 };
 
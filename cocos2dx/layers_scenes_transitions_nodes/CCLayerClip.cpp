@@ -23,6 +23,7 @@
  ****************************************************************************/
 #include "CCLayerClip.h"
 #include "CCUtils.h"
+#include "CCRenderQueue.h"
 #if CC_TARGET_PLATFORM == CC_PLATFORM_IOS
     #include "platform/ios/CCEGLView.h"
 #else
@@ -71,6 +72,7 @@ void CCLayerClip::visit() {
     if(!m_clipEnabled || m_clipRect.equals(CCRectZero)) {
         CCLayerColor::visit();
     } else {
+        CC_RENDER_QUEUE_FLUSH();
         glEnable(GL_SCISSOR_TEST);
 		glScissor(m_clipRect.origin.x,
 				  m_clipRect.origin.y,
@@ -79,6 +81,7 @@ void CCLayerClip::visit() {
 		
 		CCLayerColor::visit();
 		
+		CC_RENDER_QUEUE_FLUSH();
 		glDisable(GL_SCISSOR_TEST);
     }
 }
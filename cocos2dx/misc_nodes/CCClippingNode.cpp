@@ -30,6 +30,7 @@
 #include "shaders/CCGLProgram.h"
 #include "shaders/CCShaderCache.h"
 #include "CCDirector.h"
+#include "CCRenderQueue.h"
 #include "cocoa/CCPointExtension.h"
 #include "draw_nodes/CCDrawingPrimitives.h"
 
@@ -223,6 +224,9 @@ void CCClippingNode::visit()
     glGetIntegerv(GL_STENCIL_PASS_DEPTH_FAIL, (GLint *)&currentStencilPassDepthFail);
     glGetIntegerv(GL_STENCIL_PASS_DEPTH_PASS, (GLint *)&currentStencilPassDepthPass);
     
+    // draw pending quads before stencil is changed
+    CC_RENDER_QUEUE_FLUSH();
+    
     // enable stencil use
     glEnable(GL_STENCIL_TEST);
     // check for OpenGL error while enabling stencil test
@@ -325,6 +329,9 @@ void CCClippingNode::visit()
     kmGLPushMatrix();
     transform();
     m_pStencil->visit();
+
+    // stencil sprites must write stencil buffer before stencil state is changed
+    CC_RENDER_QUEUE_FLUSH();
     kmGLPopMatrix();
     
     // restore alpha test state
@@ -367,6 +374,7 @@ void CCClippingNode::visit()
     // CLEANUP
     
     // manually restore the stencil state
+    CC_RENDER_QUEUE_FLUSH();
     glStencilFunc(currentStencilFunc, currentStencilRef, currentStencilValueMask);
     glStencilOp(currentStencilFail, currentStencilPassDepthFail, currentStencilPassDepthPass);
     glStencilMask(currentStencilWriteMask);
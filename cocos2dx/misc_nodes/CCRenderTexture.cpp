@@ -26,6 +26,7 @@ THE SOFTWARE.
 #include "CCConfiguration.h"
 #include "misc_nodes/CCRenderTexture.h"
 #include "CCDirector.h"
+#include "CCRenderQueue.h"
 #include "platform/platform.h"
 #include "platform/CCImage.h"
 #include "shaders/CCGLProgram.h"
@@ -362,6 +363,8 @@ bool CCRenderTexture::initWithWidthAndHeight(int w, int h, CCTexture2DPixelForma
 
 void CCRenderTexture::begin()
 {
+    CC_RENDER_QUEUE_FLUSH();
+    
     kmGLMatrixMode(KM_GL_PROJECTION);
 	kmGLPushMatrix();
 	kmGLMatrixMode(KM_GL_MODELVIEW);
@@ -471,6 +474,8 @@ void CCRenderTexture::beginWithClear(float r, float g, float b, float a, float d
 
 void CCRenderTexture::end()
 {
+    CC_RENDER_QUEUE_FLUSH();
+    
     CCDirector *director = CCDirector::sharedDirector();
     
     glBindFramebuffer(GL_FRAMEBUFFER, m_nOldFBO);
@@ -0,0 +1,684 @@
+/****************************************************************************
+Copyright (c) 2010-2012 cocos2d-x.org
+
+http://www.cocos2d-x.org
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+#include "CCParticlePool.h"
+#include "ccConfig.h"
+#include "ccMacros.h"
+#include "cocoa/CCPointExtension.h"
+#include <stdlib.h>
+#include <math.h>
+
+#if CC_PARTICLE_USE_SIMD && (defined(__ARM_NEON__) || defined(__ARM_NEON))
+#include <arm_neon.h>
+#define CC_PARTICLE_NEON 1
+#elif CC_PARTICLE_USE_SIMD && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define CC_PARTICLE_SSE 1
+#endif
+
+#if CC_PARTICLE_NEON || CC_PARTICLE_SSE
+#define CC_PARTICLE_SIMD 1
+#else
+#define CC_PARTICLE_SIMD 0
+#endif
+
+NS_CC_BEGIN
+
+// arrays of float fields, allocated one after another in same buffer
+static float* CCParticlePool::* const s_floatFields[] = {
+    &CCParticlePool::posX,
+    &CCParticlePool::posY,
+    &CCParticlePool::startPosX,
+    &CCParticlePool::startPosY,
+    &CCParticlePool::colorR,
+    &CCParticlePool::colorG,
+    &CCParticlePool::colorB,
+    &CCParticlePool::colorA,
+    &CCParticlePool::deltaColorR,
+    &CCParticlePool::deltaColorG,
+    &CCParticlePool::deltaColorB,
+    &CCParticlePool::deltaColorA,
+    &CCParticlePool::size,
+    &CCParticlePool::deltaSize,
+    &CCParticlePool::rotation,
+    &CCParticlePool::deltaRotation,
+    &CCParticlePool::timeToLive,
+    &CCParticlePool::dirX,
+    &CCParticlePool::dirY,
+    &CCParticlePool::radialAccel,
+    &CCParticlePool::tangentialAccel,
+    &CCParticlePool::angle,
+    &CCParticlePool::degreesPerSecond,
+    &CCParticlePool::radius,
+    &CCParticlePool::deltaRadius,
+};
+
+static const unsigned int s_uFloatFieldCount = sizeof(s_floatFields) / sizeof(s_floatFields[0]);
+
+static bool s_bSIMDEnabled = CC_PARTICLE_SIMD;
+
+//
+// 4 lanes float vector, the kernels are written once with these helpers
+//
+#if CC_PARTICLE_SSE
+
+typedef __m128 v4f;
+typedef __m128 v4m;
+
+static inline v4f v4Load(const float* p) { return _mm_loadu_ps(p); }
+static inline void v4Store(float* p, v4f v) { _mm_storeu_ps(p, v); }
+static inline void v4StoreInt(int* p, v4f v) { _mm_storeu_si128((__m128i*)p, _mm_cvttps_epi32(v)); }
+static inline v4f v4Set(float f) { return _mm_set1_ps(f); }
+static inline v4f v4Add(v4f a, v4f b) { return _mm_add_ps(a, b); }
+static inline v4f v4Sub(v4f a, v4f b) { return _mm_sub_ps(a, b); }
+static inline v4f v4Mul(v4f a, v4f b) { return _mm_mul_ps(a, b); }
+static inline v4f v4Div(v4f a, v4f b) { return _mm_div_ps(a, b); }
+static inline v4f v4Sqrt(v4f a) { return _mm_sqrt_ps(a); }
+// same as MAX(b, a), a NaN gives b
+static inline v4f v4Max(v4f a, v4f b) { return _mm_max_ps(a, b); }
+static inline v4m v4Gt(v4f a, v4f b) { return _mm_cmpgt_ps(a, b); }
+static inline v4m v4Ge(v4f a, v4f b) { return _mm_cmpge_ps(a, b); }
+static inline v4m v4Eq(v4f a, v4f b) { return _mm_cmpeq_ps(a, b); }
+static inline v4m v4Or(v4m a, v4m b) { return _mm_or_ps(a, b); }
+static inline v4f v4Select(v4m m, v4f a, v4f b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+static inline v4f v4Floor(v4f a)
+{
+    v4f t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a), _mm_set1_ps(1.0f)));
+}
+
+#elif CC_PARTICLE_NEON
+
+typedef float32x4_t v4f;
+typedef uint32x4_t v4m;
+
+static inline v4f v4Load(const float* p) { return vld1q_f32(p); }
+static inline void v4Store(float* p, v4f v) { vst1q_f32(p, v); }
+static inline void v4StoreInt(int* p, v4f v) { vst1q_s32(p, vcvtq_s32_f32(v)); }
+static inline v4f v4Set(float f) { return vdupq_n_f32(f); }
+static inline v4f v4Add(v4f a, v4f b) { return vaddq_f32(a, b); }
+static inline v4f v4Sub(v4f a, v4f b) { return vsubq_f32(a, b); }
+static inline v4f v4Mul(v4f a, v4f b) { return vmulq_f32(a, b); }
+static inline v4f v4Div(v4f a, v4f b)
+{
+#if defined(__aarch64__)
+    return vdivq_f32(a, b);
+#else
+    // no divide on ARMv7, refine reciprocal estimate twice
+    v4f r = vrecpeq_f32(b);
+    r = vmulq_f32(vrecpsq_f32(b, r), r);
+    r = vmulq_f32(vrecpsq_f32(b, r), r);
+    return vmulq_f32(a, r);
+#endif
+}
+// the ARMv7 version gives NaN for 0, callers mask it
+static inline v4f v4Sqrt(v4f a)
+{
+#if defined(__aarch64__)
+    return vsqrtq_f32(a);
+#else
+    v4f e = vrsqrteq_f32(a);
+    e = vmulq_f32(vrsqrtsq_f32(vmulq_f32(a, e), e), e);
+    e = vmulq_f32(vrsqrtsq_f32(vmulq_f32(a, e), e), e);
+    return vmulq_f32(a, e);
+#endif
+}
+static inline v4f v4Max(v4f a, v4f b) { return vmaxq_f32(a, b); }
+static inline v4m v4Gt(v4f a, v4f b) { return vcgtq_f32(a, b); }
+static inline v4m v4Ge(v4f a, v4f b) { return vcgeq_f32(a, b); }
+static inline v4m v4Eq(v4f a, v4f b) { return vceqq_f32(a, b); }
+static inline v4m v4Or(v4m a, v4m b) { return vorrq_u32(a, b); }
+static inline v4f v4Select(v4m m, v4f a, v4f b) { return vbslq_f32(m, a, b); }
+static inline v4f v4Floor(v4f a)
+{
+#if defined(__aarch64__)
+    return vrndmq_f32(a);
+#else
+    v4f t = vcvtq_f32_s32(vcvtq_s32_f32(a));
+    return vsubq_f32(t, vreinterpretq_f32_u32(vandq_u32(vcgtq_f32(t, a), vreinterpretq_u32_f32(vdupq_n_f32(1.0f)))));
+#endif
+}
+
+#endif
+
+#if CC_PARTICLE_SIMD
+
+// value += delta * dt
+static inline void v4Step(float* value, const float* delta, v4f dt)
+{
+    v4Store(value, v4Add(v4Load(value), v4Mul(v4Load(delta), dt)));
+}
+
+/* Sine and cosine of 4 angles. The angle is reduced to [-pi/4, pi/4] by multiple of pi/2
+ (subtracted in 3 parts to keep precision), then minimax polynomials from cephes library
+ are evaluated, and the quadrant picks and negates the results. Error is a few ulp for
+ angles under several thousands radians.
+ */
+static inline void v4SinCos(v4f x, v4f* s, v4f* c)
+{
+    const v4f one = v4Set(1.0f);
+
+    v4f q = v4Floor(v4Add(v4Mul(x, v4Set(0.63661977236f)), v4Set(0.5f)));
+    v4f r = v4Sub(x, v4Mul(q, v4Set(1.5703125f)));
+    r = v4Sub(r, v4Mul(q, v4Set(4.837512969970703125e-4f)));
+    r = v4Sub(r, v4Mul(q, v4Set(7.54978995489188216e-8f)));
+
+    v4f r2 = v4Mul(r, r);
+
+    v4f ps = v4Add(v4Mul(v4Set(-1.9515295891e-4f), r2), v4Set(8.3321608736e-3f));
+    ps = v4Add(v4Mul(ps, r2), v4Set(-1.6666654611e-1f));
+    ps = v4Add(v4Mul(v4Mul(ps, r2), r), r);
+
+    v4f pc = v4Add(v4Mul(v4Set(2.443315711809948e-5f), r2), v4Set(-1.388731625493765e-3f));
+    pc = v4Add(v4Mul(pc, r2), v4Set(4.166664568298827e-2f));
+    pc = v4Add(v4Sub(v4Mul(v4Mul(pc, r2), r2), v4Mul(v4Set(0.5f), r2)), one);
+
+    // quadrant 0..3
+    v4f m = v4Sub(q, v4Mul(v4Floor(v4Mul(q, v4Set(0.25f))), v4Set(4.0f)));
+    v4m q1 = v4Eq(m, one);
+    v4m q2 = v4Eq(m, v4Set(2.0f));
+    v4m q3 = v4Eq(m, v4Set(3.0f));
+
+    v4m swap = v4Or(q1, q3);
+    v4f sv = v4Select(swap, pc, ps);
+    v4f cv = v4Select(swap, ps, pc);
+
+    const v4f zero = v4Set(0.0f);
+    *s = v4Select(v4Ge(m, v4Set(2.0f)), v4Sub(zero, sv), sv);
+    *c = v4Select(v4Or(q1, q2), v4Sub(zero, cv), cv);
+}
+
+#endif // CC_PARTICLE_SIMD
+
+CCParticlePool::CCParticlePool()
+: posX(NULL)
+, posY(NULL)
+, startPosX(NULL)
+, startPosY(NULL)
+, colorR(NULL)
+, colorG(NULL)
+, colorB(NULL)
+, colorA(NULL)
+, deltaColorR(NULL)
+, deltaColorG(NULL)
+, deltaColorB(NULL)
+, deltaColorA(NULL)
+, size(NULL)
+, deltaSize(NULL)
+, rotation(NULL)
+, deltaRotation(NULL)
+, timeToLive(NULL)
+, atlasIndex(NULL)
+, dirX(NULL)
+, dirY(NULL)
+, radialAccel(NULL)
+, tangentialAccel(NULL)
+, angle(NULL)
+, degreesPerSecond(NULL)
+, radius(NULL)
+, deltaRadius(NULL)
+, m_pBuffer(NULL)
+, m_uCapacity(0)
+{
+}
+
+CCParticlePool::~CCParticlePool()
+{
+    CC_SAFE_FREE(m_pBuffer);
+}
+
+bool CCParticlePool::isSIMDEnabled()
+{
+    return s_bSIMDEnabled;
+}
+
+void CCParticlePool::setSIMDEnabled(bool enabled)
+{
+    s_bSIMDEnabled = CC_PARTICLE_SIMD && enabled;
+}
+
+bool CCParticlePool::reserve(unsigned int capacity)
+{
+    // padded so kernels can always step 4 particles, at least one step
+    unsigned int padded = (capacity + 3) & ~3u;
+    if (padded == 0)
+    {
+        padded = 4;
+    }
+    size_t arraySize = padded * sizeof(float);
+
+    void* buffer = calloc(1, arraySize * (s_uFloatFieldCount + 1) + 15);
+    if (! buffer)
+    {
+        return false;
+    }
+
+    CC_SAFE_FREE(m_pBuffer);
+    m_pBuffer = buffer;
+    m_uCapacity = capacity;
+
+    char* p = (char*)(((size_t)buffer + 15) & ~(size_t)15);
+    for (unsigned int i = 0; i < s_uFloatFieldCount; i++)
+    {
+        this->*s_floatFields[i] = (float*)p;
+        p += arraySize;
+    }
+    atlasIndex = (unsigned int*)p;
+
+    return true;
+}
+
+void CCParticlePool::setParticle(unsigned int index, const tCCParticle& particle)
+{
+    CCAssert(index < m_uCapacity, "CCParticlePool: index out of range");
+
+    posX[index] = particle.pos.x;
+    posY[index] = particle.pos.y;
+    startPosX[index] = particle.startPos.x;
+    startPosY[index] = particle.startPos.y;
+    colorR[index] = particle.color.r;
+    colorG[index] = particle.color.g;
+    colorB[index] = particle.color.b;
+    colorA[index] = particle.color.a;
+    deltaColorR[index] = particle.deltaColor.r;
+    deltaColorG[index] = particle.deltaColor.g;
+    deltaColorB[index] = particle.deltaColor.b;
+    deltaColorA[index] = particle.deltaColor.a;
+    size[index] = particle.size;
+    deltaSize[index] = particle.deltaSize;
+    rotation[index] = particle.rotation;
+    deltaRotation[index] = particle.deltaRotation;
+    timeToLive[index] = particle.timeToLive;
+    atlasIndex[index] = particle.atlasIndex;
+    dirX[index] = particle.modeA.dir.x;
+    dirY[index] = particle.modeA.dir.y;
+    radialAccel[index] = particle.modeA.radialAccel;
+    tangentialAccel[index] = particle.modeA.tangentialAccel;
+    angle[index] = particle.modeB.angle;
+    degreesPerSecond[index] = particle.modeB.degreesPerSecond;
+    radius[index] = particle.modeB.radius;
+    deltaRadius[index] = particle.modeB.deltaRadius;
+}
+
+void CCParticlePool::getParticle(unsigned int index, tCCParticle* particle) const
+{
+    CCAssert(index < m_uCapacity, "CCParticlePool: index out of range");
+
+    particle->pos.x = posX[index];
+    particle->pos.y = posY[index];
+    particle->startPos.x = startPosX[index];
+    particle->startPos.y = startPosY[index];
+    particle->color.r = colorR[index];
+    particle->color.g = colorG[index];
+    particle->color.b = colorB[index];
+    particle->color.a = colorA[index];
+    particle->deltaColor.r = deltaColorR[index];
+    particle->deltaColor.g = deltaColorG[index];
+    particle->deltaColor.b = deltaColorB[index];
+    particle->deltaColor.a = deltaColorA[index];
+    particle->size = size[index];
+    particle->deltaSize = deltaSize[index];
+    particle->rotation = rotation[index];
+    particle->deltaRotation = deltaRotation[index];
+    particle->timeToLive = timeToLive[index];
+    particle->atlasIndex = atlasIndex[index];
+    particle->modeA.dir.x = dirX[index];
+    particle->modeA.dir.y = dirY[index];
+    particle->modeA.radialAccel = radialAccel[index];
+    particle->modeA.tangentialAccel = tangentialAccel[index];
+    particle->modeB.angle = angle[index];
+    particle->modeB.degreesPerSecond = degreesPerSecond[index];
+    particle->modeB.radius = radius[index];
+    particle->modeB.deltaRadius = deltaRadius[index];
+}
+
+void CCParticlePool::copyParticle(unsigned int dst, unsigned int src)
+{
+    CCAssert(dst < m_uCapacity && src < m_uCapacity, "CCParticlePool: index out of range");
+
+    for (unsigned int i = 0; i < s_uFloatFieldCount; i++)
+    {
+        float* field = this->*s_floatFields[i];
+        field[dst] = field[src];
+    }
+    atlasIndex[dst] = atlasIndex[src];
+}
+
+void CCParticlePool::updateLife(unsigned int count, float dt)
+{
+#if CC_PARTICLE_SIMD
+    if (s_bSIMDEnabled)
+    {
+        const v4f vdt = v4Set(dt);
+        const v4f zero = v4Set(0.0f);
+        for (unsigned int i = 0; i < count; i += 4)
+        {
+            v4Store(timeToLive + i, v4Sub(v4Load(timeToLive + i), vdt));
+
+            v4Step(colorR + i, deltaColorR + i, vdt);
+            v4Step(colorG + i, deltaColorG + i, vdt);
+            v4Step(colorB + i, deltaColorB + i, vdt);
+            v4Step(colorA + i, deltaColorA + i, vdt);
+
+            v4f s = v4Add(v4Load(size + i), v4Mul(v4Load(deltaSize + i), vdt));
+            v4Store(size + i, v4Max(s, zero));
+
+            v4Step(rotation + i, deltaRotation + i, vdt);
+        }
+        return;
+    }
+#endif
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        timeToLive[i] -= dt;
+
+        colorR[i] += (deltaColorR[i] * dt);
+        colorG[i] += (deltaColorG[i] * dt);
+        colorB[i] += (deltaColorB[i] * dt);
+        colorA[i] += (deltaColorA[i] * dt);
+
+        size[i] += (deltaSize[i] * dt);
+        size[i] = MAX(0, size[i]);
+
+        rotation[i] += (deltaRotation[i] * dt);
+    }
+}
+
+void CCParticlePool::updateGravity(unsigned int count, float dt, const CCPoint& gravity)
+{
+#if CC_PARTICLE_SIMD
+    if (s_bSIMDEnabled)
+    {
+        const v4f vdt = v4Set(dt);
+        const v4f zero = v4Set(0.0f);
+        const v4f one = v4Set(1.0f);
+        const v4f gx = v4Set(gravity.x);
+        const v4f gy = v4Set(gravity.y);
+        for (unsigned int i = 0; i < count; i += 4)
+        {
+            v4f px = v4Load(posX + i);
+            v4f py = v4Load(posY + i);
+
+            // radial direction, zero at origin
+            v4f lengthSQ = v4Add(v4Mul(px, px), v4Mul(py, py));
+            v4m nonZero = v4Gt(lengthSQ, zero);
+            v4f length = v4Select(nonZero, v4Sqrt(lengthSQ), one);
+            v4f rx = v4Select(nonZero, v4Div(px, length), zero);
+            v4f ry = v4Select(nonZero, v4Div(py, length), zero);
+
+            // radial + tangential (radial rotated by 90 degrees) + gravity
+            v4f ra = v4Load(radialAccel + i);
+            v4f ta = v4Load(tangentialAccel + i);
+            v4f ax = v4Add(v4Sub(v4Mul(rx, ra), v4Mul(ry, ta)), gx);
+            v4f ay = v4Add(v4Add(v4Mul(ry, ra), v4Mul(rx, ta)), gy);
+
+            v4f dx = v4Add(v4Load(dirX + i), v4Mul(ax, vdt));
+            v4f dy = v4Add(v4Load(dirY + i), v4Mul(ay, vdt));
+            v4Store(dirX + i, dx);
+            v4Store(dirY + i, dy);
+
+            v4Store(posX + i, v4Add(px, v4Mul(dx, vdt)));
+            v4Store(posY + i, v4Add(py, v4Mul(dy, vdt)));
+        }
+        return;
+    }
+#endif
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        CCPoint pos(posX[i], posY[i]);
+        CCPoint tmp, radial, tangential;
+
+        radial = CCPointZero;
+        // radial acceleration
+        if (pos.x || pos.y)
+        {
+            radial = ccpNormalize(pos);
+        }
+        tangential = radial;
+        radial = ccpMult(radial, radialAccel[i]);
+
+        // tangential acceleration
+        float newy = tangential.x;
+        tangential.x = -tangential.y;
+        tangential.y = newy;
+        tangential = ccpMult(tangential, tangentialAccel[i]);
+
+        // (gravity + radial + tangential) * dt
+        tmp = ccpAdd( ccpAdd( radial, tangential), gravity);
+        tmp = ccpMult( tmp, dt);
+        dirX[i] += tmp.x;
+        dirY[i] += tmp.y;
+        posX[i] += dirX[i] * dt;
+        posY[i] += dirY[i] * dt;
+    }
+}
+
+void CCParticlePool::updateRadius(unsigned int count, float dt)
+{
+#if CC_PARTICLE_SIMD
+    if (s_bSIMDEnabled)
+    {
+        const v4f vdt = v4Set(dt);
+        const v4f zero = v4Set(0.0f);
+        for (unsigned int i = 0; i < count; i += 4)
+        {
+            v4f a = v4Add(v4Load(angle + i), v4Mul(v4Load(degreesPerSecond + i), vdt));
+            v4f r = v4Add(v4Load(radius + i), v4Mul(v4Load(deltaRadius + i), vdt));
+            v4Store(angle + i, a);
+            v4Store(radius + i, r);
+
+            v4f s, c;
+            v4SinCos(a, &s, &c);
+            v4Store(posX + i, v4Mul(v4Sub(zero, c), r));
+            v4Store(posY + i, v4Mul(v4Sub(zero, s), r));
+        }
+        return;
+    }
+#endif
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        // Update the angle and radius of the particle.
+        angle[i] += degreesPerSecond[i] * dt;
+        radius[i] += deltaRadius[i] * dt;
+
+        posX[i] = - cosf(angle[i]) * radius[i];
+        posY[i] = - sinf(angle[i]) * radius[i];
+    }
+}
+
+void CCParticlePool::updateQuads(ccV3F_C4B_T2F_Quad* quads, unsigned int count, const CCPoint* origin, const CCPoint& offset,
+                                 bool useAtlasIndex, bool opacityModifyRGB)
+{
+#if CC_PARTICLE_SIMD
+    if (s_bSIMDEnabled)
+    {
+        const v4f zero = v4Set(0.0f);
+        const v4f one = v4Set(1.0f);
+        const v4f k255 = v4Set(255.0f);
+        const v4f offsetX = v4Set(offset.x);
+        const v4f offsetY = v4Set(offset.y);
+        const v4f originX = v4Set(origin ? origin->x : 0.0f);
+        const v4f originY = v4Set(origin ? origin->y : 0.0f);
+
+        // results of 4 particles, scattered into the interleaved quads at last
+        float vertices[8][4];
+        int colors[4][4];
+
+        for (unsigned int i = 0; i < count; i += 4)
+        {
+            v4f x = v4Load(posX + i);
+            v4f y = v4Load(posY + i);
+            if (origin)
+            {
+                x = v4Sub(x, v4Sub(originX, v4Load(startPosX + i)));
+                y = v4Sub(y, v4Sub(originY, v4Load(startPosY + i)));
+            }
+            x = v4Add(x, offsetX);
+            y = v4Add(y, offsetY);
+
+            // not rotated particles get cos 1 and sin 0, which gives the axis aligned quad exactly
+            v4f rot = v4Load(rotation + i);
+            v4f sr, cr;
+            v4SinCos(v4Mul(rot, v4Set(-0.01745329252f)), &sr, &cr);
+            v4m notRotated = v4Eq(rot, zero);
+            cr = v4Select(notRotated, one, cr);
+            sr = v4Select(notRotated, zero, sr);
+
+            v4f x2 = v4Mul(v4Load(size + i), v4Set(0.5f));
+            v4f x1 = v4Sub(zero, x2);
+            v4f x1cr = v4Mul(x1, cr);
+            v4f x1sr = v4Mul(x1, sr);
+            v4f x2cr = v4Mul(x2, cr);
+            v4f x2sr = v4Mul(x2, sr);
+
+            // y1 == x1 and y2 == x2
+            v4Store(vertices[0], v4Add(v4Sub(x1cr, x1sr), x));
+            v4Store(vertices[1], v4Add(v4Add(x1sr, x1cr), y));
+            v4Store(vertices[2], v4Add(v4Sub(x2cr, x1sr), x));
+            v4Store(vertices[3], v4Add(v4Add(x2sr, x1cr), y));
+            v4Store(vertices[4], v4Add(v4Sub(x2cr, x2sr), x));
+            v4Store(vertices[5], v4Add(v4Add(x2sr, x2cr), y));
+            v4Store(vertices[6], v4Add(v4Sub(x1cr, x2sr), x));
+            v4Store(vertices[7], v4Add(v4Add(x1sr, x2cr), y));
+
+            v4f r = v4Load(colorR + i);
+            v4f g = v4Load(colorG + i);
+            v4f b = v4Load(colorB + i);
+            v4f a = v4Load(colorA + i);
+            if (opacityModifyRGB)
+            {
+                r = v4Mul(r, a);
+                g = v4Mul(g, a);
+                b = v4Mul(b, a);
+            }
+            v4StoreInt(colors[0], v4Mul(r, k255));
+            v4StoreInt(colors[1], v4Mul(g, k255));
+            v4StoreInt(colors[2], v4Mul(b, k255));
+            v4StoreInt(colors[3], v4Mul(a, k255));
+
+            unsigned int lanes = MIN(4, count - i);
+            for (unsigned int j = 0; j < lanes; j++)
+            {
+                ccV3F_C4B_T2F_Quad* quad = useAtlasIndex ? &quads[atlasIndex[i + j]] : &quads[i + j];
+                ccColor4B color = ccc4(colors[0][j], colors[1][j], colors[2][j], colors[3][j]);
+
+                quad->bl.colors = color;
+                quad->br.colors = color;
+                quad->tl.colors = color;
+                quad->tr.colors = color;
+
+                quad->bl.vertices.x = vertices[0][j];
+                quad->bl.vertices.y = vertices[1][j];
+                quad->br.vertices.x = vertices[2][j];
+                quad->br.vertices.y = vertices[3][j];
+                quad->tr.vertices.x = vertices[4][j];
+                quad->tr.vertices.y = vertices[5][j];
+                quad->tl.vertices.x = vertices[6][j];
+                quad->tl.vertices.y = vertices[7][j];
+            }
+        }
+        return;
+    }
+#endif
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        ccV3F_C4B_T2F_Quad* quad = useAtlasIndex ? &quads[atlasIndex[i]] : &quads[i];
+
+        CCPoint newPosition(posX[i], posY[i]);
+        if (origin)
+        {
+            CCPoint diff = ccpSub(*origin, ccp(startPosX[i], startPosY[i]));
+            newPosition = ccpSub(newPosition, diff);
+        }
+        newPosition.x += offset.x;
+        newPosition.y += offset.y;
+
+        float r = colorR[i], g = colorG[i], b = colorB[i], a = colorA[i];
+        ccColor4B color = (opacityModifyRGB)
+            ? ccc4( r*a*255, g*a*255, b*a*255, a*255)
+            : ccc4( r*255, g*255, b*255, a*255);
+
+        quad->bl.colors = color;
+        quad->br.colors = color;
+        quad->tl.colors = color;
+        quad->tr.colors = color;
+
+        // vertices
+        GLfloat size_2 = size[i]/2;
+        if (rotation[i])
+        {
+            GLfloat x1 = -size_2;
+            GLfloat y1 = -size_2;
+
+            GLfloat x2 = size_2;
+            GLfloat y2 = size_2;
+            GLfloat x = newPosition.x;
+            GLfloat y = newPosition.y;
+
+            GLfloat rad = (GLfloat)-CC_DEGREES_TO_RADIANS(rotation[i]);
+            GLfloat cr = cosf(rad);
+            GLfloat sr = sinf(rad);
+
+            // bottom-left
+            quad->bl.vertices.x = x1 * cr - y1 * sr + x;
+            quad->bl.vertices.y = x1 * sr + y1 * cr + y;
+
+            // bottom-right vertex:
+            quad->br.vertices.x = x2 * cr - y1 * sr + x;
+            quad->br.vertices.y = x2 * sr + y1 * cr + y;
+
+            // top-left vertex:
+            quad->tl.vertices.x = x1 * cr - y2 * sr + x;
+            quad->tl.vertices.y = x1 * sr + y2 * cr + y;
+
+            // top-right vertex:
+            quad->tr.vertices.x = x2 * cr - y2 * sr + x;
+            quad->tr.vertices.y = x2 * sr + y2 * cr + y;
+        }
+        else
+        {
+            // bottom-left vertex:
+            quad->bl.vertices.x = newPosition.x - size_2;
+            quad->bl.vertices.y = newPosition.y - size_2;
+
+            // bottom-right vertex:
+            quad->br.vertices.x = newPosition.x + size_2;
+            quad->br.vertices.y = newPosition.y - size_2;
+
+            // top-left vertex:
+            quad->tl.vertices.x = newPosition.x - size_2;
+            quad->tl.vertices.y = newPosition.y + size_2;
+
+            // top-right vertex:
+            quad->tr.vertices.x = newPosition.x + size_2;
+            quad->tr.vertices.y = newPosition.y + size_2;
+        }
+    }
+}
+
+NS_CC_END
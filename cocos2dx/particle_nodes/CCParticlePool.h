@@ -0,0 +1,182 @@
+/****************************************************************************
+Copyright (c) 2010-2012 cocos2d-x.org
+
+http://www.cocos2d-x.org
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+#ifndef __CCPARTICLE_POOL_H__
+#define __CCPARTICLE_POOL_H__
+
+#include "ccTypes.h"
+#include "cocoa/CCGeometry.h"
+
+NS_CC_BEGIN
+
+/**
+ * @addtogroup particle_nodes
+ * @{
+ */
+
+/**
+Structure that contains the values of each particle
+*/
+typedef struct sCCParticle {
+    CCPoint     pos;
+    CCPoint     startPos;
+
+    ccColor4F    color;
+    ccColor4F    deltaColor;
+
+    float        size;
+    float        deltaSize;
+
+    float        rotation;
+    float        deltaRotation;
+
+    float        timeToLive;
+
+    unsigned int    atlasIndex;
+
+    //! Mode A: gravity, direction, radial accel, tangential accel
+    struct {
+        CCPoint        dir;
+        float        radialAccel;
+        float        tangentialAccel;
+    } modeA;
+
+    //! Mode B: radius mode
+    struct {
+        float        angle;
+        float        degreesPerSecond;
+        float        radius;
+        float        deltaRadius;
+    } modeB;
+
+}tCCParticle;
+
+/** @brief Particles of a particle system stored as structure of arrays
+
+Every field of tCCParticle has its own array, so the update kernels can step four
+particles at once with SSE on x86 and NEON on ARM. Other platforms, or builds with
+CC_PARTICLE_USE_SIMD set to 0, use scalar kernels which do exactly what the old per
+particle loop did. The SIMD kernels compute sine and cosine with a polynomial, so their
+results differ from the scalar ones only by float rounding.
+
+Arrays are 16 bytes aligned and padded to a multiple of 4 particles. Kernels may
+write the padding behind the last alive particle, but never the quads of it.
+
+@since v2.2
+@js NA
+@lua NA
+*/
+class CC_DLL CCParticlePool
+{
+public:
+    CCParticlePool();
+    ~CCParticlePool();
+
+    /** allocate zeroed storage for capacity particles, old particles are discarded.
+     If allocation fails the old storage is kept and false is returned
+     */
+    bool reserve(unsigned int capacity);
+
+    unsigned int getCapacity() const { return m_uCapacity; }
+
+    /** copy a particle into or out of the arrays */
+    void setParticle(unsigned int index, const tCCParticle& particle);
+    void getParticle(unsigned int index, tCCParticle* particle) const;
+
+    /** overwrite particle dst with particle src, atlas index included */
+    void copyParticle(unsigned int dst, unsigned int src);
+
+    /** decrease life and step color, size and spin of first count particles */
+    void updateLife(unsigned int count, float dt);
+
+    /** step direction and position of first count particles in gravity mode */
+    void updateGravity(unsigned int count, float dt, const CCPoint& gravity);
+
+    /** step angle, radius and position of first count particles in radius mode */
+    void updateRadius(unsigned int count, float dt);
+
+    /** Write vertices and colors of first count particles into quads.
+     Particle position is moved by (origin - startPos) if origin is not NULL, then by offset.
+     If useAtlasIndex is true quad of particle i is quads[atlasIndex[i]], otherwise quads[i].
+     */
+    void updateQuads(ccV3F_C4B_T2F_Quad* quads, unsigned int count, const CCPoint* origin, const CCPoint& offset,
+                     bool useAtlasIndex, bool opacityModifyRGB);
+
+    /** whether the SIMD kernels are used, true by default when they are compiled in.
+     Turning it off is meant for comparing both paths
+     */
+    static bool isSIMDEnabled();
+    static void setSIMDEnabled(bool enabled);
+
+public:
+    float* posX;
+    float* posY;
+    float* startPosX;
+    float* startPosY;
+
+    float* colorR;
+    float* colorG;
+    float* colorB;
+    float* colorA;
+    float* deltaColorR;
+    float* deltaColorG;
+    float* deltaColorB;
+    float* deltaColorA;
+
+    float* size;
+    float* deltaSize;
+
+    float* rotation;
+    float* deltaRotation;
+
+    float* timeToLive;
+
+    unsigned int* atlasIndex;
+
+    // mode A
+    float* dirX;
+    float* dirY;
+    float* radialAccel;
+    float* tangentialAccel;
+
+    // mode B
+    float* angle;
+    float* degreesPerSecond;
+    float* radius;
+    float* deltaRadius;
+
+private:
+    // disallow copy, arrays are owned
+    CCParticlePool(const CCParticlePool&);
+    CCParticlePool& operator=(const CCParticlePool&);
+
+    void* m_pBuffer;
+    unsigned int m_uCapacity;
+};
+
+// end of particle_nodes group
+/// @}
+
+NS_CC_END
+
+#endif //__CCPARTICLE_POOL_H__
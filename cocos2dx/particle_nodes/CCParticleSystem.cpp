@@ -84,7 +84,6 @@ NS_CC_BEGIN
 CCParticleSystem::CCParticleSystem()
 : m_sPlistFile("")
 , m_fElapsed(0)
-, m_pParticles(NULL)
 , m_fEmitCounter(0)
 , m_uParticleIdx(0)
 , m_pBatchNode(NULL)
@@ -394,11 +393,7 @@ bool CCParticleSystem::initWithTotalParticles(unsigned int numberOfParticles)
 {
     m_uTotalParticles = numberOfParticles;
 
-    CC_SAFE_FREE(m_pParticles);
-    
-    m_pParticles = (tCCParticle*)calloc(m_uTotalParticles, sizeof(tCCParticle));
-
-    if( ! m_pParticles )
+    if( ! m_tParticles.reserve(m_uTotalParticles) )
     {
         CCLOG("Particle system: not enough memory");
         CC_SAFE_RELEASE(this);
@@ -410,7 +405,7 @@ bool CCParticleSystem::initWithTotalParticles(unsigned int numberOfParticles)
     {
         for (unsigned int i = 0; i < m_uTotalParticles; i++)
         {
-            m_pParticles[i].atlasIndex=i;
+            m_tParticles.atlasIndex[i]=i;
         }
     }
     // default, active
@@ -448,7 +443,6 @@ CCParticleSystem::~CCParticleSystem()
     // Since the scheduler retains the "target (in this case the ParticleSystem)
 	// it is not needed to call "unscheduleUpdate" here. In fact, it will be called in "cleanup"
     //unscheduleUpdate();
-    CC_SAFE_FREE(m_pParticles);
     CC_SAFE_RELEASE(m_pTexture);
 }
 
@@ -459,8 +453,11 @@ bool CCParticleSystem::addParticle()
         return false;
     }
 
-    tCCParticle * particle = &m_pParticles[ m_uParticleCount ];
-    this->initParticle(particle);
+    // fields not initialized, such as atlas index, keep values of the slot
+    tCCParticle particle;
+    m_tParticles.getParticle(m_uParticleCount, &particle);
+    this->initParticle(&particle);
+    m_tParticles.setParticle(m_uParticleCount, particle);
     ++m_uParticleCount;
 
     return true;
@@ -595,8 +592,7 @@ void CCParticleSystem::resetSystem()
     m_fElapsed = 0;
     for (m_uParticleIdx = 0; m_uParticleIdx < m_uParticleCount; ++m_uParticleIdx)
     {
-        tCCParticle *p = &m_pParticles[m_uParticleIdx];
-        p->timeToLive = 0;
+        m_tParticles.timeToLive[m_uParticleIdx] = 0;
     }
 }
 bool CCParticleSystem::isFull()
@@ -645,125 +641,60 @@ void CCParticleSystem::update(float dt)
 
     if (m_bVisible)
     {
-        while (m_uParticleIdx < m_uParticleCount)
-        {
-            tCCParticle *p = &m_pParticles[m_uParticleIdx];
+        // life, color, size and spin
+        m_tParticles.updateLife(m_uParticleCount, dt);
 
-            // life
-            p->timeToLive -= dt;
+        // Mode A: gravity, direction, tangential accel & radial accel
+        if (m_nEmitterMode == kCCParticleModeGravity)
+        {
+            m_tParticles.updateGravity(m_uParticleCount, dt, modeA.gravity);
+        }
+        // Mode B: radius movement
+        else
+        {
+            m_tParticles.updateRadius(m_uParticleCount, dt);
+        }
 
-            if (p->timeToLive > 0) 
+        // remove dead particles, the last particle takes the place of a dead one
+        while (m_uParticleIdx < m_uParticleCount)
+        {
+            if (m_tParticles.timeToLive[m_uParticleIdx] > 0)
             {
-                // Mode A: gravity, direction, tangential accel & radial accel
-                if (m_nEmitterMode == kCCParticleModeGravity) 
-                {
-                    CCPoint tmp, radial, tangential;
-
-                    radial = CCPointZero;
-                    // radial acceleration
-                    if (p->pos.x || p->pos.y)
-                    {
-                        radial = ccpNormalize(p->pos);
-                    }
-                    tangential = radial;
-                    radial = ccpMult(radial, p->modeA.radialAccel);
-
-                    // tangential acceleration
-                    float newy = tangential.x;
-                    tangential.x = -tangential.y;
-                    tangential.y = newy;
-                    tangential = ccpMult(tangential, p->modeA.tangentialAccel);
-
-                    // (gravity + radial + tangential) * dt
-                    tmp = ccpAdd( ccpAdd( radial, tangential), modeA.gravity);
-                    tmp = ccpMult( tmp, dt);
-                    p->modeA.dir = ccpAdd( p->modeA.dir, tmp);
-                    tmp = ccpMult(p->modeA.dir, dt);
-                    p->pos = ccpAdd( p->pos, tmp );
-                }
-
-                // Mode B: radius movement
-                else 
-                {                
-                    // Update the angle and radius of the particle.
-                    p->modeB.angle += p->modeB.degreesPerSecond * dt;
-                    p->modeB.radius += p->modeB.deltaRadius * dt;
-
-                    p->pos.x = - cosf(p->modeB.angle) * p->modeB.radius;
-                    p->pos.y = - sinf(p->modeB.angle) * p->modeB.radius;
-                }
-
-                // color
-                p->color.r += (p->deltaColor.r * dt);
-                p->color.g += (p->deltaColor.g * dt);
-                p->color.b += (p->deltaColor.b * dt);
-                p->color.a += (p->deltaColor.a * dt);
-
-                // size
-                p->size += (p->deltaSize * dt);
-                p->size = MAX( 0, p->size );
-
-                // angle
-                p->rotation += (p->deltaRotation * dt);
-
-                //
-                // update values in quad
-                //
-
-                CCPoint    newPos;
+                ++m_uParticleIdx;
+                continue;
+            }
 
-                if (m_ePositionType == kCCPositionTypeFree || m_ePositionType == kCCPositionTypeRelative) 
-                {
-                    CCPoint diff = ccpSub( currentPosition, p->startPos );
-                    newPos = ccpSub(p->pos, diff);
-                } 
-                else
-                {
-                    newPos = p->pos;
-                }
+            // life < 0
+            int currentIndex = m_tParticles.atlasIndex[m_uParticleIdx];
+            if( m_uParticleIdx != m_uParticleCount-1 )
+            {
+                m_tParticles.copyParticle(m_uParticleIdx, m_uParticleCount-1);
+            }
+            if (m_pBatchNode)
+            {
+                //disable the switched particle
+                m_pBatchNode->disableParticle(m_uAtlasIndex+currentIndex);
 
-                // translate newPos to correct position, since matrix transform isn't performed in batchnode
-                // don't update the particle with the new position information, it will interfere with the radius and tangential calculations
-                if (m_pBatchNode)
-                {
-                    newPos.x+=m_obPosition.x;
-                    newPos.y+=m_obPosition.y;
-                }
+                //switch indexes
+                m_tParticles.atlasIndex[m_uParticleCount-1] = currentIndex;
+            }
 
-                updateQuadWithParticle(p, newPos);
-                //updateParticleImp(self, updateParticleSel, p, newPos);
+            --m_uParticleCount;
 
-                // update particle counter
-                ++m_uParticleIdx;
-            } 
-            else 
+            if( m_uParticleCount == 0 && m_bIsAutoRemoveOnFinish )
             {
-                // life < 0
-                int currentIndex = p->atlasIndex;
-                if( m_uParticleIdx != m_uParticleCount-1 )
-                {
-                    m_pParticles[m_uParticleIdx] = m_pParticles[m_uParticleCount-1];
-                }
-                if (m_pBatchNode)
-                {
-                    //disable the switched particle
-                    m_pBatchNode->disableParticle(m_uAtlasIndex+currentIndex);
-
-                    //switch indexes
-                    m_pParticles[m_uParticleCount-1].atlasIndex = currentIndex;
-                }
-
+                this->unscheduleUpdate();
+                m_pParent->removeChild(this, true);
+                return;
+            }
+        }
 
-                --m_uParticleCount;
+        //
+        // update values in quad
+        //
+        updateParticleQuads(currentPosition);
+        m_uParticleIdx = m_uParticleCount;
 
-                if( m_uParticleCount == 0 && m_bIsAutoRemoveOnFinish )
-                {
-                    this->unscheduleUpdate();
-                    m_pParent->removeChild(this, true);
-                    return;
-                }
-            }
-        } //while
         m_bTransformSystemDirty = false;
     }
     if (! m_pBatchNode)
@@ -779,6 +710,37 @@ void CCParticleSystem::updateWithNoTime(void)
     this->update(0.0f);
 }
 
+void CCParticleSystem::updateParticleQuads(const CCPoint& currentPosition)
+{
+    tCCParticle particle;
+    for (m_uParticleIdx = 0; m_uParticleIdx < m_uParticleCount; ++m_uParticleIdx)
+    {
+        m_tParticles.getParticle(m_uParticleIdx, &particle);
+
+        CCPoint    newPos;
+
+        if (m_ePositionType == kCCPositionTypeFree || m_ePositionType == kCCPositionTypeRelative) 
+        {
+            CCPoint diff = ccpSub( currentPosition, particle.startPos );
+            newPos = ccpSub(particle.pos, diff);
+        } 
+        else
+        {
+            newPos = particle.pos;
+        }
+
+        // translate newPos to correct position, since matrix transform isn't performed in batchnode
+        // don't update the particle with the new position information, it will interfere with the radius and tangential calculations
+        if (m_pBatchNode)
+        {
+            newPos.x+=m_obPosition.x;
+            newPos.y+=m_obPosition.y;
+        }
+
+        updateQuadWithParticle(&particle, newPos);
+    }
+}
+
 void CCParticleSystem::updateQuadWithParticle(tCCParticle* particle, const CCPoint& newPosition)
 {
     CC_UNUSED_PARAM(particle);
@@ -1322,7 +1284,7 @@ void CCParticleSystem::setBatchNode(CCParticleBatchNode* batchNode)
             //each particle needs a unique index
             for (unsigned int i = 0; i < m_uTotalParticles; i++)
             {
-                m_pParticles[i].atlasIndex=i;
+                m_tParticles.atlasIndex[i]=i;
             }
         }
     }
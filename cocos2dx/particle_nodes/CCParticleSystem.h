@@ -30,6 +30,7 @@ THE SOFTWARE.
 #include "base_nodes/CCNode.h"
 #include "cocoa/CCDictionary.h"
 #include "cocoa/CCString.h"
+#include "CCParticlePool.h"
 
 NS_CC_BEGIN
 
@@ -88,43 +89,6 @@ enum {
     kPositionTypeGrouped = kCCPositionTypeGrouped,
 }; 
 
-/**
-Structure that contains the values of each particle
-*/
-typedef struct sCCParticle {
-    CCPoint     pos;
-    CCPoint     startPos;
-
-    ccColor4F    color;
-    ccColor4F    deltaColor;
-
-    float        size;
-    float        deltaSize;
-
-    float        rotation;
-    float        deltaRotation;
-
-    float        timeToLive;
-
-    unsigned int    atlasIndex;
-
-    //! Mode A: gravity, direction, radial accel, tangential accel
-    struct {
-        CCPoint        dir;
-        float        radialAccel;
-        float        tangentialAccel;
-    } modeA;
-
-    //! Mode B: radius mode
-    struct {
-        float        angle;
-        float        degreesPerSecond;
-        float        radius;
-        float        deltaRadius;
-    } modeB;
-
-}tCCParticle;
-
 //typedef void (*CC_UPDATE_PARTICLE_IMP)(id, SEL, tCCParticle*, CCPoint);
 
 class CCTexture2D;
@@ -216,8 +180,8 @@ protected:
         float rotatePerSecondVar;
     } modeB;
 
-    //! Array of particles
-    tCCParticle *m_pParticles;
+    //! Particles, stored as structure of arrays
+    CCParticlePool m_tParticles;
 
     // color modulate
     //    BOOL colorModulate;
@@ -424,7 +388,20 @@ public:
     //! whether or not the system is full
     bool isFull();
 
-    //! should be overridden by subclasses
+    /** Copy alive particle at index out of or into the particle pool. Before v2.2 particles were an
+     array of tCCParticle named m_pParticles, code which used m_pParticles[index] should use these.
+     @since v2.2
+     */
+    void getParticle(unsigned int index, tCCParticle* particle) const { m_tParticles.getParticle(index, particle); }
+    void setParticle(unsigned int index, const tCCParticle& particle) { m_tParticles.setParticle(index, particle); }
+
+    /** Update quads of all alive particles, currentPosition is the emitter position particles
+     are relative to. The default implementation calls updateQuadWithParticle for each particle,
+     subclasses may override it to generate all quads at once.
+     @since v2.2
+     */
+    virtual void updateParticleQuads(const CCPoint& currentPosition);
+    //! should be overridden by subclasses, particle is a copy of the particle in the pool
     virtual void updateQuadWithParticle(tCCParticle* particle, const CCPoint& newPosition);
     //! should be overridden by subclasses
     virtual void postStep();
@@ -242,6 +242,24 @@ void CCParticleSystemQuad::initIndices()
     }
 }
 
+void CCParticleSystemQuad::updateParticleQuads(const CCPoint& currentPosition)
+{
+    bool relative = (m_ePositionType == kCCPositionTypeFree || m_ePositionType == kCCPositionTypeRelative);
+
+    if (m_pBatchNode)
+    {
+        // translate to correct position, since matrix transform isn't performed in batchnode
+        ccV3F_C4B_T2F_Quad *batchQuads = m_pBatchNode->getTextureAtlas()->getQuads();
+        m_tParticles.updateQuads(batchQuads + m_uAtlasIndex, m_uParticleCount, relative ? &currentPosition : NULL,
+                                 m_obPosition, true, m_bOpacityModifyRGB);
+    }
+    else
+    {
+        m_tParticles.updateQuads(m_pQuads, m_uParticleCount, relative ? &currentPosition : NULL,
+                                 CCPointZero, false, m_bOpacityModifyRGB);
+    }
+}
+
 void CCParticleSystemQuad::updateQuadWithParticle(tCCParticle* particle, const CCPoint& newPosition)
 {
     ccV3F_C4B_T2F_Quad *quad;
@@ -420,24 +438,21 @@ void CCParticleSystemQuad::setTotalParticles(unsigned int tp)
     if( tp > m_uAllocatedParticles )
     {
         // Allocate new memory
-        size_t particlesSize = tp * sizeof(tCCParticle);
         size_t quadsSize = sizeof(m_pQuads[0]) * tp * 1;
         size_t indicesSize = sizeof(m_pIndices[0]) * tp * 6 * 1;
 
-        tCCParticle* particlesNew = (tCCParticle*)realloc(m_pParticles, particlesSize);
+        bool particlesNew = m_tParticles.reserve(tp);
         ccV3F_C4B_T2F_Quad* quadsNew = (ccV3F_C4B_T2F_Quad*)realloc(m_pQuads, quadsSize);
         GLushort* indicesNew = (GLushort*)realloc(m_pIndices, indicesSize);
 
         if (particlesNew && quadsNew && indicesNew)
         {
             // Assign pointers
-            m_pParticles = particlesNew;
             m_pQuads = quadsNew;
             m_pIndices = indicesNew;
 
             // Clear the memory
             // XXX: Bug? If the quads are cleared, then drawing doesn't work... WHY??? XXX
-            memset(m_pParticles, 0, particlesSize);
             memset(m_pQuads, 0, quadsSize);
             memset(m_pIndices, 0, indicesSize);
 
@@ -446,7 +461,6 @@ void CCParticleSystemQuad::setTotalParticles(unsigned int tp)
         else
         {
             // Out of memory, failed to resize some array
-            if (particlesNew) m_pParticles = particlesNew;
             if (quadsNew) m_pQuads = quadsNew;
             if (indicesNew) m_pIndices = indicesNew;
 
@@ -461,7 +475,7 @@ void CCParticleSystemQuad::setTotalParticles(unsigned int tp)
         {
             for (unsigned int i = 0; i < m_uTotalParticles; i++)
             {
-                m_pParticles[i].atlasIndex=i;
+                m_tParticles.atlasIndex[i]=i;
             }
         }
 
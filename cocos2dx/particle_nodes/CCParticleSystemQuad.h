@@ -103,6 +103,11 @@ public:
      * @js NA
      */
     virtual void setTexture(CCTexture2D* texture);
+    /** generates quads of all particles at once, updateQuadWithParticle isn't called
+     *  @since v2.2
+     *  @js NA
+     */
+    virtual void updateParticleQuads(const CCPoint& currentPosition);
     /**
      * @js NA
      */
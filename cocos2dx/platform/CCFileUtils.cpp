@@ -23,12 +23,14 @@ THE SOFTWARE.
 ****************************************************************************/
 
 #include "CCFileUtils.h"
+#include "CCFileView.h"
 #include "CCDirector.h"
 #include "cocoa/CCDictionary.h"
 #include "cocoa/CCString.h"
 #include "support/xml/CCSAXParser.h"
 #include "support/xml/tinyxml2.h"
-#include "support/zip/unzip.h"
+#include "support/zip/ZipUtils.h"
+#include <sys/stat.h>
 #include <stack>
 #include <algorithm>
 
@@ -463,14 +465,41 @@ void CCFileUtils::purgeFileUtils()
     CC_SAFE_DELETE(s_sharedFileUtils);
 }
 
+// full path prefix of files in mounted lpk archives
+#define LPK_PATH_PREFIX "lpk://"
+#define LPK_PATH_PREFIX_LEN 6
+
+// full path prefix of files in mounted zip files
+#define ZIP_PATH_PREFIX "zip://"
+#define ZIP_PATH_PREFIX_LEN 6
+
+// platform variant to select in lpk archives
+#if CC_TARGET_PLATFORM == CC_PLATFORM_IOS
+    #define LPK_CURRENT_PLATFORM LPKP_IOS
+#elif CC_TARGET_PLATFORM == CC_PLATFORM_ANDROID
+    #define LPK_CURRENT_PLATFORM LPKP_ANDROID
+#else
+    #define LPK_CURRENT_PLATFORM LPKP_DEFAULT
+#endif
+
 CCFileUtils::CCFileUtils()
 : m_pFilenameLookupDict(NULL)
+, m_lpkLocale(0)
+, m_zipUseClock(0)
 , m_ttfFolder("")
 {
+    pthread_rwlock_init(&m_archiveLock, NULL);
 }
 
 CCFileUtils::~CCFileUtils()
 {
+    unmountAllLPK();
+    unmountAllZip();
+    for (std::map<std::string, CachedZip>::iterator iter = m_cachedZips.begin(); iter != m_cachedZips.end(); ++iter)
+    {
+        delete iter->second.zip;
+    }
+    pthread_rwlock_destroy(&m_archiveLock);
     CC_SAFE_RELEASE(m_pFilenameLookupDict);
 }
 
@@ -484,6 +513,21 @@ bool CCFileUtils::init()
 void CCFileUtils::purgeCachedEntries()
 {
     m_fullPathCache.clear();
+    m_fullPathMissCache.clear();
+    
+    // resources may be updated, close cached zip files
+    pthread_rwlock_wrlock(&m_archiveLock);
+    for (std::map<std::string, CachedZip>::iterator iter = m_cachedZips.begin(); iter != m_cachedZips.end(); ++iter)
+    {
+        delete iter->second.zip;
+    }
+    m_cachedZips.clear();
+    pthread_rwlock_unlock(&m_archiveLock);
+}
+
+void CCFileUtils::purgeMissingFileCache()
+{
+    m_fullPathMissCache.clear();
 }
 
 void CCFileUtils::setTTFFolder(std::string f) {
@@ -501,6 +545,14 @@ unsigned char* CCFileUtils::getFileData(const char* pszFileName, const char* psz
     *pSize = 0;
     do
     {
+        // mounted archives come before search paths
+        std::string archivePath = getPathInArchives(pszFileName);
+        if (archivePath.length() > 0)
+        {
+            pBuffer = getFileDataFromArchive(archivePath, pSize);
+            break;
+        }
+        
         // read the file from hardware
         std::string fullPath = fullPathForFilename(pszFileName);
         FILE *fp = fopen(fullPath.c_str(), pszMode);
@@ -524,44 +576,130 @@ unsigned char* CCFileUtils::getFileData(const char* pszFileName, const char* psz
     return pBuffer;
 }
 
-unsigned char* CCFileUtils::getFileDataFromZip(const char* pszZipFilePath, const char* pszFileName, size_t* pSize)
+CCFileView* CCFileUtils::openFileView(const char* pszFileName)
 {
-    unsigned char * pBuffer = NULL;
-    unzFile pFile = NULL;
-    *pSize = 0;
-
-    do 
+    CCAssert(pszFileName != NULL, "Invalid parameters.");
+    CCFileView* pView = openFileViewInArchives(pszFileName);
+    if (pView)
     {
-        CC_BREAK_IF(!pszZipFilePath || !pszFileName);
-        CC_BREAK_IF(strlen(pszZipFilePath) == 0);
-
-        pFile = unzOpen(pszZipFilePath);
-        CC_BREAK_IF(!pFile);
-
-        int nRet = unzLocateFile(pFile, pszFileName, 1);
-        CC_BREAK_IF(UNZ_OK != nRet);
-
-        char szFilePathA[260];
-        unz_file_info FileInfo;
-        nRet = unzGetCurrentFileInfo(pFile, &FileInfo, szFilePathA, sizeof(szFilePathA), NULL, 0, NULL, 0);
-        CC_BREAK_IF(UNZ_OK != nRet);
-
-        nRet = unzOpenCurrentFile(pFile);
-        CC_BREAK_IF(UNZ_OK != nRet);
-
-        pBuffer = new unsigned char[FileInfo.uncompressed_size];
-        int CC_UNUSED nSize = unzReadCurrentFile(pFile, pBuffer, FileInfo.uncompressed_size);
-        CCAssert(nSize == 0 || nSize == (int)FileInfo.uncompressed_size, "the file size is wrong");
-
-        *pSize = FileInfo.uncompressed_size;
-        unzCloseCurrentFile(pFile);
-    } while (0);
+        return pView;
+    }
+    
+    // only a file on file system can be mapped
+    std::string fullPath = fullPathForFilename(pszFileName);
+    if (fullPath[0] == '/')
+    {
+        return CCFileView::openFile(fullPath);
+    }
+    
+    size_t size = 0;
+    unsigned char* pBuffer = getFileData(fullPath.c_str(), "rb", &size);
+    return pBuffer ? CCFileView::openBuffer(pBuffer, size) : NULL;
+}
 
-    if (pFile)
+CCFileView* CCFileUtils::openFileViewInArchives(const std::string& filename)
+{
+    std::string archivePath = getPathInArchives(filename);
+    if (archivePath.empty())
+    {
+        return NULL;
+    }
+    
+    // stored entry in a mapped zip is a slice of zip mapping
+    if (isZipPath(archivePath))
     {
-        unzClose(pFile);
+        std::string entryName;
+        CCFileView* pView = NULL;
+        pthread_rwlock_rdlock(&m_archiveLock);
+        ZipFile* zip = findInZip(archivePath.substr(ZIP_PATH_PREFIX_LEN), &entryName);
+        if (zip)
+        {
+            pView = zip->openFileView(entryName);
+        }
+        pthread_rwlock_unlock(&m_archiveLock);
+        return pView;
     }
+    
+    size_t size = 0;
+    unsigned char* pBuffer = getFileDataFromArchive(archivePath, &size);
+    return pBuffer ? CCFileView::openBuffer(pBuffer, size) : NULL;
+}
 
+unsigned char* CCFileUtils::getFileDataFromZip(const char* pszZipFilePath, const char* pszFileName, size_t* pSize)
+{
+    *pSize = 0;
+    if (!pszZipFilePath || !pszFileName || strlen(pszZipFilePath) == 0)
+    {
+        return NULL;
+    }
+    
+    // zip is reopened only if it is replaced, e.g. by a new download
+    struct stat st;
+    if (stat(pszZipFilePath, &st) != 0)
+    {
+        return NULL;
+    }
+    
+    std::string zipPath = pszZipFilePath;
+    unsigned char* pBuffer = NULL;
+    bool bFound = false;
+    pthread_rwlock_rdlock(&m_archiveLock);
+    std::map<std::string, CachedZip>::iterator iter = m_cachedZips.find(zipPath);
+    if (iter != m_cachedZips.end() &&
+        iter->second.size == (long long)st.st_size &&
+        iter->second.mtime == (long long)st.st_mtime &&
+        iter->second.inode == (long long)st.st_ino)
+    {
+        bFound = true;
+        __sync_lock_test_and_set(&iter->second.lastUse, __sync_add_and_fetch(&m_zipUseClock, 1));
+        pBuffer = iter->second.zip->getFileData(pszFileName, pSize);
+    }
+    pthread_rwlock_unlock(&m_archiveLock);
+    if (bFound)
+    {
+        return pBuffer;
+    }
+    
+    ZipFile* zip = new ZipFile(zipPath);
+    if (!zip->isOpen())
+    {
+        delete zip;
+        return NULL;
+    }
+    
+    pthread_rwlock_wrlock(&m_archiveLock);
+    iter = m_cachedZips.find(zipPath);
+    if (iter != m_cachedZips.end())
+    {
+        delete iter->second.zip;
+        m_cachedZips.erase(iter);
+    }
+    
+    // close least recently used zip, views opened from it stay valid
+    while (!m_cachedZips.empty() && m_cachedZips.size() >= CC_MAX_CACHED_ZIPS)
+    {
+        std::map<std::string, CachedZip>::iterator oldest = m_cachedZips.begin();
+        for (iter = m_cachedZips.begin(); iter != m_cachedZips.end(); ++iter)
+        {
+            if (iter->second.lastUse < oldest->second.lastUse)
+            {
+                oldest = iter;
+            }
+        }
+        delete oldest->second.zip;
+        m_cachedZips.erase(oldest);
+    }
+    
+    CachedZip cached;
+    cached.zip = zip;
+    cached.size = st.st_size;
+    cached.mtime = st.st_mtime;
+    cached.inode = st.st_ino;
+    cached.lastUse = __sync_add_and_fetch(&m_zipUseClock, 1);
+    m_cachedZips[zipPath] = cached;
+    
+    pBuffer = zip->getFileData(pszFileName, pSize);
+    pthread_rwlock_unlock(&m_archiveLock);
     return pBuffer;
 }
 
@@ -622,6 +760,20 @@ std::string CCFileUtils::fullPathForFilename(const char* pszFileName)
         return cacheIter->second;
     }
     
+    // Known missing, don't probe all search paths again
+    if (m_fullPathMissCache.find(strFileName) != m_fullPathMissCache.end())
+    {
+        return pszFileName;
+    }
+    
+    // mounted archives come before search paths, a file in archives has no path on file system,
+    // its name is returned and getFileData, openFileView and isFileExist find it in archives again
+    if (getPathInArchives(strFileName).length() > 0)
+    {
+        m_fullPathCache.insert(std::pair<std::string, std::string>(pszFileName, strFileName));
+        return strFileName;
+    }
+    
     // Get the new file name.
     std::string newFilename = getNewFilename(pszFileName);
     
@@ -647,6 +799,7 @@ std::string CCFileUtils::fullPathForFilename(const char* pszFileName)
     }
     
     //CCLOG("cocos2d: fullPathForFilename: No file found at %s. Possible missing file.", pszFileName);
+    m_fullPathMissCache.insert(strFileName);
 
     // The file wasn't found, return the file name passed in.
     return pszFileName;
@@ -665,6 +818,10 @@ void CCFileUtils::setSearchResolutionsOrder(const std::vector<std::string>& sear
 {
     bool bExistDefault = false;
     m_fullPathCache.clear();
+    m_fullPathMissCache.clear();
+    
+    // archive lookup reads resolution order in any thread
+    pthread_rwlock_wrlock(&m_archiveLock);
     m_searchResolutionsOrderArray.clear();
     for (std::vector<std::string>::const_iterator iter = searchResolutionsOrder.begin(); iter != searchResolutionsOrder.end(); ++iter)
     {
@@ -685,11 +842,15 @@ void CCFileUtils::setSearchResolutionsOrder(const std::vector<std::string>& sear
     {
         m_searchResolutionsOrderArray.push_back("");
     }
+    pthread_rwlock_unlock(&m_archiveLock);
 }
 
 void CCFileUtils::addSearchResolutionsOrder(const char* order)
 {
+    pthread_rwlock_wrlock(&m_archiveLock);
     m_searchResolutionsOrderArray.push_back(order);
+    pthread_rwlock_unlock(&m_archiveLock);
+    m_fullPathMissCache.clear();
 }
 
 const std::vector<std::string>& CCFileUtils::getSearchResolutionsOrder()
@@ -707,6 +868,7 @@ void CCFileUtils::setSearchPaths(const std::vector<std::string>& searchPaths)
     bool bExistDefaultRootPath = false;
 
     m_fullPathCache.clear();
+    m_fullPathMissCache.clear();
     m_searchPathArray.clear();
     for (std::vector<std::string>::const_iterator iter = searchPaths.begin(); iter != searchPaths.end(); ++iter)
     {
@@ -749,6 +911,7 @@ void CCFileUtils::addSearchPath(const char* path_)
         path += "/";
     }
     m_searchPathArray.push_back(path);
+    m_fullPathMissCache.clear();
 }
 
 std::string CCFileUtils::getDefaultResRootPath() {
@@ -779,6 +942,7 @@ void CCFileUtils::removeAllPaths()
 void CCFileUtils::setFilenameLookupDictionary(CCDictionary* pFilenameLookupDict)
 {
     m_fullPathCache.clear();
+    m_fullPathMissCache.clear();
     CC_SAFE_RELEASE(m_pFilenameLookupDict);
     m_pFilenameLookupDict = pFilenameLookupDict;
     CC_SAFE_RETAIN(m_pFilenameLookupDict);
@@ -813,6 +977,324 @@ std::string CCFileUtils::getFullPathForDirectoryAndFilename(const std::string& s
     return ret;
 }
 
+bool CCFileUtils::mountLPK(const char* pszPath, const char* pszKey, CCLPKKeyFunc keyFunc)
+{
+    CCAssert(pszPath != NULL, "CCFileUtils: Invalid path");
+    
+    // archive itself is a loose file
+    std::string fullPath = fullPathForFilename(pszPath);
+    CCLPKArchive* archive = CCLPKArchive::open(fullPath, pszKey ? pszKey : "", keyFunc);
+    if (!archive)
+    {
+        return false;
+    }
+    
+    // remount moves archive to top
+    pthread_rwlock_wrlock(&m_archiveLock);
+    for (std::vector<CCLPKArchive*>::iterator iter = m_lpkArchives.begin(); iter != m_lpkArchives.end(); ++iter)
+    {
+        if ((*iter)->getPath() == fullPath)
+        {
+            delete *iter;
+            m_lpkArchives.erase(iter);
+            break;
+        }
+    }
+    m_lpkArchives.push_back(archive);
+    pthread_rwlock_unlock(&m_archiveLock);
+    
+    // cached paths may be overlaid
+    purgeCachedEntries();
+    return true;
+}
+
+void CCFileUtils::unmountLPK(const char* pszPath)
+{
+    std::string fullPath = fullPathForFilename(pszPath);
+    pthread_rwlock_wrlock(&m_archiveLock);
+    for (std::vector<CCLPKArchive*>::iterator iter = m_lpkArchives.begin(); iter != m_lpkArchives.end(); ++iter)
+    {
+        if ((*iter)->getPath() == fullPath)
+        {
+            delete *iter;
+            m_lpkArchives.erase(iter);
+            break;
+        }
+    }
+    pthread_rwlock_unlock(&m_archiveLock);
+    purgeCachedEntries();
+}
+
+void CCFileUtils::unmountAllLPK()
+{
+    pthread_rwlock_wrlock(&m_archiveLock);
+    for (std::vector<CCLPKArchive*>::iterator iter = m_lpkArchives.begin(); iter != m_lpkArchives.end(); ++iter)
+    {
+        delete *iter;
+    }
+    m_lpkArchives.clear();
+    pthread_rwlock_unlock(&m_archiveLock);
+    purgeCachedEntries();
+}
+
+void CCFileUtils::setLPKLocale(uint16_t locale)
+{
+    if (m_lpkLocale != locale)
+    {
+        m_lpkLocale = locale;
+        purgeCachedEntries();
+    }
+}
+
+bool CCFileUtils::isLPKPath(const std::string& strPath)
+{
+    return strPath.compare(0, LPK_PATH_PREFIX_LEN, LPK_PATH_PREFIX) == 0;
+}
+
+bool CCFileUtils::mountZip(const char* pszPath, const char* pszRoot)
+{
+    CCAssert(pszPath != NULL, "CCFileUtils: Invalid path");
+    
+    std::string fullPath = fullPathForFilename(pszPath);
+    std::string root = pszRoot ? pszRoot : "";
+    if (!root.empty() && root[root.length()-1] != '/')
+    {
+        root += "/";
+    }
+    
+    // entries out of root are never indexed
+    ZipFile* zip = new ZipFile(fullPath, root);
+    if (!zip->isOpen())
+    {
+        delete zip;
+        return false;
+    }
+    
+    // remount moves zip to top
+    pthread_rwlock_wrlock(&m_archiveLock);
+    for (std::vector<MountedZip>::iterator iter = m_mountedZips.begin(); iter != m_mountedZips.end(); ++iter)
+    {
+        if (iter->path == fullPath)
+        {
+            delete iter->zip;
+            m_mountedZips.erase(iter);
+            break;
+        }
+    }
+    MountedZip mounted;
+    mounted.zip = zip;
+    mounted.path = fullPath;
+    mounted.root = root;
+    m_mountedZips.push_back(mounted);
+    pthread_rwlock_unlock(&m_archiveLock);
+    
+    purgeCachedEntries();
+    return true;
+}
+
+void CCFileUtils::unmountZip(const char* pszPath)
+{
+    std::string fullPath = fullPathForFilename(pszPath);
+    pthread_rwlock_wrlock(&m_archiveLock);
+    for (std::vector<MountedZip>::iterator iter = m_mountedZips.begin(); iter != m_mountedZips.end(); ++iter)
+    {
+        if (iter->path == fullPath)
+        {
+            delete iter->zip;
+            m_mountedZips.erase(iter);
+            break;
+        }
+    }
+    pthread_rwlock_unlock(&m_archiveLock);
+    purgeCachedEntries();
+}
+
+void CCFileUtils::unmountAllZip()
+{
+    pthread_rwlock_wrlock(&m_archiveLock);
+    for (std::vector<MountedZip>::iterator iter = m_mountedZips.begin(); iter != m_mountedZips.end(); ++iter)
+    {
+        delete iter->zip;
+    }
+    m_mountedZips.clear();
+    pthread_rwlock_unlock(&m_archiveLock);
+    purgeCachedEntries();
+}
+
+bool CCFileUtils::isZipPath(const std::string& strPath)
+{
+    return strPath.compare(0, ZIP_PATH_PREFIX_LEN, ZIP_PATH_PREFIX) == 0;
+}
+
+ZipFile* CCFileUtils::findInZip(const std::string& filename, std::string* pEntryName)
+{
+    for (std::vector<MountedZip>::reverse_iterator iter = m_mountedZips.rbegin(); iter != m_mountedZips.rend(); ++iter)
+    {
+        std::string entryName = iter->root + filename;
+        if (iter->zip->fileExists(entryName))
+        {
+            *pEntryName = entryName;
+            return iter->zip;
+        }
+    }
+    return NULL;
+}
+
+std::string CCFileUtils::getPathInZip(const std::string& filename)
+{
+    std::string ret = "";
+    pthread_rwlock_rdlock(&m_archiveLock);
+    if (!m_mountedZips.empty())
+    {
+        std::string file = filename;
+        std::string file_path = "";
+        size_t pos = filename.find_last_of("/");
+        if (pos != std::string::npos)
+        {
+            file_path = filename.substr(0, pos+1);
+            file = filename.substr(pos+1);
+        }
+        
+        std::string entryName;
+        for (std::vector<std::string>::iterator resOrderIter = m_searchResolutionsOrderArray.begin();
+             resOrderIter != m_searchResolutionsOrderArray.end(); ++resOrderIter)
+        {
+            std::string path = file_path + *resOrderIter + file;
+            if (findInZip(path, &entryName))
+            {
+                ret = ZIP_PATH_PREFIX + path;
+                break;
+            }
+        }
+    }
+    pthread_rwlock_unlock(&m_archiveLock);
+    return ret;
+}
+
+std::string CCFileUtils::getPathInArchives(const std::string& filename)
+{
+    if (filename.empty() || isAbsolutePath(filename))
+    {
+        return "";
+    }
+    
+    std::string newFilename = getNewFilename(filename.c_str());
+    std::string ret = getPathInLPK(newFilename);
+    if (ret.empty())
+    {
+        ret = getPathInZip(newFilename);
+    }
+    return ret;
+}
+
+unsigned char* CCFileUtils::getFileDataFromArchive(const std::string& fullPath, size_t* pSize)
+{
+    if (isLPKPath(fullPath))
+    {
+        return getFileDataFromLPK(fullPath, pSize);
+    }
+    
+    // inflating holds read lock only, so zip entries are read in parallel
+    unsigned char* pBuffer = NULL;
+    std::string entryName;
+    pthread_rwlock_rdlock(&m_archiveLock);
+    ZipFile* zip = findInZip(fullPath.substr(ZIP_PATH_PREFIX_LEN), &entryName);
+    if (zip)
+    {
+        pBuffer = zip->getFileData(entryName, pSize);
+    }
+    pthread_rwlock_unlock(&m_archiveLock);
+    return pBuffer;
+}
+
+bool CCFileUtils::isFileExistInArchive(const std::string& fullPath)
+{
+    if (isLPKPath(fullPath))
+    {
+        return isFileExistInLPK(fullPath);
+    }
+    
+    std::string entryName;
+    pthread_rwlock_rdlock(&m_archiveLock);
+    bool bFound = findInZip(fullPath.substr(ZIP_PATH_PREFIX_LEN), &entryName) != NULL;
+    pthread_rwlock_unlock(&m_archiveLock);
+    return bFound;
+}
+
+CCLPKArchive* CCFileUtils::findInLPK(const std::string& filename, uint32_t* pIndex)
+{
+    for (std::vector<CCLPKArchive*>::reverse_iterator iter = m_lpkArchives.rbegin(); iter != m_lpkArchives.rend(); ++iter)
+    {
+        uint32_t index = (*iter)->findEntry(filename, m_lpkLocale, LPK_CURRENT_PLATFORM);
+        if (index != LPK_INDEX_INVALID)
+        {
+            if ((*iter)->isDeleted(index))
+            {
+                return NULL;
+            }
+            *pIndex = index;
+            return *iter;
+        }
+    }
+    return NULL;
+}
+
+std::string CCFileUtils::getPathInLPK(const std::string& filename)
+{
+    std::string ret = "";
+    pthread_rwlock_rdlock(&m_archiveLock);
+    if (!m_lpkArchives.empty())
+    {
+        std::string file = filename;
+        std::string file_path = "";
+        size_t pos = filename.find_last_of("/");
+        if (pos != std::string::npos)
+        {
+            file_path = filename.substr(0, pos+1);
+            file = filename.substr(pos+1);
+        }
+        
+        uint32_t index;
+        for (std::vector<std::string>::iterator resOrderIter = m_searchResolutionsOrderArray.begin();
+             resOrderIter != m_searchResolutionsOrderArray.end(); ++resOrderIter)
+        {
+            std::string path = file_path + *resOrderIter + file;
+            if (findInLPK(path, &index))
+            {
+                ret = LPK_PATH_PREFIX + path;
+                break;
+            }
+        }
+    }
+    pthread_rwlock_unlock(&m_archiveLock);
+    return ret;
+}
+
+unsigned char* CCFileUtils::getFileDataFromLPK(const std::string& fullPath, size_t* pSize)
+{
+    // reading holds read lock so archive can't be unmounted in the middle
+    unsigned char* pBuffer = NULL;
+    std::string path = fullPath.substr(LPK_PATH_PREFIX_LEN);
+    uint32_t index;
+    pthread_rwlock_rdlock(&m_archiveLock);
+    CCLPKArchive* archive = findInLPK(path, &index);
+    if (archive)
+    {
+        pBuffer = archive->readEntry(index, path, pSize);
+    }
+    pthread_rwlock_unlock(&m_archiveLock);
+    return pBuffer;
+}
+
+bool CCFileUtils::isFileExistInLPK(const std::string& fullPath)
+{
+    uint32_t index;
+    pthread_rwlock_rdlock(&m_archiveLock);
+    bool bFound = findInLPK(fullPath.substr(LPK_PATH_PREFIX_LEN), &index) != NULL;
+    pthread_rwlock_unlock(&m_archiveLock);
+    return bFound;
+}
+
 bool CCFileUtils::isAbsolutePath(const std::string& strPath)
 {
     return strPath[0] == '/' ? true : false;
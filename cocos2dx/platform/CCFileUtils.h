@@ -27,14 +27,19 @@ THE SOFTWARE.
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
 #include "CCPlatformMacros.h"
 #include "ccTypes.h"
 #include "ccTypeInfo.h"
+#include "support/res/CCLPKArchive.h"
+#include <pthread.h>
 
 NS_CC_BEGIN
 
 class CCDictionary;
 class CCArray;
+class CCFileView;
+class ZipFile;
 /**
  * @addtogroup platform
  * @{
@@ -86,6 +91,15 @@ public:
      */
     virtual void purgeCachedEntries();
     
+    /**
+     *  Forgets names which were not found, found paths are kept. Call it after files are written
+     *  into search paths, AssetsManager and CCFileDownloader call it when they finish. Call it in
+     *  GL thread, path caches are not guarded.
+     *
+     *  @since v2.2
+     */
+    void purgeMissingFileCache();
+    
     /**
      *  Gets resource file data
      *
@@ -98,6 +112,18 @@ public:
      */
     virtual unsigned char* getFileData(const char* pszFileName, const char* pszMode, size_t* pSize);
 
+    /**
+     *  Opens a read only view of resource file. A large file on file system is memory mapped
+     *  instead of copied into a heap buffer, so decoders which only read data should use this
+     *  rather than getFileData.
+     *
+     *  @param[in]  pszFileName The resource file name which contains the path.
+     *  @return Upon success, a view with retain count 1 is returned, otherwise NULL.
+     *  @warning Caller should release returned view.
+     *  @since v2.2
+     */
+    virtual CCFileView* openFileView(const char* pszFileName);
+    
     /**
      *  Gets resource file data from a zip file.
      *
@@ -105,6 +131,8 @@ public:
      *  @param[out] pSize If the file read operation succeeds, it will be the data size, otherwise 0.
      *  @return Upon success, a pointer to the data is returned, otherwise NULL.
      *  @warning Recall: you are responsible for calling delete[] on any Non-NULL pointer returned.
+     *  @note Zip file is indexed at first read and kept open until it changes on disk, at most
+     *        CC_MAX_CACHED_ZIPS zip files are kept open.
      *  @js NA
      */
     virtual unsigned char* getFileDataFromZip(const char* pszZipFilePath, const char* pszFileName, size_t* pSize);
@@ -149,6 +177,8 @@ public:
      	    internal_dir/gamescene/uilayer/sprite.pvr.gz                      (if not found, return "gamescene/uilayer/sprite.png")
 
      If the new file can't be found on the file system, it will return the parameter pszFileName directly.
+     A file in mounted lpk archives or zip files is found before search paths, its name is returned
+     unchanged because it has no path on file system.
      
      This method was added to simplify multiplatform support. Whether you are using cocos2d-js or any cross-compilation toolchain like StellaSDK or Apportable,
      you might need to load different resources for a given file in the different platforms.
@@ -340,6 +370,73 @@ public:
     virtual void enableMainApkExpansion(int versionCode) {}
     virtual void enablePatchApkExpansion(int versionCode) {}
     
+    /**
+     *  Mounts a lpk archive.
+     *
+     *  Files in mounted archives are searched before search paths, with same resolution
+     *  order rule. An archive mounted later overlays archives mounted before it, so a patch
+     *  archive can replace files, or hide them by a deleted entry. A file in archive has no
+     *  path on file system, fullPathForFilename returns its name unchanged and getFileData,
+     *  openFileView and isFileExist find it in archives. Archive lookup and read are thread
+     *  safe, data is read from a mapping of archive instead of a shared FILE*.
+     *
+     *  @param pszPath path of archive, relative path is resolved by fullPathForFilename. It must be
+     *         a file on file system, on Android an archive in apk should be copied out first
+     *  @param pszKey decrypt key, can be NULL if archive has no encrypted file
+     *  @param keyFunc optional function to get dynamic key of a file, if set, pszKey is ignored
+     *  @return true if archive is mounted
+     *  @since v2.2
+     */
+    virtual bool mountLPK(const char* pszPath, const char* pszKey = NULL, CCLPKKeyFunc keyFunc = NULL);
+    
+    /**
+     *  Unmounts a lpk archive, the path should be same as it is mounted.
+     *  @since v2.2
+     */
+    virtual void unmountLPK(const char* pszPath);
+    
+    /**
+     *  Unmounts all lpk archives.
+     *  @since v2.2
+     */
+    virtual void unmountAllLPK();
+    
+    /**
+     *  Sets/Gets locale used to select file variant in lpk archives, in Windows LCID.
+     *  Zero is the default locale and it is used when a file has no variant for current locale.
+     *  @since v2.2
+     */
+    void setLPKLocale(uint16_t locale);
+    uint16_t getLPKLocale() { return m_lpkLocale; }
+    
+    /**
+     *  Mounts a zip file, like an obb or a downloaded resource bundle, as a search root.
+     *
+     *  Files in mounted zip files are searched after lpk archives and before search paths, with
+     *  same resolution order rule. A zip file mounted later has higher priority. Like lpk
+     *  archives, fullPathForFilename returns name of a file in zip unchanged. Central directory
+     *  is indexed once when zip is mounted and entries can be read from any thread.
+     *
+     *  @param pszPath path of zip file on file system, relative path is resolved by fullPathForFilename
+     *  @param pszRoot folder in zip used as root, like "assets/", empty means zip root
+     *  @return true if zip file is mounted
+     *  File views opened from a zip file stay valid after it is unmounted.
+     *  @since v2.2
+     */
+    virtual bool mountZip(const char* pszPath, const char* pszRoot = "");
+    
+    /**
+     *  Unmounts a zip file, the path should be same as it is mounted.
+     *  @since v2.2
+     */
+    virtual void unmountZip(const char* pszPath);
+    
+    /**
+     *  Unmounts all zip files.
+     *  @since v2.2
+     */
+    virtual void unmountAllZip();
+    
     /// set ttf file folder
     virtual void setTTFFolder(std::string f);
     virtual std::string getTTFFolder();
@@ -411,6 +508,78 @@ protected:
      */
     virtual CCArray* createCCArrayWithContentsOfFile(const std::string& filename);
     
+    /**
+     *  Location of a file in mounted archives is "lpk://" or "zip://" plus its path, it is only
+     *  used inside CCFileUtils and never returned to callers.
+     */
+    bool isLPKPath(const std::string& strPath);
+    bool isZipPath(const std::string& strPath);
+    bool isArchivePath(const std::string& strPath) { return isLPKPath(strPath) || isZipPath(strPath); }
+    
+    /**
+     *  Gets location of a file name in mounted lpk archives or zip files, with filename lookup
+     *  dictionary and resolution order applied like fullPathForFilename. It can be called in any thread.
+     *  @return The "lpk://" or "zip://" location, or an empty string if the file isn't in archives.
+     */
+    std::string getPathInArchives(const std::string& filename);
+    
+    /**
+     *  Opens a view of a file in mounted lpk archives or zip files.
+     *  @return A view with retain count 1, or NULL if the file isn't in archives.
+     */
+    CCFileView* openFileViewInArchives(const std::string& filename);
+    
+    /**
+     *  Gets full path of a file in mounted lpk archives, resolution directories are searched in order.
+     *  @return The "lpk://" full path of the file, or an empty string if no archive has it.
+     */
+    std::string getPathInLPK(const std::string& filename);
+    
+    /**
+     *  Reads a file from mounted lpk archives.
+     *  @param fullPath The "lpk://" full path of the file.
+     *  @warning Caller should call delete[] on returned buffer.
+     */
+    unsigned char* getFileDataFromLPK(const std::string& fullPath, size_t* pSize);
+    
+    /**
+     *  Checks whether a "lpk://" full path exists in mounted archives.
+     */
+    bool isFileExistInLPK(const std::string& fullPath);
+    
+    /**
+     *  Finds the archive which provides a relative path, the last mounted archive wins. A deleted
+     *  entry hides the file in archives mounted before. Caller must hold m_archiveLock.
+     *  @return archive, or NULL if the file isn't in any archive.
+     */
+    CCLPKArchive* findInLPK(const std::string& filename, uint32_t* pIndex);
+    
+    /**
+     *  Gets full path of a file in mounted zip files, resolution directories are searched in order.
+     *  @return The "zip://" full path of the file, or an empty string if no zip has it.
+     */
+    std::string getPathInZip(const std::string& filename);
+    
+    /**
+     *  Finds the mounted zip file which provides a path relative to root, the last mounted wins.
+     *  Caller must hold m_archiveLock.
+     *  @param[out] pEntryName Name of entry in zip.
+     *  @return zip file, or NULL if no zip has it.
+     */
+    ZipFile* findInZip(const std::string& filename, std::string* pEntryName);
+    
+    /**
+     *  Reads a file from mounted lpk archives or zip files.
+     *  @param fullPath The "lpk://" or "zip://" full path of the file.
+     *  @warning Caller should call delete[] on returned buffer.
+     */
+    unsigned char* getFileDataFromArchive(const std::string& fullPath, size_t* pSize);
+    
+    /**
+     *  Checks whether a "lpk://" or "zip://" full path exists in mounted archives.
+     */
+    bool isFileExistInArchive(const std::string& fullPath);
+    
     /** Dictionary used to lookup filenames based on a key.
      *  It is used internally by the following methods:
      *
@@ -423,6 +592,7 @@ protected:
     /** 
      *  The vector contains resolution folders.
      *  The lower index of the element in this vector, the higher priority for this resolution directory.
+     *  It is written with m_archiveLock held because archive lookup reads it in any thread.
      */
     std::vector<std::string> m_searchResolutionsOrderArray;
     
@@ -447,6 +617,44 @@ protected:
      */
     std::map<std::string, std::string> m_fullPathCache;
     
+    /**
+     *  The names which fullPathForFilename can't find, so a miss doesn't probe every search path
+     *  and resolution directory again. It is cleared when search rules change, call purgeMissingFileCache
+     *  after new files are added to search paths.
+     */
+    std::set<std::string> m_fullPathMissCache;
+    
+    /**
+     *  Mounted lpk archives, in mount order. Guarded by m_archiveLock, archives and zip
+     *  files only change in mount and unmount, so lookups take a read lock.
+     */
+    std::vector<CCLPKArchive*> m_lpkArchives;
+    pthread_rwlock_t m_archiveLock;
+    
+    /// locale to select file variant in lpk archives
+    uint16_t m_lpkLocale;
+    
+    /// a zip file mounted as search root, guarded by m_archiveLock
+    struct MountedZip {
+        ZipFile* zip;
+        std::string path;
+        std::string root;
+    };
+    std::vector<MountedZip> m_mountedZips;
+    
+    /// zip files opened by getFileDataFromZip, reopened if file is changed. Guarded by m_archiveLock
+    struct CachedZip {
+        ZipFile* zip;
+        long long size;
+        long long mtime;
+        long long inode;
+        
+        /// stamp of last read, updated atomically under read lock
+        unsigned int lastUse;
+    };
+    std::map<std::string, CachedZip> m_cachedZips;
+    unsigned int m_zipUseClock;
+    
     /// the prefix folder of ttf file, like "fonts"
     std::string m_ttfFolder;
     
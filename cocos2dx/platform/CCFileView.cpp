@@ -0,0 +1,154 @@
+/****************************************************************************
+ Author: Luma (stubma@gmail.com)
+ 
+ https://github.com/stubma/cocos2dx-classical
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#include "CCFileView.h"
+#include "ccConfig.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+NS_CC_BEGIN
+
+// mapped pages or new[] buffer, freed when last view of it is released. It doesn't use
+// CCObject ref count because slices are created and released in loader threads
+struct CCFileView::Content {
+    volatile int refs;
+    unsigned char* bytes;
+    size_t size;
+    bool mapped;
+    
+    Content(unsigned char* b, size_t s, bool m) : refs(1), bytes(b), size(s), mapped(m) {}
+};
+
+CCFileView::CCFileView() :
+m_bytes(NULL),
+m_size(0),
+m_content(NULL) {
+}
+
+CCFileView::~CCFileView() {
+    if(m_content && __sync_sub_and_fetch(&m_content->refs, 1) == 0) {
+        if(m_content->mapped) {
+            munmap(m_content->bytes, m_content->size);
+        } else {
+            delete[] m_content->bytes;
+        }
+        delete m_content;
+    }
+}
+
+bool CCFileView::isMapped() {
+    return m_content && m_content->mapped;
+}
+
+CCFileView* CCFileView::openFile(const std::string& fullPath) {
+    int fd = open(fullPath.c_str(), O_RDONLY);
+    if(fd < 0)
+        return NULL;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return NULL;
+    }
+    
+    // map large file, mapping stays valid after fd is closed
+    size_t size = st.st_size;
+    if(size > 0 && size >= CC_FILE_VIEW_MMAP_THRESHOLD) {
+        void* p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(p != MAP_FAILED) {
+            close(fd);
+            CCFileView* v = new CCFileView();
+            v->m_bytes = (unsigned char*)p;
+            v->m_size = size;
+            v->m_content = new Content(v->m_bytes, size, true);
+            return v;
+        }
+    }
+    
+    // read small file, or large file if it can't be mapped
+    unsigned char* buffer = new unsigned char[size > 0 ? size : 1];
+    size_t read = 0;
+    while(read < size) {
+        ssize_t r = pread(fd, buffer + read, size - read, read);
+        if(r < 0 && errno == EINTR)
+            continue;
+        if(r <= 0)
+            break;
+        read += r;
+    }
+    close(fd);
+    if(read < size) {
+        delete[] buffer;
+        return NULL;
+    }
+    return openBuffer(buffer, size);
+}
+
+CCFileView* CCFileView::openMappedFile(const std::string& fullPath) {
+    int fd = open(fullPath.c_str(), O_RDONLY);
+    if(fd < 0)
+        return NULL;
+    struct stat st;
+    void* p = MAP_FAILED;
+    if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if(p == MAP_FAILED)
+        return NULL;
+    
+    CCFileView* v = new CCFileView();
+    v->m_bytes = (unsigned char*)p;
+    v->m_size = st.st_size;
+    v->m_content = new Content(v->m_bytes, v->m_size, true);
+    return v;
+}
+
+CCFileView* CCFileView::openBytes(const unsigned char* bytes, size_t size) {
+    CCFileView* v = new CCFileView();
+    v->m_bytes = (unsigned char*)bytes;
+    v->m_size = size;
+    return v;
+}
+
+CCFileView* CCFileView::openSlice(CCFileView* parent, size_t offset, size_t size) {
+    CCFileView* v = new CCFileView();
+    v->m_bytes = parent->m_bytes + offset;
+    v->m_size = size;
+    v->m_content = parent->m_content;
+    if(v->m_content)
+        __sync_add_and_fetch(&v->m_content->refs, 1);
+    return v;
+}
+
+CCFileView* CCFileView::openBuffer(unsigned char* buffer, size_t size) {
+    CCFileView* v = new CCFileView();
+    v->m_bytes = buffer;
+    v->m_size = size;
+    v->m_content = new Content(buffer, size, false);
+    return v;
+}
+
+NS_CC_END
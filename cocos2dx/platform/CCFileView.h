@@ -0,0 +1,117 @@
+/****************************************************************************
+ Author: Luma (stubma@gmail.com)
+ 
+ https://github.com/stubma/cocos2dx-classical
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#ifndef __CCFileView_h__
+#define __CCFileView_h__
+
+#include "cocoa/CCObject.h"
+#include <string>
+
+NS_CC_BEGIN
+
+/**
+ * A read only view of whole file content. Large files on file system are memory mapped
+ * so decoders can read them without a heap copy, other files (small files, files in apk or
+ * lpk archive) are held in a heap buffer. The view is ref counted, content stays valid until
+ * it is released. Views are opened in loader threads which have no autorelease pool, so open
+ * methods return a view with retain count 1 instead of an autoreleased one.
+ *
+ * @since v2.2
+ */
+class CC_DLL CCFileView : public CCObject {
+protected:
+    CCFileView();
+    
+public:
+    virtual ~CCFileView();
+    
+    /**
+     * open a view of a file on file system, it is mapped if it is not smaller than
+     * CC_FILE_VIEW_MMAP_THRESHOLD. It is thread safe
+     *
+     * @param fullPath absolute path of file
+     * @return view with retain count 1, caller should release it. NULL if file can't be read
+     */
+    static CCFileView* openFile(const std::string& fullPath);
+    
+    /**
+     * map a whole file no matter how large it is. It is thread safe
+     *
+     * @param fullPath absolute path of file
+     * @return view with retain count 1, caller should release it. NULL if file can't be mapped
+     */
+    static CCFileView* openMappedFile(const std::string& fullPath);
+    
+    /**
+     * open a view of memory owned by others, like a stored entry in a mapped archive
+     *
+     * @param bytes content, it must stay valid until view is released
+     * @param size size of content
+     * @return view with retain count 1, caller should release it
+     */
+    static CCFileView* openBytes(const unsigned char* bytes, size_t size);
+    
+    /**
+     * open a view of part of another view, like a stored entry in a mapped archive.
+     * Slice shares content of parent so it stays valid after parent is released. Content
+     * is ref counted atomically, slices can be created and released in any thread
+     *
+     * @param parent view which contains the slice
+     * @param offset offset of slice in parent
+     * @param size size of slice
+     * @return view with retain count 1, caller should release it
+     */
+    static CCFileView* openSlice(CCFileView* parent, size_t offset, size_t size);
+    
+    /**
+     * open a view which owns a buffer
+     *
+     * @param buffer buffer allocated by new[], it will be deleted by view
+     * @param size size of buffer
+     * @return view with retain count 1, caller should release it
+     */
+    static CCFileView* openBuffer(unsigned char* buffer, size_t size);
+    
+    /// file content, don't modify it, mapped pages are read only
+    const unsigned char* getBytes() { return m_bytes; }
+    
+    /// file size
+    size_t getSize() { return m_size; }
+    
+    /// true if content is memory mapped
+    bool isMapped();
+    
+private:
+    struct Content;
+    
+    /// content of this view, a slice points into content of parent
+    unsigned char* m_bytes;
+    size_t m_size;
+    
+    /// mapped pages or buffer shared by view and its slices, NULL if content is owned by others
+    Content* m_content;
+};
+
+NS_CC_END
+
+#endif // __CCFileView_h__
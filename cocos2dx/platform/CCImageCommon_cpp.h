@@ -31,6 +31,7 @@ THE SOFTWARE.
 #include "CCCommon.h"
 #include "CCStdC.h"
 #include "CCFileUtils.h"
+#include "CCFileView.h"
 #include "png.h"
 #include "jpeglib.h"
 #include "tiffio.h"
@@ -134,14 +135,13 @@ bool CCImage::initWithImageFile(const char * strPath, EImageFormat eImgFmt/* = e
 
     SDL_FreeSurface(iSurf);
 #else
-    size_t nSize = 0;
-    std::string fullPath = CCFileUtils::sharedFileUtils()->fullPathForFilename(strPath);
-    unsigned char* pBuffer = CCFileUtils::sharedFileUtils()->getFileData(fullPath.c_str(), "rb", &nSize);
-    if (pBuffer != NULL && nSize > 0)
+    // decoders only read compressed data, so it can be decoded from a mapped view
+    CCFileView* pView = CCFileUtils::sharedFileUtils()->openFileView(strPath);
+    if (pView != NULL && pView->getSize() > 0)
     {
-        bRet = initWithImageData(pBuffer, nSize, eImgFmt);
+        bRet = initWithImageData((void*)pView->getBytes(), pView->getSize(), eImgFmt);
     }
-    CC_SAFE_DELETE_ARRAY(pBuffer);
+    CC_SAFE_RELEASE(pView);
 #endif // EMSCRIPTEN
 
     return bRet;
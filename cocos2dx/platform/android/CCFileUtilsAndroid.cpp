@@ -192,8 +192,12 @@ bool CCFileUtilsAndroid::isFileExist(const std::string& strFilePath)
 
     bool bFound = false;
     
-    // Check whether file exists in apk.
-    if (strFilePath[0] != '/')
+    // Check whether file exists in mounted archives or apk.
+    if (getPathInArchives(strFilePath).length() > 0)
+    {
+        bFound = true;
+    }
+    else if (strFilePath[0] != '/')
     {
         std::string strPath = strFilePath;
         if (strPath.find(m_strDefaultResRootPath) != 0)
@@ -245,6 +249,38 @@ unsigned char* CCFileUtilsAndroid::getFileDataForAsync(const char* pszFileName,
     return doGetFileData(pszFileName, pszMode, pSize, true);
 }
 
+CCFileView* CCFileUtilsAndroid::openFileView(const char* pszFileName)
+{
+    CCAssert(pszFileName != NULL, "Invalid parameters.");
+    CCFileView* pView = openFileViewInArchives(pszFileName);
+    if (pView)
+    {
+        return pView;
+    }
+    
+    string fullPath = fullPathForFilename(pszFileName);
+    if (fullPath.length() == 0 || fullPath[0] == '/')
+    {
+        return CCFileUtils::openFileView(fullPath.c_str());
+    }
+    
+    // stored assets, like png and ogg, are slices of mapped apk
+    if(s_pPatchXApkFile) {
+        pView = s_pPatchXApkFile->openFileView(fullPath);
+    }
+    if(!pView && s_pMainXApkFile) {
+        pView = s_pMainXApkFile->openFileView(fullPath);
+    }
+    if(!pView) {
+        pView = s_pZipFile->openFileView(fullPath);
+    }
+    if (!pView)
+    {
+        CCLOG("Open view of file(%s) failed!", pszFileName);
+    }
+    return pView;
+}
+
 unsigned char* CCFileUtilsAndroid::doGetFileData(const char* pszFileName, const char* pszMode, size_t* pSize, bool forAsync)
 {
     unsigned char * pData = 0;
@@ -254,33 +290,25 @@ unsigned char* CCFileUtilsAndroid::doGetFileData(const char* pszFileName, const
         return 0;
     }
     
-    string fullPath = fullPathForFilename(pszFileName);
+    // mounted archives come before search paths
+    string archivePath = getPathInArchives(pszFileName);
+    string fullPath = archivePath.empty() ? fullPathForFilename(pszFileName) : "";
     
-    if (fullPath[0] != '/')
+    if (!archivePath.empty())
     {
-        if (forAsync)
-        {
-            if(s_pPatchXApkFile) {
-                pData = s_pPatchXApkFile->getFileData(fullPath.c_str(), pSize, s_pPatchXApkFile->_dataThread);
-            }
-            if(!pData && s_pMainXApkFile) {
-                pData = s_pMainXApkFile->getFileData(fullPath.c_str(), pSize, s_pMainXApkFile->_dataThread);
-            }
-            if(!pData) {
-                pData = s_pZipFile->getFileData(fullPath.c_str(), pSize, s_pZipFile->_dataThread);
-            }
+        pData = getFileDataFromArchive(archivePath, pSize);
+    }
+    else if (fullPath[0] != '/')
+    {
+        // zip reader is thread safe, async loading uses same path
+        if(s_pPatchXApkFile) {
+            pData = s_pPatchXApkFile->getFileData(fullPath, pSize);
         }
-        else
-        {
-            if(s_pPatchXApkFile) {
-                pData = s_pPatchXApkFile->getFileData(fullPath.c_str(), pSize);
-            }
-            if(!pData && s_pMainXApkFile) {
-                pData = s_pMainXApkFile->getFileData(fullPath.c_str(), pSize);
-            }
-            if(!pData) {
-                pData = s_pZipFile->getFileData(fullPath.c_str(), pSize);
-            }
+        if(!pData && s_pMainXApkFile) {
+            pData = s_pMainXApkFile->getFileData(fullPath, pSize);
+        }
+        if(!pData) {
+            pData = s_pZipFile->getFileData(fullPath, pSize);
         }
     }
     else
@@ -51,6 +51,7 @@ public:
     /* override funtions */
     bool init();
     virtual unsigned char* getFileData(const char* pszFileName, const char* pszMode, size_t* pSize);
+    virtual CCFileView* openFileView(const char* pszFileName);
     virtual std::string getWritablePath();
     virtual bool isFileExist(const std::string& strFilePath);
     virtual bool isAbsolutePath(const std::string& strPath);
@@ -221,6 +221,21 @@ CCFileUtils* CCFileUtils::sharedFileUtils()
 
 static NSFileManager* s_fileManager = [NSFileManager defaultManager];
 
+// parse a plist in mounted archive, NSDictionary and NSArray can only load it from file system
+static id propertyListFromArchive(CCFileUtils* utils, const std::string& filename)
+{
+    size_t size = 0;
+    unsigned char* data = utils->getFileData(filename.c_str(), "rb", &size);
+    if (!data)
+    {
+        return nil;
+    }
+    NSData* nsData = [NSData dataWithBytes:data length:size];
+    id plist = [NSPropertyListSerialization propertyListWithData:nsData options:NSPropertyListImmutable format:NULL error:NULL];
+    delete[] data;
+    return plist;
+}
+
 std::string CCFileUtilsIOS::getWritablePath()
 {
     // save to document folder
@@ -240,7 +255,11 @@ bool CCFileUtilsIOS::isFileExist(const std::string& strFilePath)
 
     bool bRet = false;
     
-    if (strFilePath[0] != '/')
+    if (getPathInArchives(strFilePath).length() > 0)
+    {
+        bRet = true;
+    }
+    else if (strFilePath[0] != '/')
     {
         std::string path;
         std::string file;
@@ -303,9 +322,21 @@ bool CCFileUtilsIOS::isAbsolutePath(const std::string& strPath)
 
 CCDictionary* CCFileUtilsIOS::createCCDictionaryWithContentsOfFile(const std::string& filename)
 {
-    std::string fullPath = CCFileUtils::sharedFileUtils()->fullPathForFilename(filename.c_str());
-    NSString* pPath = [NSString stringWithUTF8String:fullPath.c_str()];
-    NSDictionary* pDict = [NSDictionary dictionaryWithContentsOfFile:pPath];
+    NSDictionary* pDict = nil;
+    if (getPathInArchives(filename).length() > 0)
+    {
+        id plist = propertyListFromArchive(this, filename);
+        if ([plist isKindOfClass:[NSDictionary class]])
+        {
+            pDict = (NSDictionary*)plist;
+        }
+    }
+    else
+    {
+        std::string fullPath = fullPathForFilename(filename.c_str());
+        NSString* pPath = [NSString stringWithUTF8String:fullPath.c_str()];
+        pDict = [NSDictionary dictionaryWithContentsOfFile:pPath];
+    }
     
     if (pDict != nil)
     {
@@ -348,9 +379,21 @@ CCArray* CCFileUtilsIOS::createCCArrayWithContentsOfFile(const std::string& file
     //    pPath = [pPath stringByDeletingPathExtension];
     //    pPath = [[NSBundle mainBundle] pathForResource:pPath ofType:pathExtension];
     //    fixing cannot read data using CCArray::createWithContentsOfFile
-    std::string fullPath = CCFileUtils::sharedFileUtils()->fullPathForFilename(filename.c_str());
-    NSString* pPath = [NSString stringWithUTF8String:fullPath.c_str()];
-    NSArray* pArray = [NSArray arrayWithContentsOfFile:pPath];
+    NSArray* pArray = nil;
+    if (getPathInArchives(filename).length() > 0)
+    {
+        id plist = propertyListFromArchive(this, filename);
+        if ([plist isKindOfClass:[NSArray class]])
+        {
+            pArray = (NSArray*)plist;
+        }
+    }
+    else
+    {
+        std::string fullPath = fullPathForFilename(filename.c_str());
+        NSString* pPath = [NSString stringWithUTF8String:fullPath.c_str()];
+        pArray = [NSArray arrayWithContentsOfFile:pPath];
+    }
     
     CCArray* pRet = new CCArray();
     for (id value in pArray) {
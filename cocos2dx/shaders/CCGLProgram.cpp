@@ -26,6 +26,7 @@ THE SOFTWARE.
 ****************************************************************************/
 
 #include "CCDirector.h"
+#include "CCRenderQueue.h"
 #include "CCGLProgram.h"
 #include "ccGLStateCache.h"
 #include "ccMacros.h"
@@ -381,6 +382,9 @@ bool CCGLProgram::link()
 
 void CCGLProgram::use()
 {
+    // pending quads must be drawn before switching program
+    CC_RENDER_QUEUE_FLUSH();
+    
     ccGLUseProgram(m_uProgram);
     s_currentProgram = this;
 }
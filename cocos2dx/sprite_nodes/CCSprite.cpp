@@ -37,6 +37,7 @@ THE SOFTWARE.
 #include "shaders/ccGLStateCache.h"
 #include "shaders/CCGLProgram.h"
 #include "CCDirector.h"
+#include "CCRenderQueue.h"
 #include "cocoa/CCPointExtension.h"
 #include "cocoa/CCGeometry.h"
 #include "textures/CCTexture2D.h"
@@ -552,6 +553,16 @@ void CCSprite::draw(void)
 
     CCAssert(!m_pobBatchNode, "If CCSprite is being rendered by CCSpriteBatchNode, CCSprite#draw SHOULD NOT be called");
     
+#if CC_SPRITE_DEBUG_DRAW == 0
+    // if auto batching is enabled, quad is merged with neighbors and drawn later
+    CCRenderQueue* queue = CCRenderQueue::currentQueue();
+    if(queue && queue->appendQuad(m_sQuad, m_pobTexture, getShaderProgram(), m_sBlendFunc))
+    {
+        CC_PROFILER_STOP_CATEGORY(kCCProfilerCategorySprite, "CCSprite - draw");
+        return;
+    }
+#endif
+    
     CC_NODE_DRAW_SETUP(this);
 
     ccGLBlendFunc( m_sBlendFunc.src, m_sBlendFunc.dst );
@@ -701,24 +712,7 @@ void CCSprite::sortAllChildren()
 {
     if (m_bReorderChildDirty)
     {
-        int i = 0,j = 0,length = m_pChildren->data->num;
-        CCNode** x = (CCNode**)m_pChildren->data->arr;
-        CCNode *tempItem = NULL;
-
-        // insertion sort
-        for(i=1; i<length; i++)
-        {
-            tempItem = x[i];
-            j = i-1;
-
-            //continue moving element downwards while zOrder is smaller or when zOrder is the same but orderOfArrival is smaller
-            while(j>=0 && ( tempItem->getZOrder() < x[j]->getZOrder() || ( tempItem->getZOrder() == x[j]->getZOrder() && tempItem->getOrderOfArrival() < x[j]->getOrderOfArrival() ) ) )
-            {
-                x[j+1] = x[j];
-                j = j-1;
-            }
-            x[j+1] = tempItem;
-        }
+        sortNodesByZOrder(m_pChildren->data);
 
         if ( m_pobBatchNode)
         {
@@ -247,25 +247,7 @@ void CCSpriteBatchNode::sortAllChildren()
 {
     if (m_bReorderChildDirty)
     {
-        int i = 0,j = 0,length = m_pChildren->data->num;
-        CCNode ** x = (CCNode**)m_pChildren->data->arr;
-        CCNode *tempItem = NULL;
-
-        //insertion sort
-        for(i=1; i<length; i++)
-        {
-            tempItem = x[i];
-            j = i-1;
-
-            //continue moving element downwards while zOrder is smaller or when zOrder is the same but orderOfArrival is smaller
-            while(j>=0 && ( tempItem->getZOrder() < x[j]->getZOrder() || ( tempItem->getZOrder() == x[j]->getZOrder() && tempItem->getOrderOfArrival() < x[j]->getOrderOfArrival() ) ) )
-            {
-                x[j+1] = x[j];
-                j--;
-            }
-
-            x[j+1] = tempItem;
-        }
+        sortNodesByZOrder(m_pChildren->data);
 
         //sorted now check all children
         if (m_pChildren->count() > 0)
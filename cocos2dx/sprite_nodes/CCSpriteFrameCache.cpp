@@ -32,8 +32,10 @@ THE SOFTWARE.
 #include "CCSpriteFrameCache.h"
 #include "CCSpriteFrame.h"
 #include "CCSprite.h"
+#include "CCSpriteSheetFormat.h"
 #include "support/utils/TransformUtils.h"
 #include "platform/CCFileUtils.h"
+#include "platform/CCFileView.h"
 #include "cocoa/CCString.h"
 #include "cocoa/CCArray.h"
 #include "cocoa/CCDictionary.h"
@@ -201,21 +203,318 @@ void CCSpriteFrameCache::addSpriteFramesWithDictionary(CCDictionary* dictionary,
     }
 }
 
+// validate compiled sheet and copy its header, records are checked to be in data
+static bool readSheetHeader(const unsigned char* pData, size_t nSize, ccSpriteSheetHeader* pHeader)
+{
+    if (!pData || nSize < sizeof(ccSpriteSheetHeader))
+    {
+        return false;
+    }
+    memcpy(pHeader, pData, sizeof(ccSpriteSheetHeader));
+    if (memcmp(pHeader->magic, CC_SPRITE_SHEET_MAGIC, 4) != 0 || pHeader->version != CC_SPRITE_SHEET_VERSION)
+    {
+        return false;
+    }
+    
+    // 64 bits math so corrupted counts can't wrap around
+    unsigned long long expected = sizeof(ccSpriteSheetHeader);
+    expected += (unsigned long long)pHeader->frameCount * sizeof(ccSpriteSheetFrame);
+    expected += (unsigned long long)pHeader->aliasCount * sizeof(ccSpriteSheetAlias);
+    expected += pHeader->stringPoolSize;
+    if (expected != nSize)
+    {
+        return false;
+    }
+    
+    // last string must be terminated, then any offset in pool is a valid string
+    return pHeader->stringPoolSize == 0 || pData[nSize - 1] == 0;
+}
+
+// check all records before any frame is added, so a corrupted sheet adds nothing. Records
+// must be sorted by name hash because frames are looked up by binary search
+static bool checkSheetRecords(const unsigned char* pData, const ccSpriteSheetHeader& header)
+{
+    const unsigned char* pFrames = pData + sizeof(ccSpriteSheetHeader);
+    const unsigned char* pAliases = pFrames + header.frameCount * sizeof(ccSpriteSheetFrame);
+    
+    ccSpriteSheetFrame record;
+    uint32_t lastHash = 0;
+    for (uint32_t i = 0; i < header.frameCount; i++)
+    {
+        memcpy(&record, pFrames + i * sizeof(ccSpriteSheetFrame), sizeof(ccSpriteSheetFrame));
+        if (record.name >= header.stringPoolSize || record.hash < lastHash)
+        {
+            return false;
+        }
+        lastHash = record.hash;
+    }
+    
+    ccSpriteSheetAlias alias;
+    lastHash = 0;
+    for (uint32_t i = 0; i < header.aliasCount; i++)
+    {
+        memcpy(&alias, pAliases + i * sizeof(ccSpriteSheetAlias), sizeof(ccSpriteSheetAlias));
+        if (alias.name >= header.stringPoolSize || alias.frame >= header.frameCount || alias.hash < lastHash)
+        {
+            return false;
+        }
+        lastHash = alias.hash;
+    }
+    return true;
+}
+
+// index of first record whose hash is not less than given hash, records have a hash at offset 0
+static uint32_t lowerBoundOfHash(const unsigned char* pRecords, uint32_t count, size_t recordSize, uint32_t hash)
+{
+    uint32_t low = 0;
+    uint32_t high = count;
+    while (low < high)
+    {
+        uint32_t mid = low + (high - low) / 2;
+        uint32_t midHash;
+        memcpy(&midHash, pRecords + mid * recordSize, sizeof(uint32_t));
+        if (midHash < hash)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// find frame record of a frame name or an alias, by name hash. Visited records are checked
+// so it is safe without checkSheetRecords
+static bool findSheetFrame(const unsigned char* pData, const ccSpriteSheetHeader& header, const char* pszName, ccSpriteSheetFrame* pRecord)
+{
+    const unsigned char* pFrames = pData + sizeof(ccSpriteSheetHeader);
+    const unsigned char* pAliases = pFrames + header.frameCount * sizeof(ccSpriteSheetFrame);
+    const char* pStrings = (const char*)(pAliases + header.aliasCount * sizeof(ccSpriteSheetAlias));
+    uint32_t hash = ccSpriteSheetHashName(pszName);
+    
+    // names of same hash are adjacent
+    for (uint32_t i = lowerBoundOfHash(pFrames, header.frameCount, sizeof(ccSpriteSheetFrame), hash); i < header.frameCount; i++)
+    {
+        memcpy(pRecord, pFrames + i * sizeof(ccSpriteSheetFrame), sizeof(ccSpriteSheetFrame));
+        if (pRecord->hash != hash)
+        {
+            break;
+        }
+        if (pRecord->name < header.stringPoolSize && strcmp(pStrings + pRecord->name, pszName) == 0)
+        {
+            return true;
+        }
+    }
+    
+    ccSpriteSheetAlias alias;
+    for (uint32_t i = lowerBoundOfHash(pAliases, header.aliasCount, sizeof(ccSpriteSheetAlias), hash); i < header.aliasCount; i++)
+    {
+        memcpy(&alias, pAliases + i * sizeof(ccSpriteSheetAlias), sizeof(ccSpriteSheetAlias));
+        if (alias.hash != hash)
+        {
+            break;
+        }
+        if (alias.name < header.stringPoolSize && alias.frame < header.frameCount && strcmp(pStrings + alias.name, pszName) == 0)
+        {
+            memcpy(pRecord, pFrames + alias.frame * sizeof(ccSpriteSheetFrame), sizeof(ccSpriteSheetFrame));
+            return true;
+        }
+    }
+    return false;
+}
+
+static CCSpriteFrame* newSpriteFrameWithRecord(const ccSpriteSheetFrame& record, CCTexture2D* pobTexture)
+{
+    CCSpriteFrame* spriteFrame = new CCSpriteFrame();
+    spriteFrame->initWithTexture(pobTexture,
+                                 CCRectMake(record.rect[0], record.rect[1], record.rect[2], record.rect[3]),
+                                 (record.flags & CC_SPRITE_SHEET_FRAME_ROTATED) != 0,
+                                 CCPointMake(record.offset[0], record.offset[1]),
+                                 CCSizeMake(record.sourceSize[0], record.sourceSize[1]));
+    return spriteFrame;
+}
+
+bool CCSpriteFrameCache::addSpriteFramesWithBinaryData(const unsigned char* pData, size_t nSize, CCTexture2D *pobTexture)
+{
+    ccSpriteSheetHeader header;
+    if (!readSheetHeader(pData, nSize, &header) || !checkSheetRecords(pData, header))
+    {
+        return false;
+    }
+    const unsigned char* pFrames = pData + sizeof(ccSpriteSheetHeader);
+    const unsigned char* pAliases = pFrames + header.frameCount * sizeof(ccSpriteSheetFrame);
+    const char* pStrings = (const char*)(pAliases + header.aliasCount * sizeof(ccSpriteSheetAlias));
+    
+    ccSpriteSheetFrame record;
+    for (uint32_t i = 0; i < header.frameCount; i++)
+    {
+        memcpy(&record, pFrames + i * sizeof(ccSpriteSheetFrame), sizeof(ccSpriteSheetFrame));
+        const char* spriteFrameName = pStrings + record.name;
+        if (m_pSpriteFrames->objectForKey(spriteFrameName))
+        {
+            continue;
+        }
+        
+        // add sprite frame
+        CCSpriteFrame* spriteFrame = newSpriteFrameWithRecord(record, pobTexture);
+        m_pSpriteFrames->setObject(spriteFrame, spriteFrameName);
+        spriteFrame->release();
+    }
+    
+    ccSpriteSheetAlias alias;
+    for (uint32_t i = 0; i < header.aliasCount; i++)
+    {
+        memcpy(&alias, pAliases + i * sizeof(ccSpriteSheetAlias), sizeof(ccSpriteSheetAlias));
+        memcpy(&record, pFrames + alias.frame * sizeof(ccSpriteSheetFrame), sizeof(ccSpriteSheetFrame));
+        const char* oneAlias = pStrings + alias.name;
+        if (m_pSpriteFramesAliases->objectForKey(oneAlias))
+        {
+            CCLOGWARN("cocos2d: WARNING: an alias with name %s already exists", oneAlias);
+        }
+        CCString* frameKey = new CCString(pStrings + record.name);
+        m_pSpriteFramesAliases->setObject(frameKey, oneAlias);
+        frameKey->release();
+    }
+    return true;
+}
+
+std::string CCSpriteFrameCache::texturePathForSheet(const char *pszSheet, const std::string& textureFileName)
+{
+    string texturePath("");
+    if (! textureFileName.empty())
+    {
+        // build texture path relative to plist file
+        texturePath = CCFileUtils::sharedFileUtils()->fullPathFromRelativeFile(textureFileName.c_str(), pszSheet);
+    }
+    else
+    {
+        // build texture path by replacing file extension
+        texturePath = pszSheet;
+
+        // remove .xxx
+        size_t startPos = texturePath.find_last_of("."); 
+        texturePath = texturePath.erase(startPos);
+
+        // append .png
+        texturePath = texturePath.append(".png");
+
+        CCLOG("cocos2d: CCSpriteFrameCache: Trying to use file %s as texture", texturePath.c_str());
+    }
+    return texturePath;
+}
+
+CCSpriteFrame* CCSpriteFrameCache::spriteFrameWithBinaryData(const unsigned char* pData, size_t nSize, const char *pszName, CCTexture2D *pobTexture)
+{
+    ccSpriteSheetHeader header;
+    ccSpriteSheetFrame record;
+    if (!readSheetHeader(pData, nSize, &header) || !findSheetFrame(pData, header, pszName, &record))
+    {
+        return NULL;
+    }
+    CCSpriteFrame* spriteFrame = newSpriteFrameWithRecord(record, pobTexture);
+    spriteFrame->autorelease();
+    return spriteFrame;
+}
+
+bool CCSpriteFrameCache::isBinarySheet(const char *pszFile)
+{
+    size_t len = strlen(pszFile);
+    size_t extLen = strlen(CC_SPRITE_SHEET_EXTENSION);
+    return len > extLen && strcasecmp(pszFile + len - extLen, CC_SPRITE_SHEET_EXTENSION) == 0;
+}
+
+void CCSpriteFrameCache::addSpriteFramesWithBinaryData(const char *pszSheet, const unsigned char* pData, size_t nSize, CCTexture2D *pobTexture)
+{
+    if (m_pLoadedFileNames->find(pszSheet) != m_pLoadedFileNames->end())
+    {
+        return;//We already added it
+    }
+    
+    if (addSpriteFramesWithBinaryData(pData, nSize, pobTexture))
+    {
+        m_pLoadedFileNames->insert(pszSheet);
+    }
+    else
+    {
+        CCLOG("cocos2d: CCSpriteFrameCache: %s is not a valid compiled sheet", pszSheet);
+    }
+}
+
+void CCSpriteFrameCache::addSpriteFramesWithBinaryData(const char *pszSheet, const unsigned char* pData, size_t nSize)
+{
+    CCAssert(pszSheet, "sheet filename should not be NULL");
+    
+    if (m_pLoadedFileNames->find(pszSheet) != m_pLoadedFileNames->end())
+    {
+        return;//We already added it
+    }
+    
+    ccSpriteSheetHeader header;
+    if (!readSheetHeader(pData, nSize, &header))
+    {
+        CCLOG("cocos2d: CCSpriteFrameCache: %s is not a valid compiled sheet", pszSheet);
+        return;
+    }
+    
+    // texture name is a string in pool
+    string textureFileName("");
+    if (header.textureName != CC_SPRITE_SHEET_NO_STRING && header.textureName < header.stringPoolSize)
+    {
+        textureFileName = (const char*)(pData + nSize - header.stringPoolSize + header.textureName);
+    }
+    string texturePath = texturePathForSheet(pszSheet, textureFileName);
+    
+    CCTexture2D *pTexture = CCTextureCache::sharedTextureCache()->addImage(texturePath.c_str());
+    if (pTexture)
+    {
+        addSpriteFramesWithBinaryData(pszSheet, pData, nSize, pTexture);
+    }
+    else
+    {
+        CCLOG("cocos2d: CCSpriteFrameCache: Couldn't load texture");
+    }
+}
+
 void CCSpriteFrameCache::addSpriteFramesWithFile(const char *pszPlist, CCTexture2D *pobTexture)
 {
     if (m_pLoadedFileNames->find(pszPlist) != m_pLoadedFileNames->end())
     {
         return;//We already added it
     }
+    
+    // compiled sheet is read in place
+    if (isBinarySheet(pszPlist))
+    {
+        CCFileView* pView = CCFileUtils::sharedFileUtils()->openFileView(pszPlist);
+        if (pView)
+        {
+            addSpriteFramesWithBinaryData(pszPlist, pView->getBytes(), pView->getSize(), pobTexture);
+            pView->release();
+        }
+        return;
+    }
+    
     std::string fullPath = CCFileUtils::sharedFileUtils()->fullPathForFilename(pszPlist);
     CCDictionary *dict = CCDictionary::createWithContentsOfFileThreadSafe(fullPath.c_str());
 
-    addSpriteFramesWithDictionary(dict, pobTexture);
-    m_pLoadedFileNames->insert(pszPlist);
+    addSpriteFramesWithFile(pszPlist, dict, pobTexture);
 
     CC_SAFE_RELEASE(dict);
 }
 
+void CCSpriteFrameCache::addSpriteFramesWithFile(const char *pszPlist, CCDictionary *dict, CCTexture2D *pobTexture)
+{
+    if (m_pLoadedFileNames->find(pszPlist) != m_pLoadedFileNames->end())
+    {
+        return;//We already added it
+    }
+
+    addSpriteFramesWithDictionary(dict, pobTexture);
+    m_pLoadedFileNames->insert(pszPlist);
+}
+
 void CCSpriteFrameCache::addSpriteFramesWithFile(const char* plist, const char* textureFileName)
 {
     CCAssert(textureFileName, "texture name should not be null");
@@ -237,37 +536,42 @@ void CCSpriteFrameCache::addSpriteFramesWithFile(const char *pszPlist)
 
     if (m_pLoadedFileNames->find(pszPlist) == m_pLoadedFileNames->end())
     {
+        // compiled sheet is read in place
+        if (isBinarySheet(pszPlist))
+        {
+            CCFileView* pView = CCFileUtils::sharedFileUtils()->openFileView(pszPlist);
+            if (pView)
+            {
+                addSpriteFramesWithBinaryData(pszPlist, pView->getBytes(), pView->getSize());
+                pView->release();
+            }
+            return;
+        }
+        
         std::string fullPath = CCFileUtils::sharedFileUtils()->fullPathForFilename(pszPlist);
         CCDictionary *dict = CCDictionary::createWithContentsOfFileThreadSafe(fullPath.c_str());
 
-        string texturePath("");
+        addSpriteFramesWithFile(pszPlist, dict);
+
+        CC_SAFE_RELEASE(dict);
+    }
+}
+
+void CCSpriteFrameCache::addSpriteFramesWithFile(const char *pszPlist, CCDictionary *dict)
+{
+    CCAssert(pszPlist, "plist filename should not be NULL");
+
+    if (m_pLoadedFileNames->find(pszPlist) == m_pLoadedFileNames->end())
+    {
+        string textureFileName("");
 
         CCDictionary* metadataDict = (CCDictionary*)dict->objectForKey("metadata");
         if (metadataDict)
         {
             // try to read  texture file name from meta data
-            texturePath = metadataDict->valueForKey("textureFileName")->getCString();
-        }
-
-        if (! texturePath.empty())
-        {
-            // build texture path relative to plist file
-            texturePath = CCFileUtils::sharedFileUtils()->fullPathFromRelativeFile(texturePath.c_str(), pszPlist);
-        }
-        else
-        {
-            // build texture path by replacing file extension
-            texturePath = pszPlist;
-
-            // remove .xxx
-            size_t startPos = texturePath.find_last_of("."); 
-            texturePath = texturePath.erase(startPos);
-
-            // append .png
-            texturePath = texturePath.append(".png");
-
-            CCLOG("cocos2d: CCSpriteFrameCache: Trying to use file %s as texture", texturePath.c_str());
+            textureFileName = metadataDict->valueForKey("textureFileName")->getCString();
         }
+        string texturePath = texturePathForSheet(pszPlist, textureFileName);
 
         CCTexture2D *pTexture = CCTextureCache::sharedTextureCache()->addImage(texturePath.c_str());
 
@@ -280,10 +584,7 @@ void CCSpriteFrameCache::addSpriteFramesWithFile(const char *pszPlist)
         {
             CCLOG("cocos2d: CCSpriteFrameCache: Couldn't load texture");
         }
-
-        CC_SAFE_RELEASE(dict);
     }
-
 }
 
 void CCSpriteFrameCache::addSpriteFrame(CCSpriteFrame *pobFrame, const char *pszFrameName)
@@ -348,6 +649,29 @@ void CCSpriteFrameCache::removeSpriteFrameByName(const char *pszName)
 
 void CCSpriteFrameCache::removeSpriteFramesFromFile(const char* plist)
 {
+    if (isBinarySheet(plist))
+    {
+        CCFileView* pView = CCFileUtils::sharedFileUtils()->openFileView(plist);
+        ccSpriteSheetHeader header;
+        if (pView && readSheetHeader(pView->getBytes(), pView->getSize(), &header))
+        {
+            const unsigned char* pFrames = pView->getBytes() + sizeof(ccSpriteSheetHeader);
+            const char* pStrings = (const char*)(pView->getBytes() + pView->getSize() - header.stringPoolSize);
+            ccSpriteSheetFrame record;
+            for (uint32_t i = 0; i < header.frameCount; i++)
+            {
+                memcpy(&record, pFrames + i * sizeof(ccSpriteSheetFrame), sizeof(ccSpriteSheetFrame));
+                if (record.name < header.stringPoolSize)
+                {
+                    m_pSpriteFrames->removeObjectForKey(pStrings + record.name);
+                }
+            }
+        }
+        CC_SAFE_RELEASE(pView);
+        m_pLoadedFileNames->erase(plist);
+        return;
+    }
+    
     std::string fullPath = CCFileUtils::sharedFileUtils()->fullPathForFilename(plist);
     CCDictionary* dict = CCDictionary::createWithContentsOfFileThreadSafe(fullPath.c_str());
 
@@ -75,10 +75,19 @@ private:
     /*Adds multiple Sprite Frames with a dictionary. The texture will be associated with the created sprite frames.
      */
     void addSpriteFramesWithDictionary(CCDictionary* pobDictionary, CCTexture2D *pobTexture);
+
+    /* Adds multiple Sprite Frames from compiled sheet data, returns false if data is corrupted.
+     */
+    bool addSpriteFramesWithBinaryData(const unsigned char* pData, size_t nSize, CCTexture2D *pobTexture);
+
+    /* Gets texture path of a sheet, from the name in sheet or by replacing sheet extension with .png
+     */
+    std::string texturePathForSheet(const char *pszSheet, const std::string& textureFileName);
 public:
     /** Adds multiple Sprite Frames from a plist file.
      * A texture will be loaded automatically. The texture name will composed by replacing the .plist suffix with .png
      * If you want to use another texture, you should use the addSpriteFramesWithFile:texture method.
+     * A compiled sheet (.ccsf) is also accepted where a plist file is accepted, see CCSpriteSheetFormat.h
      * @js addSpriteFrames
      */
     void addSpriteFramesWithFile(const char *pszPlist);
@@ -94,6 +103,53 @@ public:
      */
     void addSpriteFramesWithFile(const char *pszPlist, CCTexture2D *pobTexture);
 
+    /** Adds multiple Sprite Frames from a plist file which is already parsed into a dictionary, for
+     * example by a loading thread. The texture is loaded the same way as addSpriteFramesWithFile(const char*)
+     * @since v2.2
+     * @js NA
+     * @lua NA
+     */
+    void addSpriteFramesWithFile(const char *pszPlist, CCDictionary *dict);
+
+    /** Adds multiple Sprite Frames from a plist file which is already parsed into a dictionary.
+     * The texture will be associated with the created sprite frames.
+     * @since v2.2
+     * @js NA
+     * @lua NA
+     */
+    void addSpriteFramesWithFile(const char *pszPlist, CCDictionary *dict, CCTexture2D *pobTexture);
+
+    /** Adds multiple Sprite Frames from compiled sheet data, for example a file view opened by a
+     * loading thread. The texture is loaded the same way as addSpriteFramesWithFile(const char*)
+     * @param pszSheet name of compiled sheet, used to find texture and to skip a loaded sheet
+     * @param pData sheet content, it is not referenced after return
+     * @since v2.2
+     * @js NA
+     * @lua NA
+     */
+    void addSpriteFramesWithBinaryData(const char *pszSheet, const unsigned char* pData, size_t nSize);
+
+    /** Adds multiple Sprite Frames from compiled sheet data. The texture will be associated with the created sprite frames.
+     * @since v2.2
+     * @js NA
+     * @lua NA
+     */
+    void addSpriteFramesWithBinaryData(const char *pszSheet, const unsigned char* pData, size_t nSize, CCTexture2D *pobTexture);
+
+    /** Checks whether a file is a compiled sheet, by its extension
+     * @since v2.2
+     */
+    static bool isBinarySheet(const char *pszFile);
+
+    /** Creates one sprite frame of compiled sheet data without adding the sheet to cache. Frame is
+     * found by binary search of name hash, an alias name is accepted too.
+     * @return autoreleased frame, or NULL if name is not in sheet or data is corrupted
+     * @since v2.2
+     * @js NA
+     * @lua NA
+     */
+    static CCSpriteFrame* spriteFrameWithBinaryData(const unsigned char* pData, size_t nSize, const char *pszName, CCTexture2D *pobTexture);
+
     /** Adds an sprite frame with a given name.
      If the name already exists, then the contents of the old name will be replaced with the new one.
      */
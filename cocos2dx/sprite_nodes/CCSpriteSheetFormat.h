@@ -0,0 +1,139 @@
+/****************************************************************************
+ Author: Luma (stubma@gmail.com)
+
+ https://github.com/stubma/cocos2dx-classical
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#ifndef __CCSpriteSheetFormat_h__
+#define __CCSpriteSheetFormat_h__
+
+#include "platform/CCPlatformMacros.h"
+#include <stdint.h>
+
+NS_CC_BEGIN
+
+/**
+ * @addtogroup sprite_nodes
+ * @{
+ */
+
+/*
+ * Compiled sprite sheet (.ccsf), converted from zwoptex/TexturePacker plist by
+ * tools/ccsf/plist2ccsf.py. All fields are little endian, file layout is:
+ *
+ *   ccSpriteSheetHeader
+ *   ccSpriteSheetFrame[frameCount], sorted by name hash
+ *   ccSpriteSheetAlias[aliasCount], sorted by name hash
+ *   string pool, NUL terminated utf-8 strings, referred by byte offset
+ *
+ * Rect, offset and source size are final values passed to CCSpriteFrame, so loader
+ * doesn't need to know which plist format the sheet came from. Names with same hash are
+ * adjacent, so one frame can be found by binary search of hash. Records are not
+ * guaranteed to be aligned, for example in a stored zip entry, so read them by memcpy.
+ */
+
+/// magic of compiled sprite sheet
+#define CC_SPRITE_SHEET_MAGIC "CCSF"
+
+/// current version of compiled sprite sheet
+#define CC_SPRITE_SHEET_VERSION 1
+
+/// file extension of compiled sprite sheet
+#define CC_SPRITE_SHEET_EXTENSION ".ccsf"
+
+/// string offset which means no string
+#define CC_SPRITE_SHEET_NO_STRING 0xffffffff
+
+/// frame flag, texture rect is rotated
+#define CC_SPRITE_SHEET_FRAME_ROTATED 0x1
+
+/// header of compiled sprite sheet
+typedef struct _ccSpriteSheetHeader {
+    /// CC_SPRITE_SHEET_MAGIC
+    char magic[4];
+
+    /// CC_SPRITE_SHEET_VERSION
+    uint16_t version;
+
+    /// reserved, zero
+    uint16_t flags;
+
+    /// count of frame records
+    uint32_t frameCount;
+
+    /// count of alias records
+    uint32_t aliasCount;
+
+    /// texture file name relative to sheet, or CC_SPRITE_SHEET_NO_STRING
+    uint32_t textureName;
+
+    /// byte size of string pool
+    uint32_t stringPoolSize;
+} ccSpriteSheetHeader;
+
+/// frame record
+typedef struct _ccSpriteSheetFrame {
+    /// ccSpriteSheetHashName of frame name
+    uint32_t hash;
+
+    /// offset of frame name in string pool
+    uint32_t name;
+
+    /// texture rect in pixels, x, y, width, height
+    float rect[4];
+
+    /// offset in pixels
+    float offset[2];
+
+    /// original size in pixels
+    float sourceSize[2];
+
+    /// CC_SPRITE_SHEET_FRAME_XXX flags
+    uint32_t flags;
+} ccSpriteSheetFrame;
+
+/// alias record
+typedef struct _ccSpriteSheetAlias {
+    /// ccSpriteSheetHashName of alias name
+    uint32_t hash;
+
+    /// offset of alias name in string pool
+    uint32_t name;
+
+    /// index of frame record
+    uint32_t frame;
+} ccSpriteSheetAlias;
+
+/// name hash of compiled sprite sheet, 32 bits FNV-1a of utf-8 bytes
+static inline uint32_t ccSpriteSheetHashName(const char* name) {
+    uint32_t h = 2166136261u;
+    for(const unsigned char* p = (const unsigned char*)name; *p; p++) {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// end of sprite_nodes group
+/// @}
+
+NS_CC_END
+
+#endif // __CCSpriteSheetFormat_h__
@@ -1176,6 +1176,28 @@ unsigned short* cc_utf8_to_utf16(const char* utf8, int* outUTF16CharacterCount /
     return ret;
 }
 
+int cc_utf8_to_utf16_buffer(const char* utf8, std::vector<unsigned short>& utf16)
+{
+    size_t utf8Len = utf8 ? strlen(utf8) : 0;
+    
+    // one utf16 unit at most for each utf8 byte
+    if (utf16.size() < utf8Len + 1)
+    {
+        utf16.resize(utf8Len + 1);
+    }
+    
+    const UTF8* sourceStart = reinterpret_cast<const UTF8*>(utf8);
+    UTF16* targetStart = &utf16[0];
+    if (utf8Len > 0 &&
+        ConvertUTF8toUTF16(&sourceStart, sourceStart + utf8Len, &targetStart, targetStart + utf8Len, strictConversion) != conversionOK)
+    {
+        utf16[0] = 0;
+        return -1;
+    }
+    *targetStart = 0;
+    return static_cast<int>(targetStart - &utf16[0]);
+}
+
 char * cc_utf16_to_utf8(const unsigned short* utf16, int* outUTF8CharacterCount /*= NULL*/)
 {
     if (utf16 == NULL)
@@ -97,6 +97,18 @@ CC_DLL std::vector<unsigned short> cc_utf16_vec_from_utf16_str(const unsigned sh
  * */
 CC_DLL unsigned short* cc_utf8_to_utf16(const char* utf8, int* outUTF16CharacterCount = NULL);
 
+/**
+ * Converts an utf8 string into a caller owned buffer. The result will be null terminated.
+ * The buffer only grows, so converting strings of similar length again doesn't allocate memory.
+ *
+ * @param utf8 pointer to the start of a C string. It must be an NULL terminal UTF8 string.
+ * @param utf16 buffer to receive UTF16 string
+ *
+ * @returns the character count of UTF16 string, or -1 if an error occurs.
+ * @since v2.2
+ * */
+CC_DLL int cc_utf8_to_utf16_buffer(const char* utf8, std::vector<unsigned short>& utf16);
+
 /**
  * Converts a string from UTF-16 to UTF-8. The result will be null terminated.
  *
@@ -24,6 +24,7 @@
 #include "CCFileDownloader.h"
 #include "support/utils/CCUtils.h"
 #include "CCNotificationCenter.h"
+#include "platform/CCFileUtils.h"
 
 NS_CC_BEGIN
 
@@ -179,8 +180,11 @@ void CCFileDownloader::onHttpDone(CCHttpResponse* response) {
         m_failedEntries.addObject(m_entry);
     }
     
-    // close stream
+    // close stream, downloaded file may be a name which was not found before
     CC_SAFE_RELEASE_NULL(m_fos);
+    if(response->isSuccess()) {
+        CCFileUtils::sharedFileUtils()->purgeMissingFileCache();
+    }
     m_entry = NULL;
     
     // remove first entry
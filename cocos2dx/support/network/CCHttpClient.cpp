@@ -24,382 +24,444 @@
  ****************************************************************************/
 
 #include "CCHttpClient.h"
-#include <queue>
+#include <set>
 #include <errno.h>
+#include <unistd.h>
 #include "curl/curl.h"
 #include <pthread.h>
 #include "cocoa/CCData.h"
 #include "CCDirector.h"
+#include "CCConfiguration.h"
 #include "CCNotificationCenter.h"
 #include "CCScheduler.h"
+#include "support/profile/CCProfiling.h"
 
 using namespace std;
 
 NS_CC_BEGIN
 
-class CURLHandler;
+// max number of http threads
+#define kCCHttpMaxWorkers 8
+
+// default number of http threads
+#define kCCHttpDefaultWorkers 4
 
 /// context info
 typedef struct {
     CCHttpRequest* request;
     CCHttpResponse* response;
-    CURLHandler* curl;
+    
+    /// client which executes it, set to NULL when client is released
+    CCHttpClient* client;
+    
     float connectTimeout;
     float readTimeout;
-} ccHttpContext;
-
-/// class which really perform http operation
-class CURLHandler : public CCObject {
-public:
-    /// Instance of CURL
-    CURL* m_curl;
     
-    /// Keeps custom header data
-    curl_slist* m_headers;
+    /// priority and sequence, they decide the order in queue
+    int priority;
+    unsigned int seq;
     
-    /// error buffer
-    char m_errorBuffer[CURL_ERROR_SIZE];
+    /// picked by a http thread
+    bool started;
     
-    /// context
-    ccHttpContext* m_ctx;
+    /// finished, succeeded or not
+    bool done;
     
-    /// response code
-    int32_t m_responseCode;
-    
-    /// mutex
-    pthread_mutex_t m_mutex;
+    /// is header all received?
+    bool headerReceived;
     
-    /// done flag
-    bool m_done;
+    /// is kCCNotificationHttpDidReceiveResponse delivered?
+    bool headerDelivered;
     
     /// undelivered data
-    CCData* m_data;
-    
-    /// is kCCNotificationHttpDidReceiveResponse delivered?
-    bool isHttpDidReceiveResponseDelivered;
+    CCData* data;
     
-    /// is header all received?
-    bool isHeaderAllReceived;
+    /// response code
+    long responseCode;
     
-public:
-    CURLHandler(ccHttpContext* ctx) :
-    m_ctx(NULL),
-    m_curl(NULL),
-    m_done(false),
-    m_responseCode(500),
-    isHttpDidReceiveResponseDelivered(false),
-    isHeaderAllReceived(false),
-    m_headers(NULL) {
-        // data
-        m_data = new CCData();
-        m_ctx = (ccHttpContext*)calloc(1, sizeof(ccHttpContext));
-        memcpy(m_ctx, ctx, sizeof(ccHttpContext));
-        
-        // create mutex
-        pthread_mutexattr_t attr;
-        pthread_mutexattr_init(&attr);
-        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
-        pthread_mutex_init(&m_mutex, &attr);
-        pthread_mutexattr_destroy(&attr);
-        
-        // schedule event dispatch
-        CCDirector::sharedDirector()->getScheduler()->scheduleSelector(schedule_selector(CURLHandler::dispatchNotification), this, 0, kCCRepeatForever, 0, false);
+    /// error buffer
+    char errorBuffer[CURL_ERROR_SIZE];
+} ccHttpContext;
+
+struct ccHttpContextLess {
+    bool operator()(const ccHttpContext* a, const ccHttpContext* b) const {
+        if(a->priority != b->priority)
+            return a->priority > b->priority;
+        return a->seq < b->seq;
     }
+};
+
+/// post notifications of all requests once per frame
+class CCHttpDispatcher : public CCObject {
+public:
+    void dispatch(float delta);
+};
+
+static pthread_t s_httpThreads[kCCHttpMaxWorkers];
+static int s_nHttpThreads = 0;
+static int s_nMaxHttpThreads = 0;
+
+/// http threads waiting for request
+static int s_nIdleHttpThreads = 0;
+
+/// protects everything below and all contexts
+static pthread_mutex_t s_httpMutex;
+static pthread_cond_t s_httpCondition;
+
+/// requests waiting for a http thread
+static multiset<ccHttpContext*, ccHttpContextLess>* s_pHttpQueue = NULL;
+
+/// all requests whose completion is not delivered yet
+static vector<ccHttpContext*>* s_pHttpContexts = NULL;
+
+static unsigned int s_uHttpSeq = 0;
+
+/// dns cache and ssl sessions shared by curl handles of all threads
+static CURLSH* s_pCurlShare = NULL;
+static pthread_mutex_t s_curlShareMutex[CURL_LOCK_DATA_LAST];
+
+/// dispatcher, only accessed in main thread
+static CCHttpDispatcher* s_pHttpDispatcher = NULL;
+static bool s_bHttpDispatcherScheduled = false;
+
+static void lockCurlShare(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr) {
+    pthread_mutex_lock(&s_curlShareMutex[data]);
+}
+
+static void unlockCurlShare(CURL* handle, curl_lock_data data, void* userptr) {
+    pthread_mutex_unlock(&s_curlShareMutex[data]);
+}
+
+static void initHttpEngine() {
+    if(s_pHttpQueue)
+        return;
     
-    virtual ~CURLHandler() {
-        if(m_curl)
-            curl_easy_cleanup(m_curl);
-        if(m_headers)
-            curl_slist_free_all(m_headers);
-        CC_SAFE_RELEASE(m_ctx->request);
-        CC_SAFE_RELEASE(m_ctx->response);
-        CC_SAFE_FREE(m_ctx);
-        CC_SAFE_RELEASE(m_data);
-        pthread_mutex_destroy(&m_mutex);
-    }
+    // curl global init is not thread safe, do it before any thread creates a handle
+    curl_global_init(CURL_GLOBAL_ALL);
     
-    /// Callback function used by libcurl for collect response data
-    static size_t writeData(void* ptr, size_t size, size_t nmemb, void* userdata) {
-        CURLHandler* handler = (CURLHandler*)userdata;
-        size_t sizes = size * nmemb;
-        
-        // add data to the end of recvBuffer
-        pthread_mutex_lock(&handler->m_mutex);
-        handler->m_data->appendBytes((uint8_t*)ptr, sizes);
-        handler->isHeaderAllReceived = true;
-        pthread_mutex_unlock(&handler->m_mutex);
-        
-        // return a value which is different with sizes will abort it
-        if(handler->m_ctx->request->isCancel())
-            return sizes + 1;
-        else
-            return sizes;
+    for(int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_init(&s_curlShareMutex[i], NULL);
+    }
+    s_pCurlShare = curl_share_init();
+    if(s_pCurlShare) {
+        curl_share_setopt(s_pCurlShare, CURLSHOPT_LOCKFUNC, lockCurlShare);
+        curl_share_setopt(s_pCurlShare, CURLSHOPT_UNLOCKFUNC, unlockCurlShare);
+        curl_share_setopt(s_pCurlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(s_pCurlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
     }
     
-    /// Callback function used by libcurl for collect header data
-    static size_t writeHeaderData(void* ptr, size_t size, size_t nmemb, void* userdata) {
-        CURLHandler* handler = (CURLHandler*)userdata;
-        size_t sizes = size * nmemb;
-        
-        // lock
-        pthread_mutex_lock(&handler->m_mutex);
-        
-        // parse pair
-        string header((const char*)ptr, sizes);
-        CCArray* pair = new CCArray();
-        if(!header.empty()) {
-            // remove head and tailing brace, bracket, parentheses
-            size_t start = 0;
-            size_t end = header.length() - 1;
-            char c = header[start];
-            while(c == '{' || c == '[' || c == '(') {
-                start++;
-                c = header[start];
-            }
+    pthread_mutex_init(&s_httpMutex, NULL);
+    pthread_cond_init(&s_httpCondition, NULL);
+    s_pHttpQueue = new multiset<ccHttpContext*, ccHttpContextLess>();
+    s_pHttpContexts = new vector<ccHttpContext*>();
+    
+    int workers = (int)CCConfiguration::sharedConfiguration()->getNumber("cocos2d.x.network.http_workers", kCCHttpDefaultWorkers);
+    s_nMaxHttpThreads = MIN(MAX(workers, 1), kCCHttpMaxWorkers);
+    
+    s_pHttpDispatcher = new CCHttpDispatcher();
+}
+
+static void releaseContext(ccHttpContext* ctx) {
+    CC_SAFE_RELEASE(ctx->request);
+    CC_SAFE_RELEASE(ctx->response);
+    CC_SAFE_RELEASE(ctx->data);
+    CC_SAFE_DELETE(ctx);
+}
+
+/// Callback function used by libcurl for collect response data
+static size_t writeData(void* ptr, size_t size, size_t nmemb, void* userdata) {
+    ccHttpContext* ctx = (ccHttpContext*)userdata;
+    size_t sizes = size * nmemb;
+    
+    // add data to the end of recvBuffer
+    pthread_mutex_lock(&s_httpMutex);
+    ctx->data->appendBytes((uint8_t*)ptr, sizes);
+    ctx->headerReceived = true;
+    pthread_mutex_unlock(&s_httpMutex);
+    
+    // return a value which is different with sizes will abort it
+    if(ctx->request->isCancel())
+        return sizes + 1;
+    else
+        return sizes;
+}
+
+/// Callback function used by libcurl for collect header data
+static size_t writeHeaderData(void* ptr, size_t size, size_t nmemb, void* userdata) {
+    ccHttpContext* ctx = (ccHttpContext*)userdata;
+    size_t sizes = size * nmemb;
+    
+    // parse pair
+    string header((const char*)ptr, sizes);
+    CCArray* pair = new CCArray();
+    if(!header.empty()) {
+        // remove head and tailing brace, bracket, parentheses
+        size_t start = 0;
+        size_t end = header.length() - 1;
+        char c = header[start];
+        while(c == '{' || c == '[' || c == '(') {
+            start++;
+            c = header[start];
+        }
+        c = header[end];
+        while(c == '}' || c == ']' || c == ')') {
+            end--;
             c = header[end];
-            while(c == '}' || c == ']' || c == ')') {
-                end--;
-                c = header[end];
-            }
-            
-            // iterate string
-            size_t compStart = start;
-            for(size_t i = start; i <= end; i++) {
-                c = header[i];
-                if(c == ':') {
-                    CCString* s = new CCString(header.substr(compStart, i - compStart));
-                    pair->addObject(s);
-                    CC_SAFE_RELEASE(s);
-                    compStart = i + 1;
-                } else if(c == ' ' || c == '\t' || c == '\r' || c == '\n') {
-                    if(compStart == i) {
-                        compStart++;
-                    }
-                }
-            }
-            
-            // last comp
-            // or, if last char is separator, append an empty string
-            if(compStart <= end) {
-                CCString* s = new CCString(header.substr(compStart, end - compStart + 1));
-                pair->addObject(s);
-                CC_SAFE_RELEASE(s);
-            } else if(header[end] == ':') {
-                CCString* s = new CCString("");
+        }
+        
+        // iterate string
+        size_t compStart = start;
+        for(size_t i = start; i <= end; i++) {
+            c = header[i];
+            if(c == ':') {
+                CCString* s = new CCString(header.substr(compStart, i - compStart));
                 pair->addObject(s);
                 CC_SAFE_RELEASE(s);
+                compStart = i + 1;
+            } else if(c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+                if(compStart == i) {
+                    compStart++;
+                }
             }
         }
         
-        // if pair count is two, means ok
-        if(pair->count() == 2) {
-            handler->m_ctx->response->addHeader(((CCString*)pair->objectAtIndex(0))->getCString(),
-                                                ((CCString*)pair->objectAtIndex(1))->getCString());
+        // last comp
+        // or, if last char is separator, append an empty string
+        if(compStart <= end) {
+            CCString* s = new CCString(header.substr(compStart, end - compStart + 1));
+            pair->addObject(s);
+            CC_SAFE_RELEASE(s);
+        } else if(header[end] == ':') {
+            CCString* s = new CCString("");
+            pair->addObject(s);
+            CC_SAFE_RELEASE(s);
         }
-        
-        // release array
-        CC_SAFE_RELEASE(pair);
-        
-        // unlock
-        pthread_mutex_unlock(&handler->m_mutex);
-        
-        // return a value which is different with sizes will abort it
-        if(handler->m_ctx->request->isCancel())
-            return sizes + 1;
-        else
-            return sizes;
     }
     
-    bool init() {
-        // check
-        m_curl = curl_easy_init();
-        if (!m_curl)
-            return false;
-        if (!configureCURL())
-            return false;
-        
-        /* get custom header data (if set) */
-       	const vector<string>& headers = m_ctx->request->getHeaders();
-        if(!headers.empty()) {
-            // append custom headers one by one
-            for (vector<string>::const_iterator it = headers.begin(); it != headers.end(); ++it)
-                m_headers = curl_slist_append(m_headers, it->c_str());
-            
-            // set custom headers for curl
-            if (curl_easy_setopt(m_curl, CURLOPT_HTTPHEADER, m_headers) != CURLE_OK)
-                return false;
-        }
-        
-        return curl_easy_setopt(m_curl, CURLOPT_URL, m_ctx->request->getUrl().c_str()) == CURLE_OK &&
-            curl_easy_setopt(m_curl, CURLOPT_WRITEFUNCTION, writeData) == CURLE_OK &&
-            curl_easy_setopt(m_curl, CURLOPT_WRITEDATA, this) == CURLE_OK &&
-            curl_easy_setopt(m_curl, CURLOPT_HEADERFUNCTION, writeHeaderData) == CURLE_OK &&
-            curl_easy_setopt(m_curl, CURLOPT_HEADERDATA, this) == CURLE_OK;
+    // if pair count is two, means ok
+    if(pair->count() == 2) {
+        pthread_mutex_lock(&s_httpMutex);
+        ctx->response->addHeader(((CCString*)pair->objectAtIndex(0))->getCString(),
+                                 ((CCString*)pair->objectAtIndex(1))->getCString());
+        pthread_mutex_unlock(&s_httpMutex);
     }
     
-    bool configureCURL() {
-        if(curl_easy_setopt(m_curl, CURLOPT_ERRORBUFFER, m_errorBuffer) != CURLE_OK) {
-            return false;
-        }
-        if(curl_easy_setopt(m_curl, CURLOPT_TIMEOUT, m_ctx->readTimeout) != CURLE_OK) {
-            return false;
-        }
-        if(curl_easy_setopt(m_curl, CURLOPT_CONNECTTIMEOUT, m_ctx->connectTimeout) != CURLE_OK) {
-            return false;
-        }
-        curl_easy_setopt(m_curl, CURLOPT_SSL_VERIFYPEER, 0L);
-        curl_easy_setopt(m_curl, CURLOPT_SSL_VERIFYHOST, 0L);
-        
-        // FIXED #3224: The subthread of CCHttpClient interrupts main thread if timeout comes.
-        // Document is here: http://curl.haxx.se/libcurl/c/curl_easy_setopt.html#CURLOPTNOSIGNAL
-        curl_easy_setopt(m_curl, CURLOPT_NOSIGNAL, 1L);
-        
-        return true;
-    }
+    // release array
+    CC_SAFE_RELEASE(pair);
     
-    bool processGetTask() {
-        curl_easy_setopt(m_curl, CURLOPT_FOLLOWLOCATION, true);
-        return perform();
-    }
+    // return a value which is different with sizes will abort it
+    if(ctx->request->isCancel())
+        return sizes + 1;
+    else
+        return sizes;
+}
+
+/// Callback function used by libcurl to abort a stalled request when it is cancelled
+static int progress(void* userdata, double dltotal, double dlnow, double ultotal, double ulnow) {
+    ccHttpContext* ctx = (ccHttpContext*)userdata;
+    return ctx->request->isCancel() ? 1 : 0;
+}
+
+static bool configureCURL(CURL* curl, ccHttpContext* ctx, curl_slist** headers) {
+    // handle is reused, reset options but keep connections and caches
+    curl_easy_reset(curl);
     
-    bool processPostTask() {
-        curl_easy_setopt(m_curl, CURLOPT_POST, 1);
-        CCData* data = m_ctx->request->getRequestData();
-        if(data) {
-            curl_easy_setopt(m_curl, CURLOPT_POSTFIELDS, data->getBytes());
-            curl_easy_setopt(m_curl, CURLOPT_POSTFIELDSIZE, data->getSize());
-        }
-        return perform();
+    if(s_pCurlShare)
+        curl_easy_setopt(curl, CURLOPT_SHARE, s_pCurlShare);
+    if(curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, ctx->errorBuffer) != CURLE_OK) {
+        return false;
     }
-    
-    bool processPutTask() {
-        curl_easy_setopt(m_curl, CURLOPT_CUSTOMREQUEST, "PUT");
-        CCData* data = m_ctx->request->getRequestData();
-        if(data) {
-            curl_easy_setopt(m_curl, CURLOPT_POSTFIELDS, data->getBytes());
-            curl_easy_setopt(m_curl, CURLOPT_POSTFIELDSIZE, data->getSize());
-        }
-
-        return perform();
+    if(curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, (long)(ctx->readTimeout * 1000)) != CURLE_OK) {
+        return false;
     }
-    
-    bool processDeleteTask() {
-        curl_easy_setopt(m_curl, CURLOPT_CUSTOMREQUEST, "DELETE");
-        curl_easy_setopt(m_curl, CURLOPT_FOLLOWLOCATION, true);
-        return perform();
+    if(curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, (long)(ctx->connectTimeout * 1000)) != CURLE_OK) {
+        return false;
     }
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
     
-    bool perform() {
-        // if easy perform not ok, return false
-        CURLcode code = curl_easy_perform(m_curl);
-        if (code != CURLE_OK) {
-            CCLOG("curl_easy_perform error: %d, request: %s", code, m_ctx->request->getUrl().c_str());
-            return false;
-        }
+    // FIXED #3224: The subthread of CCHttpClient interrupts main thread if timeout comes.
+    // Document is here: http://curl.haxx.se/libcurl/c/curl_easy_setopt.html#CURLOPTNOSIGNAL
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    
+    /* get custom header data (if set) */
+    const vector<string>& h = ctx->request->getHeaders();
+    if(!h.empty()) {
+        // append custom headers one by one
+        for (vector<string>::const_iterator it = h.begin(); it != h.end(); ++it)
+            *headers = curl_slist_append(*headers, it->c_str());
         
-        // get return code
-        code = curl_easy_getinfo(m_curl, CURLINFO_RESPONSE_CODE, &m_responseCode);
-        if (code != CURLE_OK || m_responseCode != 200)
+        // set custom headers for curl
+        if (curl_easy_setopt(curl, CURLOPT_HTTPHEADER, *headers) != CURLE_OK)
+            return false;
+    }
+    
+    return curl_easy_setopt(curl, CURLOPT_URL, ctx->request->getUrl().c_str()) == CURLE_OK &&
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeData) == CURLE_OK &&
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, ctx) == CURLE_OK &&
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, writeHeaderData) == CURLE_OK &&
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, ctx) == CURLE_OK &&
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L) == CURLE_OK &&
+        curl_easy_setopt(curl, CURLOPT_PROGRESSFUNCTION, progress) == CURLE_OK &&
+        curl_easy_setopt(curl, CURLOPT_PROGRESSDATA, ctx) == CURLE_OK;
+}
+
+static bool perform(CURL* curl, ccHttpContext* ctx) {
+    // set method
+    CCData* data = ctx->request->getRequestData();
+    switch (ctx->request->getMethod()) {
+        case kHttpGet:
+            curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+            break;
+        case kHttpPost:
+            curl_easy_setopt(curl, CURLOPT_POST, 1L);
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data ? (const char*)data->getBytes() : "");
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, data ? (long)data->getSize() : 0L);
+            break;
+        case kHttpPut:
+            curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data ? (const char*)data->getBytes() : "");
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, data ? (long)data->getSize() : 0L);
+            break;
+        case kHttpDelete:
+            curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "DELETE");
+            curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+            break;
+        default:
+            CCAssert(false, "CCHttpClient: unkown request type, only GET, POST, PUT and DELETE are supported");
             return false;
-        
-        return true;
     }
     
-    /// called when request is done
-    void onRequestDone() {
-        pthread_mutex_lock(&m_mutex);
-        m_done = true;
-        pthread_mutex_unlock(&m_mutex);
+    // if easy perform not ok, return false
+    CURLcode code = curl_easy_perform(curl);
+    if (code != CURLE_OK) {
+        CCLOG("curl_easy_perform error: %d, request: %s", code, ctx->request->getUrl().c_str());
+        return false;
     }
     
-    /// dispatch end notification
-    void dispatchNotification(float delta) {
-        // notification center
-        CCNotificationCenter* nc = CCNotificationCenter::sharedNotificationCenter();
-        
-        // check
-        pthread_mutex_lock(&m_mutex);
+    // get return code
+    code = curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &ctx->responseCode);
+    if (code != CURLE_OK || ctx->responseCode != 200)
+        return false;
+    
+    return true;
+}
+
+void CCHttpDispatcher::dispatch(float delta) {
+    typedef struct {
+        ccHttpContext* ctx;
+        const char* name;
+        CCData* data;
+    } ccHttpEvent;
+    
+    // collect events under lock, observers may execute new requests so post them after unlock
+    vector<ccHttpEvent> events;
+    vector<ccHttpContext*> finished;
+    pthread_mutex_lock(&s_httpMutex);
+    for(vector<ccHttpContext*>::iterator iter = s_pHttpContexts->begin(); iter != s_pHttpContexts->end();) {
+        ccHttpContext* ctx = *iter;
         
         // header notification
-        if(!isHttpDidReceiveResponseDelivered && isHeaderAllReceived) {
-            isHttpDidReceiveResponseDelivered = true;
-            nc->postNotification(kCCNotificationHttpDidReceiveResponse, m_ctx->response);
+        if(!ctx->headerDelivered && ctx->headerReceived) {
+            ctx->headerDelivered = true;
+            ccHttpEvent e = { ctx, kCCNotificationHttpDidReceiveResponse, NULL };
+            events.push_back(e);
         }
         
-        // notification
-        if(m_data->getSize() > 0) {
-            m_ctx->response->setData(m_data);
-            nc->postNotification(kCCNotificationHttpDataReceived, m_ctx->response);
-            
-            // recreate a new data
-            CC_SAFE_RELEASE(m_data);
-            m_data = new CCData();
+        // data notification, data is taken out and a new one collects following data
+        if(ctx->data->getSize() > 0) {
+            ccHttpEvent e = { ctx, kCCNotificationHttpDataReceived, ctx->data };
+            events.push_back(e);
+            ctx->data = new CCData();
         }
         
         // is done?
-        if(m_done) {
-            // notification
-            nc->postNotification(kCCNotificationHttpRequestCompleted, m_ctx->response);
-            
-            // balance retain in httpThreadEntry
-            autorelease();
-            
-            // unschedule dispatcher
-            CCDirector::sharedDirector()->getScheduler()->unscheduleSelector(schedule_selector(CURLHandler::dispatchNotification), this);
+        if(ctx->done) {
+            ccHttpEvent e = { ctx, kCCNotificationHttpRequestCompleted, NULL };
+            events.push_back(e);
+            finished.push_back(ctx);
+            iter = s_pHttpContexts->erase(iter);
+        } else {
+            iter++;
         }
-        
-        pthread_mutex_unlock(&m_mutex);
     }
-};
+    pthread_mutex_unlock(&s_httpMutex);
+    
+    // post
+    CCNotificationCenter* nc = CCNotificationCenter::sharedNotificationCenter();
+    for(vector<ccHttpEvent>::iterator iter = events.begin(); iter != events.end(); iter++) {
+        CCHttpResponse* response = iter->ctx->response;
+        if(iter->data) {
+            response->setData(iter->data);
+            nc->postNotification(iter->name, response);
+            response->setData(NULL);
+            iter->data->release();
+        } else {
+            nc->postNotification(iter->name, response);
+        }
+    }
+    
+    // free finished
+    for(vector<ccHttpContext*>::iterator iter = finished.begin(); iter != finished.end(); iter++) {
+        releaseContext(*iter);
+    }
+    
+    // unschedule when nothing left
+    pthread_mutex_lock(&s_httpMutex);
+    bool idle = s_pHttpContexts->empty();
+    pthread_mutex_unlock(&s_httpMutex);
+    if(idle) {
+        CCDirector::sharedDirector()->getScheduler()->unscheduleSelector(schedule_selector(CCHttpDispatcher::dispatch), this);
+        s_bHttpDispatcherScheduled = false;
+    }
+}
 
 void* CCHttpClient::httpThreadEntry(void* arg) {
-    // handler, it is released if init failed or released in dispatchNotification
-    ccHttpContext* ctx = (ccHttpContext*)arg;
-    CURLHandler* curl = ctx->curl;
-    if(!curl->init()) {
-        CC_SAFE_RELEASE_NULL(curl);
-    }
+    CC_PROFILER_THREAD_NAME("http");
+    
+    // one handle for thread life, so its connections are kept alive between requests
+    CURL* curl = curl_easy_init();
     
-    if(curl) {
-        // create response
-        CCHttpResponse* response = new CCHttpResponse(curl->m_ctx->request);
-        curl->m_ctx->response = response;
+    pthread_mutex_lock(&s_httpMutex);
+    while(true) {
+        // wait request
+        s_nIdleHttpThreads++;
+        while(s_pHttpQueue->empty()) {
+            pthread_cond_wait(&s_httpCondition, &s_httpMutex);
+        }
+        s_nIdleHttpThreads--;
+        
+        // pop most important one
+        ccHttpContext* ctx = *s_pHttpQueue->begin();
+        s_pHttpQueue->erase(s_pHttpQueue->begin());
+        ctx->started = true;
+        pthread_mutex_unlock(&s_httpMutex);
         
         // process request
         bool retValue = false;
-        switch (curl->m_ctx->request->getMethod()) {
-            case kHttpGet:
-                retValue = curl->processGetTask();
-                break;
-            case kHttpPost:
-                retValue = curl->processPostTask();
-                break;
-            case kHttpPut:
-                retValue = curl->processPutTask();
-                break;
-            case kHttpDelete:
-                retValue = curl->processDeleteTask();
-                break;
-            default:
-                CCAssert(true, "CCHttpClient: unkown request type, only GET and POST are supported");
-                break;
+        curl_slist* headers = NULL;
+        {
+            CC_PROFILER_ZONE("CCHttpClient - request");
+            if(curl && configureCURL(curl, ctx, &headers)) {
+                retValue = perform(curl, ctx);
+            }
         }
+        if(headers)
+            curl_slist_free_all(headers);
         
         // save response
-        response->setResponseCode(curl->m_responseCode);
+        pthread_mutex_lock(&s_httpMutex);
+        ctx->response->setResponseCode((int)ctx->responseCode);
         if (retValue) {
-            response->setSuccess(true);
+            ctx->response->setSuccess(true);
         } else {
-            response->setSuccess(false);
-            response->setErrorData(curl->m_errorBuffer);
+            ctx->response->setSuccess(false);
+            ctx->response->setErrorData(ctx->errorBuffer);
         }
         
         // done
-        curl->onRequestDone();
+        ctx->done = true;
     }
-
-    // exit
-    pthread_exit(NULL);
     
     return NULL;
 }
@@ -410,12 +472,17 @@ m_readTimeout(60) {
 }
 
 CCHttpClient::~CCHttpClient() {
-    for(vector<void*>::iterator iter = m_activeContexts.begin(); iter != m_activeContexts.end(); iter++) {
-        ccHttpContext* ctx = (ccHttpContext*)*iter;
-        CC_SAFE_RELEASE(ctx->request);
-        CC_SAFE_FREE(ctx);
+    // requests go on without client
+    if(s_pHttpContexts) {
+        pthread_mutex_lock(&s_httpMutex);
+        for(vector<ccHttpContext*>::iterator iter = s_pHttpContexts->begin(); iter != s_pHttpContexts->end(); iter++) {
+            ccHttpContext* ctx = *iter;
+            if(ctx->client == this) {
+                ctx->client = NULL;
+            }
+        }
+        pthread_mutex_unlock(&s_httpMutex);
     }
-    m_activeContexts.clear();
 }
 
 CCHttpClient* CCHttpClient::create() {
@@ -436,39 +503,83 @@ void CCHttpClient::asyncExecute(CCHttpRequest* request) {
         return;
     }
     
+    // lazy init
+    initHttpEngine();
+    
     // create context
-    ccHttpContext* ctx = (ccHttpContext*)calloc(1, sizeof(ccHttpContext));
+    ccHttpContext* ctx = new ccHttpContext();
+    memset(ctx, 0, sizeof(ccHttpContext));
     ctx->request = request;
+    ctx->response = new CCHttpResponse(request);
+    ctx->client = this;
     ctx->connectTimeout = m_connectTimeout;
     ctx->readTimeout = m_readTimeout;
-    ctx->curl = new CURLHandler(ctx);
-    CC_SAFE_RETAIN(request); // release in CURLHandler
-    CC_SAFE_RETAIN(request); // release in this
+    ctx->priority = request->getPriority();
+    ctx->responseCode = 500;
+    ctx->data = new CCData();
+    CC_SAFE_RETAIN(request);
     
-    // add to cache and clear useless context
-    m_activeContexts.push_back(ctx);
+    // queue it, start a new thread if all are busy
+    pthread_mutex_lock(&s_httpMutex);
+    ctx->seq = s_uHttpSeq++;
+    s_pHttpQueue->insert(ctx);
+    s_pHttpContexts->push_back(ctx);
+    if(s_nIdleHttpThreads < (int)s_pHttpQueue->size() && s_nHttpThreads < s_nMaxHttpThreads) {
+        if(pthread_create(&s_httpThreads[s_nHttpThreads], NULL, httpThreadEntry, NULL) == 0) {
+            pthread_detach(s_httpThreads[s_nHttpThreads]);
+            s_nHttpThreads++;
+        }
+    }
+    pthread_cond_signal(&s_httpCondition);
+    pthread_mutex_unlock(&s_httpMutex);
+    
+    // schedule event dispatch
+    if(!s_bHttpDispatcherScheduled) {
+        CCDirector::sharedDirector()->getScheduler()->scheduleSelector(schedule_selector(CCHttpDispatcher::dispatch), s_pHttpDispatcher, 0, kCCRepeatForever, 0, false);
+        s_bHttpDispatcherScheduled = true;
+    }
+}
 
-    // start network thread
-    pthread_t thread;
-    pthread_create(&thread, NULL, httpThreadEntry, ctx);
-    pthread_detach(thread);
+/// cancel a context, must be called with lock
+static void cancelContext(ccHttpContext* ctx) {
+    ctx->request->setCancel(true);
+    
+    // not started yet, finish it here
+    if(!ctx->started && !ctx->done) {
+        s_pHttpQueue->erase(ctx);
+        ctx->response->setSuccess(false);
+        char msg[] = "cancelled";
+        ctx->response->setErrorData(msg);
+        ctx->done = true;
+    }
 }
 
 void CCHttpClient::cancel(int tag) {
-    for(vector<void*>::iterator iter = m_activeContexts.begin(); iter != m_activeContexts.end(); iter++) {
-        ccHttpContext* ctx = (ccHttpContext*)*iter;
-        if(ctx->request->getTag() == tag) {
-            ctx->request->setCancel(true);
-            break;
+    if(!s_pHttpContexts)
+        return;
+    
+    pthread_mutex_lock(&s_httpMutex);
+    for(vector<ccHttpContext*>::iterator iter = s_pHttpContexts->begin(); iter != s_pHttpContexts->end(); iter++) {
+        ccHttpContext* ctx = *iter;
+        if(ctx->client == this && ctx->request->getTag() == tag) {
+            cancelContext(ctx);
         }
     }
+    pthread_mutex_unlock(&s_httpMutex);
 }
 
 void CCHttpClient::cancelAll() {
-    for(vector<void*>::iterator iter = m_activeContexts.begin(); iter != m_activeContexts.end(); iter++) {
-        ccHttpContext* ctx = (ccHttpContext*)*iter;
-        ctx->request->setCancel(true);
+    if(!s_pHttpContexts)
+        return;
+    
+    pthread_mutex_lock(&s_httpMutex);
+    for(vector<ccHttpContext*>::iterator iter = s_pHttpContexts->begin(); iter != s_pHttpContexts->end(); iter++) {
+        ccHttpContext* ctx = *iter;
+        if(ctx->client == this) {
+            cancelContext(ctx);
+        }
     }
+    pthread_mutex_unlock(&s_httpMutex);
 }
 
-NS_CC_END
\ No newline at end of file
+NS_CC_END
@@ -53,6 +53,12 @@ NS_CC_BEGIN
  * You don't need hold a http client, the http request will be executed in a thread so retaining a client
  * instance or not doesn't matter.
  *
+ * \par
+ * Requests of all clients share a pool of http threads, bigger priority of request runs first. Every thread
+ * reuses one curl handle so keep-alive connections are reused, and dns cache and ssl sessions are shared by
+ * all threads. Size of pool is read from configuration key cocos2d.x.network.http_workers, 4 by default.
+ * Notifications of all requests are posted together once per frame in main thread.
+ *
  * \note
  * Using CB prefix to avoid name conflict, CB stands for cocos2dx-classical. When you see a class starts with CB,
  * you should know it is a rewriten class which is better than the original.
@@ -62,9 +68,6 @@ private:
     /// thread entry
     static void* httpThreadEntry(void* arg);
     
-    /// handler map, key is tag
-    vector<void*> m_activeContexts;
-    
 protected:
     CCHttpClient();
     
@@ -83,10 +86,14 @@ public:
      */
     void asyncExecute(CCHttpRequest* request);
     
-    /// cancel one request which has specified tag
+    /**
+     * cancel requests of this client which have specified tag. Waiting requests are removed from queue,
+     * running requests abort if possible. Cancelled requests still post kCCNotificationHttpRequestCompleted
+     * with success flag false
+     */
     void cancel(int tag);
     
-    /// stop all ongoing http operation
+    /// stop all ongoing http operation of this client
     void cancelAll();
   
     /// connect timeout
@@ -23,23 +23,43 @@
  ****************************************************************************/
 #include "CCMemory.h"
 #include <memory.h>
+#include <stdlib.h>
+#include <new>
+#include <typeinfo>
+#include <map>
+#include <algorithm>
 #include "platform/CCCommon.h"
 #include "cocoa/CCObject.h"
 #include "support/utils/CCUtils.h"
+#if (CC_TARGET_PLATFORM != CC_PLATFORM_WINRT) && (CC_TARGET_PLATFORM != CC_PLATFORM_WP8)
+#include <pthread.h>
+#else
+#include "CCPThreadWinRT.h"
+#endif
+#ifdef __GNUC__
+#include <cxxabi.h>
+#endif
 
 using namespace std;
 
 #ifdef CC_CFLAG_MEMORY_TRACKING
 
-// uncomment if you want to log every allocation in console
-//#define CC_CFLAG_ALLOCATION_LOG
-
 /*
- * record max size
+ * records are kept in shards, shard is selected by address so alloc and free of
+ * same block always lock same shard
  */
 
-#define MEMORY_RECORD_INDEX_SIZE 0x10000
-#define MEMORY_RECORD_INDEX_MASK 0xFFFF
+#define MEMORY_SHARD_COUNT 64
+#define MEMORY_SHARD_MASK 63
+#define MEMORY_SHARD_BITS 6
+#define MEMORY_BUCKET_COUNT 512
+#define MEMORY_BUCKET_MASK 511
+
+// records allocated from system at a time
+#define MEMORY_RECORD_BLOCK 256
+
+// reference operations kept for an object, older ones are overwritten
+#define MEMORY_REF_HISTORY 8
 
 /// memory record structure
 typedef struct ccMemoryRecord {
@@ -51,10 +71,10 @@ typedef struct ccMemoryRecord {
 	/**
 	 * memory size
 	 */
-	int size;
+	size_t size;
 
 	/**
-	 * source file name where allocation occurs
+	 * source file name where allocation occurs, NULL for plain new
 	 */
 	const char* file;
 
@@ -63,106 +83,266 @@ typedef struct ccMemoryRecord {
 	 */
 	int line;
 
+	/**
+	 * tag of allocating thread
+	 */
+	int tag;
+
+	/**
+	 * sampling rate when recorded
+	 */
+	int weight;
+
+	/**
+	 * unique serial number
+	 */
+	unsigned int serial;
+
 	/**
 	 * next record
 	 */
 	struct ccMemoryRecord* next;
 } ccMemoryRecord;
 
-/*
- * record array and summary info
- */
+/// reference count operation record
+typedef enum {
+    kCC_RETAIN,
+    kCC_RELEASE,
+    kCC_AUTORELEASE
+} ccRefOp;
+typedef struct ccRefRecord {
+    ccRefOp op;
+    const char* file;
+    int line;
+    int retainCount;
+    int autoReleaseCount;
+} ccRefRecord;
+typedef struct ccObjRecord {
+    cocos2d::CCObject* obj;
+    const char* classname;
+    const char* typeName;
+    int tag;
+    int weight;
+    unsigned int serial;
+    int opCount;
+    ccRefRecord ops[MEMORY_REF_HISTORY];
+    struct ccObjRecord* next;
+} ccObjRecord;
+static const char* ccRefOpStrings[] = {
+    "RETAIN",
+    "RELEASE",
+    "AUTORELEASE"
+};
 
-static ccMemoryRecord* sMemoryRecord[MEMORY_RECORD_INDEX_SIZE] = { 0 };
-static int sTotalUsedMemory = 0;
-static int sMaxUsedMemory = 0;
-static int sTotalAlloc = 0;
-static int sTotalFree = 0;
+/// a shard of records
+typedef struct ccMemoryShard {
+    pthread_mutex_t mutex;
+    ccMemoryRecord* records[MEMORY_BUCKET_COUNT];
+    ccObjRecord* objRecords[MEMORY_BUCKET_COUNT];
+
+    // free records for reuse
+    ccMemoryRecord* freeRecords;
+    ccObjRecord* freeObjRecords;
+
+    // serial and sampling counters
+    unsigned int serial;
+    int allocSampleCounter;
+    int objSampleCounter;
+
+    // statistics
+    size_t usedMemory;
+    size_t maxUsedMemory;
+    unsigned int totalAlloc;
+    unsigned int totalFree;
+    cocos2d::ccMemoryTagStats tags[cocos2d::kCCMemoryTagCount];
+} ccMemoryShard;
+
+static ccMemoryShard sShards[MEMORY_SHARD_COUNT];
+static pthread_once_t sShardsOnce = PTHREAD_ONCE_INIT;
+
+// thread state, low 8 bits are tag, others are suspend depth
+static pthread_key_t sThreadKey;
+#define THREAD_TAG_MASK 0xFF
+#define THREAD_SUSPEND_UNIT 0x100
+
+static int sSampleRate = CC_MEMORY_TRACKING_SAMPLE_RATE;
+
+static const char* sTagNames[cocos2d::kCCMemoryTagCount] = {
+    "general",
+    "texture",
+    "atlas",
+    "armature",
+    "lua"
+};
 
-#ifdef __cplusplus
-extern "C" {
-#endif
+static void initShards() {
+    memset(sShards, 0, sizeof(sShards));
+    for(int i = 0; i < MEMORY_SHARD_COUNT; i++) {
+        pthread_mutex_init(&sShards[i].mutex, NULL);
+    }
+    pthread_key_create(&sThreadKey, NULL);
+}
 
-void addRecord(ccMemoryRecord* r) {
-	// get hash position
-	int hash = (uintptr_t)r->start & MEMORY_RECORD_INDEX_MASK;
-	ccMemoryRecord* pTemp = sMemoryRecord[hash];
-	ccMemoryRecord* pPrev = NULL;
+static inline intptr_t getThreadState() {
+    return (intptr_t)pthread_getspecific(sThreadKey);
+}
 
-	// find a block whose start address is larger than incoming record
-	while (pTemp) {
-		if (pTemp->start > r->start) {
-			break;
-		}
-		pPrev = pTemp;
-		pTemp = pTemp->next;
-	}
+static inline void setThreadState(intptr_t state) {
+    pthread_setspecific(sThreadKey, (void*)state);
+}
 
-	// insert new record into linked list
-	if (pPrev == NULL) {
-		sMemoryRecord[hash] = r;
-		if (pTemp) {
-			r->next = pTemp;
-		}
-	} else {
-		r->next = pPrev->next;
-		pPrev->next = r;
-	}
+/// stop tracking allocations of current thread, tracker uses it when it allocates for itself
+static void suspendThread() {
+    pthread_once(&sShardsOnce, initShards);
+    setThreadState(getThreadState() + THREAD_SUSPEND_UNIT);
+}
 
-	// update statistics
-	sTotalUsedMemory += r->size;
-	sMaxUsedMemory = (sMaxUsedMemory > sTotalUsedMemory ? sMaxUsedMemory : sTotalUsedMemory);
-	sTotalAlloc++;
+static void resumeThread() {
+    setThreadState(getThreadState() - THREAD_SUSPEND_UNIT);
 }
-    
-ccMemoryRecord* findRecord(void* p) {
-	int hash = (uintptr_t)p & MEMORY_RECORD_INDEX_MASK;
-	ccMemoryRecord* pTemp = sMemoryRecord[hash];
-	ccMemoryRecord* r = NULL;
-	while (pTemp) {
-		if (pTemp->start == p) {
-			r = pTemp;
-			break;
-		}
-		pTemp = pTemp->next;
-	}
-	return r;
+
+static inline int shardIndexOf(const void* p) {
+    return (int)(((uintptr_t)p >> 4) & MEMORY_SHARD_MASK);
 }
 
-ccMemoryRecord* removeRecord(ccMemoryRecord* r) {
-	int hash = (uintptr_t)r->start & MEMORY_RECORD_INDEX_MASK;
-	ccMemoryRecord* pTemp = sMemoryRecord[hash];
-	ccMemoryRecord* pPrev = NULL;
-	while(pTemp) {
-		if(pTemp == r) {
-			break;
-		}
-		pPrev = pTemp;
-		pTemp = pTemp->next;
-	}
+static inline int bucketOf(const void* p) {
+    return (int)(((uintptr_t)p >> (4 + MEMORY_SHARD_BITS)) & MEMORY_BUCKET_MASK);
+}
 
-	// didn't find?
-	if(pTemp != r) {
-		CCLOG("[MEMRECORD] Unmatched record (%p)(record=%p):%d [%s:%d]", r->start, r, r->size, r->file, r->line);
-		return NULL;
-	}
+// get a free record, must be called with shard locked. malloc is not tracked so it is safe here
+static ccMemoryRecord* newRecord(ccMemoryShard* shard) {
+    if(!shard->freeRecords) {
+        ccMemoryRecord* block = (ccMemoryRecord*)malloc(sizeof(ccMemoryRecord) * MEMORY_RECORD_BLOCK);
+        if(!block)
+            return NULL;
+        for(int i = 0; i < MEMORY_RECORD_BLOCK; i++) {
+            block[i].next = shard->freeRecords;
+            shard->freeRecords = block + i;
+        }
+    }
+    ccMemoryRecord* r = shard->freeRecords;
+    shard->freeRecords = r->next;
+    return r;
+}
 
-	// remove record
-	if(pTemp == sMemoryRecord[hash]) {
-		sMemoryRecord[hash] = pTemp->next;
-	} else {
-		pPrev->next = pTemp->next;
-	}
+static ccObjRecord* newObjRecord(ccMemoryShard* shard) {
+    if(!shard->freeObjRecords) {
+        ccObjRecord* block = (ccObjRecord*)malloc(sizeof(ccObjRecord) * MEMORY_RECORD_BLOCK);
+        if(!block)
+            return NULL;
+        for(int i = 0; i < MEMORY_RECORD_BLOCK; i++) {
+            block[i].next = shard->freeObjRecords;
+            shard->freeObjRecords = block + i;
+        }
+    }
+    ccObjRecord* r = shard->freeObjRecords;
+    shard->freeObjRecords = r->next;
+    return r;
+}
 
-	// statistics
-	sTotalUsedMemory -= r->size;
-	sTotalFree++;
+static void trackAlloc(void* p, size_t size, const char* file, int line, const char* logTag) {
+    pthread_once(&sShardsOnce, initShards);
+    intptr_t state = getThreadState();
+    if(state >= THREAD_SUSPEND_UNIT)
+        return;
+    int tag = (int)(state & THREAD_TAG_MASK);
+
+    int index = shardIndexOf(p);
+    ccMemoryShard* shard = sShards + index;
+    pthread_mutex_lock(&shard->mutex);
+
+    // exact totals
+    cocos2d::ccMemoryTagStats& stats = shard->tags[tag];
+    stats.allocCount++;
+    stats.allocBytes += size;
+
+    // sampled record
+    int rate = sSampleRate;
+    if(++shard->allocSampleCounter >= rate) {
+        shard->allocSampleCounter = 0;
+        ccMemoryRecord* r = newRecord(shard);
+        if(r) {
+            r->start = p;
+            r->size = size;
+            r->file = file;
+            r->line = line;
+            r->tag = tag;
+            r->weight = rate;
+            r->serial = (shard->serial++ << MEMORY_SHARD_BITS) | index;
+            int bucket = bucketOf(p);
+            r->next = shard->records[bucket];
+            shard->records[bucket] = r;
+
+            stats.liveCount += rate;
+            stats.liveBytes += (double)size * rate;
+            shard->usedMemory += size * rate;
+            shard->maxUsedMemory = MAX(shard->maxUsedMemory, shard->usedMemory);
+            shard->totalAlloc++;
+
+#ifdef CC_CFLAG_ALLOCATION_LOG
+            CCLOG("[%s](%p):%d [%s:%d]", logTag, r->start, (int)r->size, r->file ? r->file : "?", r->line);
+#endif
+        }
+    }
+
+    pthread_mutex_unlock(&shard->mutex);
+}
+
+// returns size of removed record, 0 if allocation is not sampled
+static size_t untrackAlloc(void* p) {
+    pthread_once(&sShardsOnce, initShards);
+
+    // suspended thread only frees its own untracked memory, and it may hold a
+    // shard lock, for example when vector of snapshot grows
+    if(getThreadState() >= THREAD_SUSPEND_UNIT)
+        return 0;
+
+    ccMemoryShard* shard = sShards + shardIndexOf(p);
+    pthread_mutex_lock(&shard->mutex);
+
+    // find record, not found if it is not sampled
+    int bucket = bucketOf(p);
+    ccMemoryRecord* pTemp = shard->records[bucket];
+    ccMemoryRecord* pPrev = NULL;
+    while(pTemp) {
+        if(pTemp->start == p) {
+            break;
+        }
+        pPrev = pTemp;
+        pTemp = pTemp->next;
+    }
+
+    // remove it
+    size_t size = 0;
+    if(pTemp) {
+        if(pPrev)
+            pPrev->next = pTemp->next;
+        else
+            shard->records[bucket] = pTemp->next;
+        size = pTemp->size;
+
+        cocos2d::ccMemoryTagStats& stats = shard->tags[pTemp->tag];
+        stats.liveCount -= pTemp->weight;
+        stats.liveBytes -= (double)pTemp->size * pTemp->weight;
+        shard->usedMemory -= pTemp->size * pTemp->weight;
+        shard->totalFree++;
+
+#ifdef CC_CFLAG_ALLOCATION_LOG
+        CCLOG("[FREE](%p):%d [%s:%d]", pTemp->start, (int)pTemp->size, pTemp->file ? pTemp->file : "?", pTemp->line);
+#endif
 
-	// return record
-	r->next = NULL;
-	return r;
+        pTemp->next = shard->freeRecords;
+        shard->freeRecords = pTemp;
+    }
+
+    pthread_mutex_unlock(&shard->mutex);
+    return size;
 }
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 void* _ccMalloc(size_t size, const char* file, int line, const char* logTag) {
 	// null pointer for zero size
 	if (size == 0)
@@ -170,22 +350,7 @@ void* _ccMalloc(size_t size, const char* file, int line, const char* logTag) {
 
 	void* p = malloc(size);
 	if (p) {
-		ccMemoryRecord* r = (ccMemoryRecord*)malloc(sizeof(ccMemoryRecord));
-		if(!r) {
-			free(p);
-			p = NULL;
-		} else {
-			r->start = p;
-			r->size = size;
-			r->file = file;
-			r->line = line;
-			r->next = NULL;
-			addRecord(r);
-		}
-
-#if CC_CFLAG_ALLOCATION_LOG
-		CCLOG("[%s](%p)(record=%p):%d [%s:%d]", logTag, r->start, r, r->size, r->file, r->line);
-#endif
+		trackAlloc(p, size, file, line, logTag);
 	}
 
 	return p;
@@ -193,26 +358,26 @@ void* _ccMalloc(size_t size, const char* file, int line, const char* logTag) {
 
 void* _ccCalloc(size_t nitems, size_t size, const char* file, int line) {
 	void* ptr = _ccMalloc(nitems * size, file, line, "CALLOC");
-	memset(ptr, 0, nitems * size);
+	if(ptr)
+		memset(ptr, 0, nitems * size);
 	return ptr;
 }
 
 void* _ccRealloc(void* ptr, size_t size, const char* file, int line) {
-	ccMemoryRecord* r = findRecord(ptr);
-	if(r) {
-		// realloc
-		void* newPtr = _ccMalloc(size, file, line, "REALLOC");
-		memcpy(newPtr, ptr, r->size);
-		free(ptr);
-
-		// remove record
-		removeRecord(r);
-		free(r);
-
-		return newPtr;
-	} else {
-		return realloc(ptr, size);
+	if(!ptr)
+		return _ccMalloc(size, file, line, "REALLOC");
+
+	// untrack before realloc, once old block is freed another thread may get
+	// same address and track it. it is tracked again as a new allocation
+	size_t oldSize = untrackAlloc(ptr);
+	void* newPtr = realloc(ptr, size);
+	if(newPtr) {
+		trackAlloc(newPtr, size, file, line, "REALLOC");
+	} else if(oldSize > 0) {
+		// old block is still valid
+		trackAlloc(ptr, oldSize, file, line, "REALLOC");
 	}
+	return newPtr;
 }
 
 void _ccFree(void* ptr, const char* file, int line) {
@@ -220,17 +385,8 @@ void _ccFree(void* ptr, const char* file, int line) {
 	if(!ptr)
 		return;
 
-	// find record and remove it
-	ccMemoryRecord* r = findRecord(ptr);
-	if(r) {
-#if CC_CFLAG_ALLOCATION_LOG
-		CCLOG("[FREE](%p)(record=%p):%d [%s:%d]", r->start, r, r->size, r->file, r->line);
-#endif
-		removeRecord(r);
-		free(r);
-	}
-
 	// even record is not found, we must release it
+	untrackAlloc(ptr);
 	free(ptr);
 }
 
@@ -238,47 +394,64 @@ void _ccFree(void* ptr, const char* file, int line) {
 }
 #endif
 
-#endif // #if CC_CFLAG_MEMORY_TRACKING
+// new must not return null, throw like default one
+static void* newOrThrow(size_t n, const char* file, int line, const char* logTag) {
+	void* p = _ccMalloc(n ? n : 1, file, line, logTag);
+	if(!p)
+		throw std::bad_alloc();
+	return p;
+}
 
-NS_CC_BEGIN
+void* operator new(size_t n, const char* file, int line) {
+	return newOrThrow(n, file, line, "NEW");
+}
 
-#if CC_CFLAG_MEMORY_TRACKING
+void* operator new[](size_t n, const char* file, int line) {
+	return newOrThrow(n, file, line, "NEW[]");
+}
 
-/// reference count operation record
-typedef enum {
-    kCC_RETAIN,
-    kCC_RELEASE,
-    kCC_AUTORELEASE
-} ccRefOp;
-typedef struct ccRefRecord {
-    ccRefOp op;
-    const char* file;
-    int line;
-    int retainCount;
-    int autoReleaseCount;
-    struct ccRefRecord* next;
-} ccRefRecord;
-typedef struct ccObjRecord{
-    CCObject* obj;
-    const char* classname;
-    struct ccObjRecord* next;
-    ccRefRecord* firstOp;
-} ccObjRecord;
-static const char* ccRefOpStrings[] = {
-    "RETAIN",
-    "RELEASE",
-    "AUTORELEASE"
-};
+void operator delete(void* p, const char* file, int line) {
+	_ccFree(p, file, line);
+}
+
+void operator delete[](void* p, const char* file, int line) {
+	_ccFree(p, file, line);
+}
+
+// replaced global new has same exception specification as declared in <new>
+#if __cplusplus >= 201103L
+#define CC_NEW_THROW
+#else
+#define CC_NEW_THROW throw(std::bad_alloc)
+#endif
+
+void* operator new(size_t n) CC_NEW_THROW {
+	return newOrThrow(n, NULL, 0, "NEW");
+}
+
+void* operator new[](size_t n) CC_NEW_THROW {
+	return newOrThrow(n, NULL, 0, "NEW[]");
+}
+
+void operator delete(void* p) throw() {
+	_ccFree(p, NULL, 0);
+}
 
-// record buffer
-static ccObjRecord* sObjRecord[MEMORY_RECORD_INDEX_SIZE] = { 0 };
+void operator delete[](void* p) throw() {
+	_ccFree(p, NULL, 0);
+}
 
-// find obj record
-static ccObjRecord* findObjRecord(CCObject* obj) {
-    int hash = obj->m_uID & MEMORY_RECORD_INDEX_MASK;
-    ccObjRecord* pTemp = sObjRecord[hash];
+#endif // #if CC_CFLAG_MEMORY_TRACKING
+
+NS_CC_BEGIN
+
+#ifdef CC_CFLAG_MEMORY_TRACKING
+
+// find obj record, must be called with shard locked
+static ccObjRecord* findObjRecord(ccMemoryShard* shard, CCObject* obj) {
+    ccObjRecord* pTemp = shard->objRecords[bucketOf(obj)];
     while (pTemp) {
-        if (pTemp->obj->m_uID == obj->m_uID) {
+        if (pTemp->obj == obj) {
             break;
         }
         pTemp = pTemp->next;
@@ -286,107 +459,367 @@ static ccObjRecord* findObjRecord(CCObject* obj) {
     return pTemp;
 }
 
-// append ref record
-static void appendRefRecord(ccObjRecord* r, ccRefRecord* newrr) {
-    if(r->firstOp) {
-        ccRefRecord* rr = r->firstOp;
-        while(rr->next) {
-            rr = rr->next;
-        }
-        rr->next = newrr;
-    } else {
-        r->firstOp = newrr;
-    }
+// class name of an object record, caller must free returned name
+static char* copyClassName(const char* classname) {
+#ifdef __GNUC__
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(classname, NULL, NULL, &status);
+    if(demangled)
+        return demangled;
+#endif
+    return (char*)CCUtils::copy(classname);
+}
+
+// dynamic type is not known in constructor of CCObject, it is taken from later
+// retain, release or autorelease on thread using object, so it is never read
+// from an object which is being constructed or destroyed
+static const char* recordTypeName(ccObjRecord* r) {
+    if(r->classname)
+        return r->classname;
+    return r->typeName ? r->typeName : typeid(CCObject).name();
 }
 
 static void dumpOneObjRecord(ccObjRecord* r) {
-    while(r) {
-        CCLOG("[REFRECORD of %s]", r->classname);
-        ccRefRecord* rr = r->firstOp;
-        while(rr) {
-            CCLOG("    %s:%d [%s:%d]", ccRefOpStrings[rr->op], rr->retainCount, rr->file, rr->line);
-            rr = rr->next;
-        }
-        r = r->next;
+    char* name = copyClassName(recordTypeName(r));
+    CCLOG("[REFRECORD of %s](%p) retain %d", name, r->obj, r->obj->retainCount());
+    free(name);
+    int first = MAX(0, r->opCount - MEMORY_REF_HISTORY);
+    for(int i = first; i < r->opCount; i++) {
+        ccRefRecord* rr = r->ops + i % MEMORY_REF_HISTORY;
+        CCLOG("    %s:%d [%s:%d]", ccRefOpStrings[rr->op], rr->retainCount, rr->file, rr->line);
     }
 }
 
+static void appendRefRecord(CCObject* obj, ccRefOp op, const char* file, int line) {
+    // null checking
+    if(!obj || !obj->m_tracked)
+        return;
+
+    // object is complete when it is referenced after construction
+    const char* typeName = typeid(*obj).name();
+
+    ccMemoryShard* shard = sShards + shardIndexOf(obj);
+    pthread_mutex_lock(&shard->mutex);
+    ccObjRecord* r = findObjRecord(shard, obj);
+    if(r) {
+        r->typeName = typeName;
+    }
+    if(r && file) {
+        ccRefRecord* rr = r->ops + r->opCount % MEMORY_REF_HISTORY;
+        rr->op = op;
+        rr->file = file;
+        rr->line = line;
+        rr->retainCount = obj->retainCount();
+        rr->autoReleaseCount = obj->autoReleaseCount();
+        r->opCount++;
+    }
+    pthread_mutex_unlock(&shard->mutex);
+}
+
+// group of growth in dumpGrowth
+struct ccGrowth {
+    double count;
+    double bytes;
+
+    ccGrowth() : count(0), bytes(0) {}
+};
+
+static bool compareGrowth(const pair<string, ccGrowth>& a, const pair<string, ccGrowth>& b) {
+    return a.second.bytes > b.second.bytes || (a.second.bytes == b.second.bytes && a.second.count > b.second.count);
+}
+
+static bool compareAllocationSerial(const CCMemorySnapshot::Allocation& a, const CCMemorySnapshot::Allocation& b) {
+    return a.serial < b.serial;
+}
+
+static bool compareObjectSerial(const CCMemorySnapshot::Object& a, const CCMemorySnapshot::Object& b) {
+    return a.serial < b.serial;
+}
+
 #endif // #if CC_CFLAG_MEMORY_TRACKING
 
+double CCMemorySnapshot::getLiveBytes() const {
+    double bytes = 0;
+    for(vector<Allocation>::const_iterator iter = m_allocations.begin(); iter != m_allocations.end(); iter++) {
+        bytes += (double)iter->size * iter->weight;
+    }
+    return bytes;
+}
+
 void CCMemory::usageReport() {
 #ifdef CC_CFLAG_MEMORY_TRACKING
-	CCLOG("[MEMREPORT] peak %d bytes, now %d bytes, alloc %d times, free %d times",
-          sMaxUsedMemory, sTotalUsedMemory, sTotalAlloc, sTotalFree);
+    pthread_once(&sShardsOnce, initShards);
+
+    // peak is sum of shard peaks, so it is upper bound
+    size_t used = 0, peak = 0;
+    unsigned int allocs = 0, frees = 0;
+    for(int i = 0; i < MEMORY_SHARD_COUNT; i++) {
+        ccMemoryShard* shard = sShards + i;
+        pthread_mutex_lock(&shard->mutex);
+        used += shard->usedMemory;
+        peak += shard->maxUsedMemory;
+        allocs += shard->totalAlloc;
+        frees += shard->totalFree;
+        pthread_mutex_unlock(&shard->mutex);
+    }
+	CCLOG("[MEMREPORT] peak %u bytes, now %u bytes, alloc %u times, free %u times, sample rate %d",
+          (unsigned int)peak, (unsigned int)used, allocs, frees, sSampleRate);
+
+    for(int tag = 0; tag < kCCMemoryTagCount; tag++) {
+        ccMemoryTagStats stats = getTagStats(tag);
+        if(stats.allocCount > 0) {
+            CCLOG("[MEMREPORT] %s: live %d, %.0f bytes, alloc %u times, %.0f bytes",
+                  getTagName(tag), stats.liveCount, stats.liveBytes, stats.allocCount, stats.allocBytes);
+        }
+    }
 #endif
 }
 
 void CCMemory::dumpRecord() {
 #ifdef CC_CFLAG_MEMORY_TRACKING
-	int leak = 0;
+	suspendThread();
+	double leak = 0;
 	int leakNum = 0;
-	for (int i = 0; i < MEMORY_RECORD_INDEX_SIZE; i++) {
-		ccMemoryRecord* r = sMemoryRecord[i];
-		while(r) {
-            CCLOG("%d.[MEMRECORD](%p)(record=%p):%d [%s:%d]", ++leakNum, r->start, r, r->size, r->file, r->line);
-            leak += r->size;
-			r = r->next;
+	for (int i = 0; i < MEMORY_SHARD_COUNT; i++) {
+		ccMemoryShard* shard = sShards + i;
+		pthread_mutex_lock(&shard->mutex);
+		for (int j = 0; j < MEMORY_BUCKET_COUNT; j++) {
+			for(ccMemoryRecord* r = shard->records[j]; r; r = r->next) {
+				CCLOG("%d.[MEMRECORD](%p):%d [%s:%d] %s", ++leakNum, r->start, (int)r->size, r->file ? r->file : "?", r->line, getTagName(r->tag));
+				leak += (double)r->size * r->weight;
+			}
 		}
+		pthread_mutex_unlock(&shard->mutex);
 	}
     
 	if(leakNum > 0) {
-		CCLOG("[MEMRECORD] total leak = %d", leak);
+		CCLOG("[MEMRECORD] total leak = %.0f", leak);
 	} else {
 		CCLOG("[MEMRECORD] no memory leak, congratulations!");
 	}
     
     // reference count records
-    for (int i = 0; i < MEMORY_RECORD_INDEX_SIZE; i++) {
-        ccObjRecord* r = sObjRecord[i];
-        dumpOneObjRecord(r);
+    for (int i = 0; i < MEMORY_SHARD_COUNT; i++) {
+        ccMemoryShard* shard = sShards + i;
+        pthread_mutex_lock(&shard->mutex);
+        for (int j = 0; j < MEMORY_BUCKET_COUNT; j++) {
+            for(ccObjRecord* r = shard->objRecords[j]; r; r = r->next) {
+                dumpOneObjRecord(r);
+            }
+        }
+        pthread_mutex_unlock(&shard->mutex);
+    }
+    resumeThread();
+#endif
+}
+
+void CCMemory::setSampleRate(int rate) {
+#ifdef CC_CFLAG_MEMORY_TRACKING
+    sSampleRate = MAX(1, rate);
+#endif
+}
+
+int CCMemory::getSampleRate() {
+#ifdef CC_CFLAG_MEMORY_TRACKING
+    return sSampleRate;
+#else
+    return 0;
+#endif
+}
+
+void CCMemory::setTagName(int tag, const char* name) {
+#ifdef CC_CFLAG_MEMORY_TRACKING
+    if(tag >= 0 && tag < kCCMemoryTagCount)
+        sTagNames[tag] = name;
+#endif
+}
+
+const char* CCMemory::getTagName(int tag) {
+#ifdef CC_CFLAG_MEMORY_TRACKING
+    if(tag >= 0 && tag < kCCMemoryTagCount && sTagNames[tag])
+        return sTagNames[tag];
+#endif
+    return "unknown";
+}
+
+ccMemoryTagStats CCMemory::getTagStats(int tag) {
+    ccMemoryTagStats stats;
+    memset(&stats, 0, sizeof(stats));
+#ifdef CC_CFLAG_MEMORY_TRACKING
+    if(tag < 0 || tag >= kCCMemoryTagCount)
+        return stats;
+
+    pthread_once(&sShardsOnce, initShards);
+    for(int i = 0; i < MEMORY_SHARD_COUNT; i++) {
+        ccMemoryShard* shard = sShards + i;
+        pthread_mutex_lock(&shard->mutex);
+        ccMemoryTagStats& s = shard->tags[tag];
+        stats.allocCount += s.allocCount;
+        stats.allocBytes += s.allocBytes;
+        stats.liveCount += s.liveCount;
+        stats.liveBytes += s.liveBytes;
+        pthread_mutex_unlock(&shard->mutex);
     }
+#endif
+    return stats;
+}
+
+int CCMemory::getCurrentTag() {
+#ifdef CC_CFLAG_MEMORY_TRACKING
+    pthread_once(&sShardsOnce, initShards);
+    return (int)(getThreadState() & THREAD_TAG_MASK);
+#else
+    return kCCMemoryTagGeneral;
+#endif
+}
+
+void CCMemory::setCurrentTag(int tag) {
+#ifdef CC_CFLAG_MEMORY_TRACKING
+    if(tag < 0 || tag >= kCCMemoryTagCount)
+        return;
+    pthread_once(&sShardsOnce, initShards);
+    setThreadState((getThreadState() & ~(intptr_t)THREAD_TAG_MASK) | tag);
 #endif
 }
 
-void CCMemory::trackCCObject(CCObject* obj, string name) {
+CCMemorySnapshot* CCMemory::takeSnapshot() {
+#ifdef CC_CFLAG_MEMORY_TRACKING
+    // snapshot itself is not tracked, so it can allocate with shard locked
+    suspendThread();
+#endif
+    CCMemorySnapshot* snapshot = new CCMemorySnapshot();
+#ifdef CC_CFLAG_MEMORY_TRACKING
+    for(int i = 0; i < MEMORY_SHARD_COUNT; i++) {
+        ccMemoryShard* shard = sShards + i;
+        pthread_mutex_lock(&shard->mutex);
+        for(int j = 0; j < MEMORY_BUCKET_COUNT; j++) {
+            for(ccMemoryRecord* r = shard->records[j]; r; r = r->next) {
+                CCMemorySnapshot::Allocation a = { r->serial, r->size, r->weight, r->tag, r->file, r->line };
+                snapshot->m_allocations.push_back(a);
+            }
+            for(ccObjRecord* r = shard->objRecords[j]; r; r = r->next) {
+                CCMemorySnapshot::Object o = { r->serial, r->weight, r->tag, recordTypeName(r) };
+                snapshot->m_objects.push_back(o);
+            }
+        }
+        pthread_mutex_unlock(&shard->mutex);
+    }
+    sort(snapshot->m_allocations.begin(), snapshot->m_allocations.end(), compareAllocationSerial);
+    sort(snapshot->m_objects.begin(), snapshot->m_objects.end(), compareObjectSerial);
+    resumeThread();
+#endif
+    return snapshot;
+}
+
+void CCMemory::dumpGrowth(const CCMemorySnapshot* older, const CCMemorySnapshot* newer, int maxLines) {
+#ifdef CC_CFLAG_MEMORY_TRACKING
+    if(!older || !newer)
+        return;
+    suspendThread();
+
+    // allocations in newer but not in older, grouped by site
+    map<string, ccGrowth> allocGroups;
+    double totalBytes = 0;
+    vector<CCMemorySnapshot::Allocation>::const_iterator oldIter = older->m_allocations.begin();
+    for(vector<CCMemorySnapshot::Allocation>::const_iterator iter = newer->m_allocations.begin(); iter != newer->m_allocations.end(); iter++) {
+        while(oldIter != older->m_allocations.end() && oldIter->serial < iter->serial)
+            oldIter++;
+        if(oldIter != older->m_allocations.end() && oldIter->serial == iter->serial)
+            continue;
+        char key[512];
+        snprintf(key, sizeof(key), "%s [%s:%d]", getTagName(iter->tag), iter->file ? iter->file : "?", iter->line);
+        ccGrowth& g = allocGroups[key];
+        g.count += iter->weight;
+        g.bytes += (double)iter->size * iter->weight;
+        totalBytes += (double)iter->size * iter->weight;
+    }
+
+    // objects in newer but not in older, grouped by class
+    map<string, ccGrowth> objGroups;
+    double totalObjects = 0;
+    vector<CCMemorySnapshot::Object>::const_iterator oldObjIter = older->m_objects.begin();
+    for(vector<CCMemorySnapshot::Object>::const_iterator iter = newer->m_objects.begin(); iter != newer->m_objects.end(); iter++) {
+        while(oldObjIter != older->m_objects.end() && oldObjIter->serial < iter->serial)
+            oldObjIter++;
+        if(oldObjIter != older->m_objects.end() && oldObjIter->serial == iter->serial)
+            continue;
+        char* name = copyClassName(iter->classname.c_str());
+        ccGrowth& g = objGroups[name];
+        free(name);
+        g.count += iter->weight;
+        totalObjects += iter->weight;
+    }
+
+    // print biggest first
+    CCLOG("[MEMGROWTH] %.0f bytes, %.0f objects, live %.0f bytes -> %.0f bytes",
+          totalBytes, totalObjects, older->getLiveBytes(), newer->getLiveBytes());
+    vector<pair<string, ccGrowth> > sorted(allocGroups.begin(), allocGroups.end());
+    sort(sorted.begin(), sorted.end(), compareGrowth);
+    for(int i = 0; i < (int)sorted.size() && i < maxLines; i++) {
+        CCLOG("    +%.0f bytes in %.0f allocations, %s", sorted[i].second.bytes, sorted[i].second.count, sorted[i].first.c_str());
+    }
+    sorted.assign(objGroups.begin(), objGroups.end());
+    for(vector<pair<string, ccGrowth> >::iterator iter = sorted.begin(); iter != sorted.end(); iter++) {
+        iter->second.bytes = iter->second.count;
+    }
+    sort(sorted.begin(), sorted.end(), compareGrowth);
+    for(int i = 0; i < (int)sorted.size() && i < maxLines; i++) {
+        CCLOG("    +%.0f %s", sorted[i].second.count, sorted[i].first.c_str());
+    }
+
+    resumeThread();
+#endif
+}
+
+void CCMemory::trackCCObject(CCObject* obj, const char* name) {
 #ifdef CC_CFLAG_MEMORY_TRACKING
     // null checking
     if(!obj)
         return;
-    
-    // create record
-    ccObjRecord* r = (ccObjRecord*)malloc(sizeof(ccObjRecord));
-    r->obj = obj;
-    r->next = NULL;
-    r->firstOp = NULL;
-    r->classname = CCUtils::copy(name.c_str());
-    
-    // get hash position
-    int hash = r->obj->m_uID & MEMORY_RECORD_INDEX_MASK;
-    ccObjRecord* pTemp = sObjRecord[hash];
-    ccObjRecord* pPrev = NULL;
-    
-    // find a block whose start address is larger than incoming record
-    while (pTemp) {
-        if (pTemp->obj->m_uID > r->obj->m_uID) {
-            break;
+
+    pthread_once(&sShardsOnce, initShards);
+    intptr_t state = getThreadState();
+    if(state >= THREAD_SUSPEND_UNIT)
+        return;
+
+    int index = shardIndexOf(obj);
+    ccMemoryShard* shard = sShards + index;
+    pthread_mutex_lock(&shard->mutex);
+
+    // track again with a new name
+    ccObjRecord* r = findObjRecord(shard, obj);
+    if(r) {
+        if(name) {
+            free((void*)r->classname);
+            r->classname = CCUtils::copy(name);
         }
-        pPrev = pTemp;
-        pTemp = pTemp->next;
+        pthread_mutex_unlock(&shard->mutex);
+        return;
     }
-    
-    // insert new record into linked list
-    if (pPrev == NULL) {
-        sObjRecord[hash] = r;
-        if (pTemp) {
-            r->next = pTemp;
+
+    // sampling
+    int rate = sSampleRate;
+    if(++shard->objSampleCounter >= rate) {
+        shard->objSampleCounter = 0;
+        r = newObjRecord(shard);
+        if(r) {
+            r->obj = obj;
+            r->classname = name ? CCUtils::copy(name) : NULL;
+            r->typeName = NULL;
+            r->tag = (int)(state & THREAD_TAG_MASK);
+            r->weight = rate;
+            r->serial = (shard->serial++ << MEMORY_SHARD_BITS) | index;
+            r->opCount = 0;
+            int bucket = bucketOf(obj);
+            r->next = shard->objRecords[bucket];
+            shard->objRecords[bucket] = r;
+
+            // set track flag
+            obj->m_tracked = true;
         }
-    } else {
-        r->next = pPrev->next;
-        pPrev->next = r;
     }
-    
-    // set track flag
-    obj->m_tracked = true;
+
+    pthread_mutex_unlock(&shard->mutex);
 #endif
 }
 
@@ -395,119 +828,54 @@ void CCMemory::untrackCCObject(CCObject* obj) {
     // null checking
     if(!obj || !obj->m_tracked)
         return;
-    
-    // get hash
-    int hash = obj->m_uID & MEMORY_RECORD_INDEX_MASK;
-    ccObjRecord* pTemp = sObjRecord[hash];
+
+    ccMemoryShard* shard = sShards + shardIndexOf(obj);
+    pthread_mutex_lock(&shard->mutex);
+
+    // find
+    int bucket = bucketOf(obj);
+    ccObjRecord* pTemp = shard->objRecords[bucket];
     ccObjRecord* pPrev = NULL;
     while(pTemp) {
-        if(pTemp->obj->m_uID == obj->m_uID) {
+        if(pTemp->obj == obj) {
             break;
         }
         pPrev = pTemp;
         pTemp = pTemp->next;
     }
-    
-    // didn't find?
-    if(!pTemp) {
-        return;
-    }
-    
-    // dump
-    dumpOneObjRecord(pTemp);
-    
+
     // remove record
-    if(pTemp == sObjRecord[hash]) {
-        sObjRecord[hash] = pTemp->next;
-    } else {
-        pPrev->next = pTemp->next;
+    if(pTemp) {
+        if(pPrev)
+            pPrev->next = pTemp->next;
+        else
+            shard->objRecords[bucket] = pTemp->next;
+        free((void*)pTemp->classname);
+        pTemp->next = shard->freeObjRecords;
+        shard->freeObjRecords = pTemp;
     }
-    
-    // free
-    ccRefRecord* rr = pTemp->firstOp;
-    while(rr) {
-        ccRefRecord* next = rr->next;
-        free(rr);
-        rr = next;
-    }
-    free((void*)pTemp->classname);
-    free(pTemp);
+    obj->m_tracked = false;
+
+    pthread_mutex_unlock(&shard->mutex);
 #endif
 }
 
 void CCMemory::trackRetain(CCObject* obj, const char* file, int line) {
 #ifdef CC_CFLAG_MEMORY_TRACKING
-    // null checking
-    if(!obj || !obj->m_tracked || !file)
-        return;
-    
-    // find record
-    ccObjRecord* r = findObjRecord(obj);
-    if(!r) {
-        CCLOG("retain on an object which is not in registry, impossible");
-        return;
-    }
-    
-    // new records
-    ccRefRecord* newrr = (ccRefRecord*)malloc(sizeof(ccRefRecord));
-    newrr->op = kCC_RETAIN;
-    newrr->file = file;
-    newrr->line = line;
-    newrr->retainCount = obj->retainCount();
-    newrr->autoReleaseCount = obj->autoReleaseCount();
-    newrr->next = NULL;
-    appendRefRecord(r, newrr);
+    appendRefRecord(obj, kCC_RETAIN, file, line);
 #endif
 }
 
 void CCMemory::trackRelease(CCObject* obj, const char* file, int line) {
 #ifdef CC_CFLAG_MEMORY_TRACKING
-    // null checking
-    if(!obj || !obj->m_tracked || !file)
-        return;
-    
-    // find record
-    ccObjRecord* r = findObjRecord(obj);
-    if(!r) {
-        CCLOG("retain on an object which is not in registry, impossible");
-        return;
-    }
-    
-    // new records
-    ccRefRecord* newrr = (ccRefRecord*)malloc(sizeof(ccRefRecord));
-    newrr->op = kCC_RELEASE;
-    newrr->file = file;
-    newrr->line = line;
-    newrr->retainCount = obj->retainCount();
-    newrr->autoReleaseCount = obj->autoReleaseCount();
-    newrr->next = NULL;
-    appendRefRecord(r, newrr);
+    appendRefRecord(obj, kCC_RELEASE, file, line);
 #endif
 }
 
 void CCMemory::trackAutorelease(CCObject* obj, const char* file, int line) {
 #ifdef CC_CFLAG_MEMORY_TRACKING
-    // null checking
-    if(!obj || !obj->m_tracked || !file)
-        return;
-    
-    // find record
-    ccObjRecord* r = findObjRecord(obj);
-    if(!r) {
-        CCLOG("retain on an object which is not in registry, impossible");
-        return;
-    }
-    
-    // new records
-    ccRefRecord* newrr = (ccRefRecord*)malloc(sizeof(ccRefRecord));
-    newrr->op = kCC_AUTORELEASE;
-    newrr->file = file;
-    newrr->line = line;
-    newrr->retainCount = obj->retainCount();
-    newrr->autoReleaseCount = obj->autoReleaseCount();
-    newrr->next = NULL;
-    appendRefRecord(r, newrr);
+    appendRefRecord(obj, kCC_AUTORELEASE, file, line);
 #endif
 }
 
-NS_CC_END
\ No newline at end of file
+NS_CC_END
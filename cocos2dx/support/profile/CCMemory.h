@@ -26,33 +26,29 @@
 
 #include "ccMacros.h"
 #include <string>
+#include <vector>
 
 #ifdef CC_CFLAG_MEMORY_TRACKING
 
+/**
+ * Default sampling rate of memory tracking, 1 means every allocation and every object is
+ * recorded, N means one of N is recorded and counts of it are weighted by N.
+ * It can be changed at runtime by CCMemory::setSampleRate.
+ */
+#ifndef CC_MEMORY_TRACKING_SAMPLE_RATE
+#define CC_MEMORY_TRACKING_SAMPLE_RATE 1
+#endif
+
 extern "C" CC_DLL void* _ccMalloc(size_t size, const char* file, int line, const char* logTag);
 extern "C" CC_DLL void* _ccCalloc(size_t nitems, size_t size, const char* file, int line);
 extern "C" CC_DLL void* _ccRealloc(void* ptr, size_t size, const char* file, int line);
 extern "C" CC_DLL void _ccFree(void* ptr, const char* file, int line);
 
-inline void* operator new(size_t n, const char* file, int line) {
-	return _ccMalloc(n, file, line, "NEW");
-}
-
-inline void* operator new[](size_t n, const char* file, int line) {
-	return _ccMalloc(n, file, line, "NEW[]");
-}
-
-void operator delete(void* p, const char* file, int line) {
-	_ccFree(p, file, line);
-}
-
-void operator delete(void* p) throw() {
-	_ccFree(p, __FILE__, __LINE__);
-}
-
-void operator delete[](void* p) throw() {
-	_ccFree(p, __FILE__, __LINE__);
-}
+// global new and delete are replaced in CCMemory.cpp
+void* operator new(size_t n, const char* file, int line);
+void* operator new[](size_t n, const char* file, int line);
+void operator delete(void* p, const char* file, int line);
+void operator delete[](void* p, const char* file, int line);
 
 #define ccMalloc(size) _ccMalloc(size, __FILE__, __LINE__, "MALLOC")
 #define ccCalloc(nitems, size) _ccCalloc(nitems, size, __FILE__, __LINE__)
@@ -61,6 +57,9 @@ void operator delete[](void* p) throw() {
 #define CCNEW new(__FILE__, __LINE__)
 #define CCNEWARR(t, s) new(__FILE__, __LINE__) t[(s)]
 
+/// tag allocations and objects created in current scope of current thread
+#define CC_MEMORY_TAG(tag) cocos2d::CCMemoryTagScope __ccMemoryTagScope(tag)
+
 #else
 
 #define ccMalloc malloc
@@ -69,28 +68,146 @@ void operator delete[](void* p) throw() {
 #define ccFree free
 #define CCNEW new
 #define CCNEWARR(t, s) new t[(s)]
+#define CC_MEMORY_TAG(tag)
 
 #endif // #if CC_CFLAG_MEMORY_TRACKING
 
+/// free a block allocated by ccMalloc and set pointer to NULL
+#define CC_SAFE_CCFREE(p) do { if(p) { ccFree(p); (p) = 0; } } while(0)
+
 NS_CC_BEGIN
 
 class CCObject;
 
 /**
- * Memory profile helper class
+ * Tag of allocation, every allocation and object is counted in the tag of its thread
+ * when it is created. Tags from kCCMemoryTagUser are free for game, name them by
+ * CCMemory::setTagName.
+ */
+typedef enum {
+    kCCMemoryTagGeneral,
+    kCCMemoryTagTexture,
+    kCCMemoryTagAtlas,
+    kCCMemoryTagArmature,
+    kCCMemoryTagLua,
+    kCCMemoryTagUser,
+    kCCMemoryTagCount = 16
+} ccMemoryTag;
+
+/**
+ * Totals of a tag. Allocation count and bytes are exact, live count and bytes are
+ * estimated from sampled records when sampling rate is not 1.
+ */
+typedef struct {
+    /// allocation count
+    unsigned int allocCount;
+
+    /// allocated bytes
+    double allocBytes;
+
+    /// live allocation count
+    int liveCount;
+
+    /// live bytes
+    double liveBytes;
+} ccMemoryTagStats;
+
+/**
+ * Live allocations and objects recorded by memory tracking at a time. Take one before
+ * and after a scene transition, then CCMemory::dumpGrowth tells what was left.
+ *
+ * @since v2.2
+ */
+class CC_DLL CCMemorySnapshot {
+    friend class CCMemory;
+
+public:
+    /// a live allocation
+    struct Allocation {
+        unsigned int serial;
+        size_t size;
+        int weight;
+        int tag;
+        const char* file;
+        int line;
+    };
+
+    /// a live object
+    struct Object {
+        unsigned int serial;
+        int weight;
+        int tag;
+
+        /// class name given to CCMemory::trackCCObject, or mangled name of object type.
+        /// it is copied because object may be gone when snapshot is read
+        std::string classname;
+    };
+
+public:
+    /// live allocations, in serial order
+    const std::vector<Allocation>& getAllocations() const { return m_allocations; }
+
+    /// live objects, in serial order
+    const std::vector<Object>& getObjects() const { return m_objects; }
+
+    /// estimated live bytes
+    double getLiveBytes() const;
+
+private:
+    std::vector<Allocation> m_allocations;
+    std::vector<Object> m_objects;
+};
+
+/**
+ * Memory profile helper class. It works when CC_CFLAG_MEMORY_TRACKING is defined.
+ *
+ * Records are kept in shards selected by address, each shard has its own lock, so
+ * loader threads can allocate together with GL thread. With sampling rate N, only one
+ * of N allocations or objects in a shard is recorded.
  */
-class CCMemory {
+class CC_DLL CCMemory {
 public:
-    /// print a summary memory usage
+    /// print a summary memory usage, and totals of every tag
     static void usageReport();
     
     /// print all leaked memory record
     static void dumpRecord();
+
+    /**
+     * set sampling rate, 1 records all. It affects allocations and objects created after,
+     * so it is better set before loading anything
+     */
+    static void setSampleRate(int rate);
+    static int getSampleRate();
+
+    /// set name of a tag, name should be a literal
+    static void setTagName(int tag, const char* name);
+    static const char* getTagName(int tag);
+
+    /// get totals of a tag
+    static ccMemoryTagStats getTagStats(int tag);
+
+    /// tag of current thread
+    static int getCurrentTag();
+    static void setCurrentTag(int tag);
+
+    /// take a snapshot of live records, caller should delete it
+    static CCMemorySnapshot* takeSnapshot();
+
+    /**
+     * print what are allocated after older snapshot and still alive in newer snapshot,
+     * grouped by allocation site and object class, biggest first
+     *
+     * @param maxLines max count of groups printed for allocations and objects each
+     */
+    static void dumpGrowth(const CCMemorySnapshot* older, const CCMemorySnapshot* newer, int maxLines = 20);
     
     /**
-     * start to track an object reference count
+     * start to track an object reference count, CCObject calls it in constructor
+     *
+     * @param name class name, NULL means type name of object is used
      */
-    static void trackCCObject(CCObject* obj, std::string name);
+    static void trackCCObject(CCObject* obj, const char* name = NULL);
     
     /// unregister CCObject
     static void untrackCCObject(CCObject* obj);
@@ -105,6 +222,26 @@ public:
     static void trackAutorelease(CCObject* obj, const char* file, int line);
 };
 
+/**
+ * Set tag of current thread in a scope, use it by CC_MEMORY_TAG
+ *
+ * @since v2.2
+ */
+class CC_DLL CCMemoryTagScope {
+public:
+    CCMemoryTagScope(int tag) :
+    m_oldTag(CCMemory::getCurrentTag()) {
+        CCMemory::setCurrentTag(tag);
+    }
+
+    ~CCMemoryTagScope() {
+        CCMemory::setCurrentTag(m_oldTag);
+    }
+
+private:
+    int m_oldTag;
+};
+
 NS_CC_END
 
 #endif // __CCMemory_h__
@@ -23,6 +23,15 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 ****************************************************************************/
 #include "CCProfiling.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <map>
+
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_IOS) || (CC_TARGET_PLATFORM == CC_PLATFORM_MAC)
+#include <mach/mach_time.h>
+#endif
 
 using namespace std;
 
@@ -37,9 +46,179 @@ bool kCCProfilerCategorySprite = false;
 bool kCCProfilerCategoryBatchSprite = false;
 bool kCCProfilerCategoryParticles = false;
 
+// a stopped zone
+typedef struct _ProfilingEvent
+{
+    unsigned int zone;
+    unsigned int depth;
+    // nanoseconds
+    long long start;
+    long long duration;
+} ProfilingEvent;
+
+typedef struct _ZoneStats
+{
+    unsigned int calls;
+    long long total;
+    long long minTime;
+    long long maxTime;
+    // average of this and last average
+    long long average;
+} ZoneStats;
+
+// profiling data of a thread, only written by its thread
+typedef struct _ProfilingThread
+{
+    unsigned int tid;
+    string name;
+    // false after thread exits, then it is given to next new thread
+    bool alive;
+
+    // started zones
+    unsigned int depth;
+    unsigned int stackZones[kCCProfilerMaxDepth];
+    long long stackStarts[kCCProfilerMaxDepth];
+
+    ZoneStats stats[kCCProfilerMaxZones];
+
+    // ring buffer of stopped zones, head is count of zones ever written
+    ProfilingEvent events[kCCProfilerRingSize];
+    volatile unsigned int head;
+} ProfilingThread;
+
+static pthread_once_t s_profilingOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t s_threadKey;
+
+// guards thread list and zone names
+static pthread_mutex_t s_profilingMutex;
+static vector<ProfilingThread*> s_threads;
+static unsigned int s_nextThreadId = 0;
+
+static const char* s_zoneNames[kCCProfilerMaxZones];
+static unsigned int s_zoneCount = 0;
+static map<string, unsigned int> s_zoneIds;
+
+// stopped zones are only written into ring buffers when capturing
+static volatile bool s_bRecording = false;
+
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_IOS) || (CC_TARGET_PLATFORM == CC_PLATFORM_MAC)
+static mach_timebase_info_data_t s_timebase;
+#endif
 
 static CCProfiler* g_sSharedProfiler = NULL;
 
+static void releaseThread(void* data)
+{
+    pthread_mutex_lock(&s_profilingMutex);
+    ((ProfilingThread*)data)->alive = false;
+    pthread_mutex_unlock(&s_profilingMutex);
+}
+
+static void initProfiling()
+{
+    pthread_key_create(&s_threadKey, releaseThread);
+    pthread_mutex_init(&s_profilingMutex, NULL);
+
+    // zone 0 collects zones beyond kCCProfilerMaxZones
+    s_zoneNames[0] = "(other zones)";
+    s_zoneCount = 1;
+
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_IOS) || (CC_TARGET_PLATFORM == CC_PLATFORM_MAC)
+    mach_timebase_info(&s_timebase);
+#endif
+}
+
+// monotonic time in nanoseconds
+static inline long long profilingTime()
+{
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_IOS) || (CC_TARGET_PLATFORM == CC_PLATFORM_MAC)
+    return (long long)(mach_absolute_time() * s_timebase.numer / s_timebase.denom);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+#endif
+}
+
+static ProfilingThread* currentThread()
+{
+    pthread_once(&s_profilingOnce, initProfiling);
+
+    ProfilingThread* t = (ProfilingThread*)pthread_getspecific(s_threadKey);
+    if (t)
+    {
+        return t;
+    }
+
+    pthread_mutex_lock(&s_profilingMutex);
+    for (vector<ProfilingThread*>::iterator it = s_threads.begin(); it != s_threads.end(); ++it)
+    {
+        if (!(*it)->alive)
+        {
+            t = *it;
+            break;
+        }
+    }
+    if (!t)
+    {
+        t = new ProfilingThread();
+        s_threads.push_back(t);
+    }
+    t->tid = s_nextThreadId++;
+    t->name.clear();
+    t->alive = true;
+    t->depth = 0;
+    t->head = 0;
+    memset(t->stats, 0, sizeof(t->stats));
+    pthread_mutex_unlock(&s_profilingMutex);
+
+    pthread_setspecific(s_threadKey, t);
+    return t;
+}
+
+static void resetZone(unsigned int zone)
+{
+    for (vector<ProfilingThread*>::iterator it = s_threads.begin(); it != s_threads.end(); ++it)
+    {
+        memset(&(*it)->stats[zone], 0, sizeof(ZoneStats));
+    }
+}
+
+static void writeJsonString(FILE* fp, const char* str)
+{
+    fputc('"', fp);
+    for (const char* p = str; *p; p++)
+    {
+        if (*p == '"' || *p == '\\')
+        {
+            fputc('\\', fp);
+            fputc(*p, fp);
+        }
+        else if ((unsigned char)*p < 0x20)
+        {
+            fprintf(fp, "\\u%04x", *p);
+        }
+        else
+        {
+            fputc(*p, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+// a complete event of chrome trace format, times are nanoseconds since capture begins
+static void writeTraceEvent(FILE* fp, bool& first, const char* name, unsigned int tid, long long start, long long duration)
+{
+    fprintf(fp, first ? "\n" : ",\n");
+    first = false;
+    fprintf(fp, "{\"name\":");
+    writeJsonString(fp, name);
+    fprintf(fp, ",\"cat\":\"cocos2d\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+            tid, start / 1000.0, duration / 1000.0);
+}
+
+// implementation of CCProfiler
+
 CCProfiler* CCProfiler::sharedProfiler(void)
 {
     if (! g_sSharedProfiler)
@@ -51,132 +230,322 @@ CCProfiler* CCProfiler::sharedProfiler(void)
     return g_sSharedProfiler;
 }
 
-CCProfilingTimer* CCProfiler::createAndAddTimerWithName(const char* timerName)
+CCProfiler::CCProfiler()
+: m_uCaptureFrames(0)
 {
-    CCProfilingTimer *t = new CCProfilingTimer();
-    t->initWithName(timerName);
-    m_pActiveTimers->setObject(t, timerName);
-    CC_SAFE_RELEASE(t);
-
-    return t;
 }
 
-void CCProfiler::releaseTimer(const char* timerName)
+CCProfiler::~CCProfiler(void)
 {
-    m_pActiveTimers->removeObjectForKey(timerName);
 }
 
-void CCProfiler::releaseAllTimers()
+bool CCProfiler::init()
 {
-    m_pActiveTimers->removeAllObjects();
+    pthread_once(&s_profilingOnce, initProfiling);
+    return true;
 }
 
-bool CCProfiler::init()
+unsigned int CCProfiler::zoneForName(const char* name)
 {
-    m_pActiveTimers = new CCDictionary();
-    return true;
+    pthread_once(&s_profilingOnce, initProfiling);
+
+    unsigned int zone = 0;
+    pthread_mutex_lock(&s_profilingMutex);
+    map<string, unsigned int>::iterator it = s_zoneIds.find(name);
+    if (it != s_zoneIds.end())
+    {
+        zone = it->second;
+    }
+    else if (s_zoneCount < kCCProfilerMaxZones)
+    {
+        zone = s_zoneCount;
+        s_zoneNames[zone] = strdup(name);
+        s_zoneIds[name] = zone;
+        s_zoneCount++;
+    }
+    else
+    {
+        CCLOG("CCProfiler: too many zones, %s is merged into other zones", name);
+    }
+    pthread_mutex_unlock(&s_profilingMutex);
+
+    return zone;
 }
 
-CCProfiler::~CCProfiler(void)
+void CCProfiler::setThreadName(const char* name)
 {
-    CC_SAFE_RELEASE(m_pActiveTimers);
+    ProfilingThread* t = currentThread();
+    pthread_mutex_lock(&s_profilingMutex);
+    t->name = name;
+    pthread_mutex_unlock(&s_profilingMutex);
 }
 
-void CCProfiler::displayTimers()
+void CCProfiler::releaseTimer(const char* timerName)
 {
-    CCDictElement* pElement = NULL;
-    CCDICT_FOREACH(m_pActiveTimers, pElement)
+    pthread_once(&s_profilingOnce, initProfiling);
+
+    pthread_mutex_lock(&s_profilingMutex);
+    map<string, unsigned int>::iterator it = s_zoneIds.find(timerName);
+    if (it != s_zoneIds.end())
     {
-        CCProfilingTimer* timer = (CCProfilingTimer*)pElement->getObject();
-        CCLog("%s", timer->description());
+        resetZone(it->second);
     }
+    pthread_mutex_unlock(&s_profilingMutex);
 }
 
-// implementation of CCProfilingTimer
-
-bool CCProfilingTimer::initWithName(const char* timerName)
+void CCProfiler::releaseAllTimers()
 {
-    m_NameStr = timerName;
-    return true;
+    pthread_once(&s_profilingOnce, initProfiling);
+
+    pthread_mutex_lock(&s_profilingMutex);
+    for (unsigned int zone = 0; zone < s_zoneCount; zone++)
+    {
+        resetZone(zone);
+    }
+    pthread_mutex_unlock(&s_profilingMutex);
 }
 
-CCProfilingTimer::CCProfilingTimer()
-: numberOfCalls(0)
-, m_dAverageTime1(0)
-, m_dAverageTime2(0)
-, totalTime(0)
-, minTime(100000000)
-, maxTime(0)
-{}
+void CCProfiler::displayTimers()
+{
+    pthread_once(&s_profilingOnce, initProfiling);
 
+    pthread_mutex_lock(&s_profilingMutex);
+    for (unsigned int zone = 0; zone < s_zoneCount; zone++)
+    {
+        // merge statistics of all threads, they are read while other threads may be updating them
+        ZoneStats merged;
+        memset(&merged, 0, sizeof(merged));
+        unsigned int threads = 0;
+        for (vector<ProfilingThread*>::iterator it = s_threads.begin(); it != s_threads.end(); ++it)
+        {
+            ZoneStats stats = (*it)->stats[zone];
+            if (stats.calls == 0)
+            {
+                continue;
+            }
+            merged.minTime = threads == 0 ? stats.minTime : MIN(merged.minTime, stats.minTime);
+            merged.maxTime = MAX(merged.maxTime, stats.maxTime);
+            merged.calls += stats.calls;
+            merged.total += stats.total;
+            merged.average += stats.average;
+            threads++;
+        }
+        if (threads == 0)
+        {
+            continue;
+        }
+
+        CCLog("%s ::\tavg1: %dµ,\tavg2: %dµ,\tmin: %dµ,\tmax: %dµ,\ttotal: %.2fs,\tnr calls: %d,\tthreads: %d",
+              s_zoneNames[zone],
+              (int)(merged.average / threads / 1000),
+              (int)(merged.total / merged.calls / 1000),
+              (int)(merged.minTime / 1000),
+              (int)(merged.maxTime / 1000),
+              merged.total / 1000000000.,
+              merged.calls,
+              threads);
+    }
+    pthread_mutex_unlock(&s_profilingMutex);
+}
 
-CCProfilingTimer::~CCProfilingTimer(void)
+void CCProfiler::captureFrames(unsigned int frames, const char* path)
 {
-    
+    s_bRecording = false;
+    m_vFrameStarts.clear();
+    m_uCaptureFrames = frames;
+    m_sCapturePath = path ? path : "";
 }
 
-const char* CCProfilingTimer::description()
+void CCProfiler::beginFrame()
 {
-    static char s_desciption[512] = {0};
-    
-    sprintf(s_desciption, "%s ::\tavg1: %dµ,\tavg2: %dµ,\tmin: %dµ,\tmax: %dµ,\ttotal: %.2fs,\tnr calls: %d", m_NameStr.c_str(), m_dAverageTime1, m_dAverageTime2, minTime, maxTime, totalTime/1000000., numberOfCalls);
-    return s_desciption;
+    ProfilingThread* t = currentThread();
+    if (t->name.empty())
+    {
+        setThreadName("gl");
+    }
+
+    if (m_uCaptureFrames == 0)
+    {
+        return;
+    }
+
+    // capture begins with this frame
+    if (m_vFrameStarts.empty())
+    {
+        s_bRecording = true;
+    }
+    m_vFrameStarts.push_back(profilingTime());
+
+    if (m_vFrameStarts.size() > m_uCaptureFrames)
+    {
+        s_bRecording = false;
+        writeTrace();
+        m_vFrameStarts.clear();
+        m_uCaptureFrames = 0;
+    }
 }
 
-void CCProfilingTimer::reset()
+bool CCProfiler::writeTrace()
 {
-    numberOfCalls = 0;
-    m_dAverageTime1 = 0;
-    m_dAverageTime2 = 0;
-    totalTime = 0;
-    minTime = 100000000;
-    maxTime = 0;
-    gettimeofday((struct timeval*)&m_sStartTime, NULL);
+    FILE* fp = fopen(m_sCapturePath.c_str(), "w");
+    if (!fp)
+    {
+        CCLOG("CCProfiler: can't write trace to %s", m_sCapturePath.c_str());
+        return false;
+    }
+
+    long long begin = m_vFrameStarts.front();
+    long long end = m_vFrameStarts.back();
+    unsigned int tid = currentThread()->tid;
+    bool first = true;
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    // frames contain zones of gl thread
+    for (unsigned int i = 0; i + 1 < m_vFrameStarts.size(); i++)
+    {
+        writeTraceEvent(fp, first, "Frame", tid, m_vFrameStarts[i] - begin, m_vFrameStarts[i + 1] - m_vFrameStarts[i]);
+    }
+
+    pthread_mutex_lock(&s_profilingMutex);
+    for (vector<ProfilingThread*>::iterator it = s_threads.begin(); it != s_threads.end(); ++it)
+    {
+        ProfilingThread* t = *it;
+
+        // head is increased after its zone is written, barrier pairs with the one in
+        // CCProfilingEndZone so zones before head are complete. Slot of head may be
+        // being written, so it is left out
+        unsigned int head = t->head;
+        __sync_synchronize();
+        unsigned int tail = head >= kCCProfilerRingSize ? head - kCCProfilerRingSize + 1 : 0;
+        if (tail == head)
+        {
+            continue;
+        }
+
+        fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", t->tid);
+        if (t->name.empty())
+        {
+            char name[32];
+            sprintf(name, "thread %u", t->tid);
+            writeJsonString(fp, name);
+        }
+        else
+        {
+            writeJsonString(fp, t->name.c_str());
+        }
+        fprintf(fp, "}}");
+
+        // if ring wrapped, oldest kept zone tells whether lost zones are in capture
+        bool overflowChecked = tail == 0;
+        for (unsigned int i = tail; i != head; i++)
+        {
+            // thread may still write zones stopped before recording is off, a zone is
+            // copied then dropped if writer reached its slot meanwhile
+            ProfilingEvent e = t->events[i & (kCCProfilerRingSize - 1)];
+            __sync_synchronize();
+            if (t->head - i >= kCCProfilerRingSize)
+            {
+                continue;
+            }
+            if (!overflowChecked)
+            {
+                overflowChecked = true;
+                if (e.start > begin)
+                {
+                    CCLOG("CCProfiler: zones of thread %u overflowed, oldest ones are lost", t->tid);
+                }
+            }
+            long long start = MAX(e.start, begin);
+            long long stop = MIN(e.start + e.duration, end);
+            if (stop < start)
+            {
+                continue;
+            }
+            writeTraceEvent(fp, first, s_zoneNames[e.zone], t->tid, start - begin, stop - start);
+        }
+    }
+    pthread_mutex_unlock(&s_profilingMutex);
+
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+
+    CCLOG("CCProfiler: %u frames are saved to %s", (unsigned int)m_vFrameStarts.size() - 1, m_sCapturePath.c_str());
+    return true;
 }
 
-void CCProfilingBeginTimingBlock(const char *timerName)
+// zones
+
+void CCProfilingBeginZone(unsigned int zone)
 {
-    CCProfiler* p = CCProfiler::sharedProfiler();
-    CCProfilingTimer* timer = (CCProfilingTimer*)p->m_pActiveTimers->objectForKey(timerName);
-    if( ! timer )
+    ProfilingThread* t = currentThread();
+    if (t->depth < kCCProfilerMaxDepth)
     {
-        timer = p->createAndAddTimerWithName(timerName);
-    }
+        t->stackZones[t->depth] = zone;
 
-    // must the be last thing to execute
-    timer->numberOfCalls++;
-    gettimeofday((struct timeval*)&timer->m_sStartTime, NULL);
+        // must the be last thing to execute
+        t->stackStarts[t->depth] = profilingTime();
+    }
+    t->depth++;
 }
 
-void CCProfilingEndTimingBlock(const char *timerName)
+void CCProfilingEndZone(unsigned int zone)
 {
     // must the be 1st thing to execute
-    struct timeval now;
-    gettimeofday( &now, NULL);
+    long long now = profilingTime();
 
-    CCProfiler* p = CCProfiler::sharedProfiler();
-    CCProfilingTimer* timer = (CCProfilingTimer*)p->m_pActiveTimers->objectForKey(timerName);
+    ProfilingThread* t = currentThread();
+    CCAssert(t->depth > 0, "CCProfiler: zone is not started");
+    if (t->depth == 0)
+    {
+        return;
+    }
+
+    // zones too deep are not recorded
+    unsigned int depth = --t->depth;
+    if (depth >= kCCProfilerMaxDepth)
+    {
+        return;
+    }
+    CCAssert(t->stackZones[depth] == zone, "CCProfiler: zones must be stopped in reverse order");
 
-    CCAssert(timer, "CCProfilingTimer  not found");
-    
-    int duration = 1000000 * (now.tv_sec - timer->m_sStartTime.tv_sec) + (now.tv_usec - timer->m_sStartTime.tv_usec);
+    long long start = t->stackStarts[depth];
+    long long duration = now - start;
 
-    timer->totalTime += duration;
-    timer->m_dAverageTime1 = (timer->m_dAverageTime1 + duration) / 2.0f;
-    timer->m_dAverageTime2 = timer->totalTime / timer->numberOfCalls;
-    timer->maxTime = MAX( timer->maxTime, duration);
-    timer->minTime = MIN( timer->minTime, duration);
+    ZoneStats& stats = t->stats[zone];
+    stats.minTime = stats.calls == 0 ? duration : MIN(stats.minTime, duration);
+    stats.maxTime = MAX(stats.maxTime, duration);
+    stats.average = (stats.average + duration) / 2;
+    stats.total += duration;
+    stats.calls++;
+
+    if (s_bRecording)
+    {
+        ProfilingEvent& e = t->events[t->head & (kCCProfilerRingSize - 1)];
+        e.zone = zone;
+        e.depth = depth;
+        e.start = start;
+        e.duration = duration;
+
+        // zone must be written before it is counted
+        __sync_synchronize();
+        t->head++;
+    }
 }
 
-void CCProfilingResetTimingBlock(const char *timerName)
+void CCProfilingBeginTimingBlock(const char *timerName)
 {
-    CCProfiler* p = CCProfiler::sharedProfiler();
-    CCProfilingTimer *timer = (CCProfilingTimer*)p->m_pActiveTimers->objectForKey(timerName);
+    CCProfilingBeginZone(CCProfiler::zoneForName(timerName));
+}
 
-    CCAssert(timer, "CCProfilingTimer not found");
+void CCProfilingEndTimingBlock(const char *timerName)
+{
+    CCProfilingEndZone(CCProfiler::zoneForName(timerName));
+}
 
-    timer->reset();
+void CCProfilingResetTimingBlock(const char *timerName)
+{
+    CCProfiler::sharedProfiler()->releaseTimer(timerName);
 }
 
 NS_CC_END
-
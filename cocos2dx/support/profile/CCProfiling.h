@@ -30,6 +30,7 @@ THE SOFTWARE.
 #include "platform/platform.h"
 #include "cocoa/CCDictionary.h"
 #include <string>
+#include <vector>
 
 NS_CC_BEGIN
 
@@ -38,11 +39,27 @@ NS_CC_BEGIN
  * @{
  */
 
-class CCProfilingTimer;
+enum {
+    /** zones kept by each thread for capturing */
+    kCCProfilerRingSize = 16384,
+    /** max different zone names, zones beyond it are merged into one */
+    kCCProfilerMaxZones = 512,
+    /** max nesting depth of zones in a thread */
+    kCCProfilerMaxDepth = 64,
+};
 
 /** CCProfiler
  cocos2d builtin profiler.
 
+ Code is measured in zones. A zone is a named block which can be nested in other zones,
+ it is started and stopped with the CC_PROFILER_* macros. Zone names are interned once per
+ call site, so a zone costs two reads of a monotonic clock and a write into a buffer of the
+ current thread. Zones work in any thread.
+
+ Statistics of each zone are shown by displayTimers. Zones of a few frames can be captured
+ with captureFrames and saved as Chrome trace JSON, open it in chrome://tracing to see the
+ zones of all threads on a timeline.
+
  To use it, enable set the CC_ENABLE_PROFILERS=1 in the ccConfig.h file
  *@js NA
  *@lua NA
@@ -51,47 +68,78 @@ class CCProfilingTimer;
 class CC_DLL CCProfiler : public CCObject
 {
 public:
+    CCProfiler();
     ~CCProfiler(void);
-    /** display the timers */
+    /** display statistics of zones, merged over all threads */
     void displayTimers(void);
     bool init(void);
 
 public:
     static CCProfiler* sharedProfiler(void);
-    /** Creates and adds a new timer */
-    CCProfilingTimer* createAndAddTimerWithName(const char* timerName);
-    /** releases a timer */
+    /** resets statistics of a zone */
     void releaseTimer(const char* timerName);
-    /** releases all timers */
+    /** resets statistics of all zones */
     void releaseAllTimers();
 
-    CCDictionary* m_pActiveTimers;
+    /** Id of a zone name, same name always gets same id. Looking up is slow, so the macros
+     do it once per call site, the name of a call site must not change
+     @since v2.2
+     */
+    static unsigned int zoneForName(const char* name);
+
+    /** name of current thread shown in traces
+     @since v2.2
+     */
+    static void setThreadName(const char* name);
+
+    /** marks beginning of a frame, called by director in gl thread
+     @since v2.2
+     */
+    void beginFrame();
+
+    /** Records zones of next frames and saves them to path as Chrome trace JSON after
+     last frame. Each thread keeps last kCCProfilerRingSize zones, a capture longer than
+     that loses oldest zones
+     @since v2.2
+     */
+    void captureFrames(unsigned int frames, const char* path);
+
+    /** whether a capture is pending or in progress
+     @since v2.2
+     */
+    bool isCapturing() { return m_uCaptureFrames > 0; }
+
+private:
+    bool writeTrace();
+
+private:
+    // frames requested, 0 if not capturing
+    unsigned int m_uCaptureFrames;
+    std::string m_sCapturePath;
+    // start time of captured frames, empty before capture begins
+    std::vector<long long> m_vFrameStarts;
 };
-/**
- *@js NA
- *@lua NA
+
+/** starts and stops a zone of id returned by CCProfiler::zoneForName, zones must be stopped in reverse order
+ @since v2.2
  */
-class CCProfilingTimer : public CCObject
+extern CC_DLL void CCProfilingBeginZone(unsigned int zone);
+extern CC_DLL void CCProfilingEndZone(unsigned int zone);
+
+/** stops a zone when going out of scope
+ @since v2.2
+ */
+class CC_DLL CCProfilingScope
 {
 public:
-    CCProfilingTimer();
-    ~CCProfilingTimer();
-    bool initWithName(const char* timerName);
-    const char* description(void);
-    struct cc_timeval* getStartTime(void) { return &m_sStartTime; };
-    /** resets the timer properties */
-    void reset();
-
-    std::string m_NameStr;
-    int               numberOfCalls;
-    int               m_dAverageTime1;
-    int               m_dAverageTime2;
-    long long         totalTime;
-    int               minTime;
-    int               maxTime;
-    struct cc_timeval m_sStartTime;
+    CCProfilingScope(unsigned int zone) : m_uZone(zone) { CCProfilingBeginZone(zone); }
+    ~CCProfilingScope() { CCProfilingEndZone(m_uZone); }
+
+private:
+    unsigned int m_uZone;
 };
 
+/** start and stop a zone by name, they look up the name on every call */
 extern CC_DLL void CCProfilingBeginTimingBlock(const char *timerName);
 extern CC_DLL void CCProfilingEndTimingBlock(const char *timerName);
 extern CC_DLL void CCProfilingResetTimingBlock(const char *timerName);
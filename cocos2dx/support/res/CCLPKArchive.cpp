@@ -0,0 +1,181 @@
+/****************************************************************************
+ Author: Luma (stubma@gmail.com)
+ 
+ https://github.com/stubma/cocos2dx-classical
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#include "CCLPKArchive.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+
+NS_CC_BEGIN
+
+// read exactly size bytes at offset, pread may return less than asked
+static bool preadFully(int fd, void* buf, size_t size, off_t offset) {
+    uint8_t* p = (uint8_t*)buf;
+    while(size > 0) {
+        ssize_t r = pread(fd, p, size, offset);
+        if(r < 0 && errno == EINTR)
+            continue;
+        if(r <= 0)
+            return false;
+        p += r;
+        size -= r;
+        offset += r;
+    }
+    return true;
+}
+
+CCLPKArchive::CCLPKArchive() :
+m_fd(-1),
+m_mapped(NULL),
+m_mappedSize(0),
+m_keyFunc(NULL) {
+    memset(&m_lpk, 0, sizeof(lpk_file));
+}
+
+CCLPKArchive::~CCLPKArchive() {
+    if(m_mapped) {
+        munmap(m_mapped, m_mappedSize);
+    }
+    if(m_fd >= 0) {
+        close(m_fd);
+    }
+    free(m_lpk.het);
+}
+
+CCLPKArchive* CCLPKArchive::open(const std::string& path, const std::string& key, CCLPKKeyFunc keyFunc) {
+    CCLPKArchive* a = new CCLPKArchive();
+    a->m_path = path;
+    a->m_key = key;
+    a->m_keyFunc = keyFunc;
+    
+    do {
+        // open
+        a->m_fd = ::open(path.c_str(), O_RDONLY);
+        if(a->m_fd < 0)
+            break;
+        struct stat st;
+        if(fstat(a->m_fd, &st) != 0 || (size_t)st.st_size < sizeof(lpk_header))
+            break;
+        
+        // header
+        lpk_header& h = a->m_lpk.h;
+        if(!preadFully(a->m_fd, &h, sizeof(lpk_header), 0))
+            break;
+        if(h.lpk_magic != LPK_MAGIC || h.hash_table_count == 0 || (h.hash_table_count & (h.hash_table_count - 1)) != 0)
+            break;
+        size_t hashTableSize = h.hash_table_count * sizeof(lpk_hash);
+        if((uint64_t)h.hash_table_offset + hashTableSize > (uint64_t)st.st_size)
+            break;
+        
+        // hash table is copied out so it stays valid and aligned no matter how data is read
+        a->m_lpk.het = (lpk_hash*)malloc(hashTableSize);
+        if(!a->m_lpk.het || !preadFully(a->m_fd, a->m_lpk.het, hashTableSize, h.hash_table_offset))
+            break;
+        
+        // map whole archive, if address space is not enough, fall back to pread
+        void* p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, a->m_fd, 0);
+        if(p != MAP_FAILED) {
+            a->m_mapped = (uint8_t*)p;
+            a->m_mappedSize = st.st_size;
+        }
+        
+        return a;
+    } while(0);
+    
+    CCLOGWARN("CCLPKArchive: failed to open %s", path.c_str());
+    delete a;
+    return NULL;
+}
+
+uint32_t CCLPKArchive::findEntry(const std::string& filename, uint16_t locale, LPKPlatform platform) {
+    const char* name = filename.c_str();
+    uint32_t index = lpk_get_file_hash_table_index(&m_lpk, name, locale, platform);
+    if(index == LPK_INDEX_INVALID && platform != LPKP_DEFAULT)
+        index = lpk_get_file_hash_table_index(&m_lpk, name, locale, LPKP_DEFAULT);
+    if(index == LPK_INDEX_INVALID && locale != 0) {
+        if(platform != LPKP_DEFAULT)
+            index = lpk_get_file_hash_table_index(&m_lpk, name, 0, platform);
+        if(index == LPK_INDEX_INVALID)
+            index = lpk_get_file_hash_table_index(&m_lpk, name, 0, LPKP_DEFAULT);
+    }
+    return index;
+}
+
+unsigned char* CCLPKArchive::readEntry(uint32_t index, const std::string& filename, size_t* pSize) {
+    if(pSize)
+        *pSize = 0;
+    lpk_hash* hash = m_lpk.het + index;
+    if(!(hash->flags & LPK_FLAG_USED) || (hash->flags & LPK_FLAG_DELETED))
+        return NULL;
+    
+    // locate packed data
+    uint64_t offset = (uint64_t)hash->offset + sizeof(lpk_header);
+    bool plain = !(hash->flags & (LPK_FLAG_COMPRESSED | LPK_FLAG_ENCRYPTED));
+    if(plain && hash->packed_size != hash->file_size)
+        return NULL;
+    const uint8_t* packed = NULL;
+    uint8_t* readBuf = NULL;
+    unsigned char* data = new unsigned char[hash->file_size > 0 ? hash->file_size : 1];
+    if(m_mapped) {
+        if(offset + hash->packed_size > m_mappedSize) {
+            delete[] data;
+            return NULL;
+        }
+        packed = m_mapped + offset;
+    } else {
+        // plain file can be read straight into result buffer
+        readBuf = plain ? data : (uint8_t*)malloc(hash->packed_size);
+        if(!readBuf || !preadFully(m_fd, readBuf, hash->packed_size, (off_t)offset)) {
+            if(readBuf != data)
+                free(readBuf);
+            delete[] data;
+            return NULL;
+        }
+        packed = readBuf;
+    }
+    
+    // unpack
+    int result = LPK_SUCCESS;
+    if(plain) {
+        if(packed != data)
+            memcpy(data, packed, hash->file_size);
+    } else {
+        std::string key = m_keyFunc ? (*m_keyFunc)(filename) : m_key;
+        result = lpk_unpack_data(hash, packed, key.c_str(), (uint32_t)key.length(), data);
+    }
+    if(readBuf != data)
+        free(readBuf);
+    if(result != LPK_SUCCESS) {
+        CCLOGWARN("CCLPKArchive: failed to unpack %s from %s, error %d", filename.c_str(), m_path.c_str(), result);
+        delete[] data;
+        return NULL;
+    }
+    
+    if(pSize)
+        *pSize = hash->file_size;
+    return data;
+}
+
+NS_CC_END
@@ -0,0 +1,113 @@
+/****************************************************************************
+ Author: Luma (stubma@gmail.com)
+ 
+ https://github.com/stubma/cocos2dx-classical
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#ifndef __CCLPKArchive_h__
+#define __CCLPKArchive_h__
+
+#include "CCPlatformMacros.h"
+#include "lpk.h"
+#include <string>
+
+NS_CC_BEGIN
+
+/**
+ * a function returns decrypt key of one file in archive, it should match the dynamic
+ * key generation of lpk tool which packed the archive
+ */
+typedef std::string (*CCLPKKeyFunc)(const std::string& filename);
+
+/**
+ * A read only lpk archive mounted by CCFileUtils. Header and hash table are loaded
+ * once when archive is opened and never change after that. File data is read from
+ * a read only mapping of archive, or with pread if mapping fails, so lookup and read
+ * can be called from any thread at same time without locking.
+ *
+ * @since v2.2
+ */
+class CC_DLL CCLPKArchive {
+protected:
+    CCLPKArchive();
+    
+public:
+    virtual ~CCLPKArchive();
+    
+    /**
+     * open an archive
+     *
+     * @param path full path of archive file
+     * @param key decrypt key for encrypted files, can be empty if no file is encrypted
+     * @param keyFunc optional, if set, it is used to get decrypt key of a file and key is ignored
+     * @return archive, or NULL if file can't be opened or it is not a lpk archive. Caller should
+     *      delete it when done
+     */
+    static CCLPKArchive* open(const std::string& path, const std::string& key = "", CCLPKKeyFunc keyFunc = NULL);
+    
+    /**
+     * find entry of a file. It tries exact locale and platform first, then falls back to
+     * default platform, then default locale
+     *
+     * @param filename relative path of file in archive
+     * @return hash index of entry, or LPK_INDEX_INVALID if archive doesn't have this file.
+     *      A deleted entry is returned too, use isDeleted to check it
+     */
+    uint32_t findEntry(const std::string& filename, uint16_t locale, LPKPlatform platform);
+    
+    /// true if entry is marked deleted, in a patch archive it hides the file in archives mounted before
+    bool isDeleted(uint32_t index) { return (m_lpk.het[index].flags & LPK_FLAG_DELETED) != 0; }
+    
+    /// unpacked size of an entry
+    uint32_t getFileSize(uint32_t index) { return m_lpk.het[index].file_size; }
+    
+    /**
+     * read and unpack an entry
+     *
+     * @param index hash index returned by findEntry
+     * @param filename relative path of file, used to get dynamic key
+     * @param pSize output of data size, set to 0 if failed
+     * @return data, caller should delete[] it. NULL if failed
+     */
+    unsigned char* readEntry(uint32_t index, const std::string& filename, size_t* pSize);
+    
+    /// full path of archive file
+    const std::string& getPath() { return m_path; }
+    
+private:
+    /// archive header and hash table, fp is not used
+    lpk_file m_lpk;
+    
+    /// archive file
+    std::string m_path;
+    int m_fd;
+    
+    /// whole archive mapping, NULL if mapping failed
+    uint8_t* m_mapped;
+    size_t m_mappedSize;
+    
+    /// static key and dynamic key function
+    std::string m_key;
+    CCLPKKeyFunc m_keyFunc;
+};
+
+NS_CC_END
+
+#endif // __CCLPKArchive_h__
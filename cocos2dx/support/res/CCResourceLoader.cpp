@@ -26,6 +26,13 @@
 #include "CCArmatureDataManager.h"
 #include "support/utils/CCUtils.h"
 #include "CCDirector.h"
+#include "platform/CCThread.h"
+#include "platform/CCFileView.h"
+#include "support/profile/CCProfiling.h"
+#include <pthread.h>
+#include <unistd.h>
+#include <deque>
+#include <algorithm>
 
 using namespace CocosDenshion;
 USING_NS_CC_EXT;
@@ -35,6 +42,159 @@ NS_CC_BEGIN
 bool CCResourceLoader::s_resolveExternal = true;
 static CCArray sActiveLoaders;
 
+// default load budget of a tick, in milliseconds
+#define DEFAULT_LOAD_BUDGET 8.0f
+
+// max tasks prepared ahead of loading, it limits memory of decoded images
+#define MAX_PREPARE_AHEAD 16
+
+// max loading threads
+#define MAX_PREPARE_THREADS 4
+
+// loading threads shared by all loaders, they sleep when there is no task
+static int sPrepareThreadCount = 0;
+static pthread_t sPrepareThreads[MAX_PREPARE_THREADS];
+static bool sPrepareStopping = false;
+static pthread_mutex_t sPrepareMutex;
+static pthread_cond_t sTaskQueuedCondition;
+static pthread_cond_t sTaskPreparedCondition;
+static deque<CCResourceLoadTask*> sPrepareQueue;
+
+static void* prepareLoop(void* arg) {
+    CC_PROFILER_THREAD_NAME("resource loader");
+    
+    pthread_mutex_lock(&sPrepareMutex);
+    while(!sPrepareStopping) {
+        if(sPrepareQueue.empty()) {
+            pthread_cond_wait(&sTaskQueuedCondition, &sPrepareMutex);
+            continue;
+        }
+        
+        CCResourceLoadTask* t = sPrepareQueue.front();
+        sPrepareQueue.pop_front();
+        t->state = CCResourceLoadTask::PREPARING;
+        pthread_mutex_unlock(&sPrepareMutex);
+        
+        {
+            // create autorelease pool for iOS
+            CCThread thread;
+            thread.createAutoreleasePool();
+            
+            CC_PROFILER_ZONE("CCResourceLoader - prepare");
+            t->prepare();
+        }
+        
+        pthread_mutex_lock(&sPrepareMutex);
+        t->state = CCResourceLoadTask::PREPARED;
+        pthread_cond_broadcast(&sTaskPreparedCondition);
+    }
+    pthread_mutex_unlock(&sPrepareMutex);
+    return NULL;
+}
+
+static void startPrepareThreads() {
+    if(sPrepareThreadCount > 0)
+        return;
+    
+    pthread_mutex_init(&sPrepareMutex, NULL);
+    pthread_cond_init(&sTaskQueuedCondition, NULL);
+    pthread_cond_init(&sTaskPreparedCondition, NULL);
+    
+    // leave one core for OpenGL thread
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int count = MIN(MAX((int)cores - 1, 1), MAX_PREPARE_THREADS);
+    sPrepareStopping = false;
+    for(sPrepareThreadCount = 0; sPrepareThreadCount < count; sPrepareThreadCount++) {
+        pthread_create(&sPrepareThreads[sPrepareThreadCount], NULL, prepareLoop, NULL);
+    }
+}
+
+// resolve in OpenGL thread because path caches of CCFileUtils are not locked, a missing
+// file fails here so loading threads only see full paths, or names of files in mounted
+// archives which are looked up without path caches, and never probe search paths
+static string resolveFullPath(const string& name) {
+    CCFileUtils* fu = CCFileUtils::sharedFileUtils();
+    string fullPath = fu->fullPathForFilename(name.c_str());
+    if(!fu->isAbsolutePath(fullPath) && !fu->isFileExist(fullPath)) {
+        CCLOGWARN("CCResourceLoader: %s is not found", name.c_str());
+        return "";
+    }
+    return fullPath;
+}
+
+// pvr and etc are uploaded as they are, other images need decoding
+static bool isDecodableImage(const string& name) {
+    string lowerCase(name);
+    for (unsigned int i = 0; i < lowerCase.length(); ++i) {
+        lowerCase[i] = tolower(lowerCase[i]);
+    }
+    return lowerCase.find(".pvr") == string::npos && lowerCase.find(".pkm") == string::npos;
+}
+
+// read, decrypt and decode an image, it is thread safe if path is full path and gResDecrypt is thread safe
+static CCImage* decodeImage(const string& fullPath) {
+    // load encryptd data, decryption and decoders only read it so a mapped view is enough
+    CCFileView* view = CCFileUtils::sharedFileUtils()->openFileView(fullPath.c_str());
+    if(!view)
+        return NULL;
+    const char* data = (const char*)view->getBytes();
+    
+    // create image
+    int decLen;
+    const char* dec = NULL;
+    if(gResDecrypt) {
+        dec = (*gResDecrypt)(data, (int)view->getSize(), &decLen);
+    } else {
+        dec = data;
+        decLen = (int)view->getSize();
+    }
+    CCImage* image = new CCImage();
+    if(!image->initWithImageData((void*)dec, decLen)) {
+        CC_SAFE_RELEASE_NULL(image);
+    }
+    
+    // free
+    if(dec != data)
+        free((void*)dec);
+    view->release();
+    
+    return image;
+}
+
+// create texture in OpenGL thread, image is decoded now if it isn't prepared
+static CCTexture2D* loadTexture(const string& name, CCImage* image) {
+    CCTextureCache* tc = CCTextureCache::sharedTextureCache();
+    if(!isDecodableImage(name)) {
+        string lowerCase(name);
+        for (unsigned int i = 0; i < lowerCase.length(); ++i) {
+            lowerCase[i] = tolower(lowerCase[i]);
+        }
+        if(lowerCase.find(".pvr") != string::npos) {
+            return tc->addPVRImage(name.c_str());
+        } else {
+            return tc->addETCImage(name.c_str());
+        }
+    }
+    
+    if(!image) {
+        CCTexture2D* tex = tc->textureForKey(name.c_str());
+        if(tex)
+            return tex;
+        string fullPath = resolveFullPath(name);
+        image = fullPath.empty() ? NULL : decodeImage(fullPath);
+        if(!image)
+            return NULL;
+        CC_SAFE_AUTORELEASE(image);
+    }
+    
+    // decrypted image can't be reloaded from file, so texture cache must keep it
+    if(gResDecrypt) {
+        return tc->addUIImage(image, name.c_str());
+    } else {
+        return tc->addDecodedImage(name.c_str(), image);
+    }
+}
+
 void AnimLoadTask::load() {
     if(!CCAnimationCache::sharedAnimationCache()->animationByName(name.c_str())) {
         CCTextureCache* tc = CCTextureCache::sharedTextureCache();
@@ -104,48 +264,57 @@ void AtlasAnimLoadTask::load() {
     }
 }
 
+ZwoptexLoadTask::~ZwoptexLoadTask() {
+    CC_SAFE_RELEASE(dict);
+    CC_SAFE_RELEASE(sheet);
+    CC_SAFE_RELEASE(image);
+}
+
+void ZwoptexLoadTask::resolve() {
+    plistFullPath = resolveFullPath(name);
+    texFullPath.clear();
+    if(!texName.empty() && isDecodableImage(texName) && !CCTextureCache::sharedTextureCache()->textureForKey(texName.c_str())) {
+        texFullPath = resolveFullPath(texName);
+    }
+}
+
+void ZwoptexLoadTask::prepare() {
+    if(!plistFullPath.empty()) {
+        if(CCSpriteFrameCache::isBinarySheet(plistFullPath.c_str()))
+            sheet = CCFileUtils::sharedFileUtils()->openFileView(plistFullPath.c_str());
+        else
+            dict = CCDictionary::createWithContentsOfFileThreadSafe(plistFullPath.c_str());
+    }
+    if(!texFullPath.empty()) {
+        image = decodeImage(texFullPath);
+    }
+}
+
 void ZwoptexLoadTask::load() {
+    CCSpriteFrameCache* cache = CCSpriteFrameCache::sharedSpriteFrameCache();
     if(texName.empty()) {
-        CCSpriteFrameCache::sharedSpriteFrameCache()->addSpriteFramesWithFile(name.c_str());
+        if(dict)
+            cache->addSpriteFramesWithFile(name.c_str(), dict);
+        else if(sheet)
+            cache->addSpriteFramesWithBinaryData(name.c_str(), sheet->getBytes(), sheet->getSize());
+        else
+            cache->addSpriteFramesWithFile(name.c_str());
     } else {
-        // check pvr, if it is pvr, add it without decryption
-        CCTexture2D* tex = NULL;
-        string lowerCase(texName);
-        for (unsigned int i = 0; i < lowerCase.length(); ++i) {
-            lowerCase[i] = tolower(lowerCase[i]);
-        }
-        if(lowerCase.find(".pvr") != string::npos) {
-            tex = CCTextureCache::sharedTextureCache()->addPVRImage(texName.c_str());
-        } else if(lowerCase.find(".pkm") != string::npos) {
-            tex = CCTextureCache::sharedTextureCache()->addETCImage(texName.c_str());
-        } else {
-            // load encryptd data
-            size_t len;
-            char* data = (char*)CCFileUtils::sharedFileUtils()->getFileData(texName.c_str(), "rb", &len);
-            
-            // create texture
-            int decLen;
-            const char* dec = NULL;
-            if(gResDecrypt) {
-                dec = (*gResDecrypt)(data, len, &decLen);
-            } else {
-                dec = data;
-                decLen = (int)len;
-            }
-            CCImage* image = new CCImage();
-            image->initWithImageData((void*)dec, decLen);
-            CC_SAFE_AUTORELEASE(image);
-            tex = CCTextureCache::sharedTextureCache()->addUIImage(image, texName.c_str());
-            
-            // free
-            if(dec != data)
-                free((void*)dec);
-            free(data);
-        }
+        CCTexture2D* tex = loadTexture(texName, image);
         
         // add zwoptex
-        CCSpriteFrameCache::sharedSpriteFrameCache()->addSpriteFramesWithFile(name.c_str(), tex);
+        if(dict)
+            cache->addSpriteFramesWithFile(name.c_str(), dict, tex);
+        else if(sheet)
+            cache->addSpriteFramesWithBinaryData(name.c_str(), sheet->getBytes(), sheet->getSize(), tex);
+        else
+            cache->addSpriteFramesWithFile(name.c_str(), tex);
     }
+    
+    // prepared data is useless now
+    CC_SAFE_RELEASE_NULL(dict);
+    CC_SAFE_RELEASE_NULL(sheet);
+    CC_SAFE_RELEASE_NULL(image);
 }
 
 void CustomTask::load() {
@@ -155,71 +324,36 @@ void CustomTask::load() {
     }
 }
 
-void ImageLoadTask::load() {
-    if(gResDecrypt) {
-        string lowerCase(name);
-        for (unsigned int i = 0; i < lowerCase.length(); ++i) {
-            lowerCase[i] = tolower(lowerCase[i]);
-        }
-        if(lowerCase.find(".pvr") != string::npos) {
-            CCTextureCache::sharedTextureCache()->addPVRImage(name.c_str());
-        } else if(lowerCase.find(".pkm") != string::npos) {
-            CCTextureCache::sharedTextureCache()->addETCImage(name.c_str());
-        } else {
-            // load encryptd data
-            size_t len;
-            char* data = (char*)CCFileUtils::sharedFileUtils()->getFileData(name.c_str(), "rb", &len);
-            
-            // create texture
-            int decLen;
-            const char* dec = NULL;
-            if(gResDecrypt) {
-                dec = (*gResDecrypt)(data, len, &decLen);
-            } else {
-                dec = data;
-                decLen = (int)len;
-            }
-            CCImage* image = new CCImage();
-            image->initWithImageData((void*)dec, decLen);
-            CC_SAFE_AUTORELEASE(image);
-            CCTextureCache::sharedTextureCache()->addUIImage(image, name.c_str());
-            
-            // free
-            if(dec != data)
-                free((void*)dec);
-            free(data);
-        }
-    } else {
-        CCTextureCache::sharedTextureCache()->addImage(name.c_str());
+ImageLoadTask::~ImageLoadTask() {
+    CC_SAFE_RELEASE(image);
+}
+
+void ImageLoadTask::resolve() {
+    fullPath.clear();
+    if(isDecodableImage(name) && !CCTextureCache::sharedTextureCache()->textureForKey(name.c_str())) {
+        fullPath = resolveFullPath(name);
     }
 }
 
+void ImageLoadTask::prepare() {
+    if(!fullPath.empty()) {
+        image = decodeImage(fullPath);
+    }
+}
+
+void ImageLoadTask::load() {
+    loadTexture(name, image);
+    CC_SAFE_RELEASE_NULL(image);
+}
+
 void BMFontLoadTask::load() {
     if(gResDecrypt) {
         CCBMFontConfiguration* conf = FNTConfigLoadFile(name.c_str());
-        
-        // load encryptd data
-        size_t len;
-        char* data = (char*)CCFileUtils::sharedFileUtils()->getFileData(conf->getAtlasName(), "rb", &len);
-        
-        // create texture
-        int decLen;
-        const char* dec = NULL;
-        if(gResDecrypt) {
-            dec = (*gResDecrypt)(data, len, &decLen);
-        } else {
-            dec = data;
-            decLen = (int)len;
+        CCImage* image = decodeImage(conf->getAtlasName());
+        if(image) {
+            CCTextureCache::sharedTextureCache()->addUIImage(image, conf->getAtlasName());
+            image->release();
         }
-        CCImage* image = new CCImage();
-        image->initWithImageData((void*)dec, decLen);
-        CC_SAFE_AUTORELEASE(image);
-        CCTextureCache::sharedTextureCache()->addUIImage(image, conf->getAtlasName());
-        
-        // free
-        if(dec != data)
-        free((void*)dec);
-        free(data);
     } else {
         CCBMFontConfiguration* conf = FNTConfigLoadFile(name.c_str());
         CCTextureCache::sharedTextureCache()->addImage(conf->getAtlasName());
@@ -240,10 +374,12 @@ void ArmatureTask::load() {
 
 CCResourceLoader::CCResourceLoader(CCResourceLoaderListener* listener) :
 m_listener(listener),
-m_delay(0),
 m_remainingIdle(0),
 m_nextLoad(0),
-m_loading(false) {
+m_nextPrepare(0),
+m_loading(false),
+m_delay(0),
+m_loadBudget(DEFAULT_LOAD_BUDGET) {
     memset(&m_func, 0, sizeof(ccScriptFunction));
     
     // just add it to an array, but not hold it
@@ -253,17 +389,20 @@ m_loading(false) {
 
 CCResourceLoader::CCResourceLoader(ccScriptFunction func) :
 m_listener(NULL),
-m_func(func),
-m_delay(0),
 m_remainingIdle(0),
 m_nextLoad(0),
-m_loading(false) {
+m_nextPrepare(0),
+m_loading(false),
+m_func(func),
+m_delay(0),
+m_loadBudget(DEFAULT_LOAD_BUDGET) {
     // just add it to an array, but not hold it
     sActiveLoaders.addObject(this);
     release();
 }
 
 CCResourceLoader::~CCResourceLoader() {
+    cancelPrepare();
     for(LoadTaskPtrList::iterator iter = m_loadTaskList.begin(); iter != m_loadTaskList.end(); iter++) {
         delete *iter;
     }
@@ -301,6 +440,27 @@ void CCResourceLoader::abortAll() {
     }
 }
 
+void CCResourceLoader::stopLoadingThreads() {
+    if(sPrepareThreadCount == 0)
+        return;
+    
+    // loaders wait for prepared tasks, so they are aborted first
+    abortAll();
+    
+    pthread_mutex_lock(&sPrepareMutex);
+    sPrepareStopping = true;
+    pthread_cond_broadcast(&sTaskQueuedCondition);
+    pthread_mutex_unlock(&sPrepareMutex);
+    for(int i = 0; i < sPrepareThreadCount; i++) {
+        pthread_join(sPrepareThreads[i], NULL);
+    }
+    sPrepareThreadCount = 0;
+    
+    pthread_cond_destroy(&sTaskPreparedCondition);
+    pthread_cond_destroy(&sTaskQueuedCondition);
+    pthread_mutex_destroy(&sPrepareMutex);
+}
+
 void CCResourceLoader::unloadImage(const string& tex) {
     CCTextureCache::sharedTextureCache()->removeTextureForKey(_resolve(tex).c_str());
 }
@@ -413,28 +573,11 @@ void CCResourceLoader::loadImage(const string& name) {
     } else if(lowerCase.find(".pkm") != string::npos) {
         CCTextureCache::sharedTextureCache()->addETCImage(_resolve(name).c_str());
     } else {
-        // load encryptd data
-        size_t len;
-        char* data = (char*)CCFileUtils::sharedFileUtils()->getFileData(_resolve(name).c_str(), "rb", &len);
-        
-        // create texture
-        int decLen;
-        const char* dec = NULL;
-        if(gResDecrypt) {
-            dec = (*gResDecrypt)(data, len, &decLen);
-        } else {
-            dec = data;
-            decLen = (int)len;
+        CCImage* image = decodeImage(_resolve(name));
+        if(image) {
+            CCTextureCache::sharedTextureCache()->addUIImage(image, name.c_str());
+            image->release();
         }
-        CCImage* image = new CCImage();
-        image->initWithImageData((void*)dec, decLen);
-        CC_SAFE_AUTORELEASE(image);
-        CCTextureCache::sharedTextureCache()->addUIImage(image, name.c_str());
-        
-        // free
-        if(dec != data)
-            free((void*)dec);
-        free(data);
     }
 }
 
@@ -465,28 +608,11 @@ void CCResourceLoader::loadZwoptex(const string& plistName, const string& texNam
     } else if(lowerCase.find(".pkm") != string::npos) {
         tex = CCTextureCache::sharedTextureCache()->addETCImage(_resolve(texName).c_str());
     } else {
-        // load encryptd data
-        size_t len;
-        char* data = (char*)CCFileUtils::sharedFileUtils()->getFileData(_resolve(texName).c_str(), "rb", &len);
-        
-        // create texture
-        int decLen;
-        const char* dec = NULL;
-        if(gResDecrypt) {
-            dec = (*gResDecrypt)(data, len, &decLen);
-        } else {
-            dec = data;
-            decLen = (int)len;
+        CCImage* image = decodeImage(_resolve(texName));
+        if(image) {
+            tex = CCTextureCache::sharedTextureCache()->addUIImage(image, _resolve(texName).c_str());
+            image->release();
         }
-        CCImage* image = new CCImage();
-        image->initWithImageData((void*)dec, decLen);
-        CC_SAFE_AUTORELEASE(image);
-        tex = CCTextureCache::sharedTextureCache()->addUIImage(image, _resolve(texName).c_str());
-        
-        // free
-        if(dec != data)
-            free((void*)dec);
-        free(data);
     }
     
     // add zwoptex
@@ -504,19 +630,16 @@ void CCResourceLoader::run() {
 }
 
 void CCResourceLoader::runInBlockMode() {
+    cancelPrepare();
     m_loading = true;
-    for(LoadTaskPtrList::iterator iter = m_loadTaskList.begin(); iter != m_loadTaskList.end(); iter++) {
-        CCResourceLoadTask* lp = *iter;
-        lp->load();
-        if(m_listener)
-            m_listener->onResourceLoadingProgress(m_nextLoad * 100 / m_loadTaskList.size(), 0);
-        if(m_func.handler) {
-            CCArray* pArrayArgs = CCArray::createWithCapacity(3);
-            pArrayArgs->addObject(CCString::create("progress"));
-            pArrayArgs->addObject(CCFloat::create(m_nextLoad * 100 / m_loadTaskList.size()));
-            pArrayArgs->addObject(CCFloat::create(0));
-            CCScriptEngineManager::sharedManager()->getScriptEngine()->executeEventWithArgs(m_func, pArrayArgs);
+    while(m_nextLoad < (int)m_loadTaskList.size()) {
+        CCResourceLoadTask* lp = m_loadTaskList.at(m_nextLoad++);
+        if(lp->state == CCResourceLoadTask::IDLE) {
+            lp->resolve();
+            lp->prepare();
         }
+        lp->load();
+        notifyProgress(0);
     }
     m_loading = false;
 }
@@ -526,11 +649,71 @@ void CCResourceLoader::abort() {
         return;
     m_loading = false;
     
+    cancelPrepare();
     CCScheduler* scheduler = CCDirector::sharedDirector()->getScheduler();
     scheduler->unscheduleSelector(schedule_selector(CCResourceLoader::doLoad), this);
     autorelease();
 }
 
+void CCResourceLoader::prepareTasks() {
+    startPrepareThreads();
+    
+    int count = (int)m_loadTaskList.size();
+    while(m_nextPrepare < count && m_nextPrepare - m_nextLoad < MAX_PREPARE_AHEAD) {
+        CCResourceLoadTask* t = m_loadTaskList.at(m_nextPrepare++);
+        
+        // it may be prepared before aborting
+        if(t->state != CCResourceLoadTask::IDLE)
+            continue;
+        
+        t->resolve();
+        pthread_mutex_lock(&sPrepareMutex);
+        t->state = CCResourceLoadTask::QUEUED;
+        sPrepareQueue.push_back(t);
+        pthread_cond_signal(&sTaskQueuedCondition);
+        pthread_mutex_unlock(&sPrepareMutex);
+    }
+}
+
+void CCResourceLoader::cancelPrepare() {
+    if(sPrepareThreadCount == 0)
+        return;
+    
+    pthread_mutex_lock(&sPrepareMutex);
+    
+    // remove queued tasks, they can be sent again
+    for(int i = m_nextLoad; i < m_nextPrepare; i++) {
+        CCResourceLoadTask* t = m_loadTaskList.at(i);
+        if(t->state == CCResourceLoadTask::QUEUED) {
+            sPrepareQueue.erase(find(sPrepareQueue.begin(), sPrepareQueue.end(), t));
+            t->state = CCResourceLoadTask::IDLE;
+        }
+    }
+    
+    // wait for tasks being prepared
+    for(int i = m_nextLoad; i < m_nextPrepare; i++) {
+        CCResourceLoadTask* t = m_loadTaskList.at(i);
+        while(t->state == CCResourceLoadTask::PREPARING) {
+            pthread_cond_wait(&sTaskPreparedCondition, &sPrepareMutex);
+        }
+    }
+    
+    pthread_mutex_unlock(&sPrepareMutex);
+    m_nextPrepare = m_nextLoad;
+}
+
+void CCResourceLoader::notifyProgress(float delta) {
+    if(m_listener)
+        m_listener->onResourceLoadingProgress(m_nextLoad * 100 / m_loadTaskList.size(), delta);
+    if(m_func.handler) {
+        CCArray* pArrayArgs = CCArray::createWithCapacity(3);
+        pArrayArgs->addObject(CCString::create("progress"));
+        pArrayArgs->addObject(CCFloat::create(m_nextLoad * 100 / m_loadTaskList.size()));
+        pArrayArgs->addObject(CCFloat::create(delta));
+        CCScriptEngineManager::sharedManager()->getScriptEngine()->executeEventWithArgs(m_func, pArrayArgs);
+    }
+}
+
 void CCResourceLoader::addAndroidStringTask(const string& lan, const string& path, bool merge) {
     AndroidStringLoadTask* t = new AndroidStringLoadTask();
     t->lan = lan;
@@ -864,7 +1047,7 @@ void CCResourceLoader::addLoadTask(CCResourceLoadTask* t) {
 void CCResourceLoader::doLoad(float delta) {
     if(m_remainingIdle > 0) {
         m_remainingIdle -= delta;
-    } else if(m_loadTaskList.size() <= m_nextLoad) {
+    } else if((int)m_loadTaskList.size() <= m_nextLoad) {
         if(m_loading) {
             m_loading = false;
             CCScheduler* scheduler = CCDirector::sharedDirector()->getScheduler();
@@ -880,19 +1063,37 @@ void CCResourceLoader::doLoad(float delta) {
             CCScriptEngineManager::sharedManager()->getScriptEngine()->executeEventWithArgs(m_func, pArrayArgs);
         }
     } else {
-        CCResourceLoadTask* lp = m_loadTaskList.at(m_nextLoad++);
         m_remainingIdle = 0;
         
-        lp->load();
-        if(m_listener)
-            m_listener->onResourceLoadingProgress(m_nextLoad * 100 / m_loadTaskList.size(), delta);
-        if(m_func.handler) {
-            CCArray* pArrayArgs = CCArray::createWithCapacity(3);
-            pArrayArgs->addObject(CCString::create("progress"));
-            pArrayArgs->addObject(CCFloat::create(m_nextLoad * 100 / m_loadTaskList.size()));
-            pArrayArgs->addObject(CCFloat::create(delta));
-            CCScriptEngineManager::sharedManager()->getScriptEngine()->executeEventWithArgs(m_func, pArrayArgs);
+        // keep loading threads busy
+        prepareTasks();
+        
+        // load prepared tasks in order until budget is used up
+        struct cc_timeval start, now;
+        CCTime::gettimeofdayCocos2d(&start, NULL);
+        while(m_loading && m_nextLoad < (int)m_loadTaskList.size()) {
+            CCResourceLoadTask* lp = m_loadTaskList.at(m_nextLoad);
+            pthread_mutex_lock(&sPrepareMutex);
+            bool prepared = lp->state == CCResourceLoadTask::PREPARED;
+            pthread_mutex_unlock(&sPrepareMutex);
+            if(!prepared)
+                break;
+            
+            m_nextLoad++;
+            lp->load();
+            notifyProgress(delta);
+            
+            // delta is only reported once
+            delta = 0;
+            
+            CCTime::gettimeofdayCocos2d(&now, NULL);
+            if(CCTime::timersubCocos2d(&start, &now) >= m_loadBudget)
+                break;
         }
+        
+        // fill slots of loaded tasks
+        if(m_loading)
+            prepareTasks();
     }
 }
 
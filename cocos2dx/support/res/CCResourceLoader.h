@@ -36,14 +36,38 @@ NS_CC_BEGIN
 
 class CCImage;
 class CCCallFunc;
+class CCDictionary;
+class CCFileView;
 
-/// load parameter
+/**
+ * load parameter
+ *
+ * A task is loaded in three steps. resolve and load are called in OpenGL thread, prepare is called
+ * in a loading thread between them so reading, decrypting, decoding and parsing don't block rendering.
+ * A task only needs to implement load, others are optional.
+ */
 struct CCResourceLoadTask {
-    CCResourceLoadTask() {
+    /// state of task in loading pipeline, guarded by loader
+    enum State {
+        IDLE,
+        QUEUED,
+        PREPARING,
+        PREPARED
+    };
+    State state;
+    
+    CCResourceLoadTask() :
+    state(IDLE) {
     }
     
     virtual ~CCResourceLoadTask() {}
     
+    /// called in OpenGL thread before prepare, resolve full paths here because CCFileUtils is not thread safe
+    virtual void resolve() {}
+    
+    /// called in loading thread, must not touch OpenGL or autorelease pool
+    virtual void prepare() {}
+    
     /// do loading
     virtual void load() {}
 };
@@ -101,8 +125,20 @@ struct ImageLoadTask : public CCResourceLoadTask {
     /// image name
     string name;
     
-    virtual ~ImageLoadTask() {}
+    /// full path of image, empty if it doesn't need decoding
+    string fullPath;
     
+    /// image decoded in loading thread
+    CCImage* image;
+    
+    ImageLoadTask() :
+    image(NULL) {
+    }
+    
+    virtual ~ImageLoadTask();
+    
+    virtual void resolve();
+    virtual void prepare();
     virtual void load();
 };
 
@@ -114,8 +150,31 @@ struct ZwoptexLoadTask : public CCResourceLoadTask {
     /// texture name
     string texName;
     
-    virtual ~ZwoptexLoadTask() {}
+    /// full path of plist
+    string plistFullPath;
+    
+    /// full path of texture, empty if it doesn't need decoding
+    string texFullPath;
+    
+    /// plist parsed in loading thread
+    CCDictionary* dict;
     
+    /// compiled sheet read in loading thread, used instead of dict
+    CCFileView* sheet;
+    
+    /// texture image decoded in loading thread
+    CCImage* image;
+    
+    ZwoptexLoadTask() :
+    dict(NULL),
+    sheet(NULL),
+    image(NULL) {
+    }
+    
+    virtual ~ZwoptexLoadTask();
+    
+    virtual void resolve();
+    virtual void prepare();
     virtual void load();
 };
 
@@ -256,6 +315,12 @@ struct CustomTask : public CCResourceLoadTask {
  * task will cause animation to skip frames. The better choice is invoking setDisplayFrame one by one.
  *
  * \par
+ * Tasks are loaded in a pipeline. Images and atlas plists are read, decrypted, decoded and parsed
+ * by loading threads ahead of time, OpenGL thread only creates textures and registers them in caches.
+ * In every tick, prepared tasks are loaded in order until load budget is used up, so several small
+ * resources can be loaded in one frame.
+ *
+ * \par
  * Decryption is supported and you can provide a decrypt function pointer to load method. Of course you
  * need write an independent tool to encrypt your resources, that's your business.
  *
@@ -289,6 +354,9 @@ private:
     /// next loading item
     int m_nextLoad;
     
+    /// next item to be sent to loading thread
+    int m_nextPrepare;
+    
     /// load list
     typedef vector<CCResourceLoadTask*> LoadTaskPtrList;
     LoadTaskPtrList m_loadTaskList;
@@ -303,6 +371,15 @@ private:
 	/// perform loading
 	void doLoad(float delta);
     
+    /// send tasks to loading threads, no more than a limited number ahead of loading
+    void prepareTasks();
+    
+    /// remove unstarted tasks from loading threads and wait for started ones
+    void cancelPrepare();
+    
+    /// notify listeners of progress
+    void notifyProgress(float delta);
+    
     /// resolve path
     static string _resolve(const string& path);
     static bool s_resolveExternal;
@@ -329,6 +406,9 @@ public:
     
     /// abort all active resource loading
     static void abortAll();
+    
+    /// abort all active resource loading and join loading threads, they are started again by next loading
+    static void stopLoadingThreads();
 	
     /**
      * load a file and return raw data, if global decrypt is set, it will be
@@ -605,6 +685,9 @@ public:
 	
 	/// delay time before start to load
 	CC_SYNTHESIZE(float, m_delay, Delay);
+    
+    /// max milliseconds spent on loading prepared tasks in one tick, at least one task is loaded per tick
+    CC_SYNTHESIZE(float, m_loadBudget, LoadBudget);
 };
 
 NS_CC_END
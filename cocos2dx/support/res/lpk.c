@@ -549,8 +549,8 @@ uint32_t lpk_get_file_hash_table_index(lpk_file* lpk, const char* filepath, uint
         hash = lpk->het + hashI;
     }
     
-    // return
-    if(hash->hash_a != hashA || hash->hash_b != hashB) {
+    // return, chain tail may be a different variant or even a different file
+    if(!(hash->flags & LPK_FLAG_USED) || hash->hash_a != hashA || hash->hash_b != hashB || hash->locale != locale || hash->platform != platform) {
         return LPK_INDEX_INVALID;
     } else {
         return hashI;
@@ -656,6 +656,59 @@ uint8_t* lpk_extract_file(lpk_file* lpk, const char* filepath, uint32_t* size, c
     return buf;
 }
     
+int lpk_unpack_data(const lpk_hash* hash, const uint8_t* packed, const char* key, const uint32_t keyLen, uint8_t* out) {
+    // decrypt to a temp buffer, plain data is used in place
+    const uint8_t* buf = packed;
+    uint32_t bufLen = hash->packed_size;
+    uint8_t* dec = NULL;
+    if(hash->flags & LPK_FLAG_ENCRYPTED) {
+        LPKEncryptAlgorithm encAlg = (hash->flags & LPK_MASK_ENCRYPTED) >> LPK_SHIFT_ENCRYPTED;
+        if(encAlg > LPKE_XXTEA) {
+            return LPK_ERROR_DECRYPT;
+        }
+        if(s_dcyt_table[encAlg]) {
+            if(s_dcyt_table[encAlg]((uint8_t*)packed, bufLen, (const uint8_t*)key, keyLen, &dec, &bufLen) != 0 || !dec) {
+                free(dec);
+                return LPK_ERROR_DECRYPT;
+            }
+            buf = dec;
+        }
+    }
+    
+    // uncompress straight into caller buffer, its size is known from hash
+    int result = LPK_SUCCESS;
+    if(hash->flags & LPK_FLAG_COMPRESSED) {
+        LPKCompressAlgorithm cmpAlg = (hash->flags & LPK_MASK_COMPRESSED) >> LPK_SHIFT_COMPRESSED;
+        if(cmpAlg != LPKC_ZLIB) {
+            result = LPK_ERROR_UNPACK;
+        } else if(hash->file_size > 0) {
+            z_stream d_stream;
+            memset(&d_stream, 0, sizeof(z_stream));
+            d_stream.next_in = (Bytef*)buf;
+            d_stream.avail_in = bufLen;
+            d_stream.next_out = out;
+            d_stream.avail_out = hash->file_size;
+            if(inflateInit2(&d_stream, 15 + 32) != Z_OK) {
+                result = LPK_ERROR_UNPACK;
+            } else {
+                if(inflate(&d_stream, Z_FINISH) != Z_STREAM_END || d_stream.total_out != hash->file_size) {
+                    result = LPK_ERROR_UNPACK;
+                }
+                inflateEnd(&d_stream);
+            }
+        }
+    } else if(bufLen != hash->file_size) {
+        result = LPK_ERROR_SIZE;
+    } else {
+        memcpy(out, buf, bufLen);
+    }
+    
+    // free
+    free(dec);
+    
+    return result;
+}
+    
 int lpk_get_used_hash_count(lpk_file* lpk) {
     int count = 0;
     lpk_hash* hash = lpk->het;
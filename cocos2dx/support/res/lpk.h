@@ -150,6 +150,12 @@ extern int lpk_close_file(lpk_file* lpk);
 extern uint32_t lpk_get_file_hash_table_index(lpk_file* lpk, const char* filepath, uint16_t locale, LPKPlatform platform);
 extern uint32_t lpk_get_file_size(lpk_file* lpk, const char* filepath, uint16_t locale, LPKPlatform platform);
 extern uint8_t* lpk_extract_file(lpk_file* lpk, const char* filepath, uint32_t* size, const char* key, const uint32_t keyLen, uint16_t locale, LPKPlatform platform);
+/**
+ * unpack data of one hash entry, packed is the raw data read from archive and out must
+ * hold hash->file_size bytes. It doesn't touch lpk_file so it is safe to call from any
+ * thread, readers which map or pread archive by themselves can use it
+ */
+extern int lpk_unpack_data(const lpk_hash* hash, const uint8_t* packed, const char* key, const uint32_t keyLen, uint8_t* out);
 extern int lpk_apply_patch(lpk_file* lpk, lpk_file* patch);
 extern int lpk_get_used_hash_count(lpk_file* lpk);
 extern void lpk_debug_output(lpk_file* lpk);
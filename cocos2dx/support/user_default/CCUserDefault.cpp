@@ -25,6 +25,11 @@ THE SOFTWARE.
 #include "platform/CCCommon.h"
 #include "platform/CCFileUtils.h"
 #include "support/xml/tinyxml2.h"
+#include <map>
+#include <pthread.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/time.h>
 
 #if (CC_TARGET_PLATFORM != CC_PLATFORM_IOS && CC_TARGET_PLATFORM != CC_PLATFORM_ANDROID)
 
@@ -37,102 +42,282 @@ using namespace std;
 
 NS_CC_BEGIN
 
+typedef map<string, string> UserDefaultValues;
+
 /**
- * define the functions here because we don't want to
+ * Values are parsed from the xml file once and kept in memory. Changed values
+ * are written back by flush(), or by a background thread when the flush interval
+ * is bigger than 0. The file is written to a temporary file and renamed, so a
+ * crash in the middle of writing never leaves a truncated file behind.
+ *
+ * define the state here because we don't want to
  * export xmlNodePtr and other types in "CCUserDefault.h"
  */
+static UserDefaultValues s_values;
+static bool s_bLoaded = false;
+static bool s_bDirty = false;
+static float s_fFlushInterval = 1.0f;
+
+// guards values and flush thread state
+static pthread_mutex_t s_valuesMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// serializes file writes of flush() and flush thread
+static pthread_mutex_t s_writeMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_cond_t s_flushCondition = PTHREAD_COND_INITIALIZER;
+static pthread_t s_flushThread;
+static bool s_bFlushThreadRunning = false;
+static bool s_bFlushThreadQuit = false;
+
+// must be called with values mutex locked. Values set before loading are newer than
+// values in file. If an existing file can't be read, store is not loaded and it is not
+// written, so user data is not overwritten by a partial store; next access tries again
+static void loadValues()
+{
+    if (s_bLoaded)
+    {
+        return;
+    }
 
-static tinyxml2::XMLElement* getXMLNodeForKey(const char* pKey, tinyxml2::XMLElement** rootNode, tinyxml2::XMLDocument **doc)
+    const string& path = CCUserDefault::getXMLFilePath();
+    if (! CCFileUtils::sharedFileUtils()->isFileExist(path))
+    {
+        s_bLoaded = true;
+        return;
+    }
+
+    size_t nSize = 0;
+    unsigned char* pXmlBuffer = CCFileUtils::sharedFileUtils()->getFileData(path.c_str(), "rb", &nSize);
+    if (NULL == pXmlBuffer)
+    {
+        CCLOG("can not read xml file: %s", path.c_str());
+        return;
+    }
+    s_bLoaded = true;
+
+    tinyxml2::XMLDocument doc;
+    doc.Parse((const char*)pXmlBuffer, nSize);
+    delete[] pXmlBuffer;
+
+    // a corrupted file is moved aside instead of being replaced by next write
+    tinyxml2::XMLElement* rootNode = doc.Error() ? NULL : doc.RootElement();
+    if (NULL == rootNode)
+    {
+        string badPath = path + ".bad";
+        CCLOG("read root node error, xml file is moved to %s", badPath.c_str());
+        rename(path.c_str(), badPath.c_str());
+        return;
+    }
+
+    // a node without content has no value, same as a missing node
+    for (tinyxml2::XMLElement* node = rootNode->FirstChildElement(); node; node = node->NextSiblingElement())
+    {
+        if (node->FirstChild())
+        {
+            s_values.insert(UserDefaultValues::value_type(node->Value(), node->FirstChild()->Value()));
+        }
+    }
+}
+
+static void* flushThreadEntry(void* data);
+
+// must be called with values mutex locked
+static void markDirty()
 {
-    tinyxml2::XMLElement* curNode = NULL;
+    if (s_bDirty)
+    {
+        return;
+    }
+    s_bDirty = true;
+
+    if (s_fFlushInterval <= 0)
+    {
+        return;
+    }
+
+    if (s_bFlushThreadRunning)
+    {
+        pthread_cond_signal(&s_flushCondition);
+    }
+    else
+    {
+        s_bFlushThreadQuit = false;
+        s_bFlushThreadRunning = pthread_create(&s_flushThread, NULL, flushThreadEntry, NULL) == 0;
+        if (!s_bFlushThreadRunning)
+        {
+            CCLOG("can not create user default flush thread, call flush() to save");
+        }
+    }
+}
 
-    // check the key value
+static bool getValueForKey(const char* pKey, string* pValue)
+{
     if (! pKey)
     {
-        return NULL;
-    }
-
-    do 
-    {
- 		tinyxml2::XMLDocument* xmlDoc = new tinyxml2::XMLDocument();
-		*doc = xmlDoc;
-		//CCFileData data(CCUserDefault::sharedUserDefault()->getXMLFilePath().c_str(),"rt");
-		size_t nSize;
-		const char* pXmlBuffer = (const char*)CCFileUtils::sharedFileUtils()->getFileData(CCUserDefault::sharedUserDefault()->getXMLFilePath().c_str(), "rb", &nSize);
-		//const char* pXmlBuffer = (const char*)data.getBuffer();
-		if(NULL == pXmlBuffer)
-		{
-			CCLOG("can not read xml file");
-			break;
-		}
-		xmlDoc->Parse(pXmlBuffer, nSize);
-        delete[] pXmlBuffer;
-		// get root node
-		*rootNode = xmlDoc->RootElement();
-		if (NULL == *rootNode)
-		{
-			CCLOG("read root node error");
-			break;
-		}
-		// find the node
-		curNode = (*rootNode)->FirstChildElement();
-		while (NULL != curNode)
-		{
-			const char* nodeName = curNode->Value();
-			if (!strcmp(nodeName, pKey))
-			{
-				break;
-			}
-
-			curNode = curNode->NextSiblingElement();
-		}
-	} while (0);
-
-	return curNode;
+        return false;
+    }
+
+    pthread_mutex_lock(&s_valuesMutex);
+    loadValues();
+    UserDefaultValues::const_iterator iter = s_values.find(pKey);
+    bool bFound = iter != s_values.end();
+    if (bFound)
+    {
+        *pValue = iter->second;
+    }
+    pthread_mutex_unlock(&s_valuesMutex);
+
+    return bFound;
 }
 
 static void setValueForKey(const char* pKey, const char* pValue)
 {
- 	tinyxml2::XMLElement* rootNode;
-	tinyxml2::XMLDocument* doc;
-	tinyxml2::XMLElement* node;
-	// check the params
-	if (! pKey || ! pValue)
-	{
-		return;
-	}
-	// find the node
-	node = getXMLNodeForKey(pKey, &rootNode, &doc);
-	// if node exist, change the content
-	if (node)
-	{
-        if (node->FirstChild())
+    // check the params
+    if (! pKey || ! pValue)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&s_valuesMutex);
+    loadValues();
+    // setting same value again doesn't need a write
+    UserDefaultValues::iterator iter = s_values.find(pKey);
+    if (iter == s_values.end())
+    {
+        s_values[pKey] = pValue;
+        markDirty();
+    }
+    else if (iter->second != pValue)
+    {
+        iter->second = pValue;
+        markDirty();
+    }
+    pthread_mutex_unlock(&s_valuesMutex);
+}
+
+static bool writeValues()
+{
+    pthread_mutex_lock(&s_writeMutex);
+
+    // build document of current values, the file is written without holding values
+    // lock so setters on other threads don't wait for the disk
+    pthread_mutex_lock(&s_valuesMutex);
+    if (! s_bDirty)
+    {
+        pthread_mutex_unlock(&s_valuesMutex);
+        pthread_mutex_unlock(&s_writeMutex);
+        return true;
+    }
+
+    // never write a store which doesn't have values of existing file, values stay dirty
+    loadValues();
+    if (! s_bLoaded)
+    {
+        pthread_mutex_unlock(&s_valuesMutex);
+        pthread_mutex_unlock(&s_writeMutex);
+        CCLOG("xml file is not loaded, skip saving: %s", CCUserDefault::getXMLFilePath().c_str());
+        return false;
+    }
+    tinyxml2::XMLDocument doc;
+    doc.LinkEndChild(doc.NewDeclaration(NULL));
+    tinyxml2::XMLElement* rootNode = doc.NewElement(USERDEFAULT_ROOT_NAME);
+    doc.LinkEndChild(rootNode);
+    for (UserDefaultValues::const_iterator iter = s_values.begin(); iter != s_values.end(); ++iter)
+    {
+        tinyxml2::XMLElement* node = doc.NewElement(iter->first.c_str());
+        node->LinkEndChild(doc.NewText(iter->second.c_str()));
+        rootNode->LinkEndChild(node);
+    }
+    s_bDirty = false;
+    pthread_mutex_unlock(&s_valuesMutex);
+
+    // write to temporary file and replace old file by rename, which is atomic
+    const string& path = CCUserDefault::getXMLFilePath();
+    string tmpPath = path + ".tmp";
+    bool bRet = false;
+    FILE* fp = fopen(tmpPath.c_str(), "wb");
+    if (fp)
+    {
+        bRet = tinyxml2::XML_SUCCESS == doc.SaveFile(fp);
+        bRet = fflush(fp) == 0 && bRet;
+        bRet = fsync(fileno(fp)) == 0 && bRet;
+        bRet = fclose(fp) == 0 && bRet;
+        bRet = bRet && rename(tmpPath.c_str(), path.c_str()) == 0;
+        if (! bRet)
         {
-            node->FirstChild()->SetValue(pValue);
+            remove(tmpPath.c_str());
         }
-        else
+    }
+
+    // keep values dirty so next flush tries again
+    if (! bRet)
+    {
+        CCLOG("can not save xml file: %s", path.c_str());
+        pthread_mutex_lock(&s_valuesMutex);
+        markDirty();
+        pthread_mutex_unlock(&s_valuesMutex);
+    }
+
+    pthread_mutex_unlock(&s_writeMutex);
+    return bRet;
+}
+
+static void* flushThreadEntry(void* data)
+{
+    pthread_mutex_lock(&s_valuesMutex);
+    while (! s_bFlushThreadQuit)
+    {
+        if (! s_bDirty || s_fFlushInterval <= 0)
         {
-            tinyxml2::XMLText* content = doc->NewText(pValue);
-            node->LinkEndChild(content);
+            pthread_cond_wait(&s_flushCondition, &s_valuesMutex);
+            continue;
         }
-	}
-	else
-	{
-		if (rootNode)
-		{
-			tinyxml2::XMLElement* tmpNode = doc->NewElement(pKey);//new tinyxml2::XMLElement(pKey);
-			rootNode->LinkEndChild(tmpNode);
-			tinyxml2::XMLText* content = doc->NewText(pValue);//new tinyxml2::XMLText(pValue);
-			tmpNode->LinkEndChild(content);
-		}	
-	}
 
-    // save file and free doc
-	if (doc)
-	{
-		doc->SaveFile(CCUserDefault::sharedUserDefault()->getXMLFilePath().c_str());
-		delete doc;
-	}
+        // wait flush interval after first change, changes in the meantime are written together
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        long long nsec = (long long)now.tv_usec * 1000 + (long long)(s_fFlushInterval * 1000000000.0);
+        struct timespec deadline;
+        deadline.tv_sec = now.tv_sec + (time_t)(nsec / 1000000000);
+        deadline.tv_nsec = (long)(nsec % 1000000000);
+        while (! s_bFlushThreadQuit && s_bDirty && s_fFlushInterval > 0)
+        {
+            if (pthread_cond_timedwait(&s_flushCondition, &s_valuesMutex, &deadline) == ETIMEDOUT)
+            {
+                break;
+            }
+        }
+
+        // values may be flushed or interval turned off meanwhile
+        if (s_bFlushThreadQuit || ! s_bDirty || s_fFlushInterval <= 0)
+        {
+            continue;
+        }
+
+        pthread_mutex_unlock(&s_valuesMutex);
+        writeValues();
+        pthread_mutex_lock(&s_valuesMutex);
+    }
+    pthread_mutex_unlock(&s_valuesMutex);
+
+    return NULL;
+}
+
+static void stopFlushThread()
+{
+    pthread_mutex_lock(&s_valuesMutex);
+    bool bRunning = s_bFlushThreadRunning;
+    s_bFlushThreadQuit = true;
+    pthread_cond_signal(&s_flushCondition);
+    pthread_mutex_unlock(&s_valuesMutex);
+
+    if (bRunning)
+    {
+        pthread_join(s_flushThread, NULL);
+        pthread_mutex_lock(&s_valuesMutex);
+        s_bFlushThreadRunning = false;
+        pthread_mutex_unlock(&s_valuesMutex);
+    }
 }
 
 /**
@@ -160,6 +345,15 @@ CCUserDefault::CCUserDefault()
 
 void CCUserDefault::purgeSharedUserDefault()
 {
+    // stop background saving first so the last write is not raced, then
+    // save pending changes synchronously; cache is loaded again by next access
+    stopFlushThread();
+    writeValues();
+    pthread_mutex_lock(&s_valuesMutex);
+    s_values.clear();
+    s_bLoaded = false;
+    pthread_mutex_unlock(&s_valuesMutex);
+
     m_spUserDefault = NULL;
 }
 
@@ -170,27 +364,13 @@ void CCUserDefault::purgeSharedUserDefault()
 
 bool CCUserDefault::getBoolForKey(const char* pKey, bool defaultValue)
 {
-    const char* value = NULL;
-	tinyxml2::XMLElement* rootNode;
-	tinyxml2::XMLDocument* doc;
-	tinyxml2::XMLElement* node;
-	node =  getXMLNodeForKey(pKey, &rootNode, &doc);
-	// find the node
-	if (node && node->FirstChild())
-	{
-        value = (const char*)(node->FirstChild()->Value());
-	}
-
-	bool ret = defaultValue;
-
-	if (value)
-	{
-		ret = (! strcmp(value, "true"));
-	}
-
-    if (doc) delete doc;
+    string value;
+    if (getValueForKey(pKey, &value))
+    {
+        return value == "true";
+    }
 
-	return ret;
+    return defaultValue;
 }
 
 int CCUserDefault::getIntegerForKey(const char* pKey)
@@ -200,31 +380,13 @@ int CCUserDefault::getIntegerForKey(const char* pKey)
 
 int CCUserDefault::getIntegerForKey(const char* pKey, int defaultValue)
 {
-	const char* value = NULL;
-	tinyxml2::XMLElement* rootNode;
-	tinyxml2::XMLDocument* doc;
-	tinyxml2::XMLElement* node;
-	node =  getXMLNodeForKey(pKey, &rootNode, &doc);
-	// find the node
-	if (node && node->FirstChild())
-	{
-        value = (const char*)(node->FirstChild()->Value());
-	}
-
-	int ret = defaultValue;
-
-	if (value)
-	{
-		ret = atoi(value);
-	}
-
-	if(doc)
-	{
-		delete doc;
-	}
-
+    string value;
+    if (getValueForKey(pKey, &value))
+    {
+        return atoi(value.c_str());
+    }
 
-	return ret;
+    return defaultValue;
 }
 
 float CCUserDefault::getFloatForKey(const char* pKey)
@@ -246,27 +408,13 @@ double  CCUserDefault::getDoubleForKey(const char* pKey)
 
 double CCUserDefault::getDoubleForKey(const char* pKey, double defaultValue)
 {
-	const char* value = NULL;
-	tinyxml2::XMLElement* rootNode;
-	tinyxml2::XMLDocument* doc;
-	tinyxml2::XMLElement* node;
-	node =  getXMLNodeForKey(pKey, &rootNode, &doc);
-	// find the node
-	if (node && node->FirstChild())
-	{
-        value = (const char*)(node->FirstChild()->Value());
-	}
-
-	double ret = defaultValue;
-
-	if (value)
-	{
-		ret = atof(value);
-	}
-
-    if (doc) delete doc;
+    string value;
+    if (getValueForKey(pKey, &value))
+    {
+        return atof(value.c_str());
+    }
 
-	return ret;
+    return defaultValue;
 }
 
 std::string CCUserDefault::getStringForKey(const char* pKey)
@@ -276,27 +424,13 @@ std::string CCUserDefault::getStringForKey(const char* pKey)
 
 string CCUserDefault::getStringForKey(const char* pKey, const std::string & defaultValue)
 {
-    const char* value = NULL;
-	tinyxml2::XMLElement* rootNode;
-	tinyxml2::XMLDocument* doc;
-	tinyxml2::XMLElement* node;
-	node =  getXMLNodeForKey(pKey, &rootNode, &doc);
-	// find the node
-	if (node && node->FirstChild())
-	{
-        value = (const char*)(node->FirstChild()->Value());
-	}
-
-	string ret = defaultValue;
-
-	if (value)
-	{
-		ret = string(value);
-	}
-
-    if (doc) delete doc;
+    string value;
+    if (getValueForKey(pKey, &value))
+    {
+        return value;
+    }
 
-	return ret;
+    return defaultValue;
 }
 
 void CCUserDefault::setBoolForKey(const char* pKey, bool value)
@@ -363,17 +497,17 @@ void CCUserDefault::setStringForKey(const char* pKey, const std::string & value)
 
 CCUserDefault* CCUserDefault::sharedUserDefault()
 {
-    initXMLFilePath();
-
-    // only create xml file one time
-    // the file exists after the program exit
-    if ((! isXMLFileExist()) && (! createXMLFile()))
-    {
-        return NULL;
-    }
-
     if (! m_spUserDefault)
     {
+        initXMLFilePath();
+
+        // only create xml file one time
+        // the file exists after the program exit
+        if ((! isXMLFileExist()) && (! createXMLFile()))
+        {
+            return NULL;
+        }
+
         m_spUserDefault = new CCUserDefault();
     }
 
@@ -441,6 +575,40 @@ const string& CCUserDefault::getXMLFilePath()
 
 void CCUserDefault::flush()
 {
+    writeValues();
+}
+
+void CCUserDefault::setFlushInterval(float seconds)
+{
+    pthread_mutex_lock(&s_valuesMutex);
+    s_fFlushInterval = seconds;
+    if (s_bFlushThreadRunning)
+    {
+        pthread_cond_signal(&s_flushCondition);
+    }
+    else if (s_bDirty && seconds > 0)
+    {
+        // start thread for values changed while it was off
+        s_bDirty = false;
+        markDirty();
+    }
+    pthread_mutex_unlock(&s_valuesMutex);
+}
+
+float CCUserDefault::getFlushInterval()
+{
+    return s_fFlushInterval;
+}
+
+void CCUserDefault::purgeDefaultForKey(const std::string& key)
+{
+    pthread_mutex_lock(&s_valuesMutex);
+    loadValues();
+    if (s_values.erase(key) > 0)
+    {
+        markDirty();
+    }
+    pthread_mutex_unlock(&s_valuesMutex);
 }
 
 NS_CC_END
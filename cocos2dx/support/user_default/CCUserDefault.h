@@ -103,11 +103,23 @@ public:
     */
     void    setStringForKey(const char* pKey, const std::string & value);
     /**
-     @brief Save content to xml file
+     @brief Save content to xml file.
+     Values are kept in memory, changes are saved by a background thread after
+     flush interval. Call it when they must be on disk now, for example when
+     application enters background.
      */
     void    flush();
 
-    /// remove a default setting, CCUserDefault doesn't provide this feature
+    /**
+     @brief Set seconds a change stays in memory before background thread saves it.
+     0 or less turns background saving off, then only flush() saves. Default is 1.
+     It has no effect on iOS and Android, which keep values in system preferences.
+     @since v2.2
+     */
+    void    setFlushInterval(float seconds);
+    float   getFlushInterval();
+
+    /// remove a default setting
     void purgeDefaultForKey(const std::string& key);
     
     static CCUserDefault* sharedUserDefault();
@@ -480,6 +480,15 @@ void CCUserDefault::flush()
     [[NSUserDefaults standardUserDefaults] synchronize];
 }
 
+void CCUserDefault::setFlushInterval(float seconds)
+{
+}
+
+float CCUserDefault::getFlushInterval()
+{
+    return 0;
+}
+
 void CCUserDefault::purgeDefaultForKey(const std::string& key) {
     NSString* nsKey = [NSString stringWithCString:key.c_str() encoding:NSUTF8StringEncoding];
     [[NSUserDefaults standardUserDefaults] removeObjectForKey:nsKey];
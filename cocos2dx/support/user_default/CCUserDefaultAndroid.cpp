@@ -437,6 +437,15 @@ void CCUserDefault::flush()
 {
 }
 
+void CCUserDefault::setFlushInterval(float seconds)
+{
+}
+
+float CCUserDefault::getFlushInterval()
+{
+    return 0;
+}
+
 void CCUserDefault::purgeDefaultForKey(const std::string& key) {
     // context
     jobject ctx = CCUtilsAndroid::getContext();
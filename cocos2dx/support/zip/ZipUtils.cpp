@@ -28,8 +28,13 @@
 #include "ZipUtils.h"
 #include "ccMacros.h"
 #include "platform/CCFileUtils.h"
+#include "platform/CCFileView.h"
 #include "unzip.h"
-#include <map>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
 
 NS_CC_BEGIN
 
@@ -513,89 +518,366 @@ void ZipUtils::ccSetPvrEncryptionKey(unsigned int keyPart1, unsigned int keyPart
 }
 
 // --------------------- ZipFile ---------------------
-// from unzip.cpp
-#define UNZ_MAXFILENAMEINZIP 256
+
+// zip record signatures and sizes
+#define ZIP_EOCD_SIG 0x06054b50
+#define ZIP_EOCD_SIZE 22
+#define ZIP64_EOCD_LOCATOR_SIG 0x07064b50
+#define ZIP64_EOCD_LOCATOR_SIZE 20
+#define ZIP64_EOCD_SIG 0x06064b50
+#define ZIP_CENTRAL_SIG 0x02014b50
+#define ZIP_CENTRAL_SIZE 46
+#define ZIP_LOCAL_SIG 0x04034b50
+#define ZIP_LOCAL_SIZE 30
+#define ZIP_METHOD_STORED 0
+#define ZIP_METHOD_DEFLATED 8
+
+static inline uint16_t zipU16(const unsigned char* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t zipU32(const unsigned char* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t zipU64(const unsigned char* p)
+{
+    return (uint64_t)zipU32(p) | ((uint64_t)zipU32(p + 4) << 32);
+}
+
+// FNV-1a, entry names are short so it is good enough and cheap
+static inline uint32_t zipHashName(const char* name, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        h = (h ^ (unsigned char)name[i]) * 16777619u;
+    }
+    return h;
+}
 
 struct ZipEntryInfo
 {
-    unz_file_pos pos;
-    uLong uncompressed_size;
+    const char* name; // points into central directory
+    uint16_t nameLength;
+    uint16_t method;
+    uint32_t hash;
+    uint64_t localHeaderOffset;
+    uint64_t compressedSize;
+    uint64_t uncompressedSize;
 };
 
 class ZipFilePrivate
 {
 public:
-    unzFile zipFile;
+    ZipFilePrivate()
+    : fd(-1)
+    , mapping(NULL)
+    , archiveSize(0)
+    , centralDirectory(NULL)
+    , centralDirectorySize(0)
+    , entryCount(0)
+    {
+    }
     
-    // std::unordered_map is faster if available on the platform
-    typedef std::map<std::string, struct ZipEntryInfo> FileListContainer;
-    FileListContainer fileList;
+    ~ZipFilePrivate()
+    {
+        CC_SAFE_RELEASE(mapping);
+        if (centralDirectory && !mapping)
+        {
+            delete[] centralDirectory;
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+    
+    bool open(const std::string& zipFile);
+    bool read(void* buffer, uint64_t size, uint64_t offset) const;
+    const ZipEntryInfo* find(const std::string& fileName) const;
+    bool locateData(const ZipEntryInfo* entry, uint64_t* pOffset) const;
+    
+    // archive, read through mapping if it is mapped, or pread
+    int fd;
+    CCFileView* mapping;
+    uint64_t archiveSize;
+    
+    // central directory, points into mapping or a heap copy
+    const unsigned char* centralDirectory;
+    uint64_t centralDirectorySize;
+    uint64_t entryCount;
+    
+    // filtered entries and open addressing index, slot is entry index + 1, 0 is empty
+    std::vector<ZipEntryInfo> entries;
+    std::vector<uint32_t> index;
 };
 
-ZipFile::ZipFile(const std::string &zipFile, const std::string &filter)
-: _data(new ZipFilePrivate)
-, _dataThread(new ZipFilePrivate)
+bool ZipFilePrivate::read(void* buffer, uint64_t size, uint64_t offset) const
 {
-    _data->zipFile = unzOpen(zipFile.c_str());
-    _dataThread->zipFile = unzOpen(zipFile.c_str());
-    if (_data->zipFile && _dataThread->zipFile)
+    // zip64 values are not trusted, compare without sum which may wrap
+    if (offset > archiveSize || size > archiveSize - offset)
     {
-        setFilter(filter);
+        return false;
     }
+    if (mapping)
+    {
+        memcpy(buffer, mapping->getBytes() + offset, (size_t)size);
+        return true;
+    }
+    unsigned char* p = (unsigned char*)buffer;
+    while (size > 0)
+    {
+        ssize_t r = pread(fd, p, (size_t)size, (off_t)offset);
+        if (r < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (r <= 0)
+        {
+            return false;
+        }
+        p += r;
+        size -= r;
+        offset += r;
+    }
+    return true;
 }
 
-ZipFile::~ZipFile()
+bool ZipFilePrivate::open(const std::string& zipFile)
 {
-    if (_data && _data->zipFile)
+    fd = ::open(zipFile.c_str(), O_RDONLY);
+    if (fd < 0)
     {
-        unzClose(_data->zipFile);
+        return false;
     }
-    if (_dataThread && _dataThread->zipFile)
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < ZIP_EOCD_SIZE)
     {
-        unzClose(_dataThread->zipFile);
+        return false;
     }
+    archiveSize = st.st_size;
+    
+    // large archive may not fit in address space of 32 bits device, then pread is used
+    mapping = CCFileView::openMappedFile(zipFile);
+    
+    // end of central directory is at the end, followed by a comment up to 64k
+    uint64_t tailSize = MIN(archiveSize, (uint64_t)(ZIP_EOCD_SIZE + 0xFFFF + ZIP64_EOCD_LOCATOR_SIZE));
+    uint64_t tailOffset = archiveSize - tailSize;
+    std::vector<unsigned char> tail((size_t)tailSize);
+    if (!read(&tail[0], tailSize, tailOffset))
+    {
+        return false;
+    }
+    const unsigned char* eocd = NULL;
+    for (int64_t i = (int64_t)tailSize - ZIP_EOCD_SIZE; i >= 0; i--)
+    {
+        if (zipU32(&tail[i]) == ZIP_EOCD_SIG)
+        {
+            eocd = &tail[i];
+            break;
+        }
+    }
+    if (!eocd)
+    {
+        return false;
+    }
+    entryCount = zipU16(eocd + 10);
+    centralDirectorySize = zipU32(eocd + 12);
+    uint64_t centralDirectoryOffset = zipU32(eocd + 16);
+    
+    // zip64 archive keeps real values in zip64 end of central directory
+    if (eocd - &tail[0] >= ZIP64_EOCD_LOCATOR_SIZE && zipU32(eocd - ZIP64_EOCD_LOCATOR_SIZE) == ZIP64_EOCD_LOCATOR_SIG)
+    {
+        unsigned char zip64[56];
+        if (!read(zip64, sizeof(zip64), zipU64(eocd - ZIP64_EOCD_LOCATOR_SIZE + 8)) || zipU32(zip64) != ZIP64_EOCD_SIG)
+        {
+            return false;
+        }
+        entryCount = zipU64(zip64 + 32);
+        centralDirectorySize = zipU64(zip64 + 40);
+        centralDirectoryOffset = zipU64(zip64 + 48);
+    }
+    if (centralDirectoryOffset > archiveSize || centralDirectorySize > archiveSize - centralDirectoryOffset)
+    {
+        return false;
+    }
+    
+    // names in index point into central directory, so keep it
+    if (mapping)
+    {
+        centralDirectory = mapping->getBytes() + centralDirectoryOffset;
+    }
+    else
+    {
+        unsigned char* buffer = new unsigned char[(size_t)centralDirectorySize];
+        if (!read(buffer, centralDirectorySize, centralDirectoryOffset))
+        {
+            delete[] buffer;
+            return false;
+        }
+        centralDirectory = buffer;
+    }
+    return true;
+}
+
+const ZipEntryInfo* ZipFilePrivate::find(const std::string& fileName) const
+{
+    if (index.empty())
+    {
+        return NULL;
+    }
+    uint32_t hash = zipHashName(fileName.c_str(), fileName.length());
+    size_t mask = index.size() - 1;
+    for (size_t slot = hash & mask; index[slot] != 0; slot = (slot + 1) & mask)
+    {
+        const ZipEntryInfo& entry = entries[index[slot] - 1];
+        if (entry.hash == hash && entry.nameLength == fileName.length() && memcmp(entry.name, fileName.c_str(), entry.nameLength) == 0)
+        {
+            return &entry;
+        }
+    }
+    return NULL;
+}
+
+bool ZipFilePrivate::locateData(const ZipEntryInfo* entry, uint64_t* pOffset) const
+{
+    // local header may have different extra field than central directory
+    unsigned char local[ZIP_LOCAL_SIZE];
+    if (!read(local, ZIP_LOCAL_SIZE, entry->localHeaderOffset) || zipU32(local) != ZIP_LOCAL_SIG)
+    {
+        return false;
+    }
+    *pOffset = entry->localHeaderOffset + ZIP_LOCAL_SIZE + zipU16(local + 26) + zipU16(local + 28);
+    return *pOffset <= archiveSize && entry->compressedSize <= archiveSize - *pOffset;
+}
+
+ZipFile::ZipFile(const std::string &zipFile, const std::string &filter)
+: _data(new ZipFilePrivate)
+{
+    if (_data->open(zipFile))
+    {
+        setFilter(filter);
+    }
+    else
+    {
+        CCLOG("ZipFile: failed to open %s", zipFile.c_str());
+        CC_SAFE_DELETE(_data);
+    }
+}
+
+ZipFile::~ZipFile()
+{
     CC_SAFE_DELETE(_data);
-    CC_SAFE_DELETE(_dataThread);
 }
 
-bool ZipFile::setFilter(const std::string &filter, ZipFilePrivate *data)
+bool ZipFile::isOpen() const
+{
+    return _data != NULL;
+}
+
+bool ZipFile::setFilter(const std::string &filter)
 {
     bool ret = false;
     do
     {
-        CC_BREAK_IF(!data);
-        CC_BREAK_IF(!data->zipFile);
+        CC_BREAK_IF(!_data);
         
         // clear existing file list
-        data->fileList.clear();
+        _data->entries.clear();
+        _data->index.clear();
         
-        // UNZ_MAXFILENAMEINZIP + 1 - it is done so in unzLocateFile
-        char szCurrentFileName[UNZ_MAXFILENAMEINZIP + 1];
-        unz_file_info64 fileInfo;
+        // go through central directory and store position information about the required files
+        const unsigned char* p = _data->centralDirectory;
+        const unsigned char* end = p + _data->centralDirectorySize;
+        _data->entries.reserve((size_t)MIN(_data->entryCount, _data->centralDirectorySize / ZIP_CENTRAL_SIZE));
+        for (uint64_t i = 0; i < _data->entryCount; i++)
+        {
+            if (p + ZIP_CENTRAL_SIZE > end || zipU32(p) != ZIP_CENTRAL_SIG)
+            {
+                break;
+            }
+            uint16_t flags = zipU16(p + 8);
+            uint16_t nameLength = zipU16(p + 28);
+            uint16_t extraLength = zipU16(p + 30);
+            uint16_t commentLength = zipU16(p + 32);
+            const unsigned char* name = p + ZIP_CENTRAL_SIZE;
+            const unsigned char* next = name + nameLength + extraLength + commentLength;
+            if (next > end)
+            {
+                break;
+            }
+            
+            // cache info about filtered files only (like 'assets/'), encrypted entries can't be read
+            if (!(flags & 1) && nameLength >= filter.length() && memcmp(name, filter.c_str(), filter.length()) == 0)
+            {
+                ZipEntryInfo entry;
+                entry.name = (const char*)name;
+                entry.nameLength = nameLength;
+                entry.method = zipU16(p + 10);
+                entry.hash = zipHashName(entry.name, nameLength);
+                entry.compressedSize = zipU32(p + 20);
+                entry.uncompressedSize = zipU32(p + 24);
+                entry.localHeaderOffset = zipU32(p + 42);
+                
+                // zip64 extra field has 64 bits values for fields which are saturated
+                const unsigned char* extra = name + nameLength;
+                const unsigned char* extraEnd = extra + extraLength;
+                while (extra + 4 <= extraEnd)
+                {
+                    uint16_t tag = zipU16(extra);
+                    uint16_t size = zipU16(extra + 2);
+                    const unsigned char* value = extra + 4;
+                    const unsigned char* valueEnd = MIN(value + size, extraEnd);
+                    if (tag == 0x0001)
+                    {
+                        if (entry.uncompressedSize == 0xFFFFFFFF && value + 8 <= valueEnd)
+                        {
+                            entry.uncompressedSize = zipU64(value);
+                            value += 8;
+                        }
+                        if (entry.compressedSize == 0xFFFFFFFF && value + 8 <= valueEnd)
+                        {
+                            entry.compressedSize = zipU64(value);
+                            value += 8;
+                        }
+                        if (entry.localHeaderOffset == 0xFFFFFFFF && value + 8 <= valueEnd)
+                        {
+                            entry.localHeaderOffset = zipU64(value);
+                        }
+                        break;
+                    }
+                    extra += 4 + size;
+                }
+                _data->entries.push_back(entry);
+            }
+            p = next;
+        }
         
-        // go through all files and store position information about the required files
-        int err = unzGoToFirstFile64(data->zipFile, &fileInfo,
-                                     szCurrentFileName, sizeof(szCurrentFileName) - 1);
-        while (err == UNZ_OK)
-        {
-            unz_file_pos posInfo;
-            int posErr = unzGetFilePos(data->zipFile, &posInfo);
-            if (posErr == UNZ_OK)
+        // build index with load factor under 0.5, later entry wins for duplicated name like unzip does
+        size_t slots = 16;
+        while (slots < _data->entries.size() * 2)
+        {
+            slots <<= 1;
+        }
+        _data->index.assign(slots, 0);
+        size_t mask = slots - 1;
+        for (size_t i = 0; i < _data->entries.size(); i++)
+        {
+            const ZipEntryInfo& entry = _data->entries[i];
+            size_t slot = entry.hash & mask;
+            while (_data->index[slot] != 0)
             {
-                std::string currentFileName = szCurrentFileName;
-                // cache info about filtered files only (like 'assets/')
-                if (filter.empty()
-                    || currentFileName.substr(0, filter.length()) == filter)
+                const ZipEntryInfo& other = _data->entries[_data->index[slot] - 1];
+                if (other.hash == entry.hash && other.nameLength == entry.nameLength && memcmp(other.name, entry.name, entry.nameLength) == 0)
                 {
-                    ZipEntryInfo entry;
-                    entry.pos = posInfo;
-                    entry.uncompressed_size = (uLong)fileInfo.uncompressed_size;
-                    data->fileList[currentFileName] = entry;
+                    break;
                 }
+                slot = (slot + 1) & mask;
             }
-            // next file - also get the information about it
-            err = unzGoToNextFile64(data->zipFile, &fileInfo,
-                                    szCurrentFileName, sizeof(szCurrentFileName) - 1);
+            _data->index[slot] = (uint32_t)(i + 1);
         }
         ret = true;
         
@@ -604,11 +886,6 @@ bool ZipFile::setFilter(const std::string &filter, ZipFilePrivate *data)
     return ret;
 }
 
-bool ZipFile::setFilter(const std::string &filter)
-{
-    return (setFilter(filter, _data) && setFilter(filter, _dataThread));
-}
-
 bool ZipFile::fileExists(const std::string &fileName) const
 {
     bool ret = false;
@@ -616,18 +893,13 @@ bool ZipFile::fileExists(const std::string &fileName) const
     {
         CC_BREAK_IF(!_data);
         
-        ret = _data->fileList.find(fileName) != _data->fileList.end();
+        ret = _data->find(fileName) != NULL;
     } while(false);
     
     return ret;
 }
 
-unsigned char *ZipFile::getFileData(const std::string &fileName, size_t *pSize)
-{
-    return getFileData(fileName, pSize, _data);
-}
-
-unsigned char *ZipFile::getFileData(const std::string &fileName, size_t* pSize, ZipFilePrivate *data)
+unsigned char *ZipFile::getFileData(const std::string &fileName, size_t* pSize) const
 {
     unsigned char * pBuffer = NULL;
     if (pSize)
@@ -637,32 +909,101 @@ unsigned char *ZipFile::getFileData(const std::string &fileName, size_t* pSize,
     
     do
     {
-        CC_BREAK_IF(!data->zipFile);
+        CC_BREAK_IF(!_data);
         CC_BREAK_IF(fileName.empty());
         
-        ZipFilePrivate::FileListContainer::const_iterator it = data->fileList.find(fileName);
-        CC_BREAK_IF(it ==  data->fileList.end());
-        
-        ZipEntryInfo fileInfo = it->second;
+        const ZipEntryInfo* entry = _data->find(fileName);
+        CC_BREAK_IF(!entry);
         
-        int nRet = unzGoToFilePos(data->zipFile, &fileInfo.pos);
-        CC_BREAK_IF(UNZ_OK != nRet);
+        uint64_t offset;
+        CC_BREAK_IF(!_data->locateData(entry, &offset));
+        CC_BREAK_IF(entry->uncompressedSize >= (uint64_t)(size_t)-1 || entry->compressedSize >= (uint64_t)(size_t)-1);
+        size_t size = (size_t)entry->uncompressedSize;
         
-        nRet = unzOpenCurrentFile(data->zipFile);
-        CC_BREAK_IF(UNZ_OK != nRet);
-        
-        pBuffer = new unsigned char[fileInfo.uncompressed_size];
-        int CC_UNUSED nSize = unzReadCurrentFile(data->zipFile, pBuffer, fileInfo.uncompressed_size);
-        CCAssert(nSize == 0 || nSize == (int)fileInfo.uncompressed_size, "the file size is wrong");
+        if (entry->method == ZIP_METHOD_STORED)
+        {
+            CC_BREAK_IF(entry->compressedSize != entry->uncompressedSize);
+            pBuffer = new unsigned char[size > 0 ? size : 1];
+            if (!_data->read(pBuffer, size, offset))
+            {
+                CC_SAFE_DELETE_ARRAY(pBuffer);
+                break;
+            }
+        }
+        else if (entry->method == ZIP_METHOD_DEFLATED)
+        {
+            // inflate from mapping directly, or from a temp copy when archive isn't mapped
+            const unsigned char* in = NULL;
+            unsigned char* temp = NULL;
+            if (_data->mapping)
+            {
+                in = _data->mapping->getBytes() + offset;
+            }
+            else
+            {
+                temp = new unsigned char[(size_t)entry->compressedSize + 1];
+                if (!_data->read(temp, entry->compressedSize, offset))
+                {
+                    delete[] temp;
+                    break;
+                }
+                in = temp;
+            }
+            
+            // raw deflate stream, each caller has its own z_stream so there is no shared state
+            pBuffer = new unsigned char[size > 0 ? size : 1];
+            z_stream stream;
+            memset(&stream, 0, sizeof(z_stream));
+            stream.next_in = (Bytef*)in;
+            stream.avail_in = (uInt)entry->compressedSize;
+            stream.next_out = pBuffer;
+            stream.avail_out = (uInt)size;
+            bool ok = inflateInit2(&stream, -MAX_WBITS) == Z_OK;
+            if (ok)
+            {
+                int err = inflate(&stream, Z_FINISH);
+                ok = (err == Z_STREAM_END || (err == Z_BUF_ERROR && size == 0)) && stream.total_out == size;
+                inflateEnd(&stream);
+            }
+            CC_SAFE_DELETE_ARRAY(temp);
+            if (!ok)
+            {
+                CC_SAFE_DELETE_ARRAY(pBuffer);
+                break;
+            }
+        }
+        else
+        {
+            CCLOG("ZipFile: unsupported compression method %d of %s", entry->method, fileName.c_str());
+            break;
+        }
         
         if (pSize)
         {
-            *pSize = fileInfo.uncompressed_size;
+            *pSize = size;
         }
-        unzCloseCurrentFile(data->zipFile);
     } while (0);
     
     return pBuffer;
 }
 
+CCFileView* ZipFile::openFileView(const std::string &fileName) const
+{
+    // stored entry in mapping can be used in place
+    if (_data && _data->mapping)
+    {
+        const ZipEntryInfo* entry = _data->find(fileName);
+        uint64_t offset;
+        if (entry && entry->method == ZIP_METHOD_STORED && entry->compressedSize == entry->uncompressedSize && _data->locateData(entry, &offset))
+        {
+            // slice shares content of mapping, so it outlives unmount of archive
+            return CCFileView::openSlice(_data->mapping, (size_t)offset, (size_t)entry->uncompressedSize);
+        }
+    }
+    
+    size_t size = 0;
+    unsigned char* pBuffer = getFileData(fileName, &size);
+    return pBuffer ? CCFileView::openBuffer(pBuffer, size) : NULL;
+}
+
 NS_CC_END
@@ -181,22 +181,22 @@ namespace cocos2d
 
     // forward declaration
     class ZipFilePrivate;
+    class CCFileView;
 
     /**
     * Zip file - reader helper class.
     *
-    * It will cache the file list of a particular zip file with positions inside an archive,
-    * so it would be much faster to read some particular files or to check their existance.
+    * The central directory is parsed once into a hashed index of entries, so checking or
+    * locating a file doesn't scan the archive. The archive is memory mapped (or read with
+    * pread if it can't be mapped) and the index never changes after filter is set, so
+    * fileExists, getFileData and openFileView can be called from any thread at same time
+    * without locking. Deflated entries are inflated in the calling thread.
     *
     * @since v2.0.5
     */
-    class ZipFile
+    class CC_DLL ZipFile
     {
     public:
-#if (CC_TARGET_PLATFORM == CC_PLATFORM_ANDROID)
-        friend class CCFileUtilsAndroid;
-#endif
-        
         /**
         * Constructor, open zip file and store file list.
         *
@@ -211,6 +211,7 @@ namespace cocos2d
 
         /**
         * Regenerate accessible file list based on a new filter string.
+        * It is not thread safe, call it before files are read.
         *
         * @param filter New filter string (first part of files names)
         * @return true whenever zip file is open successfully and it is possible to locate
@@ -239,16 +240,29 @@ namespace cocos2d
         *
         * @since v2.0.5
         */
-        unsigned char *getFileData(const std::string &fileName, size_t* pSize);
+        unsigned char *getFileData(const std::string &fileName, size_t* pSize) const;
+        
+        /**
+        * Open a read only view of a file in zip. A stored entry in a mapped archive is a
+        * slice of the mapping without copy, other entries are read into a heap buffer.
+        * @param fileName File name
+        * @return Upon success, a view with retain count 1 is returned, otherwise NULL.
+        * @warning Caller should release the view. It stays valid after zip file is deleted.
+        *
+        * @since v2.2
+        */
+        CCFileView* openFileView(const std::string &fileName) const;
+        
+        /**
+        * Check whether zip file is opened and its central directory is parsed.
+        *
+        * @since v2.2
+        */
+        bool isOpen() const;
 
     private:
-        bool setFilter(const std::string &filer, ZipFilePrivate *data);
-        unsigned char *getFileData(const std::string &fileName, size_t* pSize, ZipFilePrivate *data);
-        
-        /** Internal data like zip file pointer / file list array and so on */
+        /** Internal data like mapping, entry index and so on */
         ZipFilePrivate *_data;
-        /** Another data used not in main thread */
-        ZipFilePrivate *_dataThread;
     };
 } // end of namespace cocos2d
 #endif // __SUPPORT_ZIPUTILS_H__
@@ -303,15 +303,50 @@ bool CCTexture2D::initWithImage(CCImage *uiImage, CCTexture2DPixelFormat pf)
 
 bool CCTexture2D::initPremultipliedATextureWithImage(CCImage *image, unsigned int width, unsigned int height, CCTexture2DPixelFormat pf)
 {
+    CC_UNUSED_PARAM(width);
+    CC_UNUSED_PARAM(height);
+
+    CCTexture2DPixelFormat pixelFormat;
+    unsigned char* tempData = convertImageData(image, pf, &pixelFormat);
+
+    initWithConvertedImage(image, tempData, pixelFormat);
+    
+    if (tempData != image->getData())
+    {
+        delete [] tempData;
+    }
+
+    return true;
+}
+
+bool CCTexture2D::initWithConvertedImage(CCImage *image, const void *data, CCTexture2DPixelFormat pixelFormat)
+{
+    CCSize imageSize = CCSizeMake((float)(image->getWidth()), (float)(image->getHeight()));
+    if (!initWithData(data, pixelFormat, image->getWidth(), image->getHeight(), imageSize))
+    {
+        return false;
+    }
+
+    m_bHasPremultipliedAlpha = image->isPremultipliedAlpha();
+    return true;
+}
+
+unsigned char* CCTexture2D::convertImageData(CCImage *image, CCTexture2DPixelFormat pf, CCTexture2DPixelFormat *outPixelFormat)
+{
+    unsigned int              width = image->getWidth();
+    unsigned int              height = image->getHeight();
     unsigned char*            tempData = image->getData();
     unsigned int*             inPixel32  = NULL;
     unsigned char*            inPixel8 = NULL;
     unsigned short*           outPixel16 = NULL;
     bool                      hasAlpha = image->hasAlpha();
-    CCSize                    imageSize = CCSizeMake((float)(image->getWidth()), (float)(image->getHeight()));
     CCTexture2DPixelFormat    pixelFormat;
     size_t                    bpp = image->getBitsPerComponent();
 
+    if(pf == kCCTexture2DPixelFormat_TBD) {
+        pf = g_defaultAlphaPixelFormat;
+    }
+
     // compute pixel format
     if (hasAlpha)
     {
@@ -429,15 +464,8 @@ bool CCTexture2D::initPremultipliedATextureWithImage(CCImage *image, unsigned in
         }
     }
     
-    initWithData(tempData, pixelFormat, width, height, imageSize);
-    
-    if (tempData != image->getData())
-    {
-        delete [] tempData;
-    }
-
-    m_bHasPremultipliedAlpha = image->isPremultipliedAlpha();
-    return true;
+    *outPixelFormat = pixelFormat;
+    return tempData;
 }
 
 // implementation CCTexture2D (Text)
@@ -170,6 +170,23 @@ public:
 
     bool initWithImage(CCImage * uiImage, CCTexture2DPixelFormat pf = kCCTexture2DPixelFormat_TBD);
 
+    /** Converts pixels of an image to the format which will be uploaded by initWithConvertedImage.
+     * It doesn't touch GL state so it can be called in any thread.
+     * Returns image data itself if no conversion is needed, otherwise a new buffer which must be
+     * deleted with delete[]. The final pixel format is returned by outPixelFormat
+     * @since v2.2
+     * @js NA
+     * @lua NA
+     */
+    static unsigned char* convertImageData(CCImage* image, CCTexture2DPixelFormat pf, CCTexture2DPixelFormat* outPixelFormat);
+
+    /** Initializes a texture from image pixels already converted by convertImageData, it only uploads
+     * @since v2.2
+     * @js NA
+     * @lua NA
+     */
+    bool initWithConvertedImage(CCImage* image, const void* data, CCTexture2DPixelFormat pixelFormat);
+
     /** Initializes a texture from a string with dimensions, alignment, font name and font size */
     bool initWithString(const char *text,  const char *fontName, float fontSize, const CCSize& dimensions, CCTextAlignment hAlignment, CCVerticalTextAlignment vAlignment);
     /** Initializes a texture from a string with font name and font size */
@@ -36,6 +36,7 @@ THE SOFTWARE.
 // support
 #include "CCTexture2D.h"
 #include "cocoa/CCString.h"
+#include "support/profile/CCMemory.h"
 #include <stdlib.h>
 
 //According to some tests GL_TRIANGLE_STRIP is slower, MUCH slower. Probably I'm doing something very wrong
@@ -47,6 +48,8 @@ NS_CC_BEGIN
 CCTextureAtlas::CCTextureAtlas()
     :m_pIndices(NULL)
     ,m_bDirty(false)
+    ,m_uDirtyStart(0)
+    ,m_uDirtyEnd(0)
     ,m_pTexture(NULL)
     ,m_pQuads(NULL)
 {}
@@ -55,8 +58,8 @@ CCTextureAtlas::~CCTextureAtlas()
 {
     CCLOGINFO("cocos2d: CCTextureAtlas deallocing %p.", this);
 
-    CC_SAFE_FREE(m_pQuads);
-    CC_SAFE_FREE(m_pIndices);
+    CC_SAFE_CCFREE(m_pQuads);
+    CC_SAFE_CCFREE(m_pIndices);
 
     glDeleteBuffers(2, m_pBuffersVBO);
 
@@ -149,6 +152,8 @@ bool CCTextureAtlas::initWithFile(const char * file, unsigned int capacity)
 
 bool CCTextureAtlas::initWithTexture(CCTexture2D *texture, unsigned int capacity)
 {
+    CC_MEMORY_TAG(kCCMemoryTagAtlas);
+
 //    CCAssert(texture != NULL, "texture should not be null");
     m_uCapacity = capacity;
     m_uTotalQuads = 0;
@@ -160,14 +165,14 @@ bool CCTextureAtlas::initWithTexture(CCTexture2D *texture, unsigned int capacity
     // Re-initialization is not allowed
     CCAssert(m_pQuads == NULL && m_pIndices == NULL, "");
 
-    m_pQuads = (ccV3F_C4B_T2F_Quad*)malloc( m_uCapacity * sizeof(ccV3F_C4B_T2F_Quad) );
-    m_pIndices = (GLushort *)malloc( m_uCapacity * 6 * sizeof(GLushort) );
+    m_pQuads = (ccV3F_C4B_T2F_Quad*)ccMalloc( m_uCapacity * sizeof(ccV3F_C4B_T2F_Quad) );
+    m_pIndices = (GLushort *)ccMalloc( m_uCapacity * 6 * sizeof(GLushort) );
     
     if( ! ( m_pQuads && m_pIndices) && m_uCapacity > 0) 
     {
         //CCLOG("cocos2d: CCTextureAtlas: not enough memory");
-        CC_SAFE_FREE(m_pQuads);
-        CC_SAFE_FREE(m_pIndices);
+        CC_SAFE_CCFREE(m_pQuads);
+        CC_SAFE_CCFREE(m_pIndices);
 
         // release texture, should set it to null, because the destruction will
         // release it too. see cocos2d-x issue #484
@@ -308,6 +313,25 @@ void CCTextureAtlas::mapBuffers()
 
 // TextureAtlas - Update, Insert, Move & Remove
 
+void CCTextureAtlas::setDirtyRange(unsigned int index, unsigned int amount)
+{
+    if (amount == 0)
+    {
+        return;
+    }
+
+    if (m_uDirtyEnd > m_uDirtyStart)
+    {
+        m_uDirtyStart = MIN(m_uDirtyStart, index);
+        m_uDirtyEnd = MAX(m_uDirtyEnd, index + amount);
+    }
+    else
+    {
+        m_uDirtyStart = index;
+        m_uDirtyEnd = index + amount;
+    }
+}
+
 void CCTextureAtlas::updateQuad(ccV3F_C4B_T2F_Quad *quad, unsigned int index)
 {
     CCAssert( index >= 0 && index < m_uCapacity, "updateQuadWithTexture: Invalid index");
@@ -316,7 +340,7 @@ void CCTextureAtlas::updateQuad(ccV3F_C4B_T2F_Quad *quad, unsigned int index)
 
     m_pQuads[index] = *quad;    
 
-    m_bDirty = true;
+    setDirtyRange(index, 1);
 
 }
 
@@ -340,7 +364,7 @@ void CCTextureAtlas::insertQuad(ccV3F_C4B_T2F_Quad *quad, unsigned int index)
     m_pQuads[index] = *quad;
 
 
-    m_bDirty = true;
+    setDirtyRange(index, MAX(m_uTotalQuads, index + 1) - index);
 
 }
 
@@ -363,6 +387,8 @@ void CCTextureAtlas::insertQuads(ccV3F_C4B_T2F_Quad* quads, unsigned int index,
     }
 
 
+    setDirtyRange(index, MAX(m_uTotalQuads, index + amount) - index);
+
     unsigned int max = index + amount;
     unsigned int j = 0;
     for (unsigned int i = index; i < max ; i++)
@@ -371,8 +397,6 @@ void CCTextureAtlas::insertQuads(ccV3F_C4B_T2F_Quad* quads, unsigned int index,
         index++;
         j++;
     }
-
-    m_bDirty = true;
 }
 
 void CCTextureAtlas::insertQuadFromIndex(unsigned int oldIndex, unsigned int newIndex)
@@ -401,7 +425,7 @@ void CCTextureAtlas::insertQuadFromIndex(unsigned int oldIndex, unsigned int new
     m_pQuads[newIndex] = quadsBackup;
 
 
-    m_bDirty = true;
+    setDirtyRange(MIN(oldIndex, newIndex), howMany + 1);
 
 }
 
@@ -422,7 +446,7 @@ void CCTextureAtlas::removeQuadAtIndex(unsigned int index)
     m_uTotalQuads--;
 
 
-    m_bDirty = true;
+    setDirtyRange(index, m_uTotalQuads - index);
 
 }
 
@@ -439,7 +463,7 @@ void CCTextureAtlas::removeQuadsAtIndex(unsigned int index, unsigned int amount)
         memmove( &m_pQuads[index], &m_pQuads[index+amount], sizeof(m_pQuads[0]) * remaining );
     }
 
-    m_bDirty = true;
+    setDirtyRange(index, remaining);
 }
 
 void CCTextureAtlas::removeAllQuads()
@@ -450,6 +474,8 @@ void CCTextureAtlas::removeAllQuads()
 // TextureAtlas - Resize
 bool CCTextureAtlas::resizeCapacity(unsigned int newCapacity)
 {
+    CC_MEMORY_TAG(kCCMemoryTagAtlas);
+
     if( newCapacity == m_uCapacity )
     {
         return true;
@@ -466,7 +492,7 @@ bool CCTextureAtlas::resizeCapacity(unsigned int newCapacity)
     // so here must judge whether m_pQuads and m_pIndices is NULL.
     if (m_pQuads == NULL)
     {
-        tmpQuads = (ccV3F_C4B_T2F_Quad*)malloc( m_uCapacity * sizeof(m_pQuads[0]) );
+        tmpQuads = (ccV3F_C4B_T2F_Quad*)ccMalloc( m_uCapacity * sizeof(m_pQuads[0]) );
         if (tmpQuads != NULL)
         {
             memset(tmpQuads, 0, m_uCapacity * sizeof(m_pQuads[0]) );
@@ -474,7 +500,7 @@ bool CCTextureAtlas::resizeCapacity(unsigned int newCapacity)
     }
     else
     {
-        tmpQuads = (ccV3F_C4B_T2F_Quad*)realloc( m_pQuads, sizeof(m_pQuads[0]) * m_uCapacity );
+        tmpQuads = (ccV3F_C4B_T2F_Quad*)ccRealloc( m_pQuads, sizeof(m_pQuads[0]) * m_uCapacity );
         if (tmpQuads != NULL && m_uCapacity > uOldCapactiy)
         {
             memset(tmpQuads+uOldCapactiy, 0, (m_uCapacity - uOldCapactiy)*sizeof(m_pQuads[0]) );
@@ -483,7 +509,7 @@ bool CCTextureAtlas::resizeCapacity(unsigned int newCapacity)
 
     if (m_pIndices == NULL)
     {    
-        tmpIndices = (GLushort*)malloc( m_uCapacity * 6 * sizeof(m_pIndices[0]) );
+        tmpIndices = (GLushort*)ccMalloc( m_uCapacity * 6 * sizeof(m_pIndices[0]) );
         if (tmpIndices != NULL)
         {
             memset( tmpIndices, 0, m_uCapacity * 6 * sizeof(m_pIndices[0]) );
@@ -492,7 +518,7 @@ bool CCTextureAtlas::resizeCapacity(unsigned int newCapacity)
     }
     else
     {
-        tmpIndices = (GLushort*)realloc( m_pIndices, sizeof(m_pIndices[0]) * m_uCapacity * 6 );
+        tmpIndices = (GLushort*)ccRealloc( m_pIndices, sizeof(m_pIndices[0]) * m_uCapacity * 6 );
         if (tmpIndices != NULL && m_uCapacity > uOldCapactiy)
         {
             memset( tmpIndices+uOldCapactiy, 0, (m_uCapacity-uOldCapactiy) * 6 * sizeof(m_pIndices[0]) );
@@ -501,10 +527,10 @@ bool CCTextureAtlas::resizeCapacity(unsigned int newCapacity)
 
     if( ! ( tmpQuads && tmpIndices) ) {
         CCLOG("cocos2d: CCTextureAtlas: not enough memory");
-        CC_SAFE_FREE(tmpQuads);
-        CC_SAFE_FREE(tmpIndices);
-        CC_SAFE_FREE(m_pQuads);
-        CC_SAFE_FREE(m_pIndices);
+        CC_SAFE_CCFREE(tmpQuads);
+        CC_SAFE_CCFREE(tmpIndices);
+        CC_SAFE_CCFREE(m_pQuads);
+        CC_SAFE_CCFREE(m_pIndices);
         m_uCapacity = m_uTotalQuads = 0;
         return false;
     }
@@ -537,7 +563,7 @@ void CCTextureAtlas::moveQuadsFromIndex(unsigned int oldIndex, unsigned int amou
     }
     //create buffer
     size_t quadSize = sizeof(ccV3F_C4B_T2F_Quad);
-    ccV3F_C4B_T2F_Quad* tempQuads = (ccV3F_C4B_T2F_Quad*)malloc( quadSize * amount);
+    ccV3F_C4B_T2F_Quad* tempQuads = (ccV3F_C4B_T2F_Quad*)ccMalloc( quadSize * amount);
     memcpy( tempQuads, &m_pQuads[oldIndex], quadSize * amount );
 
     if (newIndex < oldIndex)
@@ -552,9 +578,9 @@ void CCTextureAtlas::moveQuadsFromIndex(unsigned int oldIndex, unsigned int amou
     }
     memcpy( &m_pQuads[newIndex], tempQuads, amount*quadSize);
 
-    free(tempQuads);
+    ccFree(tempQuads);
 
-    m_bDirty = true;
+    setDirtyRange(MIN(oldIndex, newIndex), MAX(oldIndex, newIndex) - MIN(oldIndex, newIndex) + amount);
 }
 
 void CCTextureAtlas::moveQuadsFromIndex(unsigned int index, unsigned int newIndex)
@@ -562,6 +588,8 @@ void CCTextureAtlas::moveQuadsFromIndex(unsigned int index, unsigned int newInde
     CCAssert(newIndex + (m_uTotalQuads - index) <= m_uCapacity, "moveQuadsFromIndex move is out of bounds");
 
     memmove(m_pQuads + newIndex,m_pQuads + index, (m_uTotalQuads - index) * sizeof(m_pQuads[0]));
+
+    setDirtyRange(MIN(index, newIndex), MAX(index, newIndex) - MIN(index, newIndex) + m_uTotalQuads - index);
 }
 
 void CCTextureAtlas::fillWithEmptyQuadsFromIndex(unsigned int index, unsigned int amount)
@@ -574,10 +602,45 @@ void CCTextureAtlas::fillWithEmptyQuadsFromIndex(unsigned int index, unsigned in
     {
         m_pQuads[i] = quad;
     }
+
+    setDirtyRange(index, amount);
 }
 
 // TextureAtlas - Drawing
 
+void CCTextureAtlas::uploadDirtyQuads(unsigned int n, unsigned int start)
+{
+    unsigned int from = m_uDirtyStart;
+    unsigned int to = m_uDirtyEnd;
+    if (m_bDirty)
+    {
+        // everything may be changed, quads after the drawn ones are not needed
+        from = 0;
+        to = MAX(m_uTotalQuads, start + n);
+    }
+    to = MIN(to, m_uCapacity);
+
+    if (to > from)
+    {
+        unsigned int bytes = sizeof(m_pQuads[0]) * (to - from);
+#if CC_TEXTURE_ATLAS_USE_VAO
+        if (from == 0 && to == m_uCapacity)
+        {
+            // orphaning, so driver doesn't wait for the buffer used by last frame
+            glBufferData(GL_ARRAY_BUFFER, bytes, m_pQuads, GL_DYNAMIC_DRAW);
+        }
+        else
+#endif
+        {
+            glBufferSubData(GL_ARRAY_BUFFER, sizeof(m_pQuads[0]) * from, bytes, &m_pQuads[from]);
+        }
+        CC_INCREMENT_GL_UPLOADED_BYTES(bytes);
+    }
+
+    m_bDirty = false;
+    m_uDirtyStart = m_uDirtyEnd = 0;
+}
+
 void CCTextureAtlas::drawQuads()
 {
     this->drawNumberOfQuads(m_uTotalQuads, 0);
@@ -606,24 +669,11 @@ void CCTextureAtlas::drawNumberOfQuads(unsigned int n, unsigned int start)
     //
 
     // XXX: update is done in draw... perhaps it should be done in a timer
-    if (m_bDirty) 
+    if (isDirty()) 
     {
         glBindBuffer(GL_ARRAY_BUFFER, m_pBuffersVBO[0]);
-        // option 1: subdata
-        //glBufferSubData(GL_ARRAY_BUFFER, sizeof(m_pQuads[0])*start, sizeof(m_pQuads[0]) * n , &m_pQuads[start] );
-		
-		// option 2: data
-        //		glBufferData(GL_ARRAY_BUFFER, sizeof(quads_[0]) * (n-start), &quads_[start], GL_DYNAMIC_DRAW);
-		
-		// option 3: orphaning + glMapBuffer
-		glBufferData(GL_ARRAY_BUFFER, sizeof(m_pQuads[0]) * (n-start), NULL, GL_DYNAMIC_DRAW);
-		void *buf = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-		memcpy(buf, m_pQuads, sizeof(m_pQuads[0])* (n-start));
-		glUnmapBuffer(GL_ARRAY_BUFFER);
-		
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        m_bDirty = false;
+        uploadDirtyQuads(n, start);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
     ccGLBindVAO(m_uVAOname);
@@ -654,10 +704,9 @@ void CCTextureAtlas::drawNumberOfQuads(unsigned int n, unsigned int start)
     glBindBuffer(GL_ARRAY_BUFFER, m_pBuffersVBO[0]);
 
     // XXX: update is done in draw... perhaps it should be done in a timer
-    if (m_bDirty) 
+    if (isDirty()) 
     {
-        glBufferSubData(GL_ARRAY_BUFFER, sizeof(m_pQuads[0])*start, sizeof(m_pQuads[0]) * n , &m_pQuads[start] );
-        m_bDirty = false;
+        uploadDirtyQuads(n, start);
     }
 
     ccGLEnableVertexAttribs(kCCVertexAttribFlag_PosColorTex);
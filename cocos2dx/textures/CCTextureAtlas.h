@@ -61,7 +61,9 @@ protected:
     GLuint              m_uVAOname;
 #endif
     GLuint              m_pBuffersVBO[2]; //0: vertex  1: indices
-    bool                m_bDirty; //indicates whether or not the array buffer of the VBO needs to be updated
+    bool                m_bDirty; //indicates whether or not the whole array buffer of the VBO needs to be updated
+    unsigned int        m_uDirtyStart; //first quad of the dirty range which needs to be updated
+    unsigned int        m_uDirtyEnd; //end of the dirty range, exclusive, range is empty if it is not greater than start
 
 
     /** quantity of quads that are going to be drawn */
@@ -213,11 +215,25 @@ public:
     void listenBackToForeground(CCObject *obj);
 
     /** whether or not the array buffer of the VBO needs to be updated*/
-    inline bool isDirty(void) { return m_bDirty; }
+    inline bool isDirty(void) { return m_bDirty || m_uDirtyEnd > m_uDirtyStart; }
     /** specify if the array buffer of the VBO needs to be updated */
-    inline void setDirty(bool bDirty) { m_bDirty = bDirty; }
+    inline void setDirty(bool bDirty)
+    {
+        m_bDirty = bDirty;
+        if (!bDirty)
+        {
+            m_uDirtyStart = m_uDirtyEnd = 0;
+        }
+    }
+
+    /** mark quads changed, only changed quads are uploaded when drawing
+     @since v2.2
+     */
+    void setDirtyRange(unsigned int index, unsigned int amount);
 
 private:
+    /// upload dirty quads to the VBO, VBO must be bound
+    void uploadDirtyQuads(unsigned int n, unsigned int start);
     void setupIndices();
     void mapBuffers();
 #if CC_TEXTURE_ATLAS_USE_VAO
@@ -37,12 +37,16 @@ THE SOFTWARE.
 #include "CCScheduler.h"
 #include "CCConfiguration.h"
 #include "cocoa/CCString.h"
+#include "support/profile/CCProfiling.h"
+#include "support/profile/CCMemory.h"
 #include <errno.h>
 #include <stack>
 #include <string>
 #include <cctype>
 #include <queue>
 #include <list>
+#include <set>
+#include <unistd.h>
 
 #if (CC_TARGET_PLATFORM != CC_PLATFORM_WINRT) && (CC_TARGET_PLATFORM != CC_PLATFORM_WP8)
 #include <pthread.h>
@@ -62,35 +66,63 @@ typedef struct _AsyncStruct
     std::string            filename;
     CCObject    *target;
     SEL_CallFuncO        selector;
+    int                  priority;
+    unsigned int         seq;               // arriving order, requests with same priority are loaded in order
+    CCTexture2DPixelFormat pixelFormat;     // requested pixel format, resolved in gl thread
+    bool                 cancelled;         // only touched in gl thread
+    std::list<struct _AsyncStruct*>::iterator it; // position in s_pAsyncRequests
+
+    // filled by loading thread
+    EImageFormat         imageType;
+    CCImage             *image;
+    unsigned char       *data;              // converted pixels, NULL if image data can be uploaded directly
+    CCTexture2DPixelFormat dataFormat;
 } AsyncStruct;
 
-typedef struct _ImageInfo
+// higher priority first, then first come first served
+struct AsyncStructLess
 {
-    AsyncStruct *asyncStruct;
-    CCImage        *image;
-    EImageFormat imageType;
-} ImageInfo;
+    bool operator()(const AsyncStruct* a, const AsyncStruct* b) const
+    {
+        if (a->priority != b->priority)
+            return a->priority > b->priority;
+        return a->seq < b->seq;
+    }
+};
 
-static pthread_t s_loadingThread;
+// default upload budget of gl thread in milliseconds per frame
+#define kCCTextureAsyncUploadBudget 5.0f
 
-static pthread_mutex_t		s_SleepMutex;
-static pthread_cond_t		s_SleepCondition;
+// max number of loading threads
+#define kCCTextureAsyncMaxWorkers 4
 
+static pthread_t s_loadingThreads[kCCTextureAsyncMaxWorkers];
+static int s_nLoadingThreads = 0;
+
+// protects request queue and image queue
 static pthread_mutex_t      s_asyncStructQueueMutex;
-static pthread_mutex_t      s_ImageInfoMutex;
+static pthread_cond_t		s_SleepCondition;
 
 #ifdef EMSCRIPTEN
 // Hack to get ASM.JS validation (no undefined symbols allowed).
 #define pthread_cond_signal(_)
+#define pthread_cond_broadcast(_)
 #endif // EMSCRIPTEN
 
 static unsigned long s_nAsyncRefCount = 0;
 
+static unsigned int s_uAsyncSeq = 0;
+
 static bool need_quit = false;
 
-static std::queue<AsyncStruct*>* s_pAsyncStructQueue = NULL;
+// requests waiting for a loading thread
+static std::multiset<AsyncStruct*, AsyncStructLess>* s_pAsyncStructQueue = NULL;
 
-static std::queue<ImageInfo*>*   s_pImageQueue = NULL;
+// requests loaded, waiting for uploading in gl thread
+static std::queue<AsyncStruct*>*   s_pImageQueue = NULL;
+
+// all requests not finished yet, only accessed in gl thread
+static std::list<AsyncStruct*>* s_pAsyncRequests = NULL;
 
 
 static EImageFormat computeImageFormatType(string& filename)
@@ -121,85 +153,89 @@ static EImageFormat computeImageFormatType(string& filename)
 
 static void loadImageData(AsyncStruct *pAsyncStruct)
 {
+    CC_MEMORY_TAG(kCCMemoryTagTexture);
     const char *filename = pAsyncStruct->filename.c_str();
 
     // compute image type
-    EImageFormat imageType = computeImageFormatType(pAsyncStruct->filename);
-    if (imageType == kFmtUnKnown)
+    pAsyncStruct->imageType = computeImageFormatType(pAsyncStruct->filename);
+    if (pAsyncStruct->imageType == kFmtUnKnown)
     {
         CCLOG("unsupported format %s",filename);
-        delete pAsyncStruct;
-        return;
     }
-        
-    // generate image            
-    CCImage *pImage = new CCImage();
-    if (pImage && !pImage->initWithImageFileThreadSafe(filename, imageType))
+    else
     {
-        CC_SAFE_RELEASE(pImage);
-        CCLOG("can not load %s", filename);
-        return;
+        // generate image, it is decoded and premultiplied here
+        CCImage *pImage = new CCImage();
+        if (pImage && !pImage->initWithImageFileThreadSafe(filename, pAsyncStruct->imageType))
+        {
+            CC_SAFE_RELEASE_NULL(pImage);
+            CCLOG("can not load %s", filename);
+        }
+
+        // convert pixels so gl thread only needs to upload
+        if (pImage)
+        {
+            unsigned char* data = CCTexture2D::convertImageData(pImage, pAsyncStruct->pixelFormat, &pAsyncStruct->dataFormat);
+            pAsyncStruct->data = data != pImage->getData() ? data : NULL;
+        }
+        pAsyncStruct->image = pImage;
     }
 
-    // generate image info
-    ImageInfo *pImageInfo = new ImageInfo();
-    pImageInfo->asyncStruct = pAsyncStruct;
-    pImageInfo->image = pImage;
-    pImageInfo->imageType = imageType;
-    // put the image info into the queue
-    pthread_mutex_lock(&s_ImageInfoMutex);
-    s_pImageQueue->push(pImageInfo);
-    pthread_mutex_unlock(&s_ImageInfoMutex);   
+    // put the request into the image queue, failed one too, so it can be released in gl thread
+    pthread_mutex_lock(&s_asyncStructQueueMutex);
+    s_pImageQueue->push(pAsyncStruct);
+    pthread_mutex_unlock(&s_asyncStructQueueMutex);
 }
 
 static void* loadImage(void* data)
 {
     AsyncStruct *pAsyncStruct = NULL;
 
-    while (true)
-    {
-        // create autorelease pool for iOS
-        CCThread thread;
-        thread.createAutoreleasePool();
+    CC_PROFILER_THREAD_NAME("texture");
 
-        std::queue<AsyncStruct*> *pQueue = s_pAsyncStructQueue;
-        pthread_mutex_lock(&s_asyncStructQueueMutex);// get async struct from queue
-        if (pQueue->empty())
+    pthread_mutex_lock(&s_asyncStructQueueMutex);
+    while (!need_quit)
+    {
+        // get async struct from queue
+        if (s_pAsyncStructQueue->empty())
         {
-            pthread_mutex_unlock(&s_asyncStructQueueMutex);
-            if (need_quit) {
-                break;
-            }
-            else {
-                pthread_cond_wait(&s_SleepCondition, &s_SleepMutex);
-                continue;
-            }
+            pthread_cond_wait(&s_SleepCondition, &s_asyncStructQueueMutex);
+            continue;
         }
-        else
+
+        pAsyncStruct = *s_pAsyncStructQueue->begin();
+        s_pAsyncStructQueue->erase(s_pAsyncStructQueue->begin());
+        pthread_mutex_unlock(&s_asyncStructQueueMutex);
+
         {
-            pAsyncStruct = pQueue->front();
-            pQueue->pop();
-            pthread_mutex_unlock(&s_asyncStructQueueMutex);
+            // create autorelease pool for iOS
+            CCThread thread;
+            thread.createAutoreleasePool();
+
+            CC_PROFILER_ZONE("CCTextureCache - load image");
             loadImageData(pAsyncStruct);
-        }        
-    }
-    
-    if( s_pAsyncStructQueue != NULL )
-    {
-        delete s_pAsyncStructQueue;
-        s_pAsyncStructQueue = NULL;
-        delete s_pImageQueue;
-        s_pImageQueue = NULL;
+        }
 
-        pthread_mutex_destroy(&s_asyncStructQueueMutex);
-        pthread_mutex_destroy(&s_ImageInfoMutex);
-        pthread_mutex_destroy(&s_SleepMutex);
-        pthread_cond_destroy(&s_SleepCondition);
+        pthread_mutex_lock(&s_asyncStructQueueMutex);
     }
+    pthread_mutex_unlock(&s_asyncStructQueueMutex);
     
     return 0;
 }
 
+// release a request which is out of the queues, gl thread only
+static void deleteAsyncStruct(AsyncStruct *pAsyncStruct)
+{
+    s_pAsyncRequests->erase(pAsyncStruct->it);
+    if (!pAsyncStruct->cancelled)
+    {
+        CC_SAFE_RELEASE(pAsyncStruct->target);
+    }
+    CC_SAFE_DELETE_ARRAY(pAsyncStruct->data);
+    CC_SAFE_RELEASE(pAsyncStruct->image);
+    delete pAsyncStruct;
+}
+
 
 // implementation CCTextureCache
 
@@ -225,13 +261,44 @@ CCTextureCache::CCTextureCache()
     CCConfiguration *conf = CCConfiguration::sharedConfiguration();
     m_customPixelFormatTextures = (CCDictionary*)conf->getObject("cocos2d.x.texture.custom_pixel_format");
     CC_SAFE_RETAIN(m_customPixelFormatTextures);
+
+    m_fAsyncUploadBudget = (float)conf->getNumber("cocos2d.x.texture.async_upload_budget", kCCTextureAsyncUploadBudget);
 }
 
 CCTextureCache::~CCTextureCache()
 {
     CCLOGINFO("cocos2d: deallocing CCTextureCache.");
-    need_quit = true;
-    pthread_cond_signal(&s_SleepCondition);
+
+    if (s_pAsyncStructQueue != NULL)
+    {
+        // wake up all loading threads and wait them to quit
+        pthread_mutex_lock(&s_asyncStructQueueMutex);
+        need_quit = true;
+        pthread_cond_broadcast(&s_SleepCondition);
+        pthread_mutex_unlock(&s_asyncStructQueueMutex);
+#if (CC_TARGET_PLATFORM != CC_PLATFORM_WINRT) && (CC_TARGET_PLATFORM != CC_PLATFORM_WP8)
+        for (int i = 0; i < s_nLoadingThreads; i++)
+        {
+            pthread_join(s_loadingThreads[i], NULL);
+        }
+        s_nLoadingThreads = 0;
+#endif
+
+        // every request is still in the request list
+        while (!s_pAsyncRequests->empty())
+        {
+            deleteAsyncStruct(s_pAsyncRequests->front());
+        }
+        s_nAsyncRefCount = 0;
+
+        CC_SAFE_DELETE(s_pAsyncStructQueue);
+        CC_SAFE_DELETE(s_pImageQueue);
+        CC_SAFE_DELETE(s_pAsyncRequests);
+
+        pthread_mutex_destroy(&s_asyncStructQueueMutex);
+        pthread_cond_destroy(&s_SleepCondition);
+    }
+
     CC_SAFE_RELEASE(m_pTextures);
     CC_SAFE_RELEASE(m_customPixelFormatTextures);
 }
@@ -259,6 +326,11 @@ CCDictionary* CCTextureCache::snapshotTextures()
 }
 
 void CCTextureCache::addImageAsync(const char *path, CCObject *target, SEL_CallFuncO selector)
+{
+    addImageAsync(path, target, selector, 0);
+}
+
+void CCTextureCache::addImageAsync(const char *path, CCObject *target, SEL_CallFuncO selector, int priority)
 {
 #ifdef EMSCRIPTEN
     CCLOGWARN("Cannot load image %s asynchronously in Emscripten builds.", path);
@@ -294,17 +366,23 @@ void CCTextureCache::addImageAsync(const char *path, CCObject *target, SEL_CallF
     // lazy init
     if (s_pAsyncStructQueue == NULL)
     {             
-        s_pAsyncStructQueue = new queue<AsyncStruct*>();
-        s_pImageQueue = new queue<ImageInfo*>();        
+        s_pAsyncStructQueue = new std::multiset<AsyncStruct*, AsyncStructLess>();
+        s_pImageQueue = new queue<AsyncStruct*>();
+        s_pAsyncRequests = new std::list<AsyncStruct*>();
         
         pthread_mutex_init(&s_asyncStructQueueMutex, NULL);
-        pthread_mutex_init(&s_ImageInfoMutex, NULL);
-        pthread_mutex_init(&s_SleepMutex, NULL);
         pthread_cond_init(&s_SleepCondition, NULL);
+        need_quit = false;
 #if (CC_TARGET_PLATFORM != CC_PLATFORM_WINRT) && (CC_TARGET_PLATFORM != CC_PLATFORM_WP8)
-        pthread_create(&s_loadingThread, NULL, loadImage, NULL);
+        // leave one core for gl thread by default
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        int workers = (int)CCConfiguration::sharedConfiguration()->getNumber("cocos2d.x.texture.async_workers", (double)(cores - 1));
+        workers = MIN(MAX(workers, 1), kCCTextureAsyncMaxWorkers);
+        for (s_nLoadingThreads = 0; s_nLoadingThreads < workers; s_nLoadingThreads++)
+        {
+            pthread_create(&s_loadingThreads[s_nLoadingThreads], NULL, loadImage, NULL);
+        }
 #endif
-        need_quit = false;
     }
 
     if (0 == s_nAsyncRefCount)
@@ -319,18 +397,34 @@ void CCTextureCache::addImageAsync(const char *path, CCObject *target, SEL_CallF
         CC_SAFE_RETAIN(target);
     }
 
+    // check if this image need custom pixel format, pixels are converted in loading thread
+    CCTexture2DPixelFormat pf = checkCustomPixelFormat(fullpath);
+    if (pf == kCCTexture2DPixelFormat_TBD)
+    {
+        pf = CCTexture2D::defaultAlphaPixelFormat();
+    }
+
     // generate async struct
     AsyncStruct *data = new AsyncStruct();
     data->filename = fullpath.c_str();
     data->target = target;
     data->selector = selector;
+    data->priority = priority;
+    data->seq = s_uAsyncSeq++;
+    data->pixelFormat = pf;
+    data->cancelled = false;
+    data->imageType = kFmtUnKnown;
+    data->image = NULL;
+    data->data = NULL;
+    data->dataFormat = pf;
+    data->it = s_pAsyncRequests->insert(s_pAsyncRequests->end(), data);
 
 #if (CC_TARGET_PLATFORM != CC_PLATFORM_WINRT) && (CC_TARGET_PLATFORM != CC_PLATFORM_WP8)
     // add async struct into queue
     pthread_mutex_lock(&s_asyncStructQueueMutex);
-    s_pAsyncStructQueue->push(data);
-    pthread_mutex_unlock(&s_asyncStructQueueMutex);
+    s_pAsyncStructQueue->insert(data);
     pthread_cond_signal(&s_SleepCondition);
+    pthread_mutex_unlock(&s_asyncStructQueueMutex);
 #else
     // WinRT uses an Async Task to load the image since the ThreadPool has a limited number of threads
     //std::replace( data->filename.begin(), data->filename.end(), '/', '\\'); 
@@ -340,65 +434,154 @@ void CCTextureCache::addImageAsync(const char *path, CCObject *target, SEL_CallF
 #endif
 }
 
-void CCTextureCache::addImageAsyncCallBack(float dt)
+void CCTextureCache::cancelImageAsync(const char *path)
 {
-    // the image is generated in loading thread
-    std::queue<ImageInfo*> *imagesQueue = s_pImageQueue;
+    CCAssert(path != NULL, "TextureCache: fileimage MUST not be NULL");
+    std::string fullpath = CCFileUtils::sharedFileUtils()->fullPathForFilename(path);
+    cancelAsyncRequests(fullpath.c_str(), NULL);
+}
+
+void CCTextureCache::cancelImageAsyncForTarget(CCObject *target)
+{
+    CCAssert(target != NULL, "TextureCache: target MUST not be NULL");
+    cancelAsyncRequests(NULL, target);
+}
+
+void CCTextureCache::cancelAllImageAsync()
+{
+    cancelAsyncRequests(NULL, NULL);
+}
 
-    pthread_mutex_lock(&s_ImageInfoMutex);
-    if (imagesQueue->empty())
+void CCTextureCache::cancelAsyncRequests(const char *fullpath, CCObject *target)
+{
+    if (s_pAsyncRequests == NULL)
     {
-        pthread_mutex_unlock(&s_ImageInfoMutex);
+        return;
     }
-    else
+
+    std::list<AsyncStruct*>::iterator iter = s_pAsyncRequests->begin();
+    while (iter != s_pAsyncRequests->end())
     {
-        ImageInfo *pImageInfo = imagesQueue->front();
-        imagesQueue->pop();
-        pthread_mutex_unlock(&s_ImageInfoMutex);
+        AsyncStruct *pAsyncStruct = *iter++;
+        if (pAsyncStruct->cancelled ||
+            (fullpath && pAsyncStruct->filename != fullpath) ||
+            (target && pAsyncStruct->target != target))
+        {
+            continue;
+        }
 
-        AsyncStruct *pAsyncStruct = pImageInfo->asyncStruct;
-        CCImage *pImage = pImageInfo->image;
+        // callback won't be called any more
+        pAsyncStruct->cancelled = true;
+        CC_SAFE_RELEASE_NULL(pAsyncStruct->target);
 
-        CCObject *target = pAsyncStruct->target;
-        SEL_CallFuncO selector = pAsyncStruct->selector;
-        const char* filename = pAsyncStruct->filename.c_str();
-        
-        // check if this image need custom pixel format
-        CCTexture2DPixelFormat pf = checkCustomPixelFormat(filename);
+        // if it is not picked by a loading thread, drop it now, otherwise it is dropped after loaded
+        pthread_mutex_lock(&s_asyncStructQueueMutex);
+        bool pending = s_pAsyncStructQueue->erase(pAsyncStruct) > 0;
+        pthread_mutex_unlock(&s_asyncStructQueueMutex);
+        if (pending)
+        {
+            deleteAsyncStruct(pAsyncStruct);
+            releaseAsyncRef();
+        }
+    }
+}
 
-        // generate texture in render thread
-        CCTexture2D *texture = new CCTexture2D();
-        texture->initWithImage(pImage, pf);
+void CCTextureCache::releaseAsyncRef()
+{
+    --s_nAsyncRefCount;
+    if (0 == s_nAsyncRefCount)
+    {
+        CCDirector::sharedDirector()->getScheduler()->unscheduleSelector(schedule_selector(CCTextureCache::addImageAsyncCallBack), this);
+    }
+}
 
-#if CC_ENABLE_CACHE_TEXTURE_DATA
-       // cache the texture file name
-       VolatileTexture::addImageTexture(texture, filename, pImageInfo->imageType);
-#endif
+void CCTextureCache::addImageAsyncCallBack(float dt)
+{
+    // the image is generated in loading thread
+    std::queue<AsyncStruct*> *imagesQueue = s_pImageQueue;
 
-        // cache the texture
-        m_pTextures->setObject(texture, filename);
-        CC_SAFE_AUTORELEASE(texture);
+    struct cc_timeval start, now;
+    CCTime::gettimeofdayCocos2d(&start, NULL);
 
-        if (target && selector)
+    // upload loaded images until budget is used up, but at least one per frame
+    while (true)
+    {
+        pthread_mutex_lock(&s_asyncStructQueueMutex);
+        if (imagesQueue->empty())
         {
-            (target->*selector)(texture);
-            CC_SAFE_RELEASE(target);
-        }        
+            pthread_mutex_unlock(&s_asyncStructQueueMutex);
+            break;
+        }
+        AsyncStruct *pAsyncStruct = imagesQueue->front();
+        imagesQueue->pop();
+        pthread_mutex_unlock(&s_asyncStructQueueMutex);
 
-        CC_SAFE_RELEASE(pImage);
-        delete pAsyncStruct;
-        delete pImageInfo;
+        uploadAsyncImage(pAsyncStruct);
 
-        --s_nAsyncRefCount;
+        // refcount may reach zero and the callback is unscheduled
         if (0 == s_nAsyncRefCount)
         {
-            CCDirector::sharedDirector()->getScheduler()->unscheduleSelector(schedule_selector(CCTextureCache::addImageAsyncCallBack), this);
+            break;
+        }
+
+        CCTime::gettimeofdayCocos2d(&now, NULL);
+        if (CCTime::timersubCocos2d(&start, &now) >= m_fAsyncUploadBudget)
+        {
+            break;
+        }
+    }
+}
+
+void CCTextureCache::uploadAsyncImage(AsyncStruct *pAsyncStruct)
+{
+    CCImage *pImage = pAsyncStruct->image;
+    CCTexture2D *texture = NULL;
+
+    if (!pAsyncStruct->cancelled && pImage)
+    {
+        const char* filename = pAsyncStruct->filename.c_str();
+
+        // same image may be requested more than once, or loaded by addImage in the meantime
+        texture = (CCTexture2D*)m_pTextures->objectForKey(filename);
+        if (!texture)
+        {
+            unsigned int maxTextureSize = CCConfiguration::sharedConfiguration()->getMaxTextureSize();
+            if (pImage->getWidth() > maxTextureSize || pImage->getHeight() > maxTextureSize)
+            {
+                CCLOG("cocos2d: WARNING: Image (%u x %u) is bigger than the supported %u x %u", pImage->getWidth(), pImage->getHeight(), maxTextureSize, maxTextureSize);
+            }
+            else
+            {
+                // generate texture in render thread, pixels are converted already
+                texture = new CCTexture2D();
+                texture->initWithConvertedImage(pImage, pAsyncStruct->data ? pAsyncStruct->data : pImage->getData(), pAsyncStruct->dataFormat);
+
+#if CC_ENABLE_CACHE_TEXTURE_DATA
+                // cache the texture file name
+                VolatileTexture::addImageTexture(texture, filename, pAsyncStruct->imageType);
+#endif
+
+                // cache the texture
+                m_pTextures->setObject(texture, filename);
+                CC_SAFE_AUTORELEASE(texture);
+            }
         }
     }
+
+    CCObject *target = pAsyncStruct->target;
+    SEL_CallFuncO selector = pAsyncStruct->selector;
+    if (texture && target && selector)
+    {
+        (target->*selector)(texture);
+    }
+
+    deleteAsyncStruct(pAsyncStruct);
+    releaseAsyncRef();
 }
 
 CCTexture2D * CCTextureCache::addImage(const char * path)
 {
+    CC_MEMORY_TAG(kCCMemoryTagTexture);
     CCAssert(path != NULL, "TextureCache: fileimage MUST not be NULL");
 
     CCTexture2D * texture = NULL;
@@ -581,8 +764,53 @@ CCTexture2D* CCTextureCache::addETCImage(const char* path)
     return texture;
 }
 
+CCTexture2D* CCTextureCache::addDecodedImage(const char *path, CCImage *image)
+{
+    CCAssert(path != NULL, "TextureCache: fileimage MUST not be NULL");
+    CCAssert(image != NULL, "TextureCache: image MUST not be nil");
+
+    std::string fullpath = CCFileUtils::sharedFileUtils()->fullPathForFilename(path);
+    if (fullpath.size() == 0)
+    {
+        return NULL;
+    }
+
+    CCTexture2D *texture = (CCTexture2D*)m_pTextures->objectForKey(fullpath.c_str());
+    if (texture)
+    {
+        return texture;
+    }
+
+    // check if this image need custom pixel format
+    CCTexture2DPixelFormat pf = checkCustomPixelFormat(fullpath);
+
+    texture = new CCTexture2D();
+    if (texture->initWithImage(image, pf))
+    {
+#if CC_ENABLE_CACHE_TEXTURE_DATA
+        // cache the texture file name
+        std::string lowerCase(fullpath);
+        for (unsigned int i = 0; i < lowerCase.length(); ++i)
+        {
+            lowerCase[i] = tolower(lowerCase[i]);
+        }
+        VolatileTexture::addImageTexture(texture, fullpath.c_str(), computeImageFormatType(lowerCase));
+#endif
+        m_pTextures->setObject(texture, fullpath.c_str());
+        CC_SAFE_RELEASE(texture);
+    }
+    else
+    {
+        CCLOG("cocos2d: Couldn't create texture for file:%s in CCTextureCache", path);
+        CC_SAFE_RELEASE_NULL(texture);
+    }
+
+    return texture;
+}
+
 CCTexture2D* CCTextureCache::addUIImage(CCImage *image, const char *key)
 {
+    CC_MEMORY_TAG(kCCMemoryTagTexture);
     CCAssert(image != NULL, "TextureCache: image MUST not be nil");
 
     CCTexture2D * texture = NULL;
@@ -38,6 +38,7 @@ NS_CC_BEGIN
 
 class CCLock;
 class CCImage;
+struct _AsyncStruct;
 
 /**
  * @addtogroup textures
@@ -59,9 +60,21 @@ protected:
     // pixel format and use format in this map
     CCDictionary* m_customPixelFormatTextures;
 
+    /// max milliseconds spent on uploading async loaded images per frame
+    float m_fAsyncUploadBudget;
+
 private:
     /// todo: void addImageWithAsyncObject(CCAsyncObject* async);
     void addImageAsyncCallBack(float dt);
+
+    /// create texture for a loaded request, call its callback and release it
+    void uploadAsyncImage(struct _AsyncStruct* pAsyncStruct);
+
+    /// cancel requests matching path and target, NULL matches any
+    void cancelAsyncRequests(const char* fullpath, CCObject* target);
+
+    /// decrease count of unfinished requests, stop upload callback when all are done
+    void releaseAsyncRef();
     
     // get texture key for etc alpha image, from a etc image key
     string textureKeyForETCAlpha(const string& key);
@@ -119,6 +132,43 @@ public:
     
     void addImageAsync(const char *path, CCObject *target, SEL_CallFuncO selector);
 
+    /** Same as addImageAsync, requests with higher priority are loaded first and requests
+    * with same priority are loaded in order. Images are decoded and converted to the final
+    * pixel format by a pool of loading threads, size of the pool is read from configuration
+    * key "cocos2d.x.texture.async_workers", default is number of cores minus one. GL thread only
+    * uploads loaded images, no more than "cocos2d.x.texture.async_upload_budget" milliseconds
+    * per frame, see setAsyncUploadBudget.
+    * @since v2.2
+    * @lua NA
+    */
+    void addImageAsync(const char *path, CCObject *target, SEL_CallFuncO selector, int priority);
+
+    /** Cancels all unfinished async requests of an image, their callbacks won't be called
+    * @since v2.2
+    * @lua NA
+    */
+    void cancelImageAsync(const char *path);
+
+    /** Cancels all unfinished async requests of a callback target, it should be called
+    * before target is destroyed if it doesn't want to wait
+    * @since v2.2
+    * @lua NA
+    */
+    void cancelImageAsyncForTarget(CCObject *target);
+
+    /** Cancels all unfinished async requests
+    * @since v2.2
+    * @lua NA
+    */
+    void cancelAllImageAsync();
+
+    /** Max milliseconds spent on uploading async loaded images per frame, at least one
+    * image is uploaded each frame no matter how small it is
+    * @since v2.2
+    */
+    float getAsyncUploadBudget() { return m_fAsyncUploadBudget; }
+    void setAsyncUploadBudget(float ms) { m_fAsyncUploadBudget = ms; }
+
     /* Returns a Texture2D object given an CGImageRef image
     * If the image was not previously loaded, it will create a new CCTexture2D object and it will return it.
     * Otherwise it will return a reference of a previously loaded image
@@ -135,6 +185,14 @@ public:
     */
     CCTexture2D* addUIImage(CCImage *image, const char *key);
 
+    /** Returns a Texture2D object for an image file whose pixels are already decoded, for
+    * example by a loading thread. Unlike addUIImage the image is not kept in memory, the texture
+    * is reloaded from file if GL context is lost, so it is only for plain image files.
+    * If the file was loaded before, the cached texture is returned.
+    * @since v2.2
+    */
+    CCTexture2D* addDecodedImage(const char *path, CCImage *image);
+
     /** Returns an already created texture. Returns nil if the texture doesn't exist.
     @since v0.99.5
     */
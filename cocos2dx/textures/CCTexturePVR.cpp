@@ -31,6 +31,7 @@ THE SOFTWARE.
 #include "support/utils/CCUtils.h"
 #include "CCStdC.h"
 #include "platform/CCFileUtils.h"
+#include "platform/CCFileView.h"
 #include "support/zip/ZipUtils.h"
 #include "shaders/ccGLStateCache.h"
 #include <ctype.h>
@@ -615,6 +616,7 @@ bool CCTexturePVR::initWithContentsOfFile(const char* path)
 {
     unsigned char* pvrdata = NULL;
     size_t pvrlen = 0;
+    CCFileView* view = NULL;
     
     std::string lowerCase(path);
     for (unsigned int i = 0; i < lowerCase.length(); ++i)
@@ -632,11 +634,18 @@ bool CCTexturePVR::initWithContentsOfFile(const char* path)
     }
     else
     {
-        pvrdata = CCFileUtils::sharedFileUtils()->getFileData(path, "rb", &pvrlen);
+        // mipmaps point into file content until they are uploaded, it is only read so a mapped view is enough
+        view = CCFileUtils::sharedFileUtils()->openFileView(path);
+        if (view)
+        {
+            pvrdata = (unsigned char*)view->getBytes();
+            pvrlen = view->getSize();
+        }
     }
     
     if (pvrlen <= 0)
     {
+        CC_SAFE_RELEASE(view);
         CC_SAFE_RELEASE(this);
         return false;
     }
@@ -652,14 +661,21 @@ bool CCTexturePVR::initWithContentsOfFile(const char* path)
 
     m_bRetainName = false; // cocos2d integration
 
-    if (! ((unpackPVRv2Data(pvrdata, pvrlen)  || unpackPVRv3Data(pvrdata, pvrlen)) && createGLTexture()) )
+    bool ok = (unpackPVRv2Data(pvrdata, pvrlen)  || unpackPVRv3Data(pvrdata, pvrlen)) && createGLTexture();
+    if (view)
+    {
+        view->release();
+    }
+    else
     {
         CC_SAFE_DELETE_ARRAY(pvrdata);
+    }
+    
+    if (!ok)
+    {
         CC_SAFE_RELEASE(this);
         return false;
     }
-
-    CC_SAFE_DELETE_ARRAY(pvrdata);
     
     return true;
 }
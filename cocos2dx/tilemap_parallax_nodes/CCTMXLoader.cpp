@@ -31,6 +31,7 @@
 #include "support/codec/CCBase64.h"
 #include "support/zip/ZipUtils.h"
 #include "platform/CCFileUtils.h"
+#include "platform/CCFileView.h"
 #include "CCDirector.h"
 
 NS_CC_BEGIN
@@ -152,10 +153,10 @@ CCTMXMapInfo* CCTMXLoader::load(const string& tmxFile) {
 	m_tmxDir = CCUtils::deleteLastPathComponent(tmxFile);
 	
 	// start
-	size_t size;
-	unsigned char* data = CCFileUtils::sharedFileUtils()->getFileData(tmxFile.c_str(), "rb", &size);
-	bool success = load((const char*)data, (int)size);
-	free(data);
+	// parser copies text, so content is read from a view without heap copy
+	CCFileView* view = CCFileUtils::sharedFileUtils()->openFileView(tmxFile.c_str());
+	bool success = view && load((const char*)view->getBytes(), (int)view->getSize());
+	CC_SAFE_RELEASE(view);
 	return success ? m_map : NULL;
 }
 
@@ -266,10 +267,9 @@ void CCTMXLoader::startElement(void* ctx, const char* name, const char** atts) {
 				}
 			} else {
 				string externalFilePath = CCUtils::appendPathComponent(m_tmxDir, externalFile);
-				size_t size;
-				unsigned char* data = CCFileUtils::sharedFileUtils()->getFileData(externalFilePath.c_str(), "rb", &size);
-				bool success = load((const char*)data, (int)size);
-				free(data);
+				CCFileView* view = CCFileUtils::sharedFileUtils()->openFileView(externalFilePath.c_str());
+				bool success = view && load((const char*)view->getBytes(), (int)view->getSize());
+				CC_SAFE_RELEASE(view);
 				
 				// firstgid is not written in external tileset, so we must read it from current tmx
 				if(success) {
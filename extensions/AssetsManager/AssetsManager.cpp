@@ -599,6 +599,9 @@ void AssetsManager::Helper::handleUpdateSucceed(Message *msg)
     {
         CCLOG("can not remove downloaded zip file %s", zipfileName.c_str());
     }
+    
+    // uncompressed files may be names which were not found before
+    CCFileUtils::sharedFileUtils()->purgeMissingFileCache();
     if (manager){
         CCArray* pArrayArgs = CCArray::createWithCapacity(2);
         pArrayArgs->addObject(CCString::create("done"));
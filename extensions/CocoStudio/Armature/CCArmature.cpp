@@ -26,6 +26,7 @@ THE SOFTWARE.
 #include "utils/CCArmatureDataManager.h"
 #include "utils/CCArmatureDefine.h"
 #include "utils/CCDataReaderHelper.h"
+#include "utils/CCArmatureBatchUpdater.h"
 #include "datas/CCDatas.h"
 #include "display/CCSkin.h"
 
@@ -83,10 +84,18 @@ m_pBatchNode(NULL),
 m_pAtlas(NULL),
 m_pParentBone(NULL),
 m_bArmatureTransformDirty(true),
+m_bPoseCacheEnabled(false),
+m_bBatchUpdateEnabled(false),
+m_bDeferDisplayUpdate(false),
+m_bDrawListDirty(true),
+m_uDrawFlushCount(0),
+m_uDrawListBuildCount(0),
 m_pBoneDic(NULL),
 m_pTopBoneList(NULL),
 m_pAnimation(NULL),
-m_pTextureAtlasDic(NULL) {
+m_pTextureAtlasDic(NULL),
+m_bBatchQueued(false),
+m_fBatchDelta(0) {
 }
 
 
@@ -457,7 +466,71 @@ CCArmatureAnimation *CCArmature::getAnimation()
 
 void CCArmature::update(float dt)
 {
-    m_pAnimation->update(dt);
+    // batch updater calls back when all armatures are queued
+    if (m_bBatchUpdateEnabled && dt > 0 && m_pParentBone == NULL && m_bRunning
+        && CCArmatureBatchUpdater::sharedBatchUpdater()->queueArmature(this, dt))
+    {
+        return;
+    }
+
+    CCObject *object = NULL;
+
+    // armature in a bone has transform of parent bone in its bones, its poses can't be shared
+    if (m_bPoseCacheEnabled && m_pParentBone == NULL && m_pArmatureData != NULL)
+    {
+        const CCArmaturePose *pose = m_pAnimation->updateWithPoseCache(dt);
+        if (pose)
+        {
+            const CCBonePose *bonePose = &pose->front();
+            CCARRAY_FOREACH(m_pTopBoneList, object)
+            {
+                bonePose = ((CCBone *)object)->applyPose(bonePose, dt);
+            }
+        }
+        else
+        {
+            CCARRAY_FOREACH(m_pTopBoneList, object)
+            {
+                ((CCBone *)object)->update(dt);
+            }
+
+            // pose is added only if all bones are saved, a bone with display chosen
+            // by user makes frame not cacheable and must not take a slot of cache
+            CCArmaturePose newPose;
+            bool saved = true;
+            CCARRAY_FOREACH(m_pTopBoneList, object)
+            {
+                if (!((CCBone *)object)->savePose(newPose))
+                {
+                    saved = false;
+                    break;
+                }
+            }
+            CCArmaturePose *cachedPose = saved ? m_pAnimation->addPose() : NULL;
+            if (cachedPose)
+            {
+                cachedPose->swap(newPose);
+            }
+        }
+    }
+    else
+    {
+        m_pAnimation->update(dt);
+
+        CCARRAY_FOREACH(m_pTopBoneList, object)
+        {
+            ((CCBone *)object)->update(dt);
+        }
+    }
+
+    m_bArmatureTransformDirty = false;
+}
+
+void CCArmature::updateTransforms(float dt)
+{
+    m_bDeferDisplayUpdate = true;
+
+    m_pAnimation->updateDeferred(dt);
 
     CCObject *object = NULL;
     CCARRAY_FOREACH(m_pTopBoneList, object)
@@ -465,7 +538,22 @@ void CCArmature::update(float dt)
         ((CCBone *)object)->update(dt);
     }
 
+    m_bDeferDisplayUpdate = false;
+}
+
+void CCArmature::updateDisplays(float dt)
+{
+    m_pAnimation->applyDeferredKeyFrames();
+
+    CCObject *object = NULL;
+    CCARRAY_FOREACH(m_pTopBoneList, object)
+    {
+        ((CCBone *)object)->updateDeferredDisplay(dt);
+    }
+
     m_bArmatureTransformDirty = false;
+
+    m_pAnimation->finishDeferredUpdate();
 }
 
 void CCArmature::draw()
@@ -476,9 +564,104 @@ void CCArmature::draw()
         ccGLBlendFunc(m_sBlendFunc.src, m_sBlendFunc.dst);
     }
 
+    if (m_bDrawListDirty)
+    {
+        buildDrawList();
+    }
+
+    m_uDrawFlushCount = 0;
+    for (std::vector<DrawRun>::iterator iter = m_drawRuns.begin(); iter != m_drawRuns.end(); iter++)
+    {
+        DrawRun &run = *iter;
+        switch (run.type)
+        {
+        case DRAW_RUN_SKINS:
+        {
+            if (m_pAtlas && (m_pAtlas != run.atlas || run.blendDirty))
+            {
+                flushAtlas();
+            }
+            m_pAtlas = run.atlas;
+
+            // atlas is sized by buildDrawList, but child armatures or other armatures in batch node may share it
+            unsigned int quads = m_pAtlas->getTotalQuads() + run.count;
+            if (quads > m_pAtlas->getCapacity() && !m_pAtlas->resizeCapacity(MAX(quads, m_pAtlas->getCapacity() * 2)))
+                return;
+
+            for (unsigned int i = run.first; i < run.first + run.count; i++)
+            {
+                CCSkin *skin = m_drawSkins[i];
+
+                // atlas of skin is changed without notice, skip it and rebuild list in next frame
+                if (skin->getTextureAtlas() != m_pAtlas)
+                {
+                    m_bDrawListDirty = true;
+                    continue;
+                }
+                skin->updateTransform();
+            }
+
+            if (run.blendDirty)
+            {
+                ccGLBlendFunc(run.blendFunc.src, run.blendFunc.dst);
+                flushAtlas();
+                ccGLBlendFunc(m_sBlendFunc.src, m_sBlendFunc.dst);
+            }
+        }
+        break;
+        case DRAW_RUN_ARMATURE:
+        {
+            CCArmature *armature = (CCArmature *)run.node;
+
+            if (m_pAtlas && m_pAtlas != armature->getTextureAtlas())
+            {
+                flushAtlas();
+            }
+            armature->draw();
+
+            m_pAtlas = armature->getTextureAtlas();
+        }
+        break;
+        default:
+        {
+            if (m_pAtlas)
+            {
+                flushAtlas();
+            }
+            run.node->visit();
+
+            CC_NODE_DRAW_SETUP(this);
+            ccGLBlendFunc(m_sBlendFunc.src, m_sBlendFunc.dst);
+        }
+        break;
+        }
+    }
+
+    if(m_pAtlas && !m_pBatchNode && m_pParentBone == NULL)
+    {
+        flushAtlas();
+    }
+}
+
+void CCArmature::buildDrawList()
+{
+    m_bDrawListDirty = false;
+    m_uDrawListBuildCount++;
+    m_drawRuns.clear();
+    m_drawSkins.clear();
+
     CCObject *object = NULL;
     CCARRAY_FOREACH(m_pChildren, object)
     {
+        DrawRun run;
+        run.type = DRAW_RUN_NODE;
+        run.atlas = NULL;
+        run.blendFunc = m_sBlendFunc;
+        run.blendDirty = false;
+        run.first = m_drawSkins.size();
+        run.count = 0;
+        run.node = (CCNode *)object;
+
         if (CCBone *bone = dynamic_cast<CCBone *>(object))
         {
             CCNode *node = bone->getDisplayRenderNode();
@@ -486,95 +669,115 @@ void CCArmature::draw()
             if (NULL == node)
                 continue;
 
+            run.node = node;
             switch (bone->getDisplayRenderNodeType())
             {
             case CS_DISPLAY_SPRITE:
             {
                 CCSkin *skin = (CCSkin *)node;
-
-                CCTextureAtlas *textureAtlas = skin->getTextureAtlas();
+                if (skin->getTextureAtlas() == NULL)
+                    continue;
 
                 ccBlendFunc func = bone->getBlendFunc();
                 bool blendDirty = func.src != CC_BLEND_SRC || func.dst != CC_BLEND_DST;
 
-                if(m_pAtlas != textureAtlas || blendDirty)
+                // join last run if nothing needs a flush between them
+                if (!m_drawRuns.empty())
                 {
-                    if (m_pAtlas)
+                    DrawRun &last = m_drawRuns.back();
+                    if (last.type == DRAW_RUN_SKINS && last.atlas == skin->getTextureAtlas() && last.blendDirty == blendDirty
+                        && (!blendDirty || (last.blendFunc.src == func.src && last.blendFunc.dst == func.dst)))
                     {
-                        m_pAtlas->drawQuads();
-                        m_pAtlas->removeAllQuads();
+                        last.count++;
+                        m_drawSkins.push_back(skin);
+                        continue;
                     }
                 }
 
-                m_pAtlas = textureAtlas;
-                if (m_pAtlas->getCapacity() == m_pAtlas->getTotalQuads() && !m_pAtlas->resizeCapacity(m_pAtlas->getCapacity() * 2))
-                    return;
-
-                skin->updateTransform();
-
-                if (blendDirty)
-                {
-                    ccGLBlendFunc(func.src, func.dst);
-
-                    m_pAtlas->drawQuads();
-                    m_pAtlas->removeAllQuads();
-
-                    ccGLBlendFunc(m_sBlendFunc.src, m_sBlendFunc.dst);
-                }
+                run.type = DRAW_RUN_SKINS;
+                run.atlas = skin->getTextureAtlas();
+                run.blendFunc = func;
+                run.blendDirty = blendDirty;
+                run.count = 1;
+                m_drawSkins.push_back(skin);
             }
             break;
             case CS_DISPLAY_ARMATURE:
-            {
-                CCArmature *armature = (CCArmature *)(node);
+                run.type = DRAW_RUN_ARMATURE;
+                break;
+            default:
+                break;
+            }
+        }
 
-                CCTextureAtlas *textureAtlas = armature->getTextureAtlas();
-                if(m_pAtlas != textureAtlas)
-                {
-                    if (m_pAtlas)
-                    {
-                        m_pAtlas->drawQuads();
-                        m_pAtlas->removeAllQuads();
-                    }
-                }
-                armature->draw();
+        m_drawRuns.push_back(run);
+    }
 
-                m_pAtlas = armature->getTextureAtlas();
-            }
-            break;
-            default:
+    // size every atlas once for all skins of this armature which use it
+    for (unsigned int i = 0; i < m_drawRuns.size(); i++)
+    {
+        DrawRun &run = m_drawRuns[i];
+        if (run.type != DRAW_RUN_SKINS)
+            continue;
+
+        bool counted = false;
+        unsigned int quads = 0;
+        for (unsigned int j = 0; j < m_drawRuns.size(); j++)
+        {
+            if (m_drawRuns[j].type == DRAW_RUN_SKINS && m_drawRuns[j].atlas == run.atlas)
             {
-                if (m_pAtlas)
+                if (j < i)
                 {
-                    m_pAtlas->drawQuads();
-                    m_pAtlas->removeAllQuads();
+                    counted = true;
+                    break;
                 }
-                node->visit();
-
-                CC_NODE_DRAW_SETUP(this);
-                ccGLBlendFunc(m_sBlendFunc.src, m_sBlendFunc.dst);
-            }
-            break;
+                quads += m_drawRuns[j].count;
             }
         }
-        else if(CCNode *node = dynamic_cast<CCNode *>(object))
-        {
-            if (m_pAtlas)
-            {
-                m_pAtlas->drawQuads();
-                m_pAtlas->removeAllQuads();
-            }
-            node->visit();
 
-            CC_NODE_DRAW_SETUP(this);
-            ccGLBlendFunc(m_sBlendFunc.src, m_sBlendFunc.dst);
+        if (!counted && run.atlas->getCapacity() < quads)
+        {
+            run.atlas->resizeCapacity(quads);
         }
     }
+}
 
-    if(m_pAtlas && !m_pBatchNode && m_pParentBone == NULL)
+void CCArmature::flushAtlas()
+{
+    if (m_pAtlas->getTotalQuads() > 0)
     {
         m_pAtlas->drawQuads();
         m_pAtlas->removeAllQuads();
+        m_uDrawFlushCount++;
+    }
+}
+
+void CCArmature::addChild(CCNode *child, int zOrder, int tag)
+{
+    CCNodeRGBA::addChild(child, zOrder, tag);
+    m_bDrawListDirty = true;
+}
+
+void CCArmature::removeChild(CCNode *child, bool cleanup)
+{
+    CCNodeRGBA::removeChild(child, cleanup);
+    m_bDrawListDirty = true;
+}
+
+void CCArmature::removeAllChildrenWithCleanup(bool cleanup)
+{
+    CCNodeRGBA::removeAllChildrenWithCleanup(cleanup);
+    m_bDrawListDirty = true;
+}
+
+void CCArmature::sortAllChildren()
+{
+    // zorder of a bone is changed
+    if (m_bReorderChildDirty)
+    {
+        m_bDrawListDirty = true;
     }
+    CCNodeRGBA::sortAllChildren();
 }
 
 
@@ -688,6 +891,7 @@ CCTextureAtlas *CCArmature::getTexureAtlasWithTexture(CCTexture2D *texture)
 void CCArmature::setParentBone(CCBone *parentBone)
 {
     m_pParentBone = parentBone;
+    m_bDrawListDirty = true;
 
     CCDictElement *element = NULL;
     CCDICT_FOREACH(m_pBoneDic, element)
@@ -36,6 +36,9 @@ class b2Body;
 struct cpBody;
 
 NS_CC_EXT_BEGIN
+
+class CCSkin;
+
 /**
  *  @lua NA
  */
@@ -127,6 +130,30 @@ public:
     virtual void update(float dt);
     virtual void draw();
 
+    using CCNode::addChild;
+    using CCNode::removeChild;
+    virtual void addChild(CCNode *child, int zOrder, int tag);
+    virtual void removeChild(CCNode *child, bool cleanup);
+    virtual void removeAllChildrenWithCleanup(bool cleanup);
+    virtual void sortAllChildren();
+
+    /// count of runs in draw list, a run of skins is drawn with one draw call at most
+    unsigned int getDrawRunCount() { return m_drawRuns.size(); }
+
+    /**
+     * First part of update, it updates animation, tweens and bone transforms but leaves
+     * displays, key frame display changes, colors, movement list and events to updateDisplays.
+     * It only touches this armature, so CCArmatureBatchUpdater calls it in worker threads.
+     * @since v2.2
+     */
+    virtual void updateTransforms(float dt);
+
+    /**
+     * Second part of update, it does the work left by updateTransforms, in main thread
+     * @since v2.2
+     */
+    virtual void updateDisplays(float dt);
+
     virtual const CCAffineTransform& nodeToParentTransform();
 
     virtual void onEnter();
@@ -190,6 +217,70 @@ protected:
     CC_SYNTHESIZE(float, m_fVersion, Version);
 
     CC_SYNTHESIZE_READONLY(bool, m_bArmatureTransformDirty, ArmatureTransformDirty);
+
+    /**
+     * Share bone poses with other armatures through CCArmaturePoseCache, it is for a crowd
+     * of armatures playing same movements. Pose is cached by frame index, so animation runs
+     * at whole frames for cached movements, bone tweens are moved to the whole frame before
+     * a pose is saved. A frame is not cached while a bone shows a display chosen by code.
+     * Bones should not be transformed by code, and armature in a bone never uses cache.
+     * Default is false.
+     * @since v2.2
+     */
+    CC_SYNTHESIZE_BOOL(m_bPoseCacheEnabled, PoseCacheEnabled);
+
+    /**
+     * Update this armature with other armatures by CCArmatureBatchUpdater, transforms of
+     * armatures are updated in worker threads. Scheduled update only queues armature and it
+     * is updated after all other updates of this frame. Update with zero delta, which play
+     * calls to refresh bones, is done at once. Armature in a bone is always updated by its
+     * parent armature. Default is false.
+     * @since v2.2
+     */
+    CC_SYNTHESIZE_BOOL(m_bBatchUpdateEnabled, BatchUpdateEnabled);
+
+    //! True while updateTransforms is running, bones and tweens leave display work behind
+    CC_SYNTHESIZE_READONLY(bool, m_bDeferDisplayUpdate, DeferDisplayUpdate);
+
+    /**
+     * Draw list should be rebuilt before next draw. Bones mark it when display, blend function
+     * or zorder is changed, call markDrawListDirty if you change a skin in other way.
+     * @since v2.2
+     */
+    CC_SYNTHESIZE_BOOL(m_bDrawListDirty, DrawListDirty);
+
+    //! Count of draw calls issued by this armature in last draw
+    CC_SYNTHESIZE_READONLY(unsigned int, m_uDrawFlushCount, DrawFlushCount);
+
+    //! Count of draw list rebuilds since armature is created
+    CC_SYNTHESIZE_READONLY(unsigned int, m_uDrawListBuildCount, DrawListBuildCount);
+protected:
+    //! Type of a run in draw list
+    enum DrawRunType
+    {
+        DRAW_RUN_SKINS,        //! skins sharing same atlas and blend function
+        DRAW_RUN_ARMATURE,     //! child armature, it draws itself
+        DRAW_RUN_NODE          //! other display or child node, it is visited
+    };
+
+    //! A run in draw list
+    struct DrawRun
+    {
+        DrawRunType type;
+        CCTextureAtlas *atlas;
+        ccBlendFunc blendFunc;
+        bool blendDirty;               //! blend function is not default one
+        unsigned int first;            //! first skin in m_drawSkins
+        unsigned int count;            //! count of skins
+        CCNode *node;                  //! armature or node of run
+    };
+
+    //! Resolve children to draw runs, and make sure atlases are big enough
+    void buildDrawList();
+
+    //! Draw quads in current atlas and clear it
+    void flushAtlas();
+
 protected:
     CCDictionary *m_pBoneDic;                    //! The dictionary of the bones, include all bones in the armature, no matter it is the direct bone or the indirect bone. It is different from m_pChindren.
 
@@ -205,6 +296,16 @@ protected:
 
     CCDictionary *m_pTextureAtlasDic;
 
+    //! Queued by batch updater, and delta time queued in this frame
+    bool m_bBatchQueued;
+    float m_fBatchDelta;
+
+    friend class CCArmatureBatchUpdater;
+
+    //! Draw list, skins of skin runs are in m_drawSkins. Displays are retained by bones
+    std::vector<DrawRun> m_drawRuns;
+    std::vector<CCSkin *> m_drawSkins;
+
 #if ENABLE_PHYSICS_BOX2D_DETECT
     CC_PROPERTY(b2Body *, m_pBody, Body);
 #elif ENABLE_PHYSICS_CHIPMUNK_DETECT
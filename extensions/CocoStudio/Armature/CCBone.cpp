@@ -77,6 +77,7 @@ CCBone::CCBone()
     m_sBlendFunc.src = CC_BLEND_SRC;
     m_sBlendFunc.dst = CC_BLEND_DST;
     m_bBlendDirty = false;
+    m_bDisplayDirty = false;
 }
 
 
@@ -223,7 +224,15 @@ void CCBone::update(float delta)
         }
     }
 
-    CCDisplayFactory::updateDisplay(this, delta, m_bBoneTransformDirty || m_pArmature->getArmatureTransformDirty());
+    // display is a node of scene, it is updated later in main thread
+    if (m_pArmature->getDeferDisplayUpdate())
+    {
+        m_bDisplayDirty = m_bDisplayDirty || m_bBoneTransformDirty || m_pArmature->getArmatureTransformDirty();
+    }
+    else
+    {
+        CCDisplayFactory::updateDisplay(this, delta, m_bBoneTransformDirty || m_pArmature->getArmatureTransformDirty());
+    }
 
     CCObject *object = NULL;
     CCARRAY_FOREACH(m_pChildren, object)
@@ -235,6 +244,115 @@ void CCBone::update(float delta)
     m_bBoneTransformDirty = false;
 }
 
+void CCBone::updateDeferredDisplay(float delta)
+{
+    CCDisplayFactory::updateDisplay(this, delta, m_bDisplayDirty);
+    m_bDisplayDirty = false;
+
+    CCObject *object = NULL;
+    CCARRAY_FOREACH(m_pChildren, object)
+    {
+        ((CCBone *)object)->updateDeferredDisplay(delta);
+    }
+}
+
+const CCBonePose *CCBone::applyPose(const CCBonePose *pose, float delta)
+{
+    bool dirty = m_pArmature->getArmatureTransformDirty() || memcmp(&m_tWorldTransform, &pose->worldTransform, sizeof(CCAffineTransform)) != 0;
+    m_tWorldTransform = pose->worldTransform;
+    m_tWorldInfo->x = pose->worldInfo[0];
+    m_tWorldInfo->y = pose->worldInfo[1];
+    m_tWorldInfo->scaleX = pose->worldInfo[2];
+    m_tWorldInfo->scaleY = pose->worldInfo[3];
+    m_tWorldInfo->skewX = pose->worldInfo[4];
+    m_tWorldInfo->skewY = pose->worldInfo[5];
+    m_pTweenData->x = pose->tween[0];
+    m_pTweenData->y = pose->tween[1];
+    m_pTweenData->scaleX = pose->tween[2];
+    m_pTweenData->scaleY = pose->tween[3];
+    m_pTweenData->skewX = pose->tween[4];
+    m_pTweenData->skewY = pose->tween[5];
+    m_bBoneTransformDirty = false;
+
+    // same as what tween does when it arrives a key frame
+    bool colorDirty = false;
+    if (!m_pDisplayManager->getForceChangeDisplay() && m_pDisplayManager->getCurrentDisplayIndex() != pose->displayIndex)
+    {
+        m_pDisplayManager->changeDisplayWithIndex(pose->displayIndex, false);
+        colorDirty = true;
+    }
+    if (m_pTweenData->zOrder != pose->zOrder)
+    {
+        m_pTweenData->zOrder = pose->zOrder;
+        updateZOrder();
+    }
+    setBlendFunc(pose->blendFunc);
+    if (m_pTweenData->a != pose->a || m_pTweenData->r != pose->r || m_pTweenData->g != pose->g || m_pTweenData->b != pose->b)
+    {
+        m_pTweenData->a = pose->a;
+        m_pTweenData->r = pose->r;
+        m_pTweenData->g = pose->g;
+        m_pTweenData->b = pose->b;
+        colorDirty = true;
+    }
+    if (colorDirty)
+    {
+        updateColor();
+    }
+
+    CCDisplayFactory::updateDisplay(this, delta, dirty);
+
+    pose++;
+    CCObject *object = NULL;
+    CCARRAY_FOREACH(m_pChildren, object)
+    {
+        pose = ((CCBone *)object)->applyPose(pose, delta);
+    }
+    return pose;
+}
+
+bool CCBone::savePose(CCArmaturePose &pose)
+{
+    // display chosen by user is not a part of movement
+    if (m_pDisplayManager->getForceChangeDisplay())
+    {
+        return false;
+    }
+
+    pose.push_back(CCBonePose());
+    CCBonePose &bonePose = pose.back();
+    bonePose.worldTransform = m_tWorldTransform;
+    bonePose.worldInfo[0] = m_tWorldInfo->x;
+    bonePose.worldInfo[1] = m_tWorldInfo->y;
+    bonePose.worldInfo[2] = m_tWorldInfo->scaleX;
+    bonePose.worldInfo[3] = m_tWorldInfo->scaleY;
+    bonePose.worldInfo[4] = m_tWorldInfo->skewX;
+    bonePose.worldInfo[5] = m_tWorldInfo->skewY;
+    bonePose.tween[0] = m_pTweenData->x;
+    bonePose.tween[1] = m_pTweenData->y;
+    bonePose.tween[2] = m_pTweenData->scaleX;
+    bonePose.tween[3] = m_pTweenData->scaleY;
+    bonePose.tween[4] = m_pTweenData->skewX;
+    bonePose.tween[5] = m_pTweenData->skewY;
+    bonePose.a = m_pTweenData->a;
+    bonePose.r = m_pTweenData->r;
+    bonePose.g = m_pTweenData->g;
+    bonePose.b = m_pTweenData->b;
+    bonePose.zOrder = m_pTweenData->zOrder;
+    bonePose.displayIndex = m_pDisplayManager->getCurrentDisplayIndex();
+    bonePose.blendFunc = m_sBlendFunc;
+
+    CCObject *object = NULL;
+    CCARRAY_FOREACH(m_pChildren, object)
+    {
+        if (!((CCBone *)object)->savePose(pose))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 void CCBone::applyParentTransform(CCBone *parent)
 {
     float x = m_tWorldInfo->x;
@@ -387,6 +505,10 @@ void CCBone::setBlendFunc(const ccBlendFunc& blendFunc)
     {
         m_sBlendFunc = blendFunc;
         m_bBlendDirty = true;
+        if (m_pArmature)
+        {
+            m_pArmature->markDrawListDirty();
+        }
     }
 }
 
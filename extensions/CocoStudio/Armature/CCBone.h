@@ -28,6 +28,7 @@ THE SOFTWARE.
 #include "utils/CCArmatureDefine.h"
 #include "datas/CCDatas.h"
 #include "animation/CCTween.h"
+#include "animation/CCArmaturePoseCache.h"
 #include "display/CCDecorativeDisplay.h"
 #include "display/CCDisplayManager.h"
 
@@ -137,6 +138,32 @@ public:
 
     void update(float delta);
 
+    /**
+     * Update displays of this bone and its child bones, when update is called with
+     * display update deferred, see CCArmature::updateTransforms
+     * @since v2.2
+     */
+    void updateDeferredDisplay(float delta);
+
+    /**
+     * Instead of update, set state of this bone and its child bones from a cached pose.
+     * Poses are in same order as update visits bones.
+     *
+     * @param pose pose of this bone
+     * @return pose after poses of this bone and its child bones
+     * @since v2.2
+     */
+    const CCBonePose *applyPose(const CCBonePose *pose, float delta);
+
+    /**
+     * Append state of this bone and its child bones to a pose, it should be called
+     * after update.
+     *
+     * @return false if a bone shows a display chosen by user, such pose can't be shared
+     * @since v2.2
+     */
+    bool savePose(CCArmaturePose &pose);
+
     void updateDisplayedColor(const ccColor3B &parentColor);
     void updateDisplayedOpacity(GLubyte parentOpacity);
 
@@ -235,6 +262,9 @@ protected:
 
     ccBlendFunc m_sBlendFunc; 
     bool m_bBlendDirty;
+
+    //! Whether or not display transform should be updated by updateDeferredDisplay
+    bool m_bDisplayDirty;
 };
 
 NS_CC_EXT_END
@@ -55,6 +55,11 @@ CCArmatureAnimation::CCArmatureAnimation()
 , m_iToIndex(0)
 , m_pTweenList(NULL)
 , m_bIgnoreFrameEvent(false)
+, m_bTweensStale(false)
+, m_pPoseCheckedMovement(NULL)
+, m_bPoseCacheableMovement(false)
+, m_iPoseFrameIndex(-1)
+, m_bMovementListDeferred(false)
 , m_bOnMovementList(false)
 , m_bMovementListLoop(false)
 , m_iMovementListDurationTo(-1)
@@ -128,6 +133,7 @@ void CCArmatureAnimation::stop()
         ((CCTween *)object)->stop();
     }
     m_pTweenList->removeAllObjects();
+    m_iPoseFrameIndex = -1;
     CCProcessBase::stop();
 }
 
@@ -174,8 +180,8 @@ float CCArmatureAnimation::getSpeedScale() const
 
 int CCArmatureAnimation::getMovementFrames(const char *animationName) {
     CCAssert(m_pAnimationData, "m_pAnimationData can not be null");
-    m_pMovementData = m_pAnimationData->getMovement(animationName);
-    return m_pMovementData->duration;
+    CCMovementData *movementData = m_pAnimationData->getMovement(animationName);
+    return movementData->duration;
 }
 
 void CCArmatureAnimation::play(const char *animationName, int durationTo, int durationTween,  int loop, int tweenEasing)
@@ -207,6 +213,9 @@ void CCArmatureAnimation::play(const char *animationName, int durationTo, int du
     loop = (loop < 0) ? m_pMovementData->loop : loop;
 
     m_bOnMovementList = false;
+    m_bTweensStale = false;
+    m_iPoseFrameIndex = -1;
+    m_pPoseCheckedMovement = NULL;
 
     CCProcessBase::play(durationTo, durationTween, loop, tweenEasing);
 
@@ -378,6 +387,8 @@ void CCArmatureAnimation::gotoAndPlay(int frameIndex)
 
     bool ignoreFrameEvent = m_bIgnoreFrameEvent;
     m_bIgnoreFrameEvent = true;
+    m_bTweensStale = false;
+    m_iPoseFrameIndex = -1;
 
     m_bIsPlaying = true;
     m_bIsComplete = m_bIsPause = false;
@@ -411,12 +422,183 @@ int CCArmatureAnimation::getMovementCount()
 void CCArmatureAnimation::update(float dt)
 {
     CCProcessBase::update(dt);
+    updateTweens(dt);
+    dispatchEvents();
+}
+
+void CCArmatureAnimation::updateDeferred(float dt)
+{
+    CCProcessBase::update(dt);
+    updateTweens(dt);
+}
+
+void CCArmatureAnimation::applyDeferredKeyFrames()
+{
+    CCObject *object = NULL;
+    CCARRAY_FOREACH(m_pTweenList, object)
+    {
+        ((CCTween *)object)->applyDeferredKeyFrames();
+    }
+}
+
+void CCArmatureAnimation::finishDeferredUpdate()
+{
+    if (m_bMovementListDeferred)
+    {
+        m_bMovementListDeferred = false;
+        updateMovementList();
+    }
+    dispatchEvents();
+}
+
+void CCArmatureAnimation::updateTweens(float dt)
+{
+    if (m_bTweensStale)
+    {
+        syncTweens();
+    }
+    else
+    {
+        CCObject *object = NULL;
+        CCARRAY_FOREACH(m_pTweenList, object)
+        {
+            ((CCTween *)object)->update(dt);
+        }
+    }
+}
+
+const CCArmaturePose *CCArmatureAnimation::updateWithPoseCache(float dt)
+{
+    m_iPoseFrameIndex = -1;
+    CCProcessBase::update(dt);
+
+    const CCArmaturePose *pose = NULL;
+    if (isPoseCacheable())
+    {
+        // same clamp as tweens, they hold last frame when percent passes 1. A frame reached
+        // by adding dt may be a hair below a whole frame, it is still that frame
+        int frameIndex = (int)((m_iRawDuration - 1) * m_fCurrentPercent + 0.001f);
+        frameIndex = MAX(0, MIN(frameIndex, m_iRawDuration - 1));
+        CCArmatureData *armatureData = m_pArmature->getArmatureData();
+        CCArmaturePoseCache *cache = CCArmaturePoseCache::sharedArmaturePoseCache();
+        pose = cache->getPose(armatureData, m_pMovementData, frameIndex, m_eTweenEasing);
+
+        // a pose saved by armature which has bones added or removed can't be used
+        if (pose && (pose->empty() || pose->size() != m_pArmature->getBoneDic()->count()))
+        {
+            pose = NULL;
+        }
+
+        if (pose)
+        {
+            m_bTweensStale = true;
+        }
+        else
+        {
+            // pose is saved for a whole frame, so tweens are moved to that frame
+            // instead of fraction of frame dt brings them to
+            m_iPoseFrameIndex = frameIndex;
+            if (m_iRawDuration > 1)
+            {
+                m_bTweensStale = true;
+            }
+        }
+    }
+
+    if (!pose)
+    {
+        updateTweens(dt);
+    }
+
+    dispatchEvents();
+    return pose;
+}
+
+CCArmaturePose *CCArmatureAnimation::addPose()
+{
+    if (m_iPoseFrameIndex < 0)
+    {
+        return NULL;
+    }
+
+    CCArmaturePose *pose = CCArmaturePoseCache::sharedArmaturePoseCache()->addPose(m_pArmature->getArmatureData(), m_pMovementData, m_iPoseFrameIndex, m_eTweenEasing);
+    m_iPoseFrameIndex = -1;
+    return pose;
+}
+
+bool CCArmatureAnimation::isPoseCacheable()
+{
+    // only a movement playing by itself, not a transition or a stopped movement
+    if (!m_pMovementData || !m_bIsPlaying || m_bIsPause || m_bIsComplete || m_eLoopType <= ANIMATION_TO_LOOP_BACK)
+    {
+        return false;
+    }
+
+    if (m_pPoseCheckedMovement != m_pMovementData)
+    {
+        // frame event and movement of child armature are fired by tweens, they can't be skipped
+        m_pPoseCheckedMovement = m_pMovementData;
+        m_bPoseCacheableMovement = true;
+        CCDictElement *element = NULL;
+        CCDictionary *dict = &m_pMovementData->movBoneDataDic;
+        CCDICT_FOREACH(dict, element)
+        {
+            CCMovementBoneData *boneData = (CCMovementBoneData *)element->getObject();
+            CCObject *object = NULL;
+            CCARRAY_FOREACH(&boneData->frameList, object)
+            {
+                CCFrameData *frame = (CCFrameData *)object;
+                if (!frame->strEvent.empty() || !frame->strMovement.empty())
+                {
+                    m_bPoseCacheableMovement = false;
+                    break;
+                }
+            }
+            if (!m_bPoseCacheableMovement)
+            {
+                break;
+            }
+        }
+    }
+
+    return m_bPoseCacheableMovement;
+}
+
+void CCArmatureAnimation::syncTweens()
+{
+    m_bTweensStale = false;
+    if (m_iRawDuration <= 1)
+    {
+        return;
+    }
+
+    // same as gotoAndPlay, but keep status of movement
+    int frameIndex = getCurrentFrameIndex();
+    frameIndex = MAX(0, MIN(frameIndex, m_iRawDuration - 1));
+    bool ignoreFrameEvent = m_bIgnoreFrameEvent;
+    m_bIgnoreFrameEvent = true;
+
     CCObject *object = NULL;
     CCARRAY_FOREACH(m_pTweenList, object)
     {
-        ((CCTween *)object)->update(dt);
+        CCTween *tween = (CCTween *)object;
+        tween->gotoAndPlay(frameIndex);
+        tween->update(0);
+        if (m_bIsComplete)
+        {
+            tween->stop();
+        }
+        else if (m_bIsPause)
+        {
+            tween->pause();
+        }
     }
 
+    m_bIgnoreFrameEvent = ignoreFrameEvent;
+}
+
+void CCArmatureAnimation::dispatchEvents()
+{
     while (m_sFrameEventQueue.size() > 0)
     {
         CCFrameEvent *event = m_sFrameEventQueue.front();
@@ -500,7 +682,15 @@ void CCArmatureAnimation::updateHandler()
                 movementEvent(m_pArmature, COMPLETE, m_strMovementID.c_str());
             }
 
-            updateMovementList();
+            // next movement is played by main thread
+            if (m_pArmature->getDeferDisplayUpdate())
+            {
+                m_bMovementListDeferred = true;
+            }
+            else
+            {
+                updateMovementList();
+            }
         }
         break;
         case ANIMATION_TO_LOOP_FRONT:
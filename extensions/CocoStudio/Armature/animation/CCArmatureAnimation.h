@@ -27,6 +27,7 @@ THE SOFTWARE.
 #define __CCANIMATION_H__
 
 #include "CCProcessBase.h"
+#include "CCArmaturePoseCache.h"
 #include <queue>
 
 NS_CC_EXT_BEGIN
@@ -204,6 +205,52 @@ public:
 
     void update(float dt);
 
+    /**
+     * Same as update, but uses pose cache. If pose of current frame is cached, bone tweens
+     * are skipped and the cached pose is returned, caller should apply it to bones. Otherwise
+     * NULL is returned, caller updates bones and then saves them by addPose. Bone tweens are
+     * moved to the whole frame which the pose is saved for, or updated as usual if the frame
+     * can't be cached.
+     *
+     * Movement which has frame event or changes movement of child armature is never cached,
+     * and neither is transition between two movements.
+     *
+     * @since v2.2
+     */
+    const CCArmaturePose *updateWithPoseCache(float dt);
+
+    /**
+     * Add an empty pose to pose cache for frame of last updateWithPoseCache, caller fills it
+     * with bones.
+     *
+     * @return NULL if that frame can't be cached, or movement is changed after it, for example,
+     *      by a movement event callback
+     * @since v2.2
+     */
+    CCArmaturePose *addPose();
+
+    /**
+     * First part of a deferred update, see CCArmature::updateTransforms. It updates movement
+     * and tweens, but leaves key frame displays, colors, movement list and events behind. It
+     * may run in a worker thread.
+     * @since v2.2
+     */
+    void updateDeferred(float dt);
+
+    /**
+     * Apply key frames and colors left behind by updateDeferred, it should be called
+     * before bone displays are updated
+     * @since v2.2
+     */
+    void applyDeferredKeyFrames();
+
+    /**
+     * Last part of a deferred update, it plays next movement of movement list if needed and
+     * dispatches events
+     * @since v2.2
+     */
+    void finishDeferredUpdate();
+
     /**
      * Get current movementID
      * @return The name of current movement
@@ -308,6 +355,18 @@ protected:
 
     void updateMovementList();
 
+    /// dispatch queued frame events and movement events
+    void dispatchEvents();
+
+    /// can bone poses of current frame be cached
+    bool isPoseCacheable();
+
+    /// tweens are not updated when pose is from cache, this moves them to current frame
+    void syncTweens();
+
+    /// update tweens, or sync them if they are stale
+    void updateTweens(float dt);
+
     inline bool isIgnoreFrameEvent() { return m_bIgnoreFrameEvent; }
 
     friend class CCTween;
@@ -330,6 +389,19 @@ protected:
 
     bool m_bIgnoreFrameEvent;
 
+    //! True if poses are taken from pose cache and tweens are left behind
+    bool m_bTweensStale;
+
+    //! The movement checked by isPoseCacheable, and whether its poses can be cached
+    CCMovementData *m_pPoseCheckedMovement;
+    bool m_bPoseCacheableMovement;
+
+    //! Frame index of pose to be added by addPose, -1 means none
+    int m_iPoseFrameIndex;
+
+    //! True if movement list should play next movement when deferred update finishes
+    bool m_bMovementListDeferred;
+
     std::queue<CCFrameEvent*> m_sFrameEventQueue;
     std::queue<CCMovementEvent*> m_sMovementEventQueue;
 
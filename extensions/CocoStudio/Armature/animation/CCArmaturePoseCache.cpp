@@ -0,0 +1,117 @@
+/****************************************************************************
+ Author: Luma (stubma@gmail.com)
+
+ https://github.com/stubma/cocos2dx-classical
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#include "CCArmaturePoseCache.h"
+
+NS_CC_EXT_BEGIN
+
+static CCArmaturePoseCache *s_sharedArmaturePoseCache = NULL;
+
+bool CCArmaturePoseCache::Key::operator<(const Key &k) const {
+    if(armatureData != k.armatureData)
+        return armatureData < k.armatureData;
+    if(movementData != k.movementData)
+        return movementData < k.movementData;
+    if(frameIndex != k.frameIndex)
+        return frameIndex < k.frameIndex;
+    return tweenEasing < k.tweenEasing;
+}
+
+CCArmaturePoseCache::CCArmaturePoseCache() :
+m_capacity(CS_ARMATURE_POSE_CACHE_CAPACITY) {
+}
+
+CCArmaturePoseCache::~CCArmaturePoseCache() {
+    removeAllPoses();
+}
+
+CCArmaturePoseCache *CCArmaturePoseCache::sharedArmaturePoseCache() {
+    if(s_sharedArmaturePoseCache == NULL) {
+        s_sharedArmaturePoseCache = new CCArmaturePoseCache();
+    }
+    return s_sharedArmaturePoseCache;
+}
+
+void CCArmaturePoseCache::purge() {
+    CC_SAFE_RELEASE_NULL(s_sharedArmaturePoseCache);
+}
+
+const CCArmaturePose *CCArmaturePoseCache::getPose(CCArmatureData *armatureData, CCMovementData *movementData, int frameIndex, int tweenEasing) {
+    Key key = { armatureData, movementData, frameIndex, tweenEasing };
+    EntryMap::iterator iter = m_index.find(key);
+    if(iter == m_index.end())
+        return NULL;
+
+    // move to front, it is most recently used now
+    if(iter->second != m_entries.begin()) {
+        m_entries.splice(m_entries.begin(), m_entries, iter->second);
+    }
+    return &iter->second->pose;
+}
+
+CCArmaturePose *CCArmaturePoseCache::addPose(CCArmatureData *armatureData, CCMovementData *movementData, int frameIndex, int tweenEasing) {
+    Key key = { armatureData, movementData, frameIndex, tweenEasing };
+    EntryMap::iterator iter = m_index.find(key);
+    if(iter != m_index.end()) {
+        m_entries.splice(m_entries.begin(), m_entries, iter->second);
+        iter->second->pose.clear();
+        return &iter->second->pose;
+    }
+
+    // make room
+    while(m_entries.size() >= m_capacity && !m_entries.empty()) {
+        removeOldestPose();
+    }
+
+    // data are retained, so their addresses can't be reused by other data while key is alive
+    armatureData->retain();
+    movementData->retain();
+    m_entries.push_front(Entry());
+    Entry &entry = m_entries.front();
+    entry.key = key;
+    m_index[key] = m_entries.begin();
+    return &entry.pose;
+}
+
+void CCArmaturePoseCache::removeOldestPose() {
+    Entry &entry = m_entries.back();
+    m_index.erase(entry.key);
+    entry.key.armatureData->release();
+    entry.key.movementData->release();
+    m_entries.pop_back();
+}
+
+void CCArmaturePoseCache::removeAllPoses() {
+    while(!m_entries.empty()) {
+        removeOldestPose();
+    }
+}
+
+void CCArmaturePoseCache::setCapacity(unsigned int capacity) {
+    m_capacity = MAX(1u, capacity);
+    while(m_entries.size() > m_capacity) {
+        removeOldestPose();
+    }
+}
+
+NS_CC_EXT_END
@@ -0,0 +1,155 @@
+/****************************************************************************
+ Author: Luma (stubma@gmail.com)
+
+ https://github.com/stubma/cocos2dx-classical
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#ifndef __CCArmaturePoseCache__
+#define __CCArmaturePoseCache__
+
+#include "../utils/CCArmatureDefine.h"
+#include "../datas/CCDatas.h"
+#include <vector>
+#include <list>
+#include <map>
+
+NS_CC_EXT_BEGIN
+
+/**
+ * Baked state of a bone at one frame, it is what CCBone::update and tween of bone
+ * leave in bone
+ *
+ * @since v2.2
+ */
+struct CC_DLL CCBonePose
+{
+    /// transform in armature space
+    CCAffineTransform worldTransform;
+
+    /// world info, x, y, scaleX, scaleY, skewX, skewY
+    float worldInfo[6];
+
+    /// tween data, x, y, scaleX, scaleY, skewX, skewY
+    float tween[6];
+
+    /// tween color
+    int a, r, g, b;
+
+    /// tween zorder
+    int zOrder;
+
+    /// display index
+    int displayIndex;
+
+    /// blend function
+    ccBlendFunc blendFunc;
+};
+
+/// poses of all bones of armature, in same order as CCArmature updates bones
+typedef std::vector<CCBonePose> CCArmaturePose;
+
+/**
+ * Pose cache shared by armatures. A crowd of armatures playing same movement does same
+ * tween and transform work every frame, with pose cache enabled (CCArmature::setPoseCacheEnabled),
+ * first armature arrived at a frame saves bone poses here and others on same frame just
+ * copy them to bones, only their own node transform is different.
+ *
+ * A pose is keyed by armature data, movement data, frame index and tween easing. Armature
+ * data and movement data are retained by cache so a key never points to a released data.
+ * Cache is bounded by CS_ARMATURE_POSE_CACHE_CAPACITY poses, or by setCapacity, least
+ * recently used pose is dropped first.
+ *
+ * Cache is not thread safe, use it in main thread.
+ *
+ * @since v2.2
+ */
+class CC_DLL CCArmaturePoseCache : public CCObject
+{
+private:
+    /// key of a pose
+    struct Key
+    {
+        CCArmatureData *armatureData;
+        CCMovementData *movementData;
+        int frameIndex;
+        int tweenEasing;
+
+        bool operator<(const Key &k) const;
+    };
+
+    /// a cached pose
+    struct Entry
+    {
+        Key key;
+        CCArmaturePose pose;
+    };
+
+    typedef std::list<Entry> EntryList;
+    typedef std::map<Key, EntryList::iterator> EntryMap;
+
+private:
+    CCArmaturePoseCache();
+
+public:
+    virtual ~CCArmaturePoseCache();
+    static CCArmaturePoseCache *sharedArmaturePoseCache();
+    static void purge();
+
+    /**
+     * Get a cached pose
+     *
+     * @return cached pose, or NULL if not found. It is valid until next addPose or removeAllPoses
+     */
+    const CCArmaturePose *getPose(CCArmatureData *armatureData, CCMovementData *movementData, int frameIndex, int tweenEasing);
+
+    /**
+     * Add an empty pose for caller to fill, least recently used pose is dropped if
+     * cache is full. If the key is already cached, old pose is cleared and returned.
+     */
+    CCArmaturePose *addPose(CCArmatureData *armatureData, CCMovementData *movementData, int frameIndex, int tweenEasing);
+
+    /// remove all poses, data retained by cache are released
+    void removeAllPoses();
+
+    /// max count of poses, cache is trimmed if it is smaller than current pose count
+    void setCapacity(unsigned int capacity);
+    unsigned int getCapacity() { return m_capacity; }
+
+    /// count of cached poses
+    unsigned int getPoseCount() { return m_entries.size(); }
+
+private:
+    /// remove least recently used pose
+    void removeOldestPose();
+
+private:
+    /// cached poses, most recently used first
+    EntryList m_entries;
+
+    /// key to entry
+    EntryMap m_index;
+
+    /// max count of poses
+    unsigned int m_capacity;
+};
+
+NS_CC_EXT_END
+
+#endif /* defined(__CCArmaturePoseCache__) */
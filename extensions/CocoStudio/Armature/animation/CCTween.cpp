@@ -62,6 +62,7 @@ CCTween::CCTween()
     , m_iToIndex(0)
     , m_pAnimation(NULL)
     , m_bPassLastFrame(false)
+    , m_bColorDirty(false)
 {
 
 }
@@ -100,6 +101,10 @@ void CCTween::play(CCMovementBoneData *movementBoneData, int durationTo, int dur
 {
     CCProcessBase::play(durationTo, durationTween, loop, tweenEasing);
 
+    // key frames of last movement are out of date
+    m_deferredKeyFrames.clear();
+    m_bColorDirty = false;
+
     if (loop)
     {
         m_eLoopType = ANIMATION_TO_LOOP_FRONT;
@@ -170,6 +175,8 @@ void CCTween::gotoAndPlay(int frameIndex)
 {
     CCProcessBase::gotoFrame(frameIndex);
 
+    m_deferredKeyFrames.clear();
+
     m_iTotalDuration = 0;
     m_iBetweenDuration = 0;
     m_iFromIndex = m_iToIndex = 0;
@@ -324,6 +331,14 @@ void CCTween::setBetween(CCFrameData *from, CCFrameData *to, bool limit)
 
 void CCTween::arriveKeyFrame(CCFrameData *keyFrameData)
 {
+    // display, zorder and child armature belong to main thread, apply them later
+    CCArmature *armature = m_pBone->getArmature();
+    if(keyFrameData && armature && armature->getDeferDisplayUpdate())
+    {
+        m_deferredKeyFrames.push_back(keyFrameData);
+        return;
+    }
+
     if(keyFrameData)
     {
         CCDisplayManager *displayManager = m_pBone->getDisplayManager();
@@ -387,7 +402,31 @@ void CCTween::tweenColorTo(float percent, CCFrameData *node)
     node->r = m_pFrom->r + percent * m_pBetween->r;
     node->g = m_pFrom->g + percent * m_pBetween->g;
     node->b = m_pFrom->b + percent * m_pBetween->b;
-    m_pBone->updateColor();
+
+    CCArmature *armature = m_pBone->getArmature();
+    if (armature && armature->getDeferDisplayUpdate())
+    {
+        m_bColorDirty = true;
+    }
+    else
+    {
+        m_pBone->updateColor();
+    }
+}
+
+void CCTween::applyDeferredKeyFrames()
+{
+    for (std::vector<CCFrameData *>::iterator iter = m_deferredKeyFrames.begin(); iter != m_deferredKeyFrames.end(); iter++)
+    {
+        arriveKeyFrame(*iter);
+    }
+    m_deferredKeyFrames.clear();
+
+    if (m_bColorDirty)
+    {
+        m_bColorDirty = false;
+        m_pBone->updateColor();
+    }
 }
 
 float CCTween::updateFrameData(float currentPercent)
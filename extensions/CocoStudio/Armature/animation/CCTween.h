@@ -28,6 +28,7 @@ THE SOFTWARE.
 
 #include "CCProcessBase.h"
 #include "../utils/CCTweenFunction.h"
+#include <vector>
 
 NS_CC_EXT_BEGIN
 
@@ -85,6 +86,13 @@ public:
 
     inline void setAnimation(CCArmatureAnimation *animation) { m_pAnimation = animation; }
     inline CCArmatureAnimation *getAnimation() const { return m_pAnimation; }
+
+    /**
+     * Apply key frames and color reached while armature deferred display update,
+     * see CCArmature::updateTransforms
+     * @since v2.2
+     */
+    void applyDeferredKeyFrames();
 protected:
 
     /**
@@ -140,6 +148,10 @@ protected:
     CCArmatureAnimation *m_pAnimation;
 
     bool m_bPassLastFrame;
+
+    //! Key frames arrived while display update is deferred, and whether color is changed
+    std::vector<CCFrameData *> m_deferredKeyFrames;
+    bool m_bColorDirty;
 };
 
 NS_CC_EXT_END
@@ -99,6 +99,7 @@ void CCBatchNode::addChild(CCNode *child, int zOrder, int tag)
                 }
             }
         }
+        armature->markDrawListDirty();
     }
 }
 
@@ -127,6 +128,7 @@ void CCBatchNode::removeChild(CCNode* child, bool cleanup)
                 }
             }
         }
+        armature->markDrawListDirty();
     }
 
     CCNode::removeChild(child, cleanup);
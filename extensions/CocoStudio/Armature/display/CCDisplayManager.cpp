@@ -323,6 +323,11 @@ void CCDisplayManager::setCurrentDecorativeDisplay(CCDecorativeDisplay *decoDisp
     {
         m_eDisplayType =  CS_DISPLAY_MAX;
     }
+
+    if (CCArmature *armature = m_pBone->getArmature())
+    {
+        armature->markDrawListDirty();
+    }
 }
 
 CCNode *CCDisplayManager::getDisplayRenderNode()
@@ -222,6 +222,7 @@ void CCSkin::setBone(CCBone *bone)
 
         CCTextureAtlas *atlas = armature->getTexureAtlasWithTexture(m_pobTexture);
         setTextureAtlas(atlas);
+        armature->markDrawListDirty();
     }
 }
 
@@ -0,0 +1,254 @@
+/****************************************************************************
+ Author: Luma (stubma@gmail.com)
+
+ https://github.com/stubma/cocos2dx-classical
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#include "CCArmatureBatchUpdater.h"
+#include "../CCArmature.h"
+#include "CCConfiguration.h"
+#include "support/profile/CCProfiling.h"
+#include <unistd.h>
+#include <limits.h>
+
+// max number of worker threads
+#define kCCArmatureMaxUpdateWorkers 4
+
+// batch smaller than this is updated by main thread only
+#define kCCArmatureMinParallelBatch 16
+
+// armatures claimed by a thread at a time
+#define kCCArmatureBatchChunk 4
+
+NS_CC_EXT_BEGIN
+
+static CCArmatureBatchUpdater *s_sharedBatchUpdater = NULL;
+
+CCArmatureBatchUpdater::CCArmatureBatchUpdater() :
+m_updating(false),
+m_nextIndex(0),
+m_workerCount(0),
+m_workersStarted(false),
+m_batchSerial(0),
+m_busyWorkers(0),
+m_quit(false) {
+    pthread_mutex_init(&m_mutex, NULL);
+    pthread_cond_init(&m_batchCondition, NULL);
+    pthread_cond_init(&m_doneCondition, NULL);
+
+#if (CC_TARGET_PLATFORM != CC_PLATFORM_WINRT) && (CC_TARGET_PLATFORM != CC_PLATFORM_WP8)
+    // leave one core for main thread by default, main thread works in batch too
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int workers = (int)CCConfiguration::sharedConfiguration()->getNumber("cocos2d.x.armature.update_workers", (double)(cores - 1));
+    m_workerCount = MIN(MAX(workers, 0), kCCArmatureMaxUpdateWorkers);
+#endif
+
+    // after all updates of priority 0, which armatures use
+    CCDirector::sharedDirector()->getScheduler()->scheduleUpdateForTarget(this, INT_MAX, false);
+}
+
+CCArmatureBatchUpdater::~CCArmatureBatchUpdater() {
+    stopWorkers();
+    pthread_mutex_destroy(&m_mutex);
+    pthread_cond_destroy(&m_batchCondition);
+    pthread_cond_destroy(&m_doneCondition);
+
+    for(std::vector<CCArmature *>::iterator iter = m_queue.begin(); iter != m_queue.end(); iter++) {
+        (*iter)->m_bBatchQueued = false;
+        (*iter)->release();
+    }
+}
+
+CCArmatureBatchUpdater *CCArmatureBatchUpdater::sharedBatchUpdater() {
+    if(s_sharedBatchUpdater == NULL) {
+        s_sharedBatchUpdater = new CCArmatureBatchUpdater();
+    }
+    return s_sharedBatchUpdater;
+}
+
+void CCArmatureBatchUpdater::purge() {
+    if(s_sharedBatchUpdater) {
+        CCDirector::sharedDirector()->getScheduler()->unscheduleUpdateForTarget(s_sharedBatchUpdater);
+        CC_SAFE_RELEASE_NULL(s_sharedBatchUpdater);
+    }
+}
+
+bool CCArmatureBatchUpdater::queueArmature(CCArmature *armature, float dt) {
+    if(m_updating)
+        return false;
+
+    // updated twice in a frame, update once with total time
+    if(armature->m_bBatchQueued) {
+        armature->m_fBatchDelta += dt;
+    } else {
+        armature->m_bBatchQueued = true;
+        armature->m_fBatchDelta = dt;
+        armature->retain();
+        m_queue.push_back(armature);
+    }
+    return true;
+}
+
+void CCArmatureBatchUpdater::update(float dt) {
+    if(m_queue.empty())
+        return;
+
+    CC_PROFILER_ZONE("CCArmatureBatchUpdater - update");
+    m_updating = true;
+
+    // first phase, armature using pose cache is left to second phase
+    m_batch.clear();
+    for(std::vector<CCArmature *>::iterator iter = m_queue.begin(); iter != m_queue.end(); iter++) {
+        if(!(*iter)->isPoseCacheEnabled()) {
+            m_batch.push_back(*iter);
+        }
+    }
+    m_nextIndex = 0;
+    bool parallel = m_workerCount > 0 && m_batch.size() >= kCCArmatureMinParallelBatch;
+    if(parallel && !m_workersStarted) {
+        startWorkers();
+        parallel = m_workerCount > 0;
+    }
+    if(parallel) {
+        // wake up workers and work with them
+        pthread_mutex_lock(&m_mutex);
+        m_busyWorkers = m_workerCount;
+        m_batchSerial++;
+        pthread_cond_broadcast(&m_batchCondition);
+        pthread_mutex_unlock(&m_mutex);
+
+        runBatch();
+
+        pthread_mutex_lock(&m_mutex);
+        while(m_busyWorkers > 0) {
+            pthread_cond_wait(&m_doneCondition, &m_mutex);
+        }
+        pthread_mutex_unlock(&m_mutex);
+    } else {
+        runBatch();
+    }
+    m_batch.clear();
+
+    // second phase, in queued order. Callbacks can't queue armature now, so queue is stable
+    for(std::vector<CCArmature *>::iterator iter = m_queue.begin(); iter != m_queue.end(); iter++) {
+        CCArmature *armature = *iter;
+        float delta = armature->m_fBatchDelta;
+        armature->m_bBatchQueued = false;
+        armature->m_fBatchDelta = 0;
+        if(armature->isPoseCacheEnabled()) {
+            armature->update(delta);
+        } else {
+            armature->updateDisplays(delta);
+        }
+    }
+    for(std::vector<CCArmature *>::iterator iter = m_queue.begin(); iter != m_queue.end(); iter++) {
+        (*iter)->release();
+    }
+    m_queue.clear();
+
+    m_updating = false;
+}
+
+void CCArmatureBatchUpdater::setWorkerCount(int count) {
+    CCAssert(!m_updating, "Can't change worker count when a batch is being updated");
+    stopWorkers();
+    m_workerCount = MIN(MAX(count, 0), kCCArmatureMaxUpdateWorkers);
+}
+
+void CCArmatureBatchUpdater::startWorkers() {
+    m_workersStarted = true;
+    m_workers.reserve(m_workerCount);
+    for(int i = 0; i < m_workerCount; i++) {
+        pthread_t worker;
+        if(pthread_create(&worker, NULL, workerThread, this) == 0) {
+            m_workers.push_back(worker);
+        } else {
+            CCLOG("CCArmatureBatchUpdater: failed to create worker thread");
+        }
+    }
+
+    // only created workers are waited for, none means main thread updates alone
+    m_workerCount = (int)m_workers.size();
+}
+
+void CCArmatureBatchUpdater::stopWorkers() {
+    if(!m_workersStarted)
+        return;
+
+    pthread_mutex_lock(&m_mutex);
+    m_quit = true;
+    pthread_cond_broadcast(&m_batchCondition);
+    pthread_mutex_unlock(&m_mutex);
+    for(std::vector<pthread_t>::iterator iter = m_workers.begin(); iter != m_workers.end(); iter++) {
+        pthread_join(*iter, NULL);
+    }
+    m_workers.clear();
+
+    // new workers wait for serial 1 as first workers do
+    m_workersStarted = false;
+    m_quit = false;
+    m_batchSerial = 0;
+}
+
+void CCArmatureBatchUpdater::runBatch() {
+    int count = (int)m_batch.size();
+    while(true) {
+        int begin = __sync_fetch_and_add(&m_nextIndex, kCCArmatureBatchChunk);
+        if(begin >= count)
+            break;
+        int end = MIN(begin + kCCArmatureBatchChunk, count);
+        for(int i = begin; i < end; i++) {
+            CCArmature *armature = m_batch[i];
+            armature->updateTransforms(armature->m_fBatchDelta);
+        }
+    }
+}
+
+void *CCArmatureBatchUpdater::workerThread(void *arg) {
+    CCArmatureBatchUpdater *updater = (CCArmatureBatchUpdater *)arg;
+
+    CC_PROFILER_THREAD_NAME("armature");
+
+    // workers are started before first batch is sent, so first serial they wait for is 1
+    unsigned int serial = 0;
+    pthread_mutex_lock(&updater->m_mutex);
+    while(true) {
+        while(!updater->m_quit && updater->m_batchSerial == serial) {
+            pthread_cond_wait(&updater->m_batchCondition, &updater->m_mutex);
+        }
+        if(updater->m_quit)
+            break;
+        serial = updater->m_batchSerial;
+        pthread_mutex_unlock(&updater->m_mutex);
+
+        updater->runBatch();
+
+        pthread_mutex_lock(&updater->m_mutex);
+        updater->m_busyWorkers--;
+        if(updater->m_busyWorkers == 0) {
+            pthread_cond_signal(&updater->m_doneCondition);
+        }
+    }
+    pthread_mutex_unlock(&updater->m_mutex);
+
+    return NULL;
+}
+
+NS_CC_EXT_END
@@ -0,0 +1,139 @@
+/****************************************************************************
+ Author: Luma (stubma@gmail.com)
+
+ https://github.com/stubma/cocos2dx-classical
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#ifndef __CCArmatureBatchUpdater__
+#define __CCArmatureBatchUpdater__
+
+#include "CCArmatureDefine.h"
+#include <vector>
+
+#if (CC_TARGET_PLATFORM != CC_PLATFORM_WINRT) && (CC_TARGET_PLATFORM != CC_PLATFORM_WP8)
+#include <pthread.h>
+#else
+#include "CCPThreadWinRT.h"
+#endif
+
+NS_CC_EXT_BEGIN
+
+class CCArmature;
+
+/**
+ * Updates armatures which enable batch update (CCArmature::setBatchUpdateEnabled) together.
+ * Scheduled update of such armature only queues it, batch updater is scheduled after all
+ * other updates and updates queued armatures in two phases.
+ *
+ * First phase evaluates animation, tweens and bone transforms. It only touches bones of
+ * each armature, so armatures are spread to worker threads and main thread works too.
+ * Second phase runs in main thread, in the order armatures are queued, it does the work
+ * deferred by first phase: display changes of key frames, colors, displays, movement list,
+ * frame events and movement events. Armature which enables pose cache is fully updated in
+ * second phase, because pose cache is shared.
+ *
+ * Worker count is read from configuration key cocos2d.x.armature.update_workers, by default
+ * it is core count minus one, at most 4, setWorkerCount changes it. Workers are started when
+ * first needed, a small batch is updated by main thread only.
+ *
+ * @since v2.2
+ */
+class CC_DLL CCArmatureBatchUpdater : public CCObject
+{
+private:
+    CCArmatureBatchUpdater();
+
+public:
+    virtual ~CCArmatureBatchUpdater();
+    static CCArmatureBatchUpdater *sharedBatchUpdater();
+    static void purge();
+
+    /**
+     * Queue an armature for update of this frame, it is called by CCArmature::update
+     *
+     * @return false if a batch is being updated, caller should update armature by itself
+     */
+    bool queueArmature(CCArmature *armature, float dt);
+
+    /// scheduled update
+    virtual void update(float dt);
+
+    /// count of worker threads, not including main thread
+    int getWorkerCount() { return m_workerCount; }
+
+    /**
+     * Set count of worker threads, not including main thread, it is at most 4. Running
+     * workers are stopped and new workers are started when next batch needs them.
+     * Don't call it in armature callbacks, they are called when a batch is being updated
+     */
+    void setWorkerCount(int count);
+
+private:
+    /// start worker threads
+    void startWorkers();
+
+    /// stop and join worker threads
+    void stopWorkers();
+
+    /// first phase of armatures in m_batch, called by main thread and workers
+    void runBatch();
+
+    /// worker thread entry
+    static void *workerThread(void *arg);
+
+private:
+    /// queued armatures, retained
+    std::vector<CCArmature *> m_queue;
+
+    /// armatures updated in first phase, they are in m_queue too
+    std::vector<CCArmature *> m_batch;
+
+    /// is a batch being updated
+    bool m_updating;
+
+    /// next index in m_batch to be claimed
+    volatile int m_nextIndex;
+
+    /// worker threads
+    std::vector<pthread_t> m_workers;
+
+    /// count of worker threads
+    int m_workerCount;
+
+    /// are workers started
+    bool m_workersStarted;
+
+    /// batch serial number, a worker runs a batch when it sees a new number
+    unsigned int m_batchSerial;
+
+    /// count of workers which are running current batch
+    int m_busyWorkers;
+
+    /// workers should quit
+    bool m_quit;
+
+    pthread_mutex_t m_mutex;
+    pthread_cond_t m_batchCondition;
+    pthread_cond_t m_doneCondition;
+};
+
+NS_CC_EXT_END
+
+#endif /* defined(__CCArmatureBatchUpdater__) */
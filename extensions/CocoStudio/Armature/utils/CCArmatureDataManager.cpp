@@ -27,6 +27,8 @@ THE SOFTWARE.
 #include "CCTransformHelp.h"
 #include "CCDataReaderHelper.h"
 #include "CCSpriteFrameCacheHelper.h"
+#include "../animation/CCArmaturePoseCache.h"
+#include "CCArmatureBatchUpdater.h"
 
 
 NS_CC_EXT_BEGIN
@@ -50,6 +52,8 @@ void CCArmatureDataManager::purge()
 {
     CCSpriteFrameCacheHelper::purge();
     CCDataReaderHelper::purge();
+    CCArmaturePoseCache::purge();
+    CCArmatureBatchUpdater::purge();
     CC_SAFE_RELEASE_NULL(s_sharedArmatureDataManager);
 }
 
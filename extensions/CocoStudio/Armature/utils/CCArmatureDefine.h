@@ -38,6 +38,14 @@ THE SOFTWARE.
 #define AUTO_ADD_SPRITE_FRAME_NAME_PREFIX 0
 #endif // !AUTO_ADD_SPRITE_FRAME_NAME_PREFIX
 
+/*
+ * Max count of poses kept by CCArmaturePoseCache, a pose is one frame of one movement.
+ * When cache is full, least recently used pose is dropped.
+ */
+#ifndef CS_ARMATURE_POSE_CACHE_CAPACITY
+#define CS_ARMATURE_POSE_CACHE_CAPACITY 512
+#endif // !CS_ARMATURE_POSE_CACHE_CAPACITY
+
 
 #define PHYSICS_TYPE 4
 
@@ -257,6 +257,8 @@ static void addData(AsyncStruct *pAsyncStruct)
 
 static void *loadData(void *)
 {
+    CC_MEMORY_TAG(kCCMemoryTagArmature);
+
     while (true)
     {
         // create autorelease pool for iOS
@@ -343,6 +345,8 @@ CCDataReaderHelper::~CCDataReaderHelper()
 
 void CCDataReaderHelper::addDataFromFile(const char *filePath)
 {
+    CC_MEMORY_TAG(kCCMemoryTagArmature);
+
     /*
     * Check if file is already added to CCArmatureDataManager, if then return.
     */
@@ -157,24 +157,7 @@ void Widget::sortAllChildren()
     CCNode::sortAllChildren();
     if( _reorderWidgetChildDirty )
     {
-        int i,j,length = _widgetChildren->data->num;
-        CCNode ** x = (CCNode**)_widgetChildren->data->arr;
-        CCNode *tempItem;
-        
-        // insertion sort
-        for(i=1; i<length; i++)
-        {
-            tempItem = x[i];
-            j = i-1;
-            
-            //continue moving element downwards while zOrder is smaller or when zOrder is the same but mutatedIndex is smaller
-            while(j>=0 && ( tempItem->getZOrder() < x[j]->getZOrder() || ( tempItem->getZOrder()== x[j]->getZOrder() && tempItem->getOrderOfArrival() < x[j]->getOrderOfArrival() ) ) )
-            {
-                x[j+1] = x[j];
-                j = j-1;
-            }
-            x[j+1] = tempItem;
-        }
+        sortNodesByZOrder(_widgetChildren->data);
         
         //don't need to check children recursively, that's done in visit of each child
         
@@ -263,6 +263,7 @@ void Layout::stencilClippingVisit()
     GLenum currentStencilPassDepthFail = GL_KEEP;
     GLenum currentStencilPassDepthPass = GL_KEEP;
     currentStencilEnabled = glIsEnabled(GL_STENCIL_TEST);
+    CC_RENDER_QUEUE_FLUSH();
     glGetIntegerv(GL_STENCIL_WRITEMASK, (GLint *)&currentStencilWriteMask);
     glGetIntegerv(GL_STENCIL_FUNC, (GLint *)&currentStencilFunc);
     glGetIntegerv(GL_STENCIL_REF, &currentStencilRef);
@@ -294,11 +295,13 @@ void Layout::stencilClippingVisit()
     kmGLPushMatrix();
     transform();
     _clippingStencil->visit();
+    CC_RENDER_QUEUE_FLUSH();
     kmGLPopMatrix();
     glDepthMask(currentDepthWriteMask);
     glStencilFunc(GL_EQUAL, mask_layer_le, mask_layer_le);
     glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
     CCNode::visit();
+    CC_RENDER_QUEUE_FLUSH();
     glStencilFunc(currentStencilFunc, currentStencilRef, currentStencilValueMask);
     glStencilOp(currentStencilFail, currentStencilPassDepthFail, currentStencilPassDepthPass);
     glStencilMask(currentStencilWriteMask);
@@ -312,12 +315,14 @@ void Layout::stencilClippingVisit()
 void Layout::scissorClippingVisit()
 {
     CCRect clippingRect = getClippingRect();
+    CC_RENDER_QUEUE_FLUSH();
     if (_handleScissor)
     {
         glEnable(GL_SCISSOR_TEST);
     }
     CCEGLView::sharedOpenGLView()->setScissorInPoints(clippingRect.origin.x, clippingRect.origin.y, clippingRect.size.width, clippingRect.size.height);
     CCNode::visit();
+    CC_RENDER_QUEUE_FLUSH();
     if (_handleScissor)
     {
         glDisable(GL_SCISSOR_TEST);
@@ -606,6 +606,7 @@ void CCScrollView::beforeDraw()
 {
     if (m_bClippingToBounds)
     {
+        CC_RENDER_QUEUE_FLUSH();
 		m_bScissorRestored = false;
         CCRect frame = getViewRect();
         if (CCEGLView::sharedOpenGLView()->isScissorEnabled()) {
@@ -635,6 +636,7 @@ void CCScrollView::afterDraw()
 {
     if (m_bClippingToBounds)
     {
+        CC_RENDER_QUEUE_FLUSH();
         if (m_bScissorRestored) {//restore the parent's scissor rect
             CCEGLView::sharedOpenGLView()->setScissorInPoints(m_tParentScissorRect.origin.x, m_tParentScissorRect.origin.y, m_tParentScissorRect.size.width, m_tParentScissorRect.size.height);
         }
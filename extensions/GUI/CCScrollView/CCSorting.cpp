@@ -116,17 +116,11 @@ CCSortableObject* CCArrayForObjectSorting::objectWithObjectID(unsigned int tag)
     }
     
     unsigned int  idx;
-    CCSortableObject* foundObj;
-    
-    foundObj = new CCSortedObject();
-    foundObj->setObjectID(tag);
+    CCSortableObject* foundObj = NULL;
     
-    idx      = this->indexOfSortedObject(foundObj);
+    idx      = this->indexOfObjectID(tag);
     
-    CC_SAFE_RELEASE(((CCSortedObject*)foundObj));
-    foundObj = NULL;
-    
-    if (idx < this->count() && idx != CC_INVALID_INDEX)
+    if (idx < this->count())
     {
         foundObj = dynamic_cast<CCSortableObject*>(this->objectAtIndex(idx));
         if (foundObj->getObjectID() != tag) {
@@ -139,34 +133,35 @@ CCSortableObject* CCArrayForObjectSorting::objectWithObjectID(unsigned int tag)
 
 unsigned int CCArrayForObjectSorting::indexOfSortedObject(CCSortableObject* object)
 {
-    unsigned int  idx = 0;
     if (object)
     {
- //       CCObject* pObj = (CCObject*)bsearch((CCObject*)&object, data->arr, data->num, sizeof(CCObject*), _compareObject);
-        // FIXME: need to use binary search to improve performance
-        CCObject* pObj = NULL;
-        unsigned int uPrevObjectID = 0;
-        unsigned int uOfSortObjectID = object->getObjectID();
-
-        CCARRAY_FOREACH(this, pObj)
-        {
-            CCSortableObject* pSortableObj = dynamic_cast<CCSortableObject*>(pObj);
-            unsigned int uCurObjectID = pSortableObj->getObjectID();
-            if (  (uOfSortObjectID == uCurObjectID)
-                  || (uOfSortObjectID >= uPrevObjectID && uOfSortObjectID < uCurObjectID))
-            {
-                break;
-            }
-            
-            uPrevObjectID = uCurObjectID;
-            idx++;
-        }
+        return indexOfObjectID(object->getObjectID());
     }
     else
     {
-        idx = CC_INVALID_INDEX;
+        return CC_INVALID_INDEX;
+    }
+}
+
+unsigned int CCArrayForObjectSorting::indexOfObjectID(unsigned int tag)
+{
+    // binary search for first object whose id is not less than tag
+    unsigned int low = 0;
+    unsigned int high = this->count();
+    while (low < high)
+    {
+        unsigned int mid = low + (high - low) / 2;
+        CCSortableObject* pSortableObj = dynamic_cast<CCSortableObject*>(this->objectAtIndex(mid));
+        if (pSortableObj->getObjectID() < tag)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
     }
-    return idx;
+    return low;
 }
 
 NS_CC_EXT_END
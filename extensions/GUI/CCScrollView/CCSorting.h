@@ -98,6 +98,15 @@ public:
      */
     unsigned int indexOfSortedObject(CCSortableObject* obj);
 
+    /*!
+     * Returns an index of the object with given id, or the index at which an object
+     * with that id would have been located. Same as indexOfSortedObject.
+     *
+     * @param tag object id to locate
+     * @return index of an object found
+     */
+    unsigned int indexOfObjectID(unsigned int tag);
+
 };
 
 NS_CC_EXT_END
@@ -25,9 +25,21 @@
 #include "CCTableViewCell.h"
 #include "LuaBasicConversions.h"
 #include "CCLuaEngine.h"
+#include <algorithm>
 
 NS_CC_EXT_BEGIN
 
+// line which contains an offset, positions are sorted so it is a binary search
+static int _lineFromOffset(const vector<float>& positions, float offset) {
+    vector<float>::const_iterator iter = lower_bound(positions.begin(), positions.end(), offset);
+    int i = (int)(iter - positions.begin());
+    if(iter == positions.end() || *iter == offset) {
+        return i;
+    } else {
+        return MAX(0, i - 1);
+    }
+}
+
 CCTableView* CCTableView::create(CCTableViewDataSource* dataSource, CCSize size)
 {
     return CCTableView::create(dataSource, size, NULL);
@@ -54,7 +66,6 @@ bool CCTableView::initWithViewSize(CCSize size, CCNode* container/* = NULL*/)
     if (CCScrollView::initWithViewSize(size,container))
     {
         m_pCellsUsed = new CCArrayForObjectSorting();
-        m_pCellsFreed = new CCArrayForObjectSorting();
         m_pIndices = new std::set<unsigned int>();
         m_colCount = 1;
         setDirection(kCCScrollViewDirectionVertical);
@@ -69,7 +80,7 @@ CCTableView::CCTableView()
 : m_pTouchedCell(NULL)
 , m_pIndices(NULL)
 , m_pCellsUsed(NULL)
-, m_pCellsFreed(NULL)
+, m_cellsCount(0)
 , m_pDataSource(NULL)
 , m_pTableViewDelegate(NULL)
 , m_viewRows(-1)
@@ -84,7 +95,9 @@ CCTableView::~CCTableView()
 {
     CC_SAFE_DELETE(m_pIndices);
     CC_SAFE_RELEASE(m_pCellsUsed);
-    CC_SAFE_RELEASE(m_pCellsFreed);
+    for(std::map<std::string, CCArray*>::iterator iter = m_cellsFreed.begin(); iter != m_cellsFreed.end(); iter++) {
+        iter->second->release();
+    }
     unregisterScriptTableViewEventHandler();
 }
 
@@ -97,7 +110,7 @@ void CCTableView::reloadData(bool keepOffset)
         
         onTableCellWillRecycle(cell);
         
-        m_pCellsFreed->addObject(cell);
+        enqueueCell(cell);
         cell->reset();
         if (cell->getParent() == getContainer())
         {
@@ -111,7 +124,7 @@ void CCTableView::reloadData(bool keepOffset)
     
     _updateCellPositions();
     _updateContentSize(keepOffset);
-    if (onNumberOfCellsInTableView() > 0)
+    if (m_cellsCount > 0)
     {
         scrollViewDidScroll(this);
     }
@@ -201,8 +214,7 @@ void CCTableView::updateCellAtIndex(unsigned int idx)
     {
         return;
     }
-    unsigned int uCountOfItems = onNumberOfCellsInTableView();
-    if (0 == uCountOfItems || idx > uCountOfItems-1)
+    if (idx >= m_cellsCount)
     {
         return;
     }
@@ -217,106 +229,130 @@ void CCTableView::updateCellAtIndex(unsigned int idx)
     _addCellIfNecessary(cell);
 }
 
-void CCTableView::insertCellAtIndex(unsigned  int idx)
+void CCTableView::insertCellAtIndex(unsigned int idx)
 {
-    if (idx == CC_INVALID_INDEX)
+    insertCellsAtIndex(idx, 1);
+}
+
+void CCTableView::removeCellAtIndex(unsigned int idx)
+{
+    removeCellsAtIndex(idx, 1);
+}
+
+void CCTableView::insertCellsAtIndex(unsigned int idx, unsigned int count)
+{
+    if (idx == CC_INVALID_INDEX || count == 0 || idx > m_cellsCount)
     {
         return;
     }
-    
-    unsigned int uCountOfItems = onNumberOfCellsInTableView();
-    if (0 == uCountOfItems || idx > uCountOfItems-1)
+    _reloadCells(idx, 0, count);
+}
+
+void CCTableView::removeCellsAtIndex(unsigned int idx, unsigned int count)
+{
+    if (idx == CC_INVALID_INDEX || count == 0 || idx + count > m_cellsCount)
     {
         return;
     }
-    
-    CCTableViewCell* cell = NULL;
-    int newIdx = 0;
-    
-    cell = (CCTableViewCell*)m_pCellsUsed->objectWithObjectID(idx);
-    if (cell)
+    _reloadCells(idx, count, 0);
+}
+
+void CCTableView::reloadCellsAtIndex(unsigned int idx, unsigned int count)
+{
+    if (idx == CC_INVALID_INDEX || count == 0 || idx + count > m_cellsCount)
     {
-        newIdx = m_pCellsUsed->indexOfSortedObject(cell);
-        for (unsigned int i=newIdx; i<m_pCellsUsed->count(); i++)
-        {
-            cell = (CCTableViewCell*)m_pCellsUsed->objectAtIndex(i);
-            _setIndexForCell(cell->getIdx()+1, cell);
-        }
+        return;
     }
-    
-    //insert a new cell
-    cell = onTableCellAtIndex(idx);
-    _setIndexForCell(idx, cell);
-    _addCellIfNecessary(cell);
-    _updateCellPositions();
-    _updateContentSize();
+    _reloadCells(idx, count, count);
 }
 
-void CCTableView::removeCellAtIndex(unsigned int idx)
+void CCTableView::_reloadCells(unsigned int idx, unsigned int removed, unsigned int inserted)
 {
-    if (idx == CC_INVALID_INDEX)
+    // recycle cells in changed range, they will be created again if visible
+    CCArray* changed = CCArray::create();
+    CCObject* pObj = NULL;
+    CCARRAY_FOREACH(m_pCellsUsed, pObj)
     {
-        return;
+        CCTableViewCell* cell = (CCTableViewCell*)pObj;
+        if (cell->getIdx() >= idx && cell->getIdx() < idx + removed)
+        {
+            changed->addObject(cell);
+        }
     }
-    
-    unsigned int uCountOfItems = onNumberOfCellsInTableView();
-    if (0 == uCountOfItems || idx > uCountOfItems-1)
+    CCARRAY_FOREACH(changed, pObj)
     {
-        return;
+        _moveCellOutOfSight((CCTableViewCell*)pObj);
     }
     
-    unsigned int newIdx = 0;
-    
-    CCTableViewCell* cell = cellAtIndex(idx);
-    if (!cell)
+    // shift cells after changed range, used cells keep sorted because all of them move
+    m_pIndices->clear();
+    CCARRAY_FOREACH(m_pCellsUsed, pObj)
     {
-        return;
+        CCTableViewCell* cell = (CCTableViewCell*)pObj;
+        if (cell->getIdx() >= idx + removed)
+        {
+            cell->setIdx(cell->getIdx() + inserted - removed);
+        }
+        m_pIndices->insert(cell->getIdx());
     }
     
-    newIdx = m_pCellsUsed->indexOfSortedObject(cell);
-    
-    //remove first
-    _moveCellOutOfSight(cell);
+    // layout, then move used cells to their new places. If data source doesn't
+    // match the change, some cells may be out of range now
+    _updateCellPositions(idx, removed, inserted);
+    _updateContentSize(true);
+    while (m_pCellsUsed->count() > 0 && ((CCTableViewCell*)m_pCellsUsed->lastObject())->getIdx() >= m_cellsCount)
+    {
+        _moveCellOutOfSight((CCTableViewCell*)m_pCellsUsed->lastObject());
+    }
+    CCARRAY_FOREACH(m_pCellsUsed, pObj)
+    {
+        CCTableViewCell* cell = (CCTableViewCell*)pObj;
+        _setIndexForCell(cell->getIdx(), cell);
+    }
     
-    m_pIndices->erase(idx);
-
-    for (unsigned int i=m_pCellsUsed->count()-1; i > newIdx; i--)
+    // fill holes and recycle cells out of view
+    if (m_cellsCount > 0)
     {
-        cell = (CCTableViewCell*)m_pCellsUsed->objectAtIndex(i);
-        _setIndexForCell(cell->getIdx()-1, cell);
+        scrollViewDidScroll(this);
     }
 }
 
 void CCTableView::enqueueCell(CCTableViewCell* cell) {
-    m_pCellsFreed->addObject(cell);
+    // cell name can be empty, so it is a map instead of CCDictionary
+    CCArray*& cells = m_cellsFreed[cell->getName()];
+    if(!cells) {
+        cells = new CCArray();
+        cells->init();
+    }
+    cells->addObject(cell);
 }
 
 CCTableViewCell *CCTableView::dequeueCell(const string& name)
 {
-    CCTableViewCell *cell = NULL;
-    
-    if (m_pCellsFreed->count() == 0) {
-        cell = NULL;
-    } else {
-        if(name.empty()) {
-            cell = (CCTableViewCell*)m_pCellsFreed->objectAtIndex(0);
-            CC_SAFE_RETAIN(cell);
-            m_pCellsFreed->removeObjectAtIndex(0);
-            CC_SAFE_AUTORELEASE(cell);
-        } else {
-            CCObject* obj;
-            CCARRAY_FOREACH(m_pCellsFreed, obj) {
-                CCTableViewCell* c = (CCTableViewCell*)obj;
-                if(c->getName() == name) {
-                    CC_SAFE_RETAIN(c);
-                    m_pCellsFreed->removeObject(c);
-                    CC_SAFE_AUTORELEASE(c);
-                    cell = c;
-                    break;
-                }
+    // free cells are grouped by name, empty name means any cell is ok
+    CCArray* cells = NULL;
+    if(name.empty()) {
+        for(std::map<std::string, CCArray*>::iterator iter = m_cellsFreed.begin(); iter != m_cellsFreed.end(); iter++) {
+            if(iter->second->count() > 0) {
+                cells = iter->second;
+                break;
             }
         }
+    } else {
+        std::map<std::string, CCArray*>::iterator iter = m_cellsFreed.find(name);
+        if(iter != m_cellsFreed.end()) {
+            cells = iter->second;
+        }
+    }
+    if(!cells || cells->count() == 0) {
+        return NULL;
     }
+    
+    // take last one so removing is cheap
+    CCTableViewCell* cell = (CCTableViewCell*)cells->lastObject();
+    CC_SAFE_RETAIN(cell);
+    cells->removeLastObject();
+    CC_SAFE_AUTORELEASE(cell);
     return cell;
 }
 
@@ -332,6 +368,7 @@ void CCTableView::_addCellIfNecessary(CCTableViewCell * cell)
 
 void CCTableView::_updateCellPositions() {
     int cellsCount = onNumberOfCellsInTableView();
+    m_cellsCount = MAX(cellsCount, 0);
     m_vCellsPositions.clear();
     m_hCellsPositions.clear();
     
@@ -418,23 +455,89 @@ void CCTableView::_updateCellPositions() {
             m_vCellsPositions.push_back(pos);
             
             // h pos
-            pos = m_insets.left;
-            first = true;
-            for (int i = 0; i < cols; i++) {
-                cellSize = onTableCellSizeForIndex(i);
-                if(!first) {
-                    pos += m_colSpacing;
-                }
-                m_hCellsPositions.push_back(pos);
-                first = false;
-                pos += cellSize.width;
-            }
-            m_hCellsPositions.push_back(pos);
+            _updateColumnPositions();
             break;
         }
     }
 }
 
+void CCTableView::_updateColumnPositions() {
+    m_hCellsPositions.clear();
+    float pos = m_insets.left;
+    bool first = true;
+    for (unsigned int i = 0; i < m_colCount; i++) {
+        CCSize cellSize = onTableCellSizeForIndex(i);
+        if(!first) {
+            pos += m_colSpacing;
+        }
+        m_hCellsPositions.push_back(pos);
+        first = false;
+        pos += cellSize.width;
+    }
+    m_hCellsPositions.push_back(pos);
+}
+
+void CCTableView::_updateCellPositions(unsigned int idx, unsigned int removed, unsigned int inserted) {
+    // empty table has no line to shift, it needs a full layout. So does a data source
+    // which doesn't match the change. For horizontal table, cells in first column decide
+    // row count, a change of them needs a full layout too
+    unsigned int cellsCount = onNumberOfCellsInTableView();
+    bool horizontal = getDirection() == kCCScrollViewDirectionHorizontal;
+    unsigned int lineCells = horizontal ? MAX(m_viewRows, 1) : MAX(m_colCount, 1);
+    if(m_cellsCount == 0 || cellsCount == 0 ||
+       cellsCount != m_cellsCount - removed + inserted ||
+       (horizontal && (idx < lineCells || m_vCellsPositions[m_viewRows] < m_tViewSize.height - m_insets.bottom))) {
+        _updateCellPositions();
+        return;
+    }
+    
+    // lines along scroll direction
+    vector<float>& positions = horizontal ? m_hCellsPositions : m_vCellsPositions;
+    float spacing = horizontal ? m_colSpacing : m_rowSpacing;
+    unsigned int firstLine = idx / lineCells;
+    unsigned int oldLines = (unsigned int)positions.size() - 1;
+    unsigned int newLines = (cellsCount + lineCells - 1) / lineCells;
+    unsigned int removedLines, insertedLines;
+    if(idx % lineCells == 0 && removed % lineCells == 0 && inserted % lineCells == 0) {
+        removedLines = removed / lineCells;
+        insertedLines = inserted / lineCells;
+    } else {
+        // cells after changed range move to other lines, so all lines from it change
+        removedLines = oldLines - firstLine;
+        insertedLines = newLines - firstLine;
+    }
+    if(oldLines - removedLines + insertedLines != newLines) {
+        _updateCellPositions();
+        return;
+    }
+    
+    // positions of new lines, the end position has no spacing so add it back to let
+    // every line be same
+    positions[oldLines] += spacing;
+    vector<float> newPositions;
+    float pos = positions[firstLine];
+    for(unsigned int i = 0; i < insertedLines; i++) {
+        CCSize cellSize = onTableCellSizeForIndex((firstLine + i) * lineCells);
+        pos += (horizontal ? cellSize.width : cellSize.height) + spacing;
+        newPositions.push_back(pos);
+    }
+    
+    // replace changed lines and shift lines after them
+    float delta = pos - positions[firstLine + removedLines];
+    positions.erase(positions.begin() + firstLine + 1, positions.begin() + firstLine + 1 + removedLines);
+    positions.insert(positions.begin() + firstLine + 1, newPositions.begin(), newPositions.end());
+    for(vector<float>::iterator iter = positions.begin() + firstLine + 1 + insertedLines; iter != positions.end(); iter++) {
+        *iter += delta;
+    }
+    positions[newLines] -= spacing;
+    m_cellsCount = cellsCount;
+    
+    // cells in first row decide column widths
+    if(!horizontal && idx < lineCells) {
+        _updateColumnPositions();
+    }
+}
+
 void CCTableView::_updateContentSize(bool keepOffset) {
     // get offset relative to top-left
     CCSize contentSize = getContentSize();
@@ -507,33 +610,13 @@ CCPoint CCTableView::containerOffsetFromIndex(unsigned int index) {
 
 int CCTableView::_indexFromOffset(CCPoint offset, bool excludeMargin) {
     // max index
-    const int maxIdx = onNumberOfCellsInTableView() - 1;
+    const int maxIdx = (int)m_cellsCount - 1;
     
     // locate
     const CCSize& contentSize = getContentSize();
     offset.y = contentSize.height - offset.y;
-    int c = (int)m_hCellsPositions.size();
-    int row, col = c;
-    for(int i = 0; i < c; i++) {
-        if(offset.x < m_hCellsPositions[i]) {
-            col = MAX(0, i - 1);
-            break;
-        } else if(offset.x == m_hCellsPositions[i]) {
-            col = MAX(0, i);
-            break;
-        }
-    }
-    c = (int)m_vCellsPositions.size();
-    row = c;
-    for(int i = 0; i < c; i++) {
-        if(offset.y < m_vCellsPositions[i]) {
-            row = MAX(0, i - 1);
-            break;
-        } else if(offset.y == m_vCellsPositions[i]) {
-            row = MAX(0, i);
-            break;
-        }
-    }
+    int col = _lineFromOffset(m_hCellsPositions, offset.x);
+    int row = _lineFromOffset(m_vCellsPositions, offset.y);
     
     // index
     int index = -1;
@@ -577,7 +660,7 @@ void CCTableView::_moveCellOutOfSight(CCTableViewCell *cell)
 {
     onTableCellWillRecycle(cell);
     
-    m_pCellsFreed->addObject(cell);
+    enqueueCell(cell);
     m_pCellsUsed->removeSortedObject(cell);
     m_pIndices->erase(cell->getIdx());
     // [m_pIndices removeIndex:cell.idx];
@@ -597,7 +680,7 @@ void CCTableView::_setIndexForCell(unsigned int index, CCTableViewCell *cell)
 
 void CCTableView::scrollViewDidScroll(CCScrollView* view)
 {
-    unsigned int uCountOfItems = onNumberOfCellsInTableView();
+    unsigned int uCountOfItems = m_cellsCount;
     if (0 == uCountOfItems)
     {
         return;
@@ -636,14 +719,6 @@ void CCTableView::scrollViewDidScroll(CCScrollView* view)
         CCLog("cells Used index %d, value = %d", i, pCell->getIdx());
         i++;
     }
-    CCLog("---------------------------------------");
-    i = 0;
-    CCARRAY_FOREACH(m_pCellsFreed, pObj)
-    {
-        CCTableViewCell* pCell = (CCTableViewCell*)pObj;
-        CCLog("cells freed index %d, value = %d", i, pCell->getIdx());
-        i++;
-    }
     CCLog("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~");
 #endif
     
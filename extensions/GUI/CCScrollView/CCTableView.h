@@ -29,6 +29,7 @@
 #include "CCSorting.h"
 #include <set>
 #include <vector>
+#include <map>
 #include "ccMacros.h"
 
 using namespace std;
@@ -189,6 +190,31 @@ public:
      * @param idx index to find a cell
      */
     void removeCellAtIndex(unsigned int idx);
+    /**
+     * Inserts cells at a given index. Data source should already contain new cells. Only
+     * sizes of new cells are asked from data source, cells after them are shifted, so it
+     * is much cheaper than reloadData for a big table. Content offset is kept.
+     *
+     * @param idx location to insert
+     * @param count count of new cells
+     */
+    void insertCellsAtIndex(unsigned int idx, unsigned int count);
+    /**
+     * Removes cells at a given index. Data source should already remove them. Cells after
+     * them are shifted, content offset is kept.
+     *
+     * @param idx index of first removed cell
+     * @param count count of removed cells
+     */
+    void removeCellsAtIndex(unsigned int idx, unsigned int count);
+    /**
+     * Reloads size and content of cells at a given index, for example, a chat message
+     * cell becomes taller. Cells after them are shifted, content offset is kept.
+     *
+     * @param idx index of first changed cell
+     * @param count count of changed cells
+     */
+    void reloadCellsAtIndex(unsigned int idx, unsigned int count);
     /**
      * reloads data from data source.  the view will be refreshed.
      * @param keepOffset true means try to keep old content offset, false means
@@ -253,9 +279,13 @@ protected:
      */
     CCArrayForObjectSorting* m_pCellsUsed;
     /**
-     * free list of cells
+     * free list of cells, key is cell name and value is a CCArray of cells with that name
+     */
+    std::map<std::string, CCArray*> m_cellsFreed;
+    /**
+     * cell count which positions are calculated for
      */
-    CCArrayForObjectSorting* m_pCellsFreed;
+    unsigned int m_cellsCount;
     /**
      * weak link to the data source object
      */
@@ -275,6 +305,9 @@ protected:
     void _setIndexForCell(unsigned int index, CCTableViewCell *cell);
     void _addCellIfNecessary(CCTableViewCell * cell);
     void _updateCellPositions();
+    void _updateCellPositions(unsigned int idx, unsigned int removed, unsigned int inserted);
+    void _updateColumnPositions();
+    void _reloadCells(unsigned int idx, unsigned int removed, unsigned int inserted);
     virtual void _updateContentSize(bool keepOffset = false);
     
     // event dispatch
@@ -27,6 +27,14 @@ THE SOFTWARE.
 #include <string>
 #include "HelloWorldScene.h"
 #include "AppMacros.h"
+#if HELLOCPP_RUN_BENCHMARKS
+#include "ParticleBenchmark.h"
+#include "SchedulerBenchmark.h"
+#include "NodeSortBenchmark.h"
+#include "BMFontBenchmark.h"
+#include "ArmatureBenchmark.h"
+#include "HttpClientTest.h"
+#endif
 
 USING_NS_CC;
 using namespace std;
@@ -91,6 +99,15 @@ bool AppDelegate::applicationDidFinishLaunching() {
     pDirector->setDisplayStats(true);
 #endif
 
+#if HELLOCPP_RUN_BENCHMARKS
+    ParticleBenchmark::run();
+    SchedulerBenchmark::run();
+    NodeSortBenchmark::run();
+    BMFontBenchmark::run();
+    ArmatureBenchmark::run();
+    HttpClientTest::run();
+#endif
+
     // create a scene. it's an autorelease object
     CCScene *pScene = HelloWorld::scene();
 
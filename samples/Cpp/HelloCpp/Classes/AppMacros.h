@@ -50,6 +50,12 @@ static cocos2d::CCSize designResolutionSize = cocos2d::CCSizeMake(2048, 1536);
 #error unknown target design resolution!
 #endif
 
+/* Set it to 1 to run benchmarks and checks of engine at launch, see Benchmark.h.
+   Results are logged, the scene is shown after they finish */
+#ifndef HELLOCPP_RUN_BENCHMARKS
+#define HELLOCPP_RUN_BENCHMARKS 0
+#endif
+
 // The font size 24 is designed for small resolution, so we should change it to fit for current design resolution
 #define TITLE_FONT_SIZE  (cocos2d::CCEGLView::sharedOpenGLView()->getDesignResolutionSize().width / smallResource.size.width * 24)
 
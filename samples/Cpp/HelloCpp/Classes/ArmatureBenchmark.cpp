@@ -0,0 +1,219 @@
+/****************************************************************************
+ Author: Luma (stubma@gmail.com)
+ 
+ https://github.com/stubma/cocos2dx-classical
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#include "ArmatureBenchmark.h"
+#include "Benchmark.h"
+#include "cocos-ext.h"
+#include "CocoStudio/Armature/animation/CCArmaturePoseCache.h"
+#include "CocoStudio/Armature/utils/CCArmatureBatchUpdater.h"
+#include <math.h>
+#include <unistd.h>
+
+USING_NS_CC;
+USING_NS_CC_EXT;
+
+#define CROWD_SIZE 500
+#define BATCH_CROWD_SIZE 1000
+#define WARMUP_FRAMES 60
+#define BENCH_FRAMES 300
+#define MOVEMENT_FRAMES 30
+#define LIMBS 4
+#define LIMB_BONES 4
+
+static const char* s_armatureName = "ArmatureBenchmark";
+static const char* s_movementName = "walk";
+
+// bone and its swing in walk movement, key frames are absolute as in combined data
+static void addBone(CCArmatureData* armatureData, CCMovementData* movementData,
+                    const char* name, const char* parentName, float x, float y, float swing) {
+    CCBoneData* boneData = CCBoneData::create();
+    boneData->name = name;
+    boneData->parentName = parentName;
+    boneData->x = x;
+    boneData->y = y;
+    armatureData->addBoneData(boneData);
+
+    // swing forward and back, last key frame is same as first so loop is smooth
+    CCMovementBoneData* movementBoneData = CCMovementBoneData::create();
+    movementBoneData->name = name;
+    movementBoneData->duration = MOVEMENT_FRAMES;
+    for(int i = 0; i < 3; i++) {
+        CCFrameData* frameData = CCFrameData::create();
+        frameData->frameID = i * MOVEMENT_FRAMES / 2;
+        frameData->duration = MOVEMENT_FRAMES / 2;
+        frameData->x = x;
+        frameData->y = y + (i == 1 ? fabsf(swing) * 8 : 0);
+        frameData->skewX = frameData->skewY = i == 1 ? swing : -swing;
+        frameData->scaleX = frameData->scaleY = 1;
+
+        // no display, there is nothing to render
+        frameData->displayIndex = -1;
+        movementBoneData->addFrameData(frameData);
+    }
+    movementData->addMovementBoneData(movementBoneData);
+}
+
+// body, head, cape, four limbs of four bones and a weapon
+static void addArmatureData() {
+    CCArmatureData* armatureData = CCArmatureData::create();
+    armatureData->name = s_armatureName;
+    armatureData->dataVersion = VERSION_COMBINED;
+    CCMovementData* movementData = CCMovementData::create();
+    movementData->name = s_movementName;
+    movementData->duration = MOVEMENT_FRAMES;
+    movementData->loop = true;
+
+    addBone(armatureData, movementData, "body", "", 0, 60, 0.05f);
+    addBone(armatureData, movementData, "head", "body", 0, 40, 0.1f);
+    addBone(armatureData, movementData, "cape", "body", -10, 30, 0.2f);
+    char name[32];
+    char parentName[32];
+    for(int limb = 0; limb < LIMBS; limb++) {
+        strcpy(parentName, "body");
+        for(int i = 0; i < LIMB_BONES; i++) {
+            snprintf(name, sizeof(name), "limb%d_%d", limb, i);
+            float swing = (limb % 2 ? 0.4f : -0.4f) / (i + 1);
+            addBone(armatureData, movementData, name, parentName, limb < 2 ? 15 : 5, limb < 2 ? 20 : -20, swing);
+            strcpy(parentName, name);
+        }
+    }
+    addBone(armatureData, movementData, "weapon", "limb0_3", 10, 0, 0.3f);
+
+    CCAnimationData* animationData = CCAnimationData::create();
+    animationData->name = s_armatureName;
+    animationData->addMovement(movementData);
+
+    CCArmatureDataManager* manager = CCArmatureDataManager::sharedArmatureDataManager();
+    manager->addArmatureData(s_armatureName, armatureData);
+    manager->addAnimationData(s_armatureName, animationData);
+}
+
+// crowd walking at spread frames, same frames in every crowd
+static CCArray* createCrowd(int size, bool poseCache) {
+    CCArray* crowd = CCArray::createWithCapacity(size);
+    for(int i = 0; i < size; i++) {
+        CCArmature* armature = CCArmature::create(s_armatureName);
+        armature->setPoseCacheEnabled(poseCache);
+        armature->setPosition(ccp(i % 25 * 40, i / 25 * 40));
+        armature->getAnimation()->play(s_movementName);
+        armature->getAnimation()->gotoAndPlay(i * 7 % MOVEMENT_FRAMES);
+        crowd->addObject(armature);
+    }
+    return crowd;
+}
+
+// update as scheduler does, batched armatures queue themselves and batch updater is last
+static void updateCrowd(CCArray* crowd, int frames, bool batched) {
+    for(int f = 0; f < frames; f++) {
+        CCObject* obj;
+        CCARRAY_FOREACH(crowd, obj) {
+            ((CCArmature*)obj)->update(1.0f / 60);
+        }
+        if(batched) {
+            CCArmatureBatchUpdater::sharedBatchUpdater()->update(1.0f / 60);
+        }
+    }
+}
+
+static double timeCrowd(CCArray* crowd, bool batched) {
+    updateCrowd(crowd, WARMUP_FRAMES, batched);
+    double start = benchmarkMillis();
+    updateCrowd(crowd, BENCH_FRAMES, batched);
+    return (benchmarkMillis() - start) / BENCH_FRAMES;
+}
+
+// batch update of a crowd with a count of threads, main thread included
+static double timeBatchedCrowd(CCArray* crowd, int threads) {
+    CCArmatureBatchUpdater::sharedBatchUpdater()->setWorkerCount(threads - 1);
+
+    // only running armature is queued
+    CCNode* stage = CCNode::create();
+    CCObject* obj;
+    CCARRAY_FOREACH(crowd, obj) {
+        ((CCArmature*)obj)->setBatchUpdateEnabled(true);
+        stage->addChild((CCArmature*)obj);
+    }
+    stage->onEnter();
+    double time = timeCrowd(crowd, true);
+    stage->onExit();
+    stage->removeAllChildren();
+    return time;
+}
+
+// same bones of two crowds have same transforms, dt is a whole frame so cached poses are exact
+static bool compareCrowds(CCArray* crowd, CCArray* other) {
+    for(unsigned int i = 0; i < crowd->count(); i++) {
+        CCArmature* armature = (CCArmature*)crowd->objectAtIndex(i);
+        CCArmature* otherArmature = (CCArmature*)other->objectAtIndex(i);
+        CCDictionary* bones = armature->getBoneDic();
+        CCDictElement* element;
+        CCDICT_FOREACH(bones, element) {
+            CCAffineTransform t = ((CCBone*)element->getObject())->nodeToArmatureTransform();
+            CCAffineTransform o = otherArmature->getBone(element->getStrKey())->nodeToArmatureTransform();
+            if(fabsf(t.a - o.a) > 0.001f || fabsf(t.b - o.b) > 0.001f || fabsf(t.c - o.c) > 0.001f ||
+               fabsf(t.d - o.d) > 0.001f || fabsf(t.tx - o.tx) > 0.01f || fabsf(t.ty - o.ty) > 0.01f) {
+                CCLOG("ArmatureBenchmark: FAILED, bone %s of armature %u differs", element->getStrKey(), i);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool ArmatureBenchmark::run() {
+    addArmatureData();
+    CCArmaturePoseCache* cache = CCArmaturePoseCache::sharedArmaturePoseCache();
+    cache->removeAllPoses();
+
+    CCArray* normalCrowd = createCrowd(CROWD_SIZE, false);
+    CCArray* cachedCrowd = createCrowd(CROWD_SIZE, true);
+    int bones = ((CCArmature*)normalCrowd->objectAtIndex(0))->getBoneDic()->count();
+    double normalTime = timeCrowd(normalCrowd, false);
+    double cachedTime = timeCrowd(cachedCrowd, false);
+    bool ok = compareCrowds(normalCrowd, cachedCrowd);
+    CCLOG("ArmatureBenchmark: %d armatures of %d bones, normal %.3f ms, pose cache %.3f ms per frame, %.2fx, %u poses",
+          CROWD_SIZE, bones, normalTime, cachedTime, normalTime / MAX(cachedTime, 0.001), cache->getPoseCount());
+    cache->removeAllPoses();
+
+    // batch update, workers are set back to configured count after it
+    CCArmatureBatchUpdater* updater = CCArmatureBatchUpdater::sharedBatchUpdater();
+    int workers = updater->getWorkerCount();
+    CCArray* serialCrowd = createCrowd(BATCH_CROWD_SIZE, false);
+    double serialTime = timeCrowd(serialCrowd, false);
+    CCLOG("ArmatureBenchmark: %d armatures one by one %.3f ms per frame, %ld cores",
+          BATCH_CROWD_SIZE, serialTime, sysconf(_SC_NPROCESSORS_ONLN));
+    int threadCounts[] = { 1, 2, 4 };
+    for(int i = 0; i < 3 && ok; i++) {
+        CCArray* batchedCrowd = createCrowd(BATCH_CROWD_SIZE, false);
+        double batchedTime = timeBatchedCrowd(batchedCrowd, threadCounts[i]);
+        ok = compareCrowds(serialCrowd, batchedCrowd);
+        CCLOG("ArmatureBenchmark: %d armatures batch update with %d threads %.3f ms per frame, %.2fx",
+              BATCH_CROWD_SIZE, updater->getWorkerCount() + 1, batchedTime, serialTime / MAX(batchedTime, 0.001));
+    }
+    updater->setWorkerCount(workers);
+
+    CCArmatureDataManager* manager = CCArmatureDataManager::sharedArmatureDataManager();
+    manager->removeArmatureData(s_armatureName);
+    manager->removeAnimationData(s_armatureName);
+    return ok;
+}
@@ -0,0 +1,40 @@
+/****************************************************************************
+ Author: Luma (stubma@gmail.com)
+ 
+ https://github.com/stubma/cocos2dx-classical
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#ifndef __ArmatureBenchmark__
+#define __ArmatureBenchmark__
+
+/**
+ * Builds a 20 bone armature with a looped walk movement in code and updates a crowd
+ * of 500 instances at spread frames with and without pose cache, and a crowd of 1000
+ * instances one by one and by batch updater with 1, 2 and 4 threads. Checks all crowds
+ * end in same bone transforms and logs time per frame of each. Bones have no display,
+ * so it doesn't render and measures animation and bone transforms only
+ */
+class ArmatureBenchmark {
+public:
+    /// return false if pose cache or batch update changes bone transforms
+    static bool run();
+};
+
+#endif /* defined(__ArmatureBenchmark__) */
@@ -0,0 +1,296 @@
+/****************************************************************************
+ Author: Luma (stubma@gmail.com)
+ 
+ https://github.com/stubma/cocos2dx-classical
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#include "BMFontBenchmark.h"
+#include "Benchmark.h"
+#include <stdio.h>
+#include <string>
+
+USING_NS_CC;
+using namespace std;
+
+#define BENCH_LABELS 10000
+#define LOAD_TIMES 20
+
+// glyphs of font, printable ascii and first common CJK ideographs
+#define LATIN_FIRST 32
+#define LATIN_LAST 126
+#define CJK_FIRST 0x4e00
+#define CJK_COUNT 3000
+#define KERNING_COUNT 1000
+#define GLYPH_SIZE 24
+
+// deterministic random, same font and labels in every run
+static unsigned int s_seed = 1;
+static unsigned int randomInt(unsigned int n) {
+    s_seed = s_seed * 1103515245 + 12345;
+    return (s_seed >> 8) % n;
+}
+
+static unsigned int glyphCount() {
+    return LATIN_LAST - LATIN_FIRST + 1 + CJK_COUNT;
+}
+
+static unsigned int glyphChar(unsigned int i) {
+    unsigned int latin = LATIN_LAST - LATIN_FIRST + 1;
+    return i < latin ? LATIN_FIRST + i : CJK_FIRST + i - latin;
+}
+
+static void appendU16(string& s, unsigned int v) {
+    s += (char)(v & 0xff);
+    s += (char)((v >> 8) & 0xff);
+}
+
+static void appendU32(string& s, unsigned int v) {
+    appendU16(s, v & 0xffff);
+    appendU16(s, v >> 16);
+}
+
+static void appendUTF8(string& s, unsigned int c) {
+    if(c < 0x80) {
+        s += (char)c;
+    } else if(c < 0x800) {
+        s += (char)(0xc0 | (c >> 6));
+        s += (char)(0x80 | (c & 0x3f));
+    } else {
+        s += (char)(0xe0 | (c >> 12));
+        s += (char)(0x80 | ((c >> 6) & 0x3f));
+        s += (char)(0x80 | (c & 0x3f));
+    }
+}
+
+static bool writeFile(const string& path, const string& content) {
+    FILE* fp = fopen(path.c_str(), "wb");
+    if(!fp)
+        return false;
+    bool ok = fwrite(content.data(), 1, content.length(), fp) == content.length();
+    fclose(fp);
+    return ok;
+}
+
+// write same font in text and binary format, page is a copy of an image of HelloCpp
+static bool writeFonts(const string& textPath, const string& binaryPath, const string& pagePath) {
+    unsigned long pageSize = 0;
+    unsigned char* page = CCFileUtils::sharedFileUtils()->getFileData("HelloWorld.png", "rb", &pageSize);
+    if(!page)
+        return false;
+    bool ok = writeFile(pagePath, string((const char*)page, pageSize));
+    delete[] page;
+    if(!ok)
+        return false;
+
+    string pageName = pagePath.substr(pagePath.rfind('/') + 1);
+    unsigned int count = glyphCount();
+    int columns = 1024 / GLYPH_SIZE;
+    char line[256];
+
+    // text
+    string text;
+    text += "info face=\"Bench\" size=24 bold=0 italic=0 charset=\"\" unicode=1 stretchH=100 smooth=1 aa=1 padding=1,2,3,4 spacing=1,1\n";
+    text += "common lineHeight=28 base=22 scaleW=1024 scaleH=1024 pages=1 packed=0\n";
+    snprintf(line, sizeof(line), "page id=0 file=\"%s\"\n", pageName.c_str());
+    text += line;
+    snprintf(line, sizeof(line), "chars count=%u\n", count);
+    text += line;
+    for(unsigned int i = 0; i < count; i++) {
+        snprintf(line, sizeof(line), "char id=%u   x=%d     y=%d     width=%d     height=%d     xoffset=%d     yoffset=%d    xadvance=%d     page=0  chnl=0\n",
+                 glyphChar(i), (i % columns) * GLYPH_SIZE, (i / columns) * GLYPH_SIZE, GLYPH_SIZE - 2, GLYPH_SIZE - 2,
+                 (int)(i % 3) - 1, (int)(i % 5), glyphChar(i) < 0x80 ? 12 : GLYPH_SIZE);
+        text += line;
+    }
+    snprintf(line, sizeof(line), "kernings count=%d\n", KERNING_COUNT);
+    text += line;
+
+    // binary, block type, size and content
+    string info;
+    appendU16(info, 24);
+    info += (char)0xc0;
+    info += (char)0;
+    appendU16(info, 100);
+    info += (char)1;
+    info += (char)1;
+    info += (char)2;
+    info += (char)3;
+    info += (char)4;
+    info += (char)1;
+    info += (char)1;
+    info += (char)0;
+    info += "Bench";
+    info += '\0';
+    string common;
+    appendU16(common, 28);
+    appendU16(common, 22);
+    appendU16(common, 1024);
+    appendU16(common, 1024);
+    appendU16(common, 1);
+    common += (char)0;
+    common.append(4, '\0');
+    string pages = pageName;
+    pages += '\0';
+    string chars;
+    for(unsigned int i = 0; i < count; i++) {
+        appendU32(chars, glyphChar(i));
+        appendU16(chars, (i % columns) * GLYPH_SIZE);
+        appendU16(chars, (i / columns) * GLYPH_SIZE);
+        appendU16(chars, GLYPH_SIZE - 2);
+        appendU16(chars, GLYPH_SIZE - 2);
+        appendU16(chars, (unsigned short)((int)(i % 3) - 1));
+        appendU16(chars, i % 5);
+        appendU16(chars, glyphChar(i) < 0x80 ? 12 : GLYPH_SIZE);
+        chars += (char)0;
+        chars += (char)15;
+    }
+
+    // kerning pairs, between latin letters and some CJK
+    string kernings;
+    s_seed = 1;
+    for(int i = 0; i < KERNING_COUNT; i++) {
+        unsigned int first = glyphChar(randomInt(count));
+        unsigned int second = glyphChar(randomInt(LATIN_LAST - LATIN_FIRST + 1));
+        int amount = (int)randomInt(7) - 3;
+        snprintf(line, sizeof(line), "kerning first=%u  second=%u  amount=%d\n", first, second, amount);
+        text += line;
+        appendU32(kernings, first);
+        appendU32(kernings, second);
+        appendU16(kernings, (unsigned short)amount);
+    }
+
+    string binary = "BMF";
+    binary += (char)3;
+    string* blocks[] = { &info, &common, &pages, &chars, &kernings };
+    for(int b = 0; b < 5; b++) {
+        binary += (char)(b + 1);
+        appendU32(binary, blocks[b]->length());
+        binary += *blocks[b];
+    }
+
+    return writeFile(textPath, text) && writeFile(binaryPath, binary);
+}
+
+static bool compareFonts(CCBMFontConfiguration* text, CCBMFontConfiguration* binary) {
+    bool ok = text->m_nCommonHeight == binary->m_nCommonHeight &&
+        text->m_tPadding.left == binary->m_tPadding.left &&
+        text->m_tPadding.top == binary->m_tPadding.top &&
+        text->m_tPadding.right == binary->m_tPadding.right &&
+        text->m_tPadding.bottom == binary->m_tPadding.bottom &&
+        text->m_sAtlasName == binary->m_sAtlasName;
+    for(unsigned int i = 0; i < glyphCount() && ok; i++) {
+        unsigned int c = glyphChar(i);
+        const ccBMFontDef* a = text->getFontDef(c);
+        const ccBMFontDef* b = binary->getFontDef(c);
+        ok = a && b && a->rect.equals(b->rect) &&
+            a->xOffset == b->xOffset && a->yOffset == b->yOffset && a->xAdvance == b->xAdvance;
+        if(!ok) {
+            CCLOG("BMFontBenchmark: FAILED, glyph %u differs in text and binary font", c);
+        }
+    }
+    ok = ok && text->getFontDef(CJK_FIRST + CJK_COUNT) == NULL && binary->getFontDef(CJK_FIRST + CJK_COUNT) == NULL;
+    for(unsigned int first = LATIN_FIRST; first <= LATIN_LAST && ok; first++) {
+        for(unsigned int second = LATIN_FIRST; second <= LATIN_LAST && ok; second++) {
+            ok = text->getKerningAmount(first, second) == binary->getKerningAmount(first, second);
+            if(!ok) {
+                CCLOG("BMFontBenchmark: FAILED, kerning of %u and %u differs in text and binary font", first, second);
+            }
+        }
+    }
+    return ok;
+}
+
+static double timeLoad(const string& path) {
+    double start = benchmarkMillis();
+    for(int i = 0; i < LOAD_TIMES; i++) {
+        CCBMFontConfiguration* conf = CCBMFontConfiguration::create(path.c_str());
+        conf->retain();
+        conf->release();
+    }
+    return (benchmarkMillis() - start) / LOAD_TIMES;
+}
+
+// a line of game text, like "Lv 12 <name> x3"
+static string mixedText() {
+    string s;
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "Lv %u ", randomInt(100));
+    s += prefix;
+    int cjk = 2 + randomInt(6);
+    for(int i = 0; i < cjk; i++) {
+        appendUTF8(s, CJK_FIRST + randomInt(CJK_COUNT));
+    }
+    s += " AVAWToy x";
+    appendUTF8(s, '0' + randomInt(10));
+    return s;
+}
+
+static double timeLayout(const string& fnt, bool quadMode) {
+    s_seed = 7;
+    CCArray* labels = CCArray::createWithCapacity(BENCH_LABELS);
+    double start = benchmarkMillis();
+    for(int i = 0; i < BENCH_LABELS; i++) {
+        string text = mixedText();
+        CCLabelBMFont* label;
+        if(quadMode) {
+            label = CCLabelBMFont::create("", fnt.c_str());
+            label->setQuadMode(true);
+            label->setString(text.c_str());
+        } else {
+            label = CCLabelBMFont::create(text.c_str(), fnt.c_str());
+        }
+        labels->addObject(label);
+    }
+    return benchmarkMillis() - start;
+}
+
+bool BMFontBenchmark::run() {
+    string dir = CCFileUtils::sharedFileUtils()->getWritablePath();
+    string textPath = dir + "bmfont_bench.fnt";
+    string binaryPath = dir + "bmfont_bench_bin.fnt";
+    string pagePath = dir + "bmfont_bench.png";
+    if(!writeFonts(textPath, binaryPath, pagePath)) {
+        CCLOG("BMFontBenchmark: FAILED, can't write font to %s", dir.c_str());
+        return false;
+    }
+
+    CCBMFontConfiguration* text = CCBMFontConfiguration::create(textPath.c_str());
+    CCBMFontConfiguration* binary = CCBMFontConfiguration::create(binaryPath.c_str());
+    bool ok = text && binary && compareFonts(text, binary);
+    if(ok) {
+        CCLOG("BMFontBenchmark: text and binary font match, %u glyphs, %d kernings", glyphCount(), KERNING_COUNT);
+    }
+
+    double textTime = timeLoad(textPath);
+    double binaryTime = timeLoad(binaryPath);
+    CCLOG("BMFontBenchmark: load %u glyphs, text %.3f ms, binary %.3f ms, %.2fx",
+          glyphCount(), textTime, binaryTime, textTime / MAX(binaryTime, 0.001));
+
+    double spriteTime = timeLayout(binaryPath, false);
+    double quadTime = timeLayout(binaryPath, true);
+    CCLOG("BMFontBenchmark: %d labels of mixed Latin and CJK text, sprite mode %.1f ms, quad mode %.1f ms",
+          BENCH_LABELS, spriteTime, quadTime);
+
+    CCLabelBMFont::purgeCachedData();
+    CCTextureCache::sharedTextureCache()->removeTextureForKey(pagePath.c_str());
+    remove(textPath.c_str());
+    remove(binaryPath.c_str());
+    remove(pagePath.c_str());
+    return ok;
+}
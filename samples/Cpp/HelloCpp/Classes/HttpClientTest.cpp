@@ -0,0 +1,432 @@
+/****************************************************************************
+ Author: Luma (stubma@gmail.com)
+ 
+ https://github.com/stubma/cocos2dx-classical
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#include "HttpClientTest.h"
+#include "Benchmark.h"
+#include "support/network/CCHttpClient.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+USING_NS_CC;
+using namespace std;
+
+// tags of requests, order requests use their index as tag
+#define TAG_BLOCKER 100
+#define TAG_QUEUED_CANCEL 50
+#define ORDER_REQUESTS 8
+
+// max time to wait for server or notifications
+#define WAIT_MILLIS 10000
+
+// same default and range as http thread pool
+#define DEFAULT_HTTP_WORKERS 4
+#define MAX_HTTP_WORKERS 8
+
+/**
+ * Loopback http server, a thread per connection and keep-alive. Path is echoed as body,
+ * request of /block/... is held until blockers are released or client closes connection
+ */
+class LoopbackServer {
+public:
+    LoopbackServer() :
+    m_fd(-1),
+    m_port(0),
+    m_stop(false),
+    m_released(false),
+    m_connections(0),
+    m_blockers(0) {
+        pthread_mutex_init(&m_mutex, NULL);
+    }
+
+    ~LoopbackServer() {
+        stop();
+        pthread_mutex_destroy(&m_mutex);
+    }
+
+    bool start() {
+        m_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if(m_fd < 0)
+            return false;
+
+        // any free port
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        socklen_t len = sizeof(addr);
+        if(bind(m_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+           listen(m_fd, 16) != 0 ||
+           getsockname(m_fd, (struct sockaddr*)&addr, &len) != 0) {
+            close(m_fd);
+            m_fd = -1;
+            return false;
+        }
+        m_port = ntohs(addr.sin_port);
+
+        if(pthread_create(&m_acceptThread, NULL, acceptEntry, this) != 0) {
+            close(m_fd);
+            m_fd = -1;
+            return false;
+        }
+        return true;
+    }
+
+    /// close listen socket and all connections
+    void stop() {
+        if(m_fd < 0)
+            return;
+
+        setFlag(&m_stop);
+        pthread_join(m_acceptThread, NULL);
+        close(m_fd);
+        m_fd = -1;
+        while(getCount(&m_connections) > 0) {
+            usleep(10000);
+        }
+    }
+
+    int getPort() { return m_port; }
+    void releaseBlockers() { setFlag(&m_released); }
+    int getBlockerCount() { return getCount(&m_blockers); }
+
+    /// paths in the order they arrived
+    vector<string> getPaths() {
+        pthread_mutex_lock(&m_mutex);
+        vector<string> paths = m_paths;
+        pthread_mutex_unlock(&m_mutex);
+        return paths;
+    }
+
+private:
+    void setFlag(bool* flag) {
+        pthread_mutex_lock(&m_mutex);
+        *flag = true;
+        pthread_mutex_unlock(&m_mutex);
+    }
+
+    bool getFlag(bool* flag) {
+        pthread_mutex_lock(&m_mutex);
+        bool value = *flag;
+        pthread_mutex_unlock(&m_mutex);
+        return value;
+    }
+
+    int getCount(int* count) {
+        pthread_mutex_lock(&m_mutex);
+        int value = *count;
+        pthread_mutex_unlock(&m_mutex);
+        return value;
+    }
+
+    /// wait until fd is readable, return false if server stops
+    bool waitReadable(int fd) {
+        struct pollfd p = { fd, POLLIN, 0 };
+        while(!getFlag(&m_stop)) {
+            if(poll(&p, 1, 20) > 0)
+                return true;
+        }
+        return false;
+    }
+
+    static void* acceptEntry(void* arg) {
+        LoopbackServer* server = (LoopbackServer*)arg;
+        while(server->waitReadable(server->m_fd)) {
+            int fd = accept(server->m_fd, NULL, NULL);
+            if(fd < 0)
+                continue;
+
+            pthread_mutex_lock(&server->m_mutex);
+            server->m_connections++;
+            server->m_connectionFds.push_back(fd);
+            pthread_mutex_unlock(&server->m_mutex);
+            pthread_t thread;
+            if(pthread_create(&thread, NULL, connectionEntry, server) == 0) {
+                pthread_detach(thread);
+            } else {
+                server->closeConnection(fd);
+            }
+        }
+        return NULL;
+    }
+
+    static void* connectionEntry(void* arg) {
+        LoopbackServer* server = (LoopbackServer*)arg;
+
+        // take the fd this thread is created for
+        pthread_mutex_lock(&server->m_mutex);
+        int fd = server->m_connectionFds.front();
+        server->m_connectionFds.erase(server->m_connectionFds.begin());
+        pthread_mutex_unlock(&server->m_mutex);
+
+        server->serve(fd);
+        server->closeConnection(fd);
+        return NULL;
+    }
+
+    void closeConnection(int fd) {
+        close(fd);
+        pthread_mutex_lock(&m_mutex);
+        m_connections--;
+        pthread_mutex_unlock(&m_mutex);
+    }
+
+    /// serve requests of a connection until client closes it or server stops
+    void serve(int fd) {
+        string buffer;
+        char chunk[1024];
+        while(true) {
+            // request head, GET has no body
+            size_t end;
+            while((end = buffer.find("\r\n\r\n")) == string::npos) {
+                if(!waitReadable(fd))
+                    return;
+                ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+                if(n <= 0)
+                    return;
+                buffer.append(chunk, n);
+            }
+            size_t pathStart = buffer.find(' ') + 1;
+            string path = buffer.substr(pathStart, buffer.find(' ', pathStart) - pathStart);
+            buffer.erase(0, end + 4);
+
+            pthread_mutex_lock(&m_mutex);
+            m_paths.push_back(path);
+            pthread_mutex_unlock(&m_mutex);
+
+            // hold it, a closed connection means client aborted
+            if(path.find("/block/") == 0) {
+                pthread_mutex_lock(&m_mutex);
+                m_blockers++;
+                pthread_mutex_unlock(&m_mutex);
+                struct pollfd p = { fd, POLLIN, 0 };
+                while(!getFlag(&m_released)) {
+                    if(getFlag(&m_stop))
+                        return;
+                    if(poll(&p, 1, 20) > 0) {
+                        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+                        if(n <= 0)
+                            return;
+                        buffer.append(chunk, n);
+                    }
+                }
+            }
+
+            char head[128];
+            snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Length: %d\r\nContent-Type: text/plain\r\n\r\n", (int)path.length());
+            string response = head + path;
+            if(send(fd, response.data(), response.length(), 0) != (ssize_t)response.length())
+                return;
+        }
+    }
+
+private:
+    int m_fd;
+    int m_port;
+    pthread_t m_acceptThread;
+    pthread_mutex_t m_mutex;
+
+    // below are protected by mutex
+    bool m_stop;
+    bool m_released;
+    int m_connections;
+    vector<int> m_connectionFds;
+    int m_blockers;
+    vector<string> m_paths;
+};
+
+/// collects completed requests, in main thread
+class HttpClientTestObserver : public CCObject {
+public:
+    HttpClientTestObserver() {
+        CCNotificationCenter::sharedNotificationCenter()->addObserver(this,
+                                                                      callfuncO_selector(HttpClientTestObserver::onRequestCompleted),
+                                                                      kCCNotificationHttpRequestCompleted,
+                                                                      NULL);
+    }
+
+    virtual ~HttpClientTestObserver() {
+        CCNotificationCenter::sharedNotificationCenter()->removeObserver(this, kCCNotificationHttpRequestCompleted);
+    }
+
+    void onRequestCompleted(CCObject* obj) {
+        CCHttpResponse* response = (CCHttpResponse*)obj;
+        m_results[response->getRequest()->getTag()] = response->isSuccess();
+        m_times[response->getRequest()->getTag()] = benchmarkMillis();
+    }
+
+    bool isCompleted(int tag) { return m_results.find(tag) != m_results.end(); }
+    bool isSucceeded(int tag) { return isCompleted(tag) && m_results[tag]; }
+    double getTime(int tag) { return m_times[tag]; }
+
+private:
+    map<int, bool> m_results;
+    map<int, double> m_times;
+};
+
+static void get(CCHttpClient* client, int port, const char* path, int tag, int priority) {
+    char url[128];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d%s", port, path);
+    CCHttpRequest* request = CCHttpRequest::create();
+    request->setMethod(kHttpGet);
+    request->setUrl(url);
+    request->setTag(tag);
+    request->setPriority(priority);
+    client->asyncExecute(request);
+}
+
+// pump scheduler until requests from first tag to last tag complete
+static bool waitCompleted(HttpClientTestObserver* observer, int firstTag, int lastTag) {
+    CCScheduler* scheduler = CCDirector::sharedDirector()->getScheduler();
+    double start = benchmarkMillis();
+    while(benchmarkMillis() - start < WAIT_MILLIS) {
+        scheduler->update(1.0f / 60);
+        bool completed = true;
+        for(int tag = firstTag; tag <= lastTag && completed; tag++) {
+            completed = observer->isCompleted(tag);
+        }
+        if(completed)
+            return true;
+        usleep(5000);
+    }
+    return false;
+}
+
+bool HttpClientTest::run() {
+    LoopbackServer server;
+    if(!server.start()) {
+        CCLOG("HttpClientTest: FAILED, can't start loopback server");
+        return false;
+    }
+    int port = server.getPort();
+    int workers = (int)CCConfiguration::sharedConfiguration()->getNumber("cocos2d.x.network.http_workers", DEFAULT_HTTP_WORKERS);
+    workers = MIN(MAX(workers, 1), MAX_HTTP_WORKERS);
+    CCHttpClient* client = CCHttpClient::create();
+    HttpClientTestObserver* observer = new HttpClientTestObserver();
+    bool ok = true;
+
+    // hold every http thread, so following requests wait in queue
+    char path[64];
+    for(int i = 0; i < workers; i++) {
+        snprintf(path, sizeof(path), "/block/%d", i);
+        get(client, port, path, TAG_BLOCKER + i, 0);
+    }
+    double start = benchmarkMillis();
+    while(server.getBlockerCount() < workers && benchmarkMillis() - start < WAIT_MILLIS) {
+        usleep(5000);
+    }
+    if(server.getBlockerCount() < workers) {
+        CCLOG("HttpClientTest: FAILED, %d of %d http threads reached server", server.getBlockerCount(), workers);
+        ok = false;
+    }
+
+    // queue requests out of priority order, and one with top priority which is cancelled in queue
+    int priorities[ORDER_REQUESTS] = { 0, 3, 1, 3, 2, 0, 1, 3 };
+    for(int i = 0; ok && i < ORDER_REQUESTS; i++) {
+        snprintf(path, sizeof(path), "/order/%d", i);
+        get(client, port, path, i, priorities[i]);
+    }
+    if(ok) {
+        get(client, port, "/cancelled", TAG_QUEUED_CANCEL, 10);
+        client->cancel(TAG_QUEUED_CANCEL);
+    }
+
+    // cancel first blocker while server holds it, its thread then runs queue alone
+    double cancelTime = benchmarkMillis();
+    client->cancel(TAG_BLOCKER);
+    if(ok && (!waitCompleted(observer, TAG_QUEUED_CANCEL, TAG_QUEUED_CANCEL) ||
+              !waitCompleted(observer, TAG_BLOCKER, TAG_BLOCKER) ||
+              !waitCompleted(observer, 0, ORDER_REQUESTS - 1))) {
+        CCLOG("HttpClientTest: FAILED, requests are not completed in %d ms", WAIT_MILLIS);
+        ok = false;
+    }
+
+    if(ok) {
+        // cancelled requests fail, queued one never reaches server
+        vector<string> paths = server.getPaths();
+        bool queuedCancelSent = find(paths.begin(), paths.end(), "/cancelled") != paths.end();
+        if(observer->isSucceeded(TAG_QUEUED_CANCEL) || queuedCancelSent) {
+            CCLOG("HttpClientTest: FAILED, cancelled queued request is %s", queuedCancelSent ? "sent" : "succeeded");
+            ok = false;
+        }
+        if(observer->isSucceeded(TAG_BLOCKER)) {
+            CCLOG("HttpClientTest: FAILED, cancelled running request succeeded");
+            ok = false;
+        }
+
+        // bigger priority first, same priority in request order
+        string order;
+        string expected;
+        for(vector<string>::iterator iter = paths.begin(); iter != paths.end(); iter++) {
+            if(iter->find("/order/") == 0) {
+                order += iter->substr(7);
+            }
+        }
+        for(int p = 10; p >= 0; p--) {
+            for(int i = 0; i < ORDER_REQUESTS; i++) {
+                if(priorities[i] == p) {
+                    expected += (char)('0' + i);
+                }
+            }
+        }
+        for(int i = 0; i < ORDER_REQUESTS; i++) {
+            if(!observer->isSucceeded(i)) {
+                CCLOG("HttpClientTest: FAILED, request %d failed", i);
+                ok = false;
+            }
+        }
+        if(order != expected) {
+            CCLOG("HttpClientTest: FAILED, requests ran in order %s, expected %s", order.c_str(), expected.c_str());
+            ok = false;
+        }
+        if(ok) {
+            CCLOG("HttpClientTest: %d http threads, requests ran in priority order %s, running request cancelled in %.0f ms",
+                  workers, order.c_str(), observer->getTime(TAG_BLOCKER) - cancelTime);
+        }
+    }
+
+    // other blockers finish normally
+    server.releaseBlockers();
+    if(!waitCompleted(observer, TAG_BLOCKER + 1, TAG_BLOCKER + workers - 1)) {
+        CCLOG("HttpClientTest: FAILED, released requests are not completed in %d ms", WAIT_MILLIS);
+        ok = false;
+    }
+    for(int i = 1; ok && i < workers; i++) {
+        if(!observer->isSucceeded(TAG_BLOCKER + i)) {
+            CCLOG("HttpClientTest: FAILED, released request %d failed", i);
+            ok = false;
+        }
+    }
+
+    observer->release();
+    server.stop();
+    return ok;
+}
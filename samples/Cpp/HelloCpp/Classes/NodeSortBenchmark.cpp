@@ -0,0 +1,113 @@
+/****************************************************************************
+ Author: Luma (stubma@gmail.com)
+ 
+ https://github.com/stubma/cocos2dx-classical
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#include "NodeSortBenchmark.h"
+#include "Benchmark.h"
+#include <vector>
+
+USING_NS_CC;
+using namespace std;
+
+#define BENCH_CHILDREN 2000
+#define BENCH_FRAMES 100
+
+// deterministic random, same reorders in every run
+static unsigned int s_seed = 1;
+static unsigned int randomInt(unsigned int n) {
+    s_seed = s_seed * 1103515245 + 12345;
+    return (s_seed >> 8) % n;
+}
+
+// sortAllChildren before incremental sort
+static void insertionSort(vector<CCNode*>& x) {
+    int length = (int)x.size();
+    for(int i = 1; i < length; i++) {
+        CCNode* tempItem = x[i];
+        int j = i - 1;
+        while(j >= 0 && (tempItem->getZOrder() < x[j]->getZOrder() ||
+                         (tempItem->getZOrder() == x[j]->getZOrder() && tempItem->getOrderOfArrival() < x[j]->getOrderOfArrival()))) {
+            x[j + 1] = x[j];
+            j = j - 1;
+        }
+        x[j + 1] = tempItem;
+    }
+}
+
+static bool runPercent(int percent, bool jump) {
+    s_seed = 1;
+    CCNode* parent = CCNode::create();
+    for(int i = 0; i < BENCH_CHILDREN; i++) {
+        parent->addChild(CCNode::create(), randomInt(BENCH_CHILDREN));
+    }
+    parent->sortAllChildren();
+
+    int reorders = MAX(1, BENCH_CHILDREN * percent / 100);
+    double insertionTime = 0;
+    double incrementalTime = 0;
+    vector<CCNode*> reference;
+    bool ok = true;
+    for(int f = 0; f < BENCH_FRAMES && ok; f++) {
+        // y sorted units walk a few rows, or jump to anywhere
+        CCArray* children = parent->getChildren();
+        for(int r = 0; r < reorders; r++) {
+            CCNode* child = (CCNode*)children->objectAtIndex(randomInt(BENCH_CHILDREN));
+            int z = jump ? randomInt(BENCH_CHILDREN) : child->getZOrder() + (int)randomInt(21) - 10;
+            parent->reorderChild(child, z);
+        }
+
+        reference.clear();
+        for(unsigned int i = 0; i < children->count(); i++) {
+            reference.push_back((CCNode*)children->objectAtIndex(i));
+        }
+        double start = benchmarkMillis();
+        insertionSort(reference);
+        insertionTime += benchmarkMillis() - start;
+
+        start = benchmarkMillis();
+        parent->sortAllChildren();
+        incrementalTime += benchmarkMillis() - start;
+
+        for(unsigned int i = 0; i < children->count() && ok; i++) {
+            ok = reference[i] == children->objectAtIndex(i);
+            if(!ok) {
+                CCLOG("NodeSortBenchmark: FAILED, %d%% %s, frame %d, child %u is in wrong position",
+                      percent, jump ? "jumped" : "walked", f, i);
+            }
+        }
+    }
+
+    CCLOG("NodeSortBenchmark: %d children, %d%% %s, insertion sort %.3f ms, incremental sort %.3f ms per frame, %.2fx",
+          BENCH_CHILDREN, percent, jump ? "jumped" : "walked", insertionTime / BENCH_FRAMES, incrementalTime / BENCH_FRAMES,
+          insertionTime / MAX(incrementalTime, 0.001));
+    return ok;
+}
+
+bool NodeSortBenchmark::run() {
+    bool ok = true;
+    int percents[] = { 1, 10, 100 };
+    for(int i = 0; i < 3; i++) {
+        ok = runPercent(percents[i], false) && ok;
+        ok = runPercent(percents[i], true) && ok;
+    }
+    return ok;
+}
@@ -0,0 +1,183 @@
+/****************************************************************************
+ Author: Luma (stubma@gmail.com)
+ 
+ https://github.com/stubma/cocos2dx-classical
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#include "ParticleBenchmark.h"
+#include "Benchmark.h"
+#include "particle_nodes/CCParticlePool.h"
+#include <math.h>
+
+USING_NS_CC;
+
+// particles of check and benchmark
+#define CHECK_PARTICLES 1001
+#define CHECK_STEPS 60
+#define BENCH_PARTICLES 10000
+#define BENCH_STEPS 200
+
+// relative tolerance, SIMD sine and cosine are a polynomial
+#define TOLERANCE 1e-4f
+
+// deterministic random, both pools must start from same particles
+static unsigned int s_seed = 1;
+static float random01() {
+    s_seed = s_seed * 1103515245 + 12345;
+    return ((s_seed >> 8) & 0xffff) / 65535.0f;
+}
+static float randomRange(float low, float high) {
+    return low + (high - low) * random01();
+}
+
+// a particle like CCParticleSystem::initParticle makes, it lives longer than check
+static void fillPool(CCParticlePool& pool, unsigned int count) {
+    s_seed = 1;
+    pool.reserve(count);
+    for(unsigned int i = 0; i < count; i++) {
+        tCCParticle p;
+        memset(&p, 0, sizeof(tCCParticle));
+        p.pos = ccp(randomRange(-200, 200), randomRange(-200, 200));
+        p.startPos = ccp(randomRange(-50, 50), randomRange(-50, 50));
+        p.color = ccc4f(random01(), random01(), random01(), random01());
+        p.deltaColor = ccc4f(randomRange(-0.5f, 0.5f), randomRange(-0.5f, 0.5f), randomRange(-0.5f, 0.5f), randomRange(-0.5f, 0.5f));
+        p.size = randomRange(1, 64);
+        p.deltaSize = randomRange(-16, 16);
+        p.rotation = randomRange(-180, 180);
+        p.deltaRotation = randomRange(-90, 90);
+        p.timeToLive = randomRange(5, 10);
+        p.atlasIndex = count - 1 - i;
+        p.modeA.dir = ccp(randomRange(-100, 100), randomRange(-100, 100));
+        p.modeA.radialAccel = randomRange(-50, 50);
+        p.modeA.tangentialAccel = randomRange(-50, 50);
+        p.modeB.angle = randomRange(0, 6.28f);
+        p.modeB.degreesPerSecond = randomRange(-3, 3);
+        p.modeB.radius = randomRange(0, 300);
+        p.modeB.deltaRadius = randomRange(-30, 30);
+        pool.setParticle(i, p);
+    }
+}
+
+// one frame of CCParticleSystem::update, without emitting and removing particles
+static void step(CCParticlePool& pool, unsigned int count, bool radiusMode, ccV3F_C4B_T2F_Quad* quads, bool useAtlasIndex) {
+    float dt = 1 / 60.0f;
+    CCPoint origin = ccp(10, 20);
+    pool.updateLife(count, dt);
+    if(radiusMode)
+        pool.updateRadius(count, dt);
+    else
+        pool.updateGravity(count, dt, ccp(0, -98));
+    pool.updateQuads(quads, count, &origin, ccp(3, 4), useAtlasIndex, true);
+}
+
+static bool nearlyEqual(float a, float b) {
+    return fabsf(a - b) <= TOLERANCE * MAX(1.0f, MAX(fabsf(a), fabsf(b)));
+}
+
+static bool compareVertex(const ccV3F_C4B_T2F& a, const ccV3F_C4B_T2F& b) {
+    return nearlyEqual(a.vertices.x, b.vertices.x) &&
+        nearlyEqual(a.vertices.y, b.vertices.y) &&
+        abs(a.colors.r - b.colors.r) <= 1 &&
+        abs(a.colors.g - b.colors.g) <= 1 &&
+        abs(a.colors.b - b.colors.b) <= 1 &&
+        abs(a.colors.a - b.colors.a) <= 1;
+}
+
+static bool checkMode(bool radiusMode, bool useAtlasIndex) {
+    const char* name = radiusMode ? "radius" : "gravity";
+    CCParticlePool simd, scalar;
+    fillPool(simd, CHECK_PARTICLES);
+    fillPool(scalar, CHECK_PARTICLES);
+    ccV3F_C4B_T2F_Quad* simdQuads = (ccV3F_C4B_T2F_Quad*)calloc(CHECK_PARTICLES, sizeof(ccV3F_C4B_T2F_Quad));
+    ccV3F_C4B_T2F_Quad* scalarQuads = (ccV3F_C4B_T2F_Quad*)calloc(CHECK_PARTICLES, sizeof(ccV3F_C4B_T2F_Quad));
+
+    for(int s = 0; s < CHECK_STEPS; s++) {
+        CCParticlePool::setSIMDEnabled(true);
+        step(simd, CHECK_PARTICLES, radiusMode, simdQuads, useAtlasIndex);
+        CCParticlePool::setSIMDEnabled(false);
+        step(scalar, CHECK_PARTICLES, radiusMode, scalarQuads, useAtlasIndex);
+    }
+    CCParticlePool::setSIMDEnabled(true);
+
+    // state and quads of every particle
+    bool ok = true;
+    for(unsigned int i = 0; i < CHECK_PARTICLES && ok; i++) {
+        tCCParticle a, b;
+        simd.getParticle(i, &a);
+        scalar.getParticle(i, &b);
+        ok = nearlyEqual(a.pos.x, b.pos.x) && nearlyEqual(a.pos.y, b.pos.y) &&
+            nearlyEqual(a.color.r, b.color.r) && nearlyEqual(a.color.a, b.color.a) &&
+            nearlyEqual(a.size, b.size) && nearlyEqual(a.rotation, b.rotation) &&
+            nearlyEqual(a.timeToLive, b.timeToLive) &&
+            nearlyEqual(a.modeA.dir.x, b.modeA.dir.x) && nearlyEqual(a.modeA.dir.y, b.modeA.dir.y) &&
+            nearlyEqual(a.modeB.angle, b.modeB.angle) && nearlyEqual(a.modeB.radius, b.modeB.radius);
+        ok = ok && compareVertex(simdQuads[i].bl, scalarQuads[i].bl) &&
+            compareVertex(simdQuads[i].br, scalarQuads[i].br) &&
+            compareVertex(simdQuads[i].tl, scalarQuads[i].tl) &&
+            compareVertex(simdQuads[i].tr, scalarQuads[i].tr);
+        if(!ok) {
+            CCLOG("ParticleBenchmark: FAILED, %s mode, particle %u differs: simd (%f, %f), scalar (%f, %f)",
+                  name, i, a.pos.x, a.pos.y, b.pos.x, b.pos.y);
+        }
+    }
+
+    free(simdQuads);
+    free(scalarQuads);
+    if(ok)
+        CCLOG("ParticleBenchmark: %s mode, %s, SIMD and scalar results match", name, useAtlasIndex ? "batched" : "unbatched");
+    return ok;
+}
+
+static double timeMode(bool radiusMode, bool simdEnabled) {
+    CCParticlePool pool;
+    fillPool(pool, BENCH_PARTICLES);
+    ccV3F_C4B_T2F_Quad* quads = (ccV3F_C4B_T2F_Quad*)calloc(BENCH_PARTICLES, sizeof(ccV3F_C4B_T2F_Quad));
+    CCParticlePool::setSIMDEnabled(simdEnabled);
+    double start = benchmarkMillis();
+    for(int s = 0; s < BENCH_STEPS; s++) {
+        step(pool, BENCH_PARTICLES, radiusMode, quads, false);
+    }
+    double elapsed = benchmarkMillis() - start;
+    CCParticlePool::setSIMDEnabled(true);
+    free(quads);
+    return elapsed / BENCH_STEPS;
+}
+
+bool ParticleBenchmark::run() {
+    CCParticlePool::setSIMDEnabled(true);
+    if(!CCParticlePool::isSIMDEnabled()) {
+        CCLOG("ParticleBenchmark: SIMD kernels are not compiled in, nothing to compare");
+        return true;
+    }
+
+    bool ok = checkMode(false, false);
+    ok = checkMode(false, true) && ok;
+    ok = checkMode(true, false) && ok;
+    ok = checkMode(true, true) && ok;
+
+    for(int m = 0; m < 2; m++) {
+        bool radiusMode = m == 1;
+        double simdTime = timeMode(radiusMode, true);
+        double scalarTime = timeMode(radiusMode, false);
+        CCLOG("ParticleBenchmark: %s mode, %d particles, scalar %.3f ms, SIMD %.3f ms per frame, %.2fx",
+              radiusMode ? "radius" : "gravity", BENCH_PARTICLES, scalarTime, simdTime, scalarTime / MAX(simdTime, 0.001));
+    }
+    return ok;
+}
@@ -0,0 +1,149 @@
+/****************************************************************************
+ Author: Luma (stubma@gmail.com)
+ 
+ https://github.com/stubma/cocos2dx-classical
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#include "SchedulerBenchmark.h"
+#include "Benchmark.h"
+
+USING_NS_CC;
+
+// simulated frames, 10 seconds at 60 fps
+#define BENCH_FRAMES 600
+#define BENCH_DT (1 / 60.0f)
+
+// the longest interval, one of INTERVAL_EVERY_FRAME timers is updated every frame
+#define MAX_INTERVAL 10.0f
+#define INTERVAL_EVERY_FRAME 100
+
+namespace {
+
+// target of all selectors, counts calls of every timer
+class TimerTarget : public CCObject {
+public:
+    TimerTarget(unsigned int* calls, int index) : m_calls(calls), m_index(index) {}
+    void tick(float dt) {
+        m_calls[m_index]++;
+    }
+
+private:
+    unsigned int* m_calls;
+    int m_index;
+};
+
+} // namespace
+
+static float intervalOf(int i) {
+    if(i % INTERVAL_EVERY_FRAME == 0)
+        return 0;
+    return MAX_INTERVAL * ((i * 7919) % 1000) / 1000.0f;
+}
+
+// calls of a timer which is updated every frame, as scheduler did before timer queue
+static unsigned int expectedCalls(float interval) {
+    unsigned int calls = 0;
+    float elapsed = -1;
+    for(int f = 0; f < BENCH_FRAMES; f++) {
+        if(elapsed == -1) {
+            elapsed = 0;
+        } else {
+            elapsed += BENCH_DT;
+            if(elapsed >= interval) {
+                calls++;
+                elapsed = 0;
+            }
+        }
+    }
+    return calls;
+}
+
+static bool runScheduler(int count, double* frameMillis) {
+    unsigned int* calls = (unsigned int*)calloc(count, sizeof(unsigned int));
+    CCScheduler* scheduler = new CCScheduler();
+    CCArray* targets = CCArray::createWithCapacity(count);
+    for(int i = 0; i < count; i++) {
+        TimerTarget* t = new TimerTarget(calls, i);
+        targets->addObject(t);
+        t->release();
+        scheduler->scheduleSelector(schedule_selector(TimerTarget::tick), t, intervalOf(i), kCCRepeatForever, 0, false);
+    }
+
+    double start = benchmarkMillis();
+    for(int f = 0; f < BENCH_FRAMES; f++) {
+        scheduler->update(BENCH_DT);
+    }
+    *frameMillis = (benchmarkMillis() - start) / BENCH_FRAMES;
+
+    // queue triggers a timer with a delta summed in double, allow one call of difference
+    bool ok = true;
+    for(int i = 0; i < count && ok; i++) {
+        unsigned int expected = expectedCalls(intervalOf(i));
+        ok = calls[i] + 1 >= expected && calls[i] <= expected + 1;
+        if(!ok) {
+            CCLOG("SchedulerBenchmark: FAILED, timer %d with interval %f is called %u times, expected %u",
+                  i, intervalOf(i), calls[i], expected);
+        }
+    }
+
+    scheduler->unscheduleAll();
+    scheduler->release();
+    free(calls);
+    return ok;
+}
+
+// every timer is updated in every frame
+static double runEveryFrame(int count) {
+    unsigned int* calls = (unsigned int*)calloc(count, sizeof(unsigned int));
+    CCArray* timers = CCArray::createWithCapacity(count);
+    CCArray* targets = CCArray::createWithCapacity(count);
+    for(int i = 0; i < count; i++) {
+        TimerTarget* t = new TimerTarget(calls, i);
+        targets->addObject(t);
+        t->release();
+        CCTimer* timer = new CCTimer();
+        timer->initWithTarget(t, schedule_selector(TimerTarget::tick), intervalOf(i), kCCRepeatForever, 0);
+        timers->addObject(timer);
+        timer->release();
+    }
+
+    double start = benchmarkMillis();
+    for(int f = 0; f < BENCH_FRAMES; f++) {
+        for(int i = 0; i < count; i++) {
+            ((CCTimer*)timers->objectAtIndex(i))->update(BENCH_DT);
+        }
+    }
+    double elapsed = (benchmarkMillis() - start) / BENCH_FRAMES;
+    free(calls);
+    return elapsed;
+}
+
+bool SchedulerBenchmark::run() {
+    bool ok = true;
+    int counts[] = { 10000, 100000 };
+    for(int c = 0; c < 2; c++) {
+        double queueTime = 0;
+        ok = runScheduler(counts[c], &queueTime) && ok;
+        double everyFrameTime = runEveryFrame(counts[c]);
+        CCLOG("SchedulerBenchmark: %d timers, every frame %.3f ms, timer queue %.3f ms per frame, %.2fx",
+              counts[c], everyFrameTime, queueTime, everyFrameTime / MAX(queueTime, 0.001));
+    }
+    return ok;
+}
@@ -0,0 +1,384 @@
+/****************************************************************************
+ Author: Luma (stubma@gmail.com)
+
+ https://github.com/stubma/cocos2dx-classical
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#include "CCLuaBytecodeCache.h"
+#include "support/utils/CCUtils.h"
+#include <stdio.h>
+#include <dirent.h>
+
+extern "C" {
+#include "lualib.h"
+#include "lauxlib.h"
+}
+
+// cache entry file extension
+#define ENTRY_EXTENSION ".luacc"
+
+// magic and version of cache entry
+#define ENTRY_MAGIC "CCLB"
+#define ENTRY_VERSION 1
+
+NS_CC_BEGIN
+
+// header of cache entry, followed by bytecode. Entry is never copied to other
+// device so it is saved in native byte order
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t vmSignature;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    uint64_t bytecodeSize;
+} ccLuaBytecodeHeader;
+
+static CCLuaBytecodeCache* s_sharedCache = NULL;
+
+// 64 bits FNV-1a
+static uint64_t hashBytes(const void* data, size_t len, uint64_t h = 14695981039346656037ULL) {
+    const unsigned char* p = (const unsigned char*)data;
+    const unsigned char* end = p + len;
+    for(; p < end; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// lua_Writer which appends to a vector
+static int writeToVector(lua_State* L, const void* p, size_t sz, void* ud) {
+    vector<char>* buf = (vector<char>*)ud;
+    buf->insert(buf->end(), (const char*)p, (const char*)p + sz);
+    return 0;
+}
+
+CCLuaBytecodeCache::CCLuaBytecodeCache() :
+m_vmSignature(0),
+m_preloading(false),
+m_enabled(true) {
+    pthread_mutex_init(&m_preloadMutex, NULL);
+
+    // cache lives in writable path, it must be got in main thread because
+    // android needs jni to get it
+    m_cachePath = CCFileUtils::sharedFileUtils()->getWritablePath() + "luacache/";
+    if(!CCUtils::isPathExistent(m_cachePath)) {
+        CCUtils::createIntermediateFolders(m_cachePath);
+    }
+
+    // VM signature is hash of version string and dump of an empty chunk. Dump
+    // header has everything affects bytecode format, such as VM name, bytecode
+    // version, endian and type sizes
+    m_vmSignature = hashBytes(LUA_RELEASE, strlen(LUA_RELEASE));
+    lua_State* L = luaL_newstate();
+    if(L) {
+        if(luaL_loadbuffer(L, "", 0, "=") == 0) {
+            vector<char> buf;
+            lua_dump(L, writeToVector, &buf);
+            if(!buf.empty()) {
+                m_vmSignature = hashBytes(&buf[0], buf.size(), m_vmSignature);
+            }
+        }
+        lua_close(L);
+    }
+}
+
+CCLuaBytecodeCache::~CCLuaBytecodeCache() {
+    pthread_mutex_destroy(&m_preloadMutex);
+}
+
+CCLuaBytecodeCache* CCLuaBytecodeCache::sharedCache() {
+    if(!s_sharedCache) {
+        s_sharedCache = new CCLuaBytecodeCache();
+    }
+    return s_sharedCache;
+}
+
+unsigned char* CCLuaBytecodeCache::readScript(const string& fullPath, size_t* size) {
+    *size = 0;
+    unsigned char* data = NULL;
+    CC_FILE_DECRYPT_FUNC decFunc = CCScriptEngineManager::sharedManager()->getScriptDecryptFunc();
+    if(decFunc) {
+        data = (unsigned char*)(*decFunc)(fullPath.c_str(), size);
+    }
+    if(!data) {
+        data = CCFileUtils::sharedFileUtils()->getFileData(fullPath.c_str(), "rb", size);
+    }
+    return data;
+}
+
+int CCLuaBytecodeCache::loadBuffer(lua_State* L, const char* chunk, size_t size, const char* chunkName) {
+    // bytecode, or nothing to compile
+    if(!m_enabled || size == 0 || chunk[0] == LUA_SIGNATURE[0]) {
+        return luaL_loadbuffer(L, chunk, size, chunkName);
+    }
+
+    // try cache entry
+    uint64_t sourceHash = hashBytes(chunk, size);
+    string path = getEntryPath(chunkName);
+    if(loadEntry(L, path, sourceHash, size, chunkName)) {
+        return 0;
+    }
+
+    // compile source and save it for next time
+    int ret = luaL_loadbuffer(L, chunk, size, chunkName);
+    if(ret == 0) {
+        saveEntry(L, path, sourceHash, size, ".tmp");
+    }
+    return ret;
+}
+
+void CCLuaBytecodeCache::preload(const vector<string>& files) {
+    if(!m_enabled || files.empty())
+        return;
+
+    // resolve and read here because path mapping, file utils and decrypt function
+    // may need main thread. Bytecode needs no compiling
+    vector<PreloadItem> items;
+    for(vector<string>::const_iterator iter = files.begin(); iter != files.end(); iter++) {
+        PreloadItem item;
+        item.chunkName = CCUtils::getExternalOrFullPath(*iter);
+        item.data = readScript(item.chunkName, &item.size);
+        if(!item.data)
+            continue;
+        if(item.size == 0 || item.data[0] == LUA_SIGNATURE[0]) {
+            delete[] item.data;
+            continue;
+        }
+        items.push_back(item);
+    }
+    if(items.empty())
+        return;
+
+    // queue them, start thread if it is not running
+    pthread_mutex_lock(&m_preloadMutex);
+    m_preloadQueue.insert(m_preloadQueue.end(), items.begin(), items.end());
+    bool start = !m_preloading;
+    m_preloading = true;
+    pthread_mutex_unlock(&m_preloadMutex);
+    if(start) {
+        pthread_t thread;
+        if(pthread_create(&thread, NULL, preloadThread, this) == 0) {
+            pthread_detach(thread);
+        } else {
+            pthread_mutex_lock(&m_preloadMutex);
+            clearPreloadQueue();
+            m_preloading = false;
+            pthread_mutex_unlock(&m_preloadMutex);
+        }
+    }
+}
+
+void CCLuaBytecodeCache::preloadManifest(const string& manifest) {
+    // read manifest
+    size_t size = 0;
+    string fullPath = CCFileUtils::sharedFileUtils()->fullPathForFilename(manifest.c_str());
+    unsigned char* data = CCFileUtils::sharedFileUtils()->getFileData(fullPath.c_str(), "rb", &size);
+    if(!data) {
+        CCLOGWARN("CCLuaBytecodeCache: can't read preload manifest %s", manifest.c_str());
+        return;
+    }
+
+    // one path per line
+    vector<string> files;
+    const char* p = (const char*)data;
+    const char* end = p + size;
+    while(p < end) {
+        const char* lineEnd = p;
+        while(lineEnd < end && *lineEnd != '\n')
+            lineEnd++;
+        string line = CCUtils::trim(string(p, lineEnd - p));
+        if(!line.empty() && line[0] != '#') {
+            files.push_back(line);
+        }
+        p = lineEnd + 1;
+    }
+    delete[] data;
+
+    preload(files);
+}
+
+bool CCLuaBytecodeCache::isPreloading() {
+    pthread_mutex_lock(&m_preloadMutex);
+    bool preloading = m_preloading;
+    pthread_mutex_unlock(&m_preloadMutex);
+    return preloading;
+}
+
+void CCLuaBytecodeCache::clear() {
+    DIR* dir = opendir(m_cachePath.c_str());
+    if(!dir)
+        return;
+    struct dirent* entry;
+    while((entry = readdir(dir)) != NULL) {
+        if(entry->d_name[0] != '.') {
+            CCUtils::deleteFile(m_cachePath + entry->d_name);
+        }
+    }
+    closedir(dir);
+}
+
+string CCLuaBytecodeCache::getEntryPath(const char* chunkName) {
+    // source hash is not in the name, entry of an edited script is overwritten
+    // instead of left behind. Chunk name is saved in bytecode debug info, so same
+    // source under other name has its own entry
+    uint64_t key = hashBytes(chunkName, strlen(chunkName));
+    key = hashBytes(&m_vmSignature, sizeof(m_vmSignature), key);
+    char buf[32];
+    sprintf(buf, "%08x%08x", (unsigned int)(key >> 32), (unsigned int)key);
+    return m_cachePath + buf + ENTRY_EXTENSION;
+}
+
+bool CCLuaBytecodeCache::loadEntry(lua_State* L, const string& path, uint64_t sourceHash, size_t sourceSize, const char* chunkName) {
+    FILE* fp = fopen(path.c_str(), "rb");
+    if(!fp)
+        return false;
+
+    // check header, then load bytecode
+    bool ok = false;
+    ccLuaBytecodeHeader header;
+    if(fread(&header, sizeof(header), 1, fp) == 1 &&
+       !memcmp(header.magic, ENTRY_MAGIC, 4) &&
+       header.version == ENTRY_VERSION &&
+       header.vmSignature == m_vmSignature &&
+       header.sourceHash == sourceHash &&
+       header.sourceSize == sourceSize &&
+       header.bytecodeSize > 0) {
+        char* bytecode = (char*)malloc(header.bytecodeSize);
+        if(bytecode) {
+            if(fread(bytecode, header.bytecodeSize, 1, fp) == 1) {
+                // bytecode must start with signature, otherwise VM compiles it as source
+                if(bytecode[0] == LUA_SIGNATURE[0]) {
+                    if(luaL_loadbuffer(L, bytecode, header.bytecodeSize, chunkName) == 0) {
+                        ok = true;
+                    } else {
+                        lua_pop(L, 1);
+                    }
+                }
+            }
+            free(bytecode);
+        }
+    }
+    fclose(fp);
+
+    // bad or stale entry is deleted, it will be saved again
+    if(!ok) {
+        CCLOG("CCLuaBytecodeCache: discard invalid cache entry of %s", chunkName);
+        CCUtils::deleteFile(path);
+    }
+
+    return ok;
+}
+
+bool CCLuaBytecodeCache::isEntryValid(const string& path, uint64_t sourceHash, size_t sourceSize) {
+    FILE* fp = fopen(path.c_str(), "rb");
+    if(!fp)
+        return false;
+    ccLuaBytecodeHeader header;
+    bool valid = fread(&header, sizeof(header), 1, fp) == 1 &&
+        !memcmp(header.magic, ENTRY_MAGIC, 4) &&
+        header.version == ENTRY_VERSION &&
+        header.vmSignature == m_vmSignature &&
+        header.sourceHash == sourceHash &&
+        header.sourceSize == sourceSize &&
+        fseek(fp, 0, SEEK_END) == 0 &&
+        (uint64_t)ftell(fp) == sizeof(header) + header.bytecodeSize;
+    fclose(fp);
+    return valid;
+}
+
+void CCLuaBytecodeCache::saveEntry(lua_State* L, const string& path, uint64_t sourceHash, size_t sourceSize, const char* tmpSuffix) {
+    // dump function at top
+    vector<char> bytecode;
+    if(lua_dump(L, writeToVector, &bytecode) != 0 || bytecode.empty())
+        return;
+
+    // header
+    ccLuaBytecodeHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ENTRY_MAGIC, 4);
+    header.version = ENTRY_VERSION;
+    header.vmSignature = m_vmSignature;
+    header.sourceHash = sourceHash;
+    header.sourceSize = sourceSize;
+    header.bytecodeSize = bytecode.size();
+
+    // write to a temp file and rename it, so reader never sees a partial entry.
+    // main thread and preload thread use different temp suffix
+    string tmpPath = path + tmpSuffix;
+    FILE* fp = fopen(tmpPath.c_str(), "wb");
+    if(!fp)
+        return;
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+        fwrite(&bytecode[0], bytecode.size(), 1, fp) == 1;
+    ok = fclose(fp) == 0 && ok;
+    if(!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        CCUtils::deleteFile(tmpPath);
+    }
+}
+
+void CCLuaBytecodeCache::compileScript(lua_State* L, PreloadItem& item) {
+    // skip cached script
+    const char* chunk = (const char*)item.data;
+    uint64_t sourceHash = hashBytes(chunk, item.size);
+    string path = getEntryPath(item.chunkName.c_str());
+    if(!isEntryValid(path, sourceHash, item.size)) {
+        if(luaL_loadbuffer(L, chunk, item.size, item.chunkName.c_str()) == 0) {
+            saveEntry(L, path, sourceHash, item.size, ".ptmp");
+        }
+        lua_pop(L, 1);
+    }
+    CC_SAFE_DELETE_ARRAY(item.data);
+}
+
+void CCLuaBytecodeCache::clearPreloadQueue() {
+    for(deque<PreloadItem>::iterator iter = m_preloadQueue.begin(); iter != m_preloadQueue.end(); iter++) {
+        delete[] iter->data;
+    }
+    m_preloadQueue.clear();
+}
+
+void* CCLuaBytecodeCache::preloadThread(void* arg) {
+    CCLuaBytecodeCache* cache = (CCLuaBytecodeCache*)arg;
+
+    // a private lua state, it only compiles so no library is opened
+    lua_State* L = luaL_newstate();
+    while(true) {
+        pthread_mutex_lock(&cache->m_preloadMutex);
+        if(!L || cache->m_preloadQueue.empty()) {
+            cache->clearPreloadQueue();
+            cache->m_preloading = false;
+            pthread_mutex_unlock(&cache->m_preloadMutex);
+            break;
+        }
+        PreloadItem item = cache->m_preloadQueue.front();
+        cache->m_preloadQueue.pop_front();
+        pthread_mutex_unlock(&cache->m_preloadMutex);
+
+        cache->compileScript(L, item);
+    }
+    if(L) {
+        lua_close(L);
+    }
+    return NULL;
+}
+
+NS_CC_END
@@ -0,0 +1,166 @@
+/****************************************************************************
+ Author: Luma (stubma@gmail.com)
+
+ https://github.com/stubma/cocos2dx-classical
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#ifndef __CCLuaBytecodeCache__
+#define __CCLuaBytecodeCache__
+
+#include "cocos2d.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+
+extern "C" {
+#include "lua.h"
+}
+
+using namespace std;
+
+NS_CC_BEGIN
+
+/**
+ * On-device cache of compiled lua chunks. Parsing source is the biggest part of
+ * a require, so the first load of a script dumps its bytecode to writable path and
+ * later loads of same script use that bytecode instead.
+ *
+ * A chunk has one cache entry file, named by chunk name and a signature of the
+ * running VM. The entry header keeps hash and size of plain (decrypted) source, so an
+ * edited or hot updated script fails the check and its entry is replaced in place,
+ * old bytecode never piles up. An app built with other lua backend (LuaJIT or lua)
+ * uses other files. Any problem of entry, such as missing, stale, truncated or
+ * rejected by VM, falls back to compile source silently.
+ *
+ * Cached bytecode is not stripped, error messages still have line numbers.
+ *
+ * @since v2.2
+ */
+class CC_DLL CCLuaBytecodeCache {
+private:
+    CCLuaBytecodeCache();
+
+public:
+    virtual ~CCLuaBytecodeCache();
+    static CCLuaBytecodeCache* sharedCache();
+
+    /**
+     * Read script file data, by script decrypt function if it is set, otherwise
+     * by CCFileUtils.
+     *
+     * @param fullPath full path of script file
+     * @param size return data size
+     * @return script data, caller should delete[] it. NULL if failed
+     */
+    static unsigned char* readScript(const string& fullPath, size_t* size);
+
+    /**
+     * Load a chunk into lua state, same as luaL_loadbuffer but cached. Chunk
+     * which is already bytecode is passed to luaL_loadbuffer directly.
+     *
+     * @param L lua state
+     * @param chunk plain source or bytecode
+     * @param size byte size of chunk
+     * @param chunkName chunk name, it is a part of key
+     * @return same as luaL_loadbuffer, if zero, compiled function is pushed
+     */
+    int loadBuffer(lua_State* L, const char* chunk, size_t size, const char* chunkName);
+
+    /**
+     * Compile scripts in a background thread and save them into cache, so that
+     * later require of them only needs to load bytecode. Scripts are read and decrypted
+     * in caller thread, only compiling is done in background thread.
+     *
+     * @param files script paths, resolved by CCUtils::getExternalOrFullPath, same as
+     *      lua loader. So path should be the one lua loader sees, such as "script/main.lua"
+     */
+    void preload(const vector<string>& files);
+
+    /**
+     * Preload scripts listed in a manifest file. Manifest is plain text, one script
+     * path per line, empty line and line starts with '#' are ignored.
+     *
+     * @param manifest path of manifest file
+     */
+    void preloadManifest(const string& manifest);
+
+    /// is there preloading work in progress
+    bool isPreloading();
+
+    /// delete all cache entries, for example, after scripts are updated
+    void clear();
+
+    /// cache directory
+    const string& getCachePath() { return m_cachePath; }
+
+private:
+    /// path of cache entry of a chunk
+    string getEntryPath(const char* chunkName);
+
+    /// try loading a cache entry, if ok, compiled function is pushed
+    bool loadEntry(lua_State* L, const string& path, uint64_t sourceHash, size_t sourceSize, const char* chunkName);
+
+    /// is a cache entry valid for a source
+    bool isEntryValid(const string& path, uint64_t sourceHash, size_t sourceSize);
+
+    /// dump function at stack top into a cache entry
+    void saveEntry(lua_State* L, const string& path, uint64_t sourceHash, size_t sourceSize, const char* tmpSuffix);
+
+    /// script read by preload, waiting for compiling
+    struct PreloadItem {
+        string chunkName;
+        unsigned char* data;
+        size_t size;
+    };
+    
+    /// compile a script and save it, used by preload thread. Data of item is deleted
+    void compileScript(lua_State* L, PreloadItem& item);
+
+    /// delete queued scripts, caller should hold preload lock
+    void clearPreloadQueue();
+
+    /// preload thread entry
+    static void* preloadThread(void* arg);
+
+private:
+    /// cache entries directory, ends with a slash
+    string m_cachePath;
+
+    /// signature of VM and bytecode format
+    uint64_t m_vmSignature;
+
+    /// scripts waiting for preload
+    deque<PreloadItem> m_preloadQueue;
+
+    /// is preload thread running
+    bool m_preloading;
+
+    /// lock of preload queue
+    pthread_mutex_t m_preloadMutex;
+
+    /// enable cache or not, by default it is true
+    CC_SYNTHESIZE_BOOL(m_enabled, Enabled);
+};
+
+NS_CC_END
+
+#endif /* defined(__CCLuaBytecodeCache__) */
@@ -38,6 +38,7 @@ extern "C" {
 #include "lua_cocos2dx_auto.h"
 #include "lua_cocos2dx_manual.h"
 #include "Cocos2dxLuaLoader.h"
+#include "CCLuaBytecodeCache.h"
 #include "LuaBasicConversions.h"
 
 #if (CC_TARGET_PLATFORM == CC_PLATFORM_IOS || CC_TARGET_PLATFORM == CC_PLATFORM_MAC)
@@ -204,38 +205,30 @@ int CCLuaStack::executeString(const char *codes)
 
 int CCLuaStack::executeScriptFile(const char* filename)
 {
+    CC_MEMORY_TAG(kCCMemoryTagLua);
+
     // get full path of file
     std::string fullPath = CCFileUtils::sharedFileUtils()->fullPathForFilename(filename);
     
     // load file, if has decrypt function, decrypt it
     size_t codeBufferSize = 0;
-    CC_FILE_DECRYPT_FUNC decFunc = CCScriptEngineManager::sharedManager()->getScriptDecryptFunc();
-    unsigned char* codeBuffer = NULL;
-    if(decFunc) {
-        codeBuffer = (unsigned char*)(*decFunc)(fullPath.c_str(), &codeBufferSize);
-    }
+    unsigned char* codeBuffer = CCLuaBytecodeCache::readScript(fullPath, &codeBufferSize);
     if(!codeBuffer) {
-        codeBuffer = CCFileUtils::sharedFileUtils()->getFileData(fullPath.c_str(), "rb", &codeBufferSize);
+        CCLOG("[LUA ERROR] can not get file data of %s", fullPath.c_str());
+        return 1;
     }
     
-    // copy buffer to ensure zero terminated
-    char* tmp = (char*)malloc(sizeof(char) * (codeBufferSize + 1));
-    memcpy(tmp, codeBuffer, codeBufferSize);
-    tmp[codeBufferSize] = 0;
-    
-    // do string
+    // compile it, or load cached bytecode, then run
     ++m_callFromLua;
-    int nRet = luaL_dostring(m_state, tmp);
+    int nRet = CCLuaBytecodeCache::sharedCache()->loadBuffer(m_state, (const char*)codeBuffer, codeBufferSize, fullPath.c_str());
+    if(nRet == 0) {
+        nRet = lua_pcall(m_state, 0, LUA_MULTRET, 0);
+    }
     --m_callFromLua;
     CC_ASSERT(m_callFromLua >= 0);
     
     // release
-    if(codeBuffer) {
-        delete[] codeBuffer;
-    }
-    if(tmp) {
-        free(tmp);
-    }
+    delete[] codeBuffer;
     
     // check return
     if (nRet != 0) {
@@ -416,6 +409,8 @@ void CCLuaStack::executeObjectDestructor(CCObject* obj) {
 
 int CCLuaStack::executeFunction(int numArgs, CCObject* collector, SEL_ScriptReturnedValueCollector sel)
 {
+    CC_MEMORY_TAG(kCCMemoryTagLua);
+
     int functionIndex = -(numArgs + 1);
     if (!lua_isfunction(m_state, functionIndex))
     {
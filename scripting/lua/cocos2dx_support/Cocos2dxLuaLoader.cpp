@@ -25,6 +25,7 @@ THE SOFTWARE.
 #include <string>
 #include <algorithm>
 #include "support/utils/CCUtils.h"
+#include "CCLuaBytecodeCache.h"
 
 using namespace cocos2d;
 
@@ -67,18 +68,11 @@ extern "C"
             filepath = CCUtils::getExternalOrFullPath(filepath);
         }
         
-        // load lua file
+        // load lua file, compiled chunk is cached
         size_t codeBufferSize = 0;
-        CC_FILE_DECRYPT_FUNC decFunc = CCScriptEngineManager::sharedManager()->getScriptDecryptFunc();
-        unsigned char* codeBuffer = NULL;
-        if(decFunc) {
-            codeBuffer = (unsigned char*)(*decFunc)(filepath.c_str(), &codeBufferSize);
-        }
-        if(!codeBuffer) {
-            codeBuffer = CCFileUtils::sharedFileUtils()->getFileData(filepath.c_str(), "rb", &codeBufferSize);
-        }
+        unsigned char* codeBuffer = CCLuaBytecodeCache::readScript(filepath, &codeBufferSize);
         if (codeBuffer) {
-            if (luaL_loadbuffer(L, (char*)codeBuffer, codeBufferSize, filepath.c_str()) != 0) {
+            if (CCLuaBytecodeCache::sharedCache()->loadBuffer(L, (char*)codeBuffer, codeBufferSize, filepath.c_str()) != 0) {
                 CCLOG("error loading module %s from file %s :\n\t%s",
                       lua_tostring(L, 1), filepath.c_str(), lua_tostring(L, -1));
             }
@@ -0,0 +1,191 @@
+# coding:utf8
+#!/usr/bin/python
+
+from __future__ import print_function
+
+import sys
+import os
+import re
+import getopt
+import struct
+import plistlib
+
+# keep same with cocos2dx/sprite_nodes/CCSpriteSheetFormat.h
+CCSF_MAGIC = b'CCSF'
+CCSF_VERSION = 1
+CCSF_NO_STRING = 0xffffffff
+CCSF_FRAME_ROTATED = 0x1
+HEADER_FORMAT = '<4sHHIIII'
+FRAME_FORMAT = '<II8fI'
+ALIAS_FORMAT = '<III'
+
+
+def help():
+    print('#####################################################')
+    print('# Usage of compiled sprite sheet tool')
+    print('# plist2ccsf [options]')
+    print('# Options:')
+    print('# [-s|--source] file or folder')
+    print('#     zwoptex/TexturePacker plist file, or a directory in which all sprite sheet plist')
+    print('#     files will be converted')
+    print('# [-o|--output] folder')
+    print('#     output root directory, .ccsf file will be saved here, keep the same folder')
+    print('#     hierarchy with source. If not set, .ccsf is saved beside plist')
+    print('# [-f|--force]')
+    print('#     if set, same files in output directory will be overridden')
+    print('# [-h|--help]')
+    print('#     show command usage, or just don\'t specify any arguments')
+
+
+def hash_name(name):
+    # 32 bits FNV-1a, same as ccSpriteSheetHashName
+    h = 2166136261
+    for b in bytearray(name):
+        h ^= b
+        h = (h * 16777619) & 0xffffffff
+    return h
+
+
+def parse_numbers(s):
+    # "{{x,y},{w,h}}", "{x,y}" or "{w,h}"
+    return [float(n) for n in re.findall(r'-?[0-9]*\.?[0-9]+(?:[eE][-+]?[0-9]+)?', s)]
+
+
+def read_plist(path):
+    if hasattr(plistlib, 'load'):
+        with open(path, 'rb') as f:
+            return plistlib.load(f)
+    return plistlib.readPlist(path)
+
+
+def convert_frame(fmt, frame):
+    # returns rect, rotated, offset, source size, aliases. Same as
+    # CCSpriteFrameCache::addSpriteFramesWithDictionary
+    if fmt == 0:
+        rect = [float(frame.get('x', 0)), float(frame.get('y', 0)),
+                float(frame.get('width', 0)), float(frame.get('height', 0))]
+        offset = [float(frame.get('offsetX', 0)), float(frame.get('offsetY', 0))]
+        source = [float(abs(int(frame.get('originalWidth', 0)))), float(abs(int(frame.get('originalHeight', 0))))]
+        return rect, False, offset, source, []
+    elif fmt == 1 or fmt == 2:
+        rect = parse_numbers(frame['frame'])
+        rotated = fmt == 2 and bool(frame.get('rotated', False))
+        offset = parse_numbers(frame['offset'])
+        source = parse_numbers(frame['sourceSize'])
+        return rect, rotated, offset, source, []
+    else:
+        size = parse_numbers(frame['spriteSize'])
+        offset = parse_numbers(frame['spriteOffset'])
+        source = parse_numbers(frame['spriteSourceSize'])
+        texRect = parse_numbers(frame['textureRect'])
+        rotated = bool(frame.get('textureRotated', False))
+        rect = [texRect[0], texRect[1], size[0], size[1]]
+        return rect, rotated, offset, source, list(frame.get('aliases', []))
+
+
+def convert(src, dst):
+    root = read_plist(src)
+    if 'frames' not in root:
+        print('file "%s" is not a sprite sheet, skip' % src)
+        return False
+    metadata = root.get('metadata', {})
+    fmt = int(metadata.get('format', 0))
+    if fmt < 0 or fmt > 3:
+        print('file "%s" has unsupported format %d, skip' % (src, fmt))
+        return False
+
+    # string pool
+    pool = bytearray()
+    pool_index = {}
+
+    def add_string(s):
+        b = s.encode('utf-8')
+        if b not in pool_index:
+            pool_index[b] = len(pool)
+            pool.extend(b + b'\0')
+        return pool_index[b]
+
+    # frames sorted by hash, name breaks tie so output is stable
+    names = sorted(root['frames'].keys(), key=lambda n: (hash_name(n.encode('utf-8')), n))
+    frames = []
+    aliases = []
+    for i, name in enumerate(names):
+        rect, rotated, offset, source, frameAliases = convert_frame(fmt, root['frames'][name])
+        frames.append(struct.pack(FRAME_FORMAT, hash_name(name.encode('utf-8')), add_string(name),
+                                  rect[0], rect[1], rect[2], rect[3], offset[0], offset[1],
+                                  source[0], source[1], rotated and CCSF_FRAME_ROTATED or 0))
+        for alias in frameAliases:
+            aliases.append((hash_name(alias.encode('utf-8')), alias, i))
+    aliases.sort(key=lambda a: (a[0], a[1]))
+    aliasRecords = [struct.pack(ALIAS_FORMAT, h, add_string(a), i) for h, a, i in aliases]
+
+    textureName = CCSF_NO_STRING
+    if metadata.get('textureFileName'):
+        textureName = add_string(metadata['textureFileName'])
+
+    header = struct.pack(HEADER_FORMAT, CCSF_MAGIC, CCSF_VERSION, 0, len(frames), len(aliasRecords),
+                         textureName, len(pool))
+    with open(dst, 'wb') as f:
+        f.write(header)
+        f.write(b''.join(frames))
+        f.write(b''.join(aliasRecords))
+        f.write(bytes(pool))
+    print('converted "%s", %d frames, %d aliases' % (src, len(frames), len(aliasRecords)))
+    return True
+
+
+def visit(src, out):
+    if os.path.isdir(src):
+        outPath = out and os.path.join(out, os.path.basename(src)) or None
+        if outPath and not os.path.exists(outPath):
+            os.makedirs(outPath)
+        for f in os.listdir(src):
+            visit(os.path.join(src, f), outPath)
+    elif os.path.splitext(src)[1] == '.plist':
+        dst = os.path.splitext(os.path.join(out or os.path.dirname(src), os.path.basename(src)))[0] + '.ccsf'
+        if os.path.exists(dst) and not arg_force:
+            print('file "%s" exists, skip' % dst)
+        else:
+            convert(src, dst)
+
+# options process
+shortOpts = 's:o:fh'
+longOpts = ['source=', 'output=', 'force', 'help']
+opts, args = getopt.getopt(sys.argv[1:], shortOpts, longOpts)
+
+# if no argument, help
+if len(sys.argv) <= 1:
+    help()
+    sys.exit()
+
+# parse arguments
+arg_source = None
+arg_output = None
+arg_force = False
+for k, v in opts:
+    if k in ('-s', '--source'):
+        arg_source = v
+    elif k in ('-o', '--output'):
+        arg_output = v
+    elif k in ('-f', '--force'):
+        arg_force = True
+    elif k in ('-h', '--help'):
+        help()
+        sys.exit()
+
+# check source
+if arg_source is None:
+    print('must specify source file or directory')
+    sys.exit()
+if arg_source[-1] == '/' and len(arg_source) > 1:
+    arg_source = arg_source[:-1]
+arg_source = os.path.expanduser(arg_source)
+
+# check output
+if arg_output is not None:
+    arg_output = os.path.expanduser(arg_output)
+    if not os.path.exists(arg_output):
+        os.makedirs(arg_output)
+
+visit(arg_source, arg_output)
+print('done')